@@ -0,0 +1,324 @@
+#include "dataset.h"
+#include "db_internal.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr long long kBatchTransactions = 50000;
+
+    // 营业时间8点到22点，午间和傍晚两个高峰
+    constexpr double kHourWeights[24] = {
+        0, 0, 0, 0, 0, 0, 0, 0,
+        2, 4, 6, 9, 10, 7, 5, 5, 6, 9, 10, 8, 5, 3, 0, 0,
+    };
+    // 周日到周六，周末客流更大
+    constexpr double kWeekdayWeights[7] = {1.35, 0.9, 0.9, 0.95, 1.0, 1.15, 1.4};
+
+    // 购物车行数分布：下标为行数
+    constexpr double kBasketWeights[] = {0, 30, 22, 15, 10, 8, 5, 4, 3, 1.5, 1, 0.5};
+
+    const char* const kReturnReasons[] = {"质量问题", "买错了", "不想要了", "包装破损", "过期"};
+
+    class ZipfSampler
+    {
+    public:
+        ZipfSampler(const int n, const double s)
+        {
+            double sum = 0;
+            m_cdf.reserve(n);
+            for (int rank = 1; rank <= n; ++rank)
+            {
+                sum += 1.0 / std::pow(rank, s);
+                m_cdf.push_back(sum);
+            }
+            for (double& value : m_cdf)
+                value /= sum;
+        }
+
+        // 返回热度排名，从0开始
+        int sample(std::mt19937_64& rng) const
+        {
+            const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            const auto it = std::lower_bound(m_cdf.begin(), m_cdf.end(), u);
+            return static_cast<int>(std::min<size_t>(it - m_cdf.begin(), m_cdf.size() - 1));
+        }
+
+    private:
+        std::vector<double> m_cdf;
+    };
+
+    struct Statements
+    {
+        sqlite3_stmt* product = nullptr;
+        sqlite3_stmt* transaction = nullptr;
+        sqlite3_stmt* item = nullptr;
+        sqlite3_stmt* refund = nullptr;
+
+        ~Statements()
+        {
+            sqlite3_finalize(product);
+            sqlite3_finalize(transaction);
+            sqlite3_finalize(item);
+            sqlite3_finalize(refund);
+        }
+
+        bool prepare()
+        {
+            return sqlite3_prepare_v2(db, "INSERT INTO products (id, name, price, stock, alert_threshold, barcode) "
+                                      "VALUES (?, ?, ?, ?, ?, ?);", -1, &product, nullptr) == SQLITE_OK &&
+                sqlite3_prepare_v2(db, "INSERT INTO transactions (transaction_id, create_time, is_paid, total_price, "
+                                   "amount_paid, change) VALUES (?, ?, 1, ?, ?, ?);", -1, &transaction,
+                                   nullptr) == SQLITE_OK &&
+                sqlite3_prepare_v2(db, "INSERT INTO cart_items (transaction_id, product_id, quantity, "
+                                   "returned_quantity, subtotal) VALUES (?, ?, ?, ?, ?);", -1, &item,
+                                   nullptr) == SQLITE_OK &&
+                sqlite3_prepare_v2(db, "INSERT INTO returns (transaction_id, product_id, quantity, reason, "
+                                   "return_time) VALUES (?, ?, ?, ?, ?);", -1, &refund, nullptr) == SQLITE_OK;
+        }
+    };
+
+    bool step_done(sqlite3_stmt* stmt)
+    {
+        const int rc = sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            fprintf(stderr, "写入测试数据失败: %s\n", sqlite3_errmsg(db));
+            return false;
+        }
+        return true;
+    }
+
+    double round_cents(const double value)
+    {
+        return std::round(value * 100.0) / 100.0;
+    }
+
+    // 按本地时区取某天零点，日内时段分布以收银机所在时区为准
+    std::int64_t local_midnight(const std::int64_t end_time, const int days_before)
+    {
+        const time_t end = static_cast<time_t>(end_time);
+        std::tm tm = *localtime(&end);
+        tm.tm_mday -= days_before;
+        tm.tm_hour = 0;
+        tm.tm_min = 0;
+        tm.tm_sec = 0;
+        tm.tm_isdst = -1;
+        return static_cast<std::int64_t>(mktime(&tm));
+    }
+
+    // 把交易总数按星期权重分配到每一天，余数按顺序累积，保证总数精确
+    std::vector<long long> daily_counts(const DatasetSpec& spec, std::vector<std::int64_t>& day_starts)
+    {
+        std::vector<double> weights;
+        double total_weight = 0;
+        for (int d = spec.days; d >= 1; --d)
+        {
+            const std::int64_t start = local_midnight(spec.end_time, d);
+            const time_t t = static_cast<time_t>(start);
+            const double weight = kWeekdayWeights[localtime(&t)->tm_wday];
+            day_starts.push_back(start);
+            weights.push_back(weight);
+            total_weight += weight;
+        }
+
+        std::vector<long long> counts;
+        double carry = 0;
+        long long assigned = 0;
+        for (const double weight : weights)
+        {
+            carry += static_cast<double>(spec.transactions) * weight / total_weight;
+            const long long count = static_cast<long long>(carry) - assigned;
+            counts.push_back(count);
+            assigned += count;
+        }
+        counts.back() += spec.transactions - assigned;
+        return counts;
+    }
+}
+
+bool dataset_preset(const std::string& name, DatasetSpec& spec)
+{
+    if (name == "small")
+    {
+        spec.products = 1000;
+        spec.transactions = 10000;
+    }
+    else if (name == "medium")
+    {
+        spec.products = 10000;
+        spec.transactions = 1000000;
+    }
+    else if (name == "large")
+    {
+        spec.products = 100000;
+        spec.transactions = 10000000;
+    }
+    else
+        return false;
+    return true;
+}
+
+std::string dataset_barcode(const int id)
+{
+    char digits[14];
+    snprintf(digits, sizeof(digits), "690%09d", id);
+    int sum = 0;
+    for (int i = 0; i < 12; ++i)
+        sum += (digits[i] - '0') * (i % 2 ? 3 : 1);
+    digits[12] = static_cast<char>('0' + (10 - sum % 10) % 10);
+    digits[13] = '\0';
+    return digits;
+}
+
+bool generate_dataset(const DatasetSpec& spec, DatasetStats* stats, void (*progress)(long long, long long))
+{
+    const auto begin = std::chrono::steady_clock::now();
+    DatasetStats local;
+    std::mt19937_64 rng(spec.seed);
+
+    Statements statements;
+    if (!statements.prepare())
+    {
+        fprintf(stderr, "编译数据生成语句失败: %s\n", sqlite3_errmsg(db));
+        return false;
+    }
+    if (!begin_bulk_load())
+        return false;
+
+    // 商品：价格对数均匀分布在1到500元，热度排名与商品ID随机对应
+    std::vector<int> rank_to_id(spec.products);
+    std::vector<double> prices(spec.products + 1);
+    for (int i = 0; i < spec.products; ++i)
+        rank_to_id[i] = i + 1;
+    std::shuffle(rank_to_id.begin(), rank_to_id.end(), rng);
+
+    bool ok = sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    std::uniform_real_distribution<double> log_price(std::log(1.0), std::log(500.0));
+    std::uniform_int_distribution<int> stock_level(0, 500);
+    std::uniform_int_distribution<int> threshold(5, 20);
+    char name[32];
+    for (int id = 1; ok && id <= spec.products; ++id)
+    {
+        prices[id] = round_cents(std::exp(log_price(rng)));
+        snprintf(name, sizeof(name), "商品%06d", id);
+        sqlite3_bind_int(statements.product, 1, id);
+        sqlite3_bind_text(statements.product, 2, name, -1, SQLITE_TRANSIENT);
+        sqlite3_bind_double(statements.product, 3, prices[id]);
+        sqlite3_bind_int(statements.product, 4, stock_level(rng));
+        sqlite3_bind_int(statements.product, 5, threshold(rng));
+        sqlite3_bind_text(statements.product, 6, dataset_barcode(id).c_str(), -1, SQLITE_TRANSIENT);
+        ok = step_done(statements.product);
+        ++local.products;
+    }
+
+    const ZipfSampler popularity(spec.products, spec.zipf);
+    std::discrete_distribution<int> basket_lines(std::begin(kBasketWeights), std::end(kBasketWeights));
+    std::discrete_distribution<int> hour_of_day(std::begin(kHourWeights), std::end(kHourWeights));
+    std::discrete_distribution<int> quantity({0, 70, 20, 5, 3, 2});
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_int_distribution<int> second_of_hour(0, 3599);
+    std::uniform_int_distribution<int> return_delay(600, 7 * 86400);
+    std::uniform_int_distribution<int> reason(0, std::size(kReturnReasons) - 1);
+
+    std::vector<std::int64_t> day_starts;
+    const std::vector<long long> counts = daily_counts(spec, day_starts);
+    long long transaction_id = 0;
+    std::vector<std::int64_t> times;
+    std::map<int, int> basket;
+    for (size_t day = 0; ok && day < counts.size(); ++day)
+    {
+        // 先生成当天所有时间点并排序，使交易ID随时间递增
+        times.clear();
+        for (long long i = 0; i < counts[day]; ++i)
+            times.push_back(day_starts[day] + hour_of_day(rng) * 3600LL + second_of_hour(rng));
+        std::sort(times.begin(), times.end());
+
+        for (const std::int64_t create_time : times)
+        {
+            ++transaction_id;
+            basket.clear();
+            const int lines = basket_lines(rng);
+            for (int i = 0; i < lines; ++i)
+                basket[rank_to_id[popularity.sample(rng)]] += quantity(rng);
+
+            double total = 0;
+            for (const auto& [product_id, count] : basket)
+                total += round_cents(prices[product_id] * count);
+            total = round_cents(total);
+            const double paid = std::ceil(total);
+
+            // 退货只涉及一行，退回该行的部分或全部数量，按售价退款
+            const bool has_return = chance(rng) < spec.return_rate;
+            auto returned_line = basket.begin();
+            int returned_quantity = 0;
+            if (has_return)
+            {
+                std::advance(returned_line, std::uniform_int_distribution<size_t>(0, basket.size() - 1)(rng));
+                returned_quantity = std::uniform_int_distribution<int>(1, returned_line->second)(rng);
+            }
+            const double refund = has_return ? round_cents(prices[returned_line->first] * returned_quantity) : 0;
+
+            sqlite3_bind_int64(statements.transaction, 1, transaction_id);
+            sqlite3_bind_int64(statements.transaction, 2, create_time);
+            sqlite3_bind_double(statements.transaction, 3, round_cents(total - refund));
+            sqlite3_bind_double(statements.transaction, 4, paid);
+            sqlite3_bind_double(statements.transaction, 5, round_cents(paid - total));
+            ok = step_done(statements.transaction);
+
+            for (auto it = basket.begin(); ok && it != basket.end(); ++it)
+            {
+                sqlite3_bind_int64(statements.item, 1, transaction_id);
+                sqlite3_bind_int(statements.item, 2, it->first);
+                sqlite3_bind_int(statements.item, 3, it->second);
+                sqlite3_bind_int(statements.item, 4, has_return && it == returned_line ? returned_quantity : 0);
+                sqlite3_bind_double(statements.item, 5, round_cents(prices[it->first] * it->second));
+                ok = step_done(statements.item);
+                ++local.cart_items;
+            }
+
+            if (ok && has_return)
+            {
+                const std::int64_t return_time = std::min(create_time + return_delay(rng), spec.end_time);
+                sqlite3_bind_int64(statements.refund, 1, transaction_id);
+                sqlite3_bind_int(statements.refund, 2, returned_line->first);
+                sqlite3_bind_int(statements.refund, 3, returned_quantity);
+                sqlite3_bind_text(statements.refund, 4, kReturnReasons[reason(rng)], -1, SQLITE_STATIC);
+                sqlite3_bind_int64(statements.refund, 5, std::max(return_time, create_time));
+                ok = step_done(statements.refund);
+                ++local.returns;
+            }
+            ++local.transactions;
+
+            if (ok && transaction_id % kBatchTransactions == 0)
+            {
+                ok = sqlite3_exec(db, "COMMIT; BEGIN;", nullptr, nullptr, nullptr) == SQLITE_OK;
+                if (progress)
+                    progress(transaction_id, spec.transactions);
+            }
+            if (!ok)
+                break;
+        }
+    }
+
+    if (ok)
+        ok = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    else
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+    if (progress && ok)
+        progress(spec.transactions, spec.transactions);
+
+    // 无论成功与否都恢复正常模式，保证连接仍可继续使用
+    const bool restored = end_bulk_load();
+    local.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (stats)
+        *stats = local;
+    return ok && restored;
+}
@@ -0,0 +1,38 @@
+#ifndef DATASET_H
+#define DATASET_H
+#include <cstdint>
+#include <string>
+
+// 可复现的测试数据集：相同参数和种子总是生成完全相同的数据库内容，
+// 供基准测试、界面压力测试和迁移测试共用
+struct DatasetSpec
+{
+    int products = 1000;
+    long long transactions = 10000;
+    int days = 365;                  // 交易时间覆盖的天数
+    double zipf = 1.1;               // 商品热度的Zipf指数，越大越集中于少数爆款
+    double return_rate = 0.02;       // 发生退货的交易比例
+    std::uint64_t seed = 42;
+    std::int64_t end_time = 1735689600;  // 时间范围终点（默认2025-01-01 00:00 UTC），固定以保证可复现
+};
+
+struct DatasetStats
+{
+    long long products = 0;
+    long long transactions = 0;
+    long long cart_items = 0;
+    long long returns = 0;
+    double seconds = 0;
+};
+
+// 预设规模：small 1k商品/1万笔，medium 1万商品/100万笔，large 10万商品/1000万笔
+bool dataset_preset(const std::string& name, DatasetSpec& spec);
+
+// 商品id对应的EAN-13条码，由id确定，不消耗随机数，不影响其余数据
+std::string dataset_barcode(int id);
+
+// 向当前连接（init_db打开的空库）批量写入数据集，progress非空时每提交一批调用一次
+bool generate_dataset(const DatasetSpec& spec, DatasetStats* stats = nullptr,
+                      void (*progress)(long long done, long long total) = nullptr);
+
+#endif // DATASET_H
@@ -0,0 +1,466 @@
+// 数据层基准测试：在生成的数据集上重复执行数据层入口函数，
+// 以JSON Lines格式输出每项测试的吞吐量和延迟分位数
+//
+// 用法: sales_bench [--tiers 1000x5000,10000x50000] [--iterations 2000] [--seed 42]
+//                   [--out sales_bench.jsonl] [--dir .] [--stats query_stats.json]
+
+#include "asyncdb.h"
+#include "backup.h"
+#include "catalog.h"
+#include "database.h"
+#include "dataset.h"
+#include "detailcache.h"
+#include "journal.h"
+#include "maintenance.h"
+#include "promotion.h"
+#include "querystats.h"
+#include "replication.h"
+#include "saleslog.h"
+#include "startup.h"
+#include "db_internal.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef SALES_SQLITE_BUILD
+#define SALES_SQLITE_BUILD "system"
+#endif
+
+namespace
+{
+    struct Tier
+    {
+        int products;
+        int transactions;
+    };
+
+    struct Options
+    {
+        std::vector<Tier> tiers = {{1000, 5000}, {10000, 50000}};
+        int iterations = 2000;
+        unsigned seed = 42;
+        std::string out = "sales_bench.jsonl";
+        std::string dir = ".";
+        std::string stats;  // 非空时在结束后写入数据层查询统计
+    };
+
+    bool parse_tiers(const std::string& text, std::vector<Tier>& tiers)
+    {
+        tiers.clear();
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find(',', start);
+            if (end == std::string::npos) end = text.size();
+            const std::string item = text.substr(start, end - start);
+            const size_t x = item.find('x');
+            if (x == std::string::npos) return false;
+            const int products = std::atoi(item.substr(0, x).c_str());
+            const int transactions = std::atoi(item.substr(x + 1).c_str());
+            if (products <= 0 || transactions < 0) return false;
+            tiers.push_back({products, transactions});
+            start = end + 1;
+        }
+        return !tiers.empty();
+    }
+
+    bool parse_options(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (arg == "--tiers" && has_value)
+            {
+                if (!parse_tiers(argv[++i], options.tiers)) return false;
+            }
+            else if (arg == "--iterations" && has_value)
+                options.iterations = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--seed" && has_value)
+                options.seed = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--out" && has_value)
+                options.out = argv[++i];
+            else if (arg == "--dir" && has_value)
+                options.dir = argv[++i];
+            else if (arg == "--stats" && has_value)
+                options.stats = argv[++i];
+            else
+                return false;
+        }
+        return true;
+    }
+
+    struct Result
+    {
+        double ops_per_sec;
+        double p50_us;
+        double p99_us;
+        double max_us;
+    };
+
+    Result measure(const int iterations, const std::function<void(int)>& operation)
+    {
+        using Clock = std::chrono::steady_clock;
+        std::vector<double> samples;
+        samples.reserve(iterations);
+
+        const auto begin = Clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            const auto start = Clock::now();
+            operation(i);
+            samples.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+        }
+        const double total_sec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](const double p)
+        {
+            const size_t index = static_cast<size_t>(p * static_cast<double>(samples.size() - 1));
+            return samples[index];
+        };
+        return {iterations / total_sec, percentile(0.50), percentile(0.99), samples.back()};
+    }
+
+    void report(FILE* out, const char* name, const Tier& tier, const int iterations, const Result& result)
+    {
+        fprintf(out,
+                "{\"bench\":\"%s\",\"products\":%d,\"transactions\":%d,\"iterations\":%d,"
+                "\"ops_per_sec\":%.1f,\"p50_us\":%.2f,\"p99_us\":%.2f,\"max_us\":%.2f,"
+                "\"sqlite_version\":\"%s\",\"sqlite_build\":\"%s\"}\n",
+                name, tier.products, tier.transactions, iterations,
+                result.ops_per_sec, result.p50_us, result.p99_us, result.max_us, sqlite3_libversion(),
+                SALES_SQLITE_BUILD);
+        fflush(out);
+        fprintf(stderr, "%-32s %7d/%-8d %12.1f ops/s  p50 %9.2fus  p99 %9.2fus\n",
+                name, tier.products, tier.transactions, result.ops_per_sec, result.p50_us, result.p99_us);
+    }
+
+    bool run_tier(const Options& options, const Tier& tier, FILE* out)
+    {
+        const std::string path = options.dir + "/sales_bench_" + std::to_string(tier.products) + "x" +
+            std::to_string(tier.transactions) + ".db";
+        for (const char* suffix : {"", "-wal", "-shm", ".saleslog", ".catalog", ".hq", ".hq-wal", ".hq-shm"})
+            std::remove((path + suffix).c_str());
+        std::error_code ec;
+        std::filesystem::remove_all(path + ".backups", ec);
+
+        if (!init_db(path))
+            return false;
+
+        // 准备阶段走批量导入路径，不经过被测函数
+        DatasetSpec spec;
+        spec.products = tier.products;
+        spec.transactions = tier.transactions;
+        spec.seed = options.seed;
+        if (!generate_dataset(spec))
+            return false;
+        // 补足库存，save_transaction测试不因售罄而走拒绝分支
+        sqlite3_exec(db, "UPDATE products SET stock = 1000000;", nullptr, nullptr, nullptr);
+
+        // 打开销售日志，save_transaction与add_return的耗时包含提交后的日志追加
+        if (!open_sales_log(path + ".saleslog"))
+            return false;
+
+        std::mt19937 rng(options.seed);
+
+        std::uniform_int_distribution<int> product_dist(1, tier.products);
+        std::uniform_int_distribution<int> transaction_dist(1, std::max(1, tier.transactions));
+        const int iterations = options.iterations;
+        // 全表读取的代价随规模增长，迭代次数相应减少
+        const int scan_iterations = std::max(5, iterations / std::max(1, tier.products / 100));
+
+        report(out, "query_product", tier, iterations, measure(iterations, [&](int)
+        {
+            query_product(product_dist(rng));
+        }));
+
+        report(out, "get_all_products", tier, scan_iterations, measure(scan_iterations, [&](int)
+        {
+            get_all_products();
+        }));
+
+        // 扫码查商品：未打开快照时走条码唯一索引
+        report(out, "query_product_by_barcode", tier, iterations, measure(iterations, [&](int)
+        {
+            query_product_by_barcode(dataset_barcode(product_dist(rng)));
+        }));
+
+        // 目录快照：打开（映射并核对版本）与经由快照读取商品列表
+        if (!open_catalog_snapshot(path + ".catalog"))
+            return false;
+        report(out, "open_catalog_snapshot", tier, iterations, measure(iterations, [&](int)
+        {
+            open_catalog_snapshot(path + ".catalog");
+        }));
+
+        report(out, "get_all_products_snapshot", tier, scan_iterations, measure(scan_iterations, [&](int)
+        {
+            get_all_products();
+        }));
+
+        // 快照中的条码哈希定位商品，库存仍按主键读取当前值
+        report(out, "query_product_by_barcode_snapshot", tier, iterations, measure(iterations, [&](int)
+        {
+            query_product_by_barcode(dataset_barcode(product_dist(rng)));
+        }));
+
+        // 300条促销（折扣、组合、任选各占三分之一，每条两种商品）下扫码加入购物车，每40次扫码换一个新购物车
+        {
+            const char* const kinds[] = {"percent", "bundle", "multibuy"};
+            for (int i = 0; i < 300; ++i)
+            {
+                Promotion promotion;
+                promotion.name = "bench" + std::to_string(i);
+                promotion.kind = kinds[i % 3];
+                promotion.quantity = 3;
+                promotion.price = 5.0;
+                promotion.percent = 10.0;
+                const int first = product_dist(rng);
+                const int second = first % tier.products + 1;
+                promotion.items = {{first, 1}, {second, 1}};
+                add_promotion(promotion);
+            }
+            CartPricer pricer(load_promotion_rules(), time(nullptr));
+            std::unordered_map<int, int> quantities;
+            report(out, "cart_scan_with_promotions", tier, iterations, measure(iterations, [&](const int i)
+            {
+                if (i % 40 == 0)
+                {
+                    pricer.clear();
+                    quantities.clear();
+                }
+                const int product_id = product_dist(rng);
+                pricer.set_line(product_id, 10.0, ++quantities[product_id]);
+            }));
+        }
+
+        report(out, "get_all_transactions", tier, scan_iterations, measure(scan_iterations, [&](int)
+        {
+            get_all_transactions();
+        }));
+
+        report(out, "get_transaction_detail", tier, iterations, measure(iterations, [&](int)
+        {
+            get_transaction_detail(transaction_dist(rng));
+        }));
+
+        // 只在少量交易之间来回翻看，模拟收银员翻阅小票时的缓存命中
+        clear_transaction_detail_cache();
+        report(out, "get_transaction_detail_cached", tier, iterations, measure(iterations, [&](const int i)
+        {
+            get_transaction_detail_cached(1 + i % 32);
+        }));
+
+        // 异步查询：交给工作线程再取回结果的往返开销，以及4笔明细同时读取与逐笔读取的对比
+        if (async_database().open(2))
+        {
+            report(out, "async_query_product", tier, iterations, measure(iterations, [&](int)
+            {
+                async_database().query_product(product_dist(rng)).get();
+            }));
+            report(out, "async_transaction_detail_x4", tier, iterations, measure(iterations, [&](int)
+            {
+                std::vector<DbFuture<TransactionDetail>> pending;
+                for (int k = 0; k < 4; ++k)
+                    pending.push_back(async_database().get_transaction_detail(transaction_dist(rng)));
+                for (auto& detail : pending)
+                    detail.get();
+            }));
+            report(out, "sync_transaction_detail_x4", tier, iterations, measure(iterations, [&](int)
+            {
+                for (int k = 0; k < 4; ++k)
+                    get_transaction_detail(transaction_dist(rng));
+            }));
+            async_database().close();
+        }
+
+        const auto random_transaction = [&]
+        {
+            Transaction transaction{};
+            transaction.create_time = time(nullptr);
+            transaction.is_paid = true;
+            for (int l = 0; l < 3; ++l)
+            {
+                CartItem item{};
+                item.product.id = product_dist(rng);
+                item.quantity = 1;
+                item.subtotal = 10.0f;
+                transaction.cart.items.push_back(item);
+                transaction.total_price += item.subtotal;
+            }
+            transaction.amount_paid = transaction.total_price;
+            return transaction;
+        };
+
+        report(out, "save_transaction", tier, iterations, measure(iterations, [&](int)
+        {
+            save_transaction(random_transaction());
+        }));
+
+        // 对刚才保存的交易逐笔退回一件商品
+        const int first_new_transaction = tier.transactions + 1;
+        std::vector<int> return_products(iterations, 0);
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(db, "SELECT transaction_id, MIN(product_id) FROM cart_items WHERE transaction_id >= ? "
+                           "GROUP BY transaction_id ORDER BY transaction_id;", -1, &stmt, nullptr);
+        sqlite3_bind_int(stmt, 1, first_new_transaction);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const int index = sqlite3_column_int(stmt, 0) - first_new_transaction;
+            if (index >= 0 && index < iterations)
+                return_products[index] = sqlite3_column_int(stmt, 1);
+        }
+        sqlite3_finalize(stmt);
+
+        report(out, "add_return", tier, iterations, measure(iterations, [&](const int i)
+        {
+            add_return(first_new_transaction + i, return_products[i], 1, "bench");
+        }));
+
+        // 事件溯源模式：结账只追加销售事件，再一次投影全部事件（单次耗时即投影iterations条事件的耗时）
+        if (!enable_sales_journal())
+            return false;
+        report(out, "save_transaction_journal", tier, iterations, measure(iterations, [&](int)
+        {
+            save_transaction(random_transaction());
+        }));
+        report(out, "journal_project_batch", tier, 1, measure(1, [&](int)
+        {
+            project_sales_journal();
+        }));
+        if (!disable_sales_journal())
+            return false;
+
+        // 门店复制：结账额外生成变更集写入发件箱，再把基线和全部变更一次发送到总部库
+        if (!enable_replication("bench"))
+            return false;
+        report(out, "save_transaction_replicated", tier, iterations, measure(iterations, [&](int)
+        {
+            save_transaction(random_transaction());
+        }));
+        report(out, "replication_ship_all", tier, 1, measure(1, [&](int)
+        {
+            ship_replication(path + ".hq");
+        }));
+        if (!disable_replication())
+            return false;
+
+        // 在线备份：单独一次备份的耗时，以及另一连接不停备份时的结账延迟
+        const std::string backup_dir = path + ".backups";
+        report(out, "online_backup", tier, 1, measure(1, [&](int)
+        {
+            backup_database(backup_dir);
+        }));
+        std::atomic<bool> checkout_done{false};
+        std::thread backup_thread([&]
+        {
+            if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) == SQLITE_OK)
+            {
+                sqlite3_busy_timeout(db, 2000);
+                while (!checkout_done.load())
+                    backup_database(backup_dir);
+            }
+            close_db();
+        });
+        report(out, "save_transaction_during_backup", tier, iterations, measure(iterations, [&](int)
+        {
+            save_transaction(random_transaction());
+        }));
+        checkout_done = true;
+        backup_thread.join();
+
+        // 后台维护各任务单次耗时，预算放宽到不中断，测的是完整执行一次的代价
+        MaintenanceOptions maintenance = get_maintenance_options();
+        maintenance.budget_ms = 60000;
+        set_maintenance_options(maintenance);
+        for (const char* job : {"checkpoint", "optimize", "vacuum", "analyze"})
+        {
+            report(out, (std::string("maintenance_") + job).c_str(), tier, 1, measure(1, [&](int)
+            {
+                run_maintenance_job(job);
+            }));
+        }
+
+        // 全区间销售合计：列式日志扫描与直接对明细表做SQL聚合对比
+        report(out, "sales_log_summary", tier, scan_iterations, measure(scan_iterations, [&](int)
+        {
+            summarize_sales_log(0, LLONG_MAX);
+        }));
+
+        report(out, "sql_sales_summary", tier, scan_iterations, measure(scan_iterations, [&](int)
+        {
+            sqlite3_stmt* summary = nullptr;
+            sqlite3_prepare_v2(db, "SELECT (SELECT SUM(quantity) FROM cart_items), (SELECT SUM(subtotal) FROM cart_items), "
+                               "(SELECT SUM(quantity) FROM returns);", -1, &summary, nullptr);
+            sqlite3_step(summary);
+            sqlite3_finalize(summary);
+        }));
+
+        // 重新打开已是当前表结构版本的数据库并完成后台预热，即收银端开机到可扫码的数据层部分
+        report(out, "boot_to_scan_ready", tier, scan_iterations, measure(scan_iterations, [&](int)
+        {
+            init_db(path);
+            start_startup_warmup();
+            wait_startup_warmup();
+        }));
+
+        close_sales_log();
+        close_catalog_snapshot();
+        close_db();
+        return true;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        fprintf(stderr, "用法: %s [--tiers 1000x5000,10000x50000] [--iterations N] [--seed N] "
+                "[--out FILE] [--dir DIR] [--stats FILE]\n", argv[0]);
+        return 2;
+    }
+
+    FILE* out = options.out == "-" ? stdout : fopen(options.out.c_str(), "w");
+    if (!out)
+    {
+        fprintf(stderr, "无法写入结果文件: %s\n", options.out.c_str());
+        return 1;
+    }
+
+    int status = 0;
+    for (const auto& tier : options.tiers)
+    {
+        if (!run_tier(options, tier, out))
+        {
+            fprintf(stderr, "数据规模 %dx%d 测试失败\n", tier.products, tier.transactions);
+            status = 1;
+        }
+    }
+
+    if (out != stdout)
+        fclose(out);
+
+    if (!options.stats.empty())
+    {
+        FILE* stats = fopen(options.stats.c_str(), "w");
+        if (stats)
+        {
+            fputs(query_stats_to_json(get_query_stats()).c_str(), stats);
+            fclose(stats);
+        }
+    }
+    return status;
+}
@@ -0,0 +1,498 @@
+// 多终端收银压测：N个收银线程各自打开连接，对同一个数据库并发结账、退货和翻阅历史，
+// 结束时汇总吞吐量、提交延迟分布、锁冲突次数，并核对库存是否与成功的操作一致。
+// 指定--daemon时各线程改为经由该套接字上的收银服务（salesctl daemon serve）访问同一数据库，
+// 锁冲突发生在服务进程内，结果中改为报告服务的组提交次数和平均批次
+//
+// 用法: sales_loadgen [--db sales_loadgen.db] [--daemon SOCKET] [--tills 8] [--readers 2] [--seconds 30]
+//                     [--checkout-rate 0] [--return-rate 0.05] [--lookup-rate 0.5]
+//                     [--products 2000] [--stock 500] [--zipf 1.1] [--seed 42]
+//                     [--out sales_loadgen.json]
+
+#include "daemon.h"
+#include "database.h"
+#include "db_internal.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Options
+    {
+        std::string db_path = "sales_loadgen.db";
+        std::string daemon_socket;  // 非空时经由收银服务
+        int tills = 8;
+        int readers = 2;
+        int seconds = 30;
+        double checkout_rate = 0;   // 每个终端每秒结账次数，0表示不限速
+        double return_rate = 0.05;  // 每次结账后发起一次退货的概率
+        double lookup_rate = 0.5;   // 每次结账后翻阅一张历史小票的概率
+        int products = 2000;
+        int stock = 500;
+        double zipf = 1.1;
+        unsigned seed = 42;
+        std::string out = "sales_loadgen.json";
+    };
+
+    bool parse_options(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc)
+                return false;
+            const char* value = argv[++i];
+            if (arg == "--db") options.db_path = value;
+            else if (arg == "--daemon") options.daemon_socket = value;
+            else if (arg == "--tills") options.tills = std::max(1, std::atoi(value));
+            else if (arg == "--readers") options.readers = std::max(0, std::atoi(value));
+            else if (arg == "--seconds") options.seconds = std::max(1, std::atoi(value));
+            else if (arg == "--checkout-rate") options.checkout_rate = std::max(0.0, std::atof(value));
+            else if (arg == "--return-rate") options.return_rate = std::clamp(std::atof(value), 0.0, 1.0);
+            else if (arg == "--lookup-rate") options.lookup_rate = std::clamp(std::atof(value), 0.0, 1.0);
+            else if (arg == "--products") options.products = std::max(1, std::atoi(value));
+            else if (arg == "--stock") options.stock = std::max(0, std::atoi(value));
+            else if (arg == "--zipf") options.zipf = std::max(0.0, std::atof(value));
+            else if (arg == "--seed") options.seed = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+            else if (arg == "--out") options.out = value;
+            else return false;
+        }
+        return true;
+    }
+
+    // 以2为底的对数分桶的延迟直方图，同时保留原始样本用于计算分位数
+    struct Latency
+    {
+        static constexpr int kBuckets = 24;  // 1us .. 8s
+        unsigned long long buckets[kBuckets] = {};
+        std::vector<double> samples;
+
+        void add(const double us)
+        {
+            int bucket = 0;
+            while (bucket + 1 < kBuckets && us >= static_cast<double>(1ULL << (bucket + 1)))
+                ++bucket;
+            ++buckets[bucket];
+            samples.push_back(us);
+        }
+
+        void merge(const Latency& other)
+        {
+            for (int i = 0; i < kBuckets; ++i)
+                buckets[i] += other.buckets[i];
+            samples.insert(samples.end(), other.samples.begin(), other.samples.end());
+        }
+
+        double percentile(const double p) const
+        {
+            if (samples.empty())
+                return 0;
+            return samples[static_cast<size_t>(p * static_cast<double>(samples.size() - 1))];
+        }
+    };
+
+    // 单个线程的统计，线程结束后合并
+    struct TillStats
+    {
+        Latency checkout;
+        Latency refund;
+        Latency lookup;
+        unsigned long long checkouts = 0;
+        unsigned long long checkout_failures = 0;
+        unsigned long long stock_rejections = 0;  // 库存不足被整单拒绝，属于正常业务结果
+        unsigned long long returns = 0;
+        unsigned long long return_failures = 0;
+        unsigned long long lookups = 0;
+        std::map<int, long long> stock_delta;     // 成功操作对每个商品库存的预期影响
+    };
+
+    // 按Zipf分布抽取商品，排名靠前的商品被购买得最多
+    class ZipfPicker
+    {
+    public:
+        ZipfPicker(std::vector<int> ids, const double s) : m_ids(std::move(ids))
+        {
+            double sum = 0;
+            m_cdf.reserve(m_ids.size());
+            for (size_t rank = 1; rank <= m_ids.size(); ++rank)
+            {
+                sum += 1.0 / std::pow(static_cast<double>(rank), s);
+                m_cdf.push_back(sum);
+            }
+            for (double& value : m_cdf)
+                value /= sum;
+        }
+
+        int pick(std::mt19937& rng) const
+        {
+            const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            const auto it = std::lower_bound(m_cdf.begin(), m_cdf.end(), u);
+            return m_ids[std::min<size_t>(it - m_cdf.begin(), m_ids.size() - 1)];
+        }
+
+    private:
+        std::vector<int> m_ids;
+        std::vector<double> m_cdf;
+    };
+
+    double elapsed_us(const Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    }
+
+    // 已提交的最大交易ID：开始时读一次，之后每笔成功的结账加一，经由收银服务时终端线程没有自己的连接
+    std::atomic<int> g_maxTransactionId{0};
+
+    int read_max_transaction_id()
+    {
+        int max_id = 0;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT IFNULL(MAX(transaction_id), 0) FROM transactions;", -1, &stmt,
+                               nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            max_id = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+        return max_id;
+    }
+
+    int max_transaction_id()
+    {
+        return g_maxTransactionId.load(std::memory_order_relaxed);
+    }
+
+    std::map<int, long long> read_stock_levels()
+    {
+        std::map<int, long long> levels;
+        for (const auto& product : get_all_products())
+            levels[product.id] = product.stock;
+        return levels;
+    }
+
+    // 商品表为空时生成压测用的商品，已有数据则直接沿用
+    bool ensure_products(const Options& options)
+    {
+        if (!get_all_products().empty())
+            return true;
+
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK ||
+            sqlite3_prepare_v2(db, "INSERT INTO products (name, price, stock, alert_threshold) VALUES (?, ?, ?, 10);",
+                               -1, &stmt, nullptr) != SQLITE_OK)
+        {
+            fprintf(stderr, "生成压测商品失败: %s\n", sqlite3_errmsg(db));
+            return false;
+        }
+        std::mt19937 rng(options.seed);
+        std::uniform_int_distribution<int> cents(100, 20000);
+        for (int i = 1; i <= options.products; ++i)
+        {
+            const std::string name = "压测商品" + std::to_string(i);
+            sqlite3_reset(stmt);
+            sqlite3_bind_text(stmt, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_double(stmt, 2, cents(rng) / 100.0);
+            sqlite3_bind_int(stmt, 3, options.stock);
+            sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
+        return sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+
+    // 随机挑一张历史小票，退回其中尚未退完的一件商品
+    void try_return(std::mt19937& rng, TillStats& stats)
+    {
+        const int max_id = max_transaction_id();
+        if (max_id == 0)
+            return;
+        const int transaction_id = std::uniform_int_distribution<int>(1, max_id)(rng);
+        const TransactionDetail detail = get_transaction_detail(transaction_id);
+        std::vector<const CartItem*> candidates;
+        for (const auto& line : detail.lines)
+        {
+            if (line.item.quantity > line.item.returned_quantity)
+                candidates.push_back(&line.item);
+        }
+        if (candidates.empty())
+            return;
+        const CartItem* item = candidates[std::uniform_int_distribution<size_t>(0, candidates.size() - 1)(rng)];
+
+        const auto start = Clock::now();
+        const bool ok = add_return(transaction_id, item->product.id, 1, "压测退货");
+        stats.refund.add(elapsed_us(start));
+        if (ok)
+        {
+            ++stats.returns;
+            stats.stock_delta[item->product.id] += 1;
+        }
+        else
+        {
+            // 其他终端可能刚好退完了同一行，属于并发下的正常拒绝
+            ++stats.return_failures;
+        }
+    }
+
+    void lookup(std::mt19937& rng, TillStats& stats)
+    {
+        const int max_id = max_transaction_id();
+        if (max_id == 0)
+            return;
+        const auto start = Clock::now();
+        get_transaction_detail(std::uniform_int_distribution<int>(1, max_id)(rng));
+        stats.lookup.add(elapsed_us(start));
+        ++stats.lookups;
+    }
+
+    void run_till(const Options& options, const ZipfPicker& picker, const int till, const Clock::time_point deadline,
+                  TillStats& stats)
+    {
+        if (options.daemon_socket.empty() && !init_db(options.db_path))
+            return;
+        std::mt19937 rng(options.seed + 1000 + till);
+        std::uniform_real_distribution<double> chance(0.0, 1.0);
+        std::uniform_int_distribution<int> basket_size(1, 8);
+        std::uniform_int_distribution<int> quantity(1, 3);
+        const auto interval = options.checkout_rate > 0
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / options.checkout_rate))
+            : Clock::duration::zero();
+        auto next_checkout = Clock::now();
+
+        while (Clock::now() < deadline)
+        {
+            // 同一商品在购物车中只占一行，与收银界面的行为一致
+            std::map<int, int> basket;
+            const int lines = basket_size(rng);
+            for (int i = 0; i < lines; ++i)
+                basket[picker.pick(rng)] += quantity(rng);
+
+            Transaction transaction{};
+            transaction.create_time = time(nullptr);
+            transaction.is_paid = true;
+            for (const auto& [product_id, count] : basket)
+            {
+                CartItem item{};
+                item.product.id = product_id;
+                item.quantity = count;
+                item.subtotal = static_cast<float>(count);
+                transaction.cart.items.push_back(item);
+                transaction.total_price += item.subtotal;
+            }
+            transaction.amount_paid = transaction.total_price;
+
+            std::vector<StockConflict> conflicts;
+            const auto start = Clock::now();
+            const bool ok = save_transaction(transaction, &conflicts);
+            stats.checkout.add(elapsed_us(start));
+            if (ok)
+            {
+                ++stats.checkouts;
+                g_maxTransactionId.fetch_add(1, std::memory_order_relaxed);
+                for (const auto& [product_id, count] : basket)
+                    stats.stock_delta[product_id] -= count;
+            }
+            else if (!conflicts.empty())
+                ++stats.stock_rejections;
+            else
+                ++stats.checkout_failures;
+
+            if (chance(rng) < options.return_rate)
+                try_return(rng, stats);
+            if (chance(rng) < options.lookup_rate)
+                lookup(rng, stats);
+
+            if (interval != Clock::duration::zero())
+            {
+                next_checkout += interval;
+                std::this_thread::sleep_until(next_checkout);
+            }
+        }
+        close_db();
+    }
+
+    void run_reader(const Options& options, const int reader, const Clock::time_point deadline, TillStats& stats)
+    {
+        if (options.daemon_socket.empty() && !init_db(options.db_path))
+            return;
+        std::mt19937 rng(options.seed + 2000 + reader);
+        while (Clock::now() < deadline)
+            lookup(rng, stats);
+        close_db();
+    }
+
+    // 库存一致性核对，返回违规条数并把明细写到stderr
+    int check_consistency(const std::map<int, long long>& before, const std::map<int, long long>& expected_delta)
+    {
+        int violations = 0;
+        const auto after = read_stock_levels();
+        for (const auto& [product_id, stock] : after)
+        {
+            const auto it = before.find(product_id);
+            const long long initial = it == before.end() ? 0 : it->second;
+            const auto delta_it = expected_delta.find(product_id);
+            const long long expected = initial + (delta_it == expected_delta.end() ? 0 : delta_it->second);
+            if (stock < 0 || stock != expected)
+            {
+                fprintf(stderr, "库存不一致: 商品ID %d 初始 %lld, 预期 %lld, 实际 %lld\n",
+                        product_id, initial, expected, stock);
+                ++violations;
+            }
+        }
+
+        // 每一行的已退数量必须等于退货记录之和，且不超过购买数量
+        const char* sql =
+            "SELECT c.transaction_id, c.product_id, c.quantity, c.returned_quantity, IFNULL(r.total, 0) "
+            "FROM cart_items c LEFT JOIN ("
+            "  SELECT transaction_id, product_id, SUM(quantity) AS total FROM returns "
+            "  GROUP BY transaction_id, product_id) r "
+            "ON r.transaction_id = c.transaction_id AND r.product_id = c.product_id "
+            "WHERE c.returned_quantity > c.quantity OR c.returned_quantity <> IFNULL(r.total, 0);";
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                fprintf(stderr, "退货记录不一致: 交易ID %d 商品ID %d 购买 %d 已退 %d 退货记录合计 %d\n",
+                        sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1), sqlite3_column_int(stmt, 2),
+                        sqlite3_column_int(stmt, 3), sqlite3_column_int(stmt, 4));
+                ++violations;
+            }
+        }
+        sqlite3_finalize(stmt);
+        return violations;
+    }
+
+    void write_latency(FILE* out, const char* name, const Latency& latency, const bool last)
+    {
+        fprintf(out, "    \"%s\": {\"count\": %zu, \"p50_us\": %.1f, \"p95_us\": %.1f, \"p99_us\": %.1f, "
+                "\"max_us\": %.1f, \"histogram_log2_us\": [",
+                name, latency.samples.size(), latency.percentile(0.50), latency.percentile(0.95),
+                latency.percentile(0.99), latency.samples.empty() ? 0.0 : latency.samples.back());
+        for (int i = 0; i < Latency::kBuckets; ++i)
+            fprintf(out, "%s%llu", i ? ", " : "", latency.buckets[i]);
+        fprintf(out, "]}%s\n", last ? "" : ",");
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        fprintf(stderr, "用法: %s [--db FILE] [--daemon SOCKET] [--tills N] [--readers N] [--seconds N] [--checkout-rate R] "
+                "[--return-rate P] [--lookup-rate P] [--products N] [--stock N] [--zipf S] [--seed N] "
+                "[--out FILE]\n", argv[0]);
+        return 2;
+    }
+
+    if (!init_db(options.db_path) || !ensure_products(options))
+        return 1;
+    g_maxTransactionId.store(read_max_transaction_id());
+    if (!options.daemon_socket.empty() && !connect_sales_daemon(options.daemon_socket))
+        return 1;
+    DaemonStats daemon_before;
+    if (sales_daemon_connected())
+        query_daemon_stats(daemon_before);
+    std::vector<int> product_ids;
+    for (const auto& product : get_all_products())
+        product_ids.push_back(product.id);
+    // 打乱排名，热门商品不集中在ID最小的一段
+    std::mt19937 shuffle_rng(options.seed);
+    std::shuffle(product_ids.begin(), product_ids.end(), shuffle_rng);
+    const ZipfPicker picker(std::move(product_ids), options.zipf);
+    const auto stock_before = read_stock_levels();
+    const WriteContention contention_before = get_write_contention();
+
+    std::vector<TillStats> till_stats(options.tills);
+    std::vector<TillStats> reader_stats(options.readers);
+    std::vector<std::thread> threads;
+    const auto begin = Clock::now();
+    const auto deadline = begin + std::chrono::seconds(options.seconds);
+    for (int i = 0; i < options.tills; ++i)
+        threads.emplace_back(run_till, std::cref(options), std::cref(picker), i, deadline, std::ref(till_stats[i]));
+    for (int i = 0; i < options.readers; ++i)
+        threads.emplace_back(run_reader, std::cref(options), i, deadline, std::ref(reader_stats[i]));
+    for (auto& thread : threads)
+        thread.join();
+    const double wall_sec = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    TillStats total;
+    for (const auto* group : {&till_stats, &reader_stats})
+    {
+        for (const auto& stats : *group)
+        {
+            total.checkout.merge(stats.checkout);
+            total.refund.merge(stats.refund);
+            total.lookup.merge(stats.lookup);
+            total.checkouts += stats.checkouts;
+            total.checkout_failures += stats.checkout_failures;
+            total.stock_rejections += stats.stock_rejections;
+            total.returns += stats.returns;
+            total.return_failures += stats.return_failures;
+            total.lookups += stats.lookups;
+            for (const auto& [product_id, delta] : stats.stock_delta)
+                total.stock_delta[product_id] += delta;
+        }
+    }
+    for (auto* latency : {&total.checkout, &total.refund, &total.lookup})
+        std::sort(latency->samples.begin(), latency->samples.end());
+
+    const WriteContention contention_after = get_write_contention();
+    const unsigned long long busy_retries = contention_after.busy_retries - contention_before.busy_retries;
+    const unsigned long long busy_failures = contention_after.busy_failures - contention_before.busy_failures;
+    const unsigned long long lock_waits = contention_after.lock_waits - contention_before.lock_waits;
+    const double lock_wait_ms = static_cast<double>(contention_after.lock_wait_us - contention_before.lock_wait_us) / 1000.0;
+    DaemonStats daemon_after;
+    if (sales_daemon_connected())
+        query_daemon_stats(daemon_after);
+    const long long batches = daemon_after.batches - daemon_before.batches;
+    const long long batched_checkouts = daemon_after.checkouts - daemon_before.checkouts;
+    const int violations = check_consistency(stock_before, total.stock_delta);
+    disconnect_sales_daemon();
+    close_db();
+
+    FILE* out = options.out == "-" ? stdout : fopen(options.out.c_str(), "w");
+    if (!out)
+    {
+        fprintf(stderr, "无法写入结果文件: %s\n", options.out.c_str());
+        return 1;
+    }
+    fprintf(out, "{\n  \"tills\": %d, \"readers\": %d, \"seconds\": %.2f, \"sqlite_version\": \"%s\",\n",
+            options.tills, options.readers, wall_sec, sqlite3_libversion());
+    fprintf(out, "  \"checkouts\": %llu, \"checkouts_per_sec\": %.1f, \"checkout_failures\": %llu, "
+            "\"stock_rejections\": %llu,\n", total.checkouts, total.checkouts / wall_sec, total.checkout_failures,
+            total.stock_rejections);
+    fprintf(out, "  \"returns\": %llu, \"return_failures\": %llu, \"lookups\": %llu, \"lookups_per_sec\": %.1f,\n",
+            total.returns, total.return_failures, total.lookups, total.lookups / wall_sec);
+    fprintf(out, "  \"lock_waits\": %llu, \"lock_wait_ms\": %.1f, \"busy_retries\": %llu, \"busy_failures\": %llu, "
+            "\"consistency_violations\": %d,\n", lock_waits, lock_wait_ms, busy_retries, busy_failures, violations);
+    fprintf(out, "  \"daemon\": %s, \"group_commits\": %lld, \"average_batch\": %.2f,\n",
+            options.daemon_socket.empty() ? "false" : "true", batches,
+            batches ? static_cast<double>(batched_checkouts) / static_cast<double>(batches) : 0.0);
+    fprintf(out, "  \"latency\": {\n");
+    write_latency(out, "save_transaction", total.checkout, false);
+    write_latency(out, "add_return", total.refund, false);
+    write_latency(out, "history_lookup", total.lookup, true);
+    fprintf(out, "  }\n}\n");
+    if (out != stdout)
+        fclose(out);
+
+    fprintf(stderr, "结账 %llu 笔 (%.1f/s), 提交延迟 p50 %.1fus p99 %.1fus, 退货 %llu 笔, 等待写锁 %llu 次 (%.1fms), "
+            "锁冲突重试 %llu 次, 一致性违规 %d 条\n", total.checkouts, total.checkouts / wall_sec,
+            total.checkout.percentile(0.50), total.checkout.percentile(0.99), total.returns, lock_waits, lock_wait_ms,
+            busy_retries, violations);
+    if (batches)
+        fprintf(stderr, "收银服务组提交 %lld 次，平均每批 %.2f 笔\n", batches,
+                static_cast<double>(batched_checkouts) / static_cast<double>(batches));
+    return violations == 0 ? 0 : 3;
+}
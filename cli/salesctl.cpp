@@ -0,0 +1,727 @@
+// 后台批处理命令行工具，直接使用sales_core，不依赖Qt
+//
+// 用法: salesctl [--db sales.db] <命令> [参数]
+//   import products FILE.csv          按名称新增或更新商品（名称,单价,库存[,预警阈值[,条码]]）
+//   import restock FILE.csv           按送货单入库（商品ID或名称,数量）
+//   export products FILE.csv
+//   export transactions FILE.csv [--from YYYY-MM-DD] [--to YYYY-MM-DD]
+//   export returns FILE.csv [--from YYYY-MM-DD] [--to YYYY-MM-DD]
+//   rollup rebuild                    重建每日销售汇总
+//   archive --before YYYY-MM-DD --to ARCHIVE.db
+//   integrity                         检查数据库完整性和业务约束
+//   report daily [--from YYYY-MM-DD] [--to YYYY-MM-DD]
+//   report top [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--limit N]
+//   report hourly|returns|basket [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--limit N]   直接从交易明细分析
+//   catalog rebuild|info              商品目录快照（DB.catalog）
+//   barcode set ID CODE               设置商品条码，CODE为空串时清除
+//   barcode find CODE                 按条码查商品（经由目录快照）
+//   promotion add multibuy|bundle|percent NAME --items ID[:N],... [--quantity N] [--price X] [--percent P]
+//             [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--hours HH:MM-HH:MM]   新增促销，N为组合中该商品的数量
+//   promotion list | promotion enable|disable|delete ID
+//   saleslog rebuild|summary|products [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--limit N]   列式销售日志（DB.saleslog）
+//   journal enable|disable|status|project|snapshot   事件溯源模式
+//   journal replay [--from EVENT_ID]  从快照重放事件日志重建当前状态表，默认从最新快照
+//   replicate enable [--store ID]|disable|status   门店复制
+//   replicate ship --hq HQ.db         把未应用的变更批次发送到总部库
+//   replicate export FILE | replicate apply FILE --hq HQ.db   离线传送批次文件
+//   replicate hq --hq HQ.db           总部库各门店的复制位置、延迟和吞吐
+//   backup run DIR [--pages N] [--pause MS] [--keep N]   在线备份到目录并轮换旧快照
+//   backup list DIR | backup verify FILE
+//   maintenance run optimize|analyze|vacuum|checkpoint [--budget MS]   立即执行一项维护任务
+//   maintenance status                数据库文件状况和各维护任务最近一次的结果
+//   maintenance convert               把早期建的库转换为增量自动清理模式（整库VACUUM，停业时执行）
+//   daemon serve [--socket DB.sock] [--commit-delay-us N] [--max-batch N] [--max-clients N]
+//                                     运行收银服务，各终端经本地套接字共用一个数据库进程，Ctrl+C退出
+//   daemon stats [--socket DB.sock]   收银服务的连接、请求和组提交统计
+
+#include "analytics.h"
+#include "backup.h"
+#include "batch.h"
+#include "catalog.h"
+#include "daemon.h"
+#include "database.h"
+#include "journal.h"
+#include "log.h"
+#include "maintenance.h"
+#include "promotion.h"
+#include "replication.h"
+#include "saleslog.h"
+#include "startup.h"
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+    constexpr long long kNoUpperBound = 4102444800LL;  // 2100-01-01
+
+    int usage()
+    {
+        fprintf(stderr,
+                "用法: salesctl [--db FILE] <命令> [参数]\n"
+                "  import products|restock FILE.csv\n"
+                "  export products|transactions|returns FILE.csv [--from YYYY-MM-DD] [--to YYYY-MM-DD]\n"
+                "  rollup rebuild\n"
+                "  archive --before YYYY-MM-DD --to ARCHIVE.db\n"
+                "  integrity\n"
+                "  report daily|top|hourly|returns|basket [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--limit N]\n"
+                "  catalog rebuild|info\n"
+                "  barcode set ID CODE | barcode find CODE\n"
+                "  promotion add multibuy|bundle|percent NAME --items ID[:N],... [--quantity N] [--price X] [--percent P]\n"
+                "            [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--hours HH:MM-HH:MM]\n"
+                "  promotion list | promotion enable|disable|delete ID\n"
+                "  saleslog rebuild|summary|products [--from YYYY-MM-DD] [--to YYYY-MM-DD] [--limit N]\n"
+                "  journal enable|disable|status|project|snapshot\n"
+                "  journal replay [--from EVENT_ID]\n"
+                "  replicate enable [--store ID]|disable|status\n"
+                "  replicate ship|hq --hq HQ.db\n"
+                "  replicate export FILE | replicate apply FILE --hq HQ.db\n"
+                "  backup run DIR [--pages N] [--pause MS] [--keep N]\n"
+                "  backup list DIR | backup verify FILE\n"
+                "  maintenance run optimize|analyze|vacuum|checkpoint [--budget MS]\n"
+                "  maintenance status|convert\n"
+                "  daemon serve [--socket FILE] [--commit-delay-us N] [--max-batch N] [--max-clients N]\n"
+                "  daemon stats [--socket FILE]\n");
+        return 2;
+    }
+
+    // 把YYYY-MM-DD解析为本地零点的时间戳
+    bool parse_day(const std::string& text, long long& timestamp)
+    {
+        std::tm tm{};
+        if (sscanf(text.c_str(), "%4d-%2d-%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday) != 3)
+            return false;
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        const time_t value = mktime(&tm);
+        if (value == static_cast<time_t>(-1))
+            return false;
+        timestamp = static_cast<long long>(value);
+        return true;
+    }
+
+    // 拆分位置参数和--选项
+    struct Arguments
+    {
+        std::vector<std::string> positional;
+        std::map<std::string, std::string> options;
+    };
+
+    bool parse_arguments(const int argc, char* argv[], Arguments& args)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if (arg.rfind("--", 0) == 0)
+            {
+                if (i + 1 >= argc)
+                    return false;
+                args.options[arg.substr(2)] = argv[++i];
+            }
+            else
+                args.positional.push_back(arg);
+        }
+        return !args.positional.empty();
+    }
+
+    std::string option(const Arguments& args, const std::string& name, const std::string& fallback = "")
+    {
+        const auto it = args.options.find(name);
+        return it == args.options.end() ? fallback : it->second;
+    }
+
+    // 读取--from/--to，--to当天包含在内
+    bool time_range(const Arguments& args, long long& from, long long& to)
+    {
+        from = 0;
+        to = kNoUpperBound;
+        const std::string from_text = option(args, "from");
+        const std::string to_text = option(args, "to");
+        if (!from_text.empty() && !parse_day(from_text, from))
+            return false;
+        if (!to_text.empty())
+        {
+            if (!parse_day(to_text, to))
+                return false;
+            to += 86400;
+        }
+        return true;
+    }
+
+    int run_import(const Arguments& args)
+    {
+        if (args.positional.size() != 3)
+            return usage();
+        const std::string& kind = args.positional[1];
+        const std::string& path = args.positional[2];
+        std::string err;
+        if (kind == "products")
+        {
+            int inserted = 0;
+            int updated = 0;
+            if (!import_products_csv(path, &inserted, &updated, &err))
+                return 1;
+            printf("新增商品 %d 种，更新商品 %d 种\n", inserted, updated);
+            return 0;
+        }
+        if (kind == "restock")
+        {
+            std::vector<RestockLine> lines;
+            std::vector<Product> updated;
+            if (!load_restock_csv(path, lines, &err) || !restock_products(lines, &updated, &err))
+                return 1;
+            printf("入库完成，共 %zu 种商品\n", updated.size());
+            return 0;
+        }
+        return usage();
+    }
+
+    int run_export(const Arguments& args)
+    {
+        if (args.positional.size() != 3)
+            return usage();
+        const std::string& kind = args.positional[1];
+        const std::string& path = args.positional[2];
+        long long from = 0;
+        long long to = 0;
+        if (!time_range(args, from, to))
+            return usage();
+        std::string err;
+        bool ok;
+        if (kind == "products")
+            ok = export_products_csv(path, &err);
+        else if (kind == "transactions")
+            ok = export_transactions_csv(path, from, to, &err);
+        else if (kind == "returns")
+            ok = export_returns_csv(path, from, to, &err);
+        else
+            return usage();
+        return ok ? 0 : 1;
+    }
+
+    int run_archive(const Arguments& args)
+    {
+        long long before = 0;
+        const std::string archive_path = option(args, "to");
+        if (!parse_day(option(args, "before"), before) || archive_path.empty())
+            return usage();
+        ArchiveResult result{};
+        std::string err;
+        if (!archive_transactions(before, archive_path, &result, &err))
+            return 1;
+        printf("已归档交易 %d 笔，购物车项 %d 条，退货记录 %d 条到 %s\n",
+               result.transactions, result.cart_items, result.returns, archive_path.c_str());
+        return 0;
+    }
+
+    int run_integrity()
+    {
+        std::vector<std::string> problems;
+        if (check_integrity(problems))
+        {
+            printf("ok\n");
+            return 0;
+        }
+        for (const auto& problem : problems)
+            printf("%s\n", problem.c_str());
+        return 1;
+    }
+
+    int run_report(const Arguments& args)
+    {
+        if (args.positional.size() != 2)
+            return usage();
+        const std::string from = option(args, "from");
+        const std::string to = option(args, "to");
+        const int limit = std::atoi(option(args, "limit", "20").c_str());
+        long long from_time = 0;
+        long long to_time = 0;
+        if (!time_range(args, from_time, to_time))
+            return usage();
+        if (args.positional[1] == "daily")
+        {
+            printf("日期,交易笔数,售出件数,退回件数,销售额,实收\n");
+            for (const auto& day : get_daily_sales(from, to))
+            {
+                printf("%s,%d,%d,%d,%.2f,%.2f\n", day.day.c_str(), day.transactions, day.items_sold,
+                       day.items_returned, day.gross, day.net);
+            }
+            return 0;
+        }
+        if (args.positional[1] == "top")
+        {
+            printf("商品ID,商品名称,售出数量,退回数量,销售额\n");
+            for (const auto& product : get_top_products(from, to, limit > 0 ? limit : 20))
+            {
+                printf("%d,%s,%d,%d,%.2f\n", product.product_id, product.name.c_str(), product.quantity,
+                       product.returned_quantity, product.revenue);
+            }
+            return 0;
+        }
+        if (args.positional[1] == "hourly")
+        {
+            printf("小时,交易笔数,售出件数,销售额,占比\n");
+            for (const auto& hour : get_sales_by_hour(from_time, to_time))
+            {
+                printf("%02d,%d,%d,%.2f,%.4f\n", hour.hour, hour.transactions, hour.items, hour.revenue,
+                       hour.revenue_share);
+            }
+            return 0;
+        }
+        if (args.positional[1] == "returns")
+        {
+            printf("商品ID,商品名称,售出数量,退回数量,退货率,整体退货率\n");
+            for (const auto& rate : get_return_rates(from_time, to_time, limit > 0 ? limit : 20))
+            {
+                printf("%d,%s,%d,%d,%.4f,%.4f\n", rate.product_id, rate.name.c_str(), rate.sold, rate.returned,
+                       rate.return_rate, rate.overall_rate);
+            }
+            return 0;
+        }
+        if (args.positional[1] == "basket")
+        {
+            const BasketStats basket = get_basket_stats(from_time, to_time);
+            printf("交易笔数,平均件数,件数中位数,平均商品种数,平均客单价\n");
+            printf("%d,%.2f,%.1f,%.2f,%.2f\n", basket.transactions, basket.average_items, basket.median_items,
+                   basket.average_lines, basket.average_amount);
+            return 0;
+        }
+        return usage();
+    }
+
+    int run_catalog(const std::string& db_path, const Arguments& args)
+    {
+        if (args.positional.size() != 2)
+            return usage();
+        if (!open_catalog_snapshot(db_path + ".catalog"))
+            return 1;
+        const std::string& action = args.positional[1];
+        int status = 0;
+        if (action == "rebuild")
+            status = rebuild_catalog_snapshot() ? 0 : 1;
+        else if (action != "info")
+            status = usage();
+        if (status == 0)
+        {
+            const CatalogSnapshotInfo info = get_catalog_snapshot_info();
+            printf("商品数,目录版本,文件字节数,与数据库一致\n");
+            printf("%u,%lld,%llu,%s\n", info.products, info.catalog_version,
+                   static_cast<unsigned long long>(info.file_bytes), info.current ? "是" : "否");
+        }
+        close_catalog_snapshot();
+        return status;
+    }
+
+    int run_barcode(const std::string& db_path, const Arguments& args)
+    {
+        if (args.positional.size() == 4 && args.positional[1] == "set")
+            return set_product_barcode(std::atoi(args.positional[2].c_str()), args.positional[3]) ? 0 : 1;
+        if (args.positional.size() != 3 || args.positional[1] != "find")
+            return usage();
+        if (!open_catalog_snapshot(db_path + ".catalog"))
+            return 1;
+        const Product product = query_product_by_barcode(args.positional[2]);
+        close_catalog_snapshot();
+        if (product.id == -1)
+        {
+            fprintf(stderr, "未找到条码为 %s 的商品\n", args.positional[2].c_str());
+            return 1;
+        }
+        printf("商品ID,名称,单价,库存\n");
+        printf("%d,%s,%.2f,%d\n", product.id, product.name.c_str(), product.price, product.stock);
+        return 0;
+    }
+
+    // 解析“ID[:N],ID[:N]”形式的促销商品列表
+    bool parse_promotion_items(const std::string& text, std::vector<PromotionItem>& items)
+    {
+        size_t begin = 0;
+        while (begin < text.size())
+        {
+            size_t end = text.find(',', begin);
+            if (end == std::string::npos)
+                end = text.size();
+            PromotionItem item;
+            const std::string field = text.substr(begin, end - begin);
+            if (sscanf(field.c_str(), "%d:%d", &item.product_id, &item.quantity) < 1 || item.product_id <= 0)
+                return false;
+            items.push_back(item);
+            begin = end + 1;
+        }
+        return !items.empty();
+    }
+
+    int run_promotion(const Arguments& args)
+    {
+        if (args.positional.size() == 2 && args.positional[1] == "list")
+        {
+            printf("促销ID,名称,种类,每组件数,每组价格,减价百分比,开始时间,结束时间,每天时段,启用,商品\n");
+            for (const auto& promotion : get_promotions())
+            {
+                std::string items;
+                for (const auto& item : promotion.items)
+                    items += (items.empty() ? "" : " ") + std::to_string(item.product_id) + ':' + std::to_string(item.quantity);
+                printf("%d,%s,%s,%d,%.2f,%.1f,%lld,%lld,%02d:%02d-%02d:%02d,%s,%s\n", promotion.promotion_id,
+                       promotion.name.c_str(), promotion.kind.c_str(), promotion.quantity, promotion.price,
+                       promotion.percent, promotion.start_time, promotion.end_time, promotion.day_start_minute / 60,
+                       promotion.day_start_minute % 60, promotion.day_end_minute / 60, promotion.day_end_minute % 60,
+                       promotion.active ? "是" : "否", items.c_str());
+            }
+            return 0;
+        }
+        if (args.positional.size() == 3)
+        {
+            const std::string& action = args.positional[1];
+            const int promotion_id = std::atoi(args.positional[2].c_str());
+            if (action == "enable" || action == "disable")
+                return set_promotion_active(promotion_id, action == "enable") ? 0 : 1;
+            if (action == "delete")
+                return delete_promotion(promotion_id) ? 0 : 1;
+            return usage();
+        }
+        if (args.positional.size() != 4 || args.positional[1] != "add")
+            return usage();
+
+        Promotion promotion;
+        promotion.kind = args.positional[2];
+        promotion.name = args.positional[3];
+        promotion.quantity = std::atoi(option(args, "quantity", "0").c_str());
+        promotion.price = std::atof(option(args, "price", "0").c_str());
+        promotion.percent = std::atof(option(args, "percent", "0").c_str());
+        long long from = 0;
+        long long to = 0;
+        if (!parse_promotion_items(option(args, "items"), promotion.items) || !time_range(args, from, to))
+            return usage();
+        promotion.start_time = from;
+        promotion.end_time = to == kNoUpperBound ? 0 : to;
+        const std::string hours = option(args, "hours");
+        if (!hours.empty())
+        {
+            int start_hour, start_minute, end_hour, end_minute;
+            if (sscanf(hours.c_str(), "%d:%d-%d:%d", &start_hour, &start_minute, &end_hour, &end_minute) != 4)
+                return usage();
+            promotion.day_start_minute = start_hour * 60 + start_minute;
+            promotion.day_end_minute = end_hour * 60 + end_minute;
+        }
+        if (!add_promotion(promotion))
+            return 1;
+        printf("已新增促销 %d\n", promotion.promotion_id);
+        return 0;
+    }
+
+    int run_sales_log(const std::string& db_path, const Arguments& args)
+    {
+        if (args.positional.size() != 2)
+            return usage();
+        long long from = 0;
+        long long to = 0;
+        if (!time_range(args, from, to))
+            return usage();
+        if (!open_sales_log(db_path + ".saleslog"))
+            return 1;
+        const std::string& action = args.positional[1];
+        int status = 0;
+        if (action == "rebuild")
+            status = rebuild_sales_log() ? 0 : 1;
+        else if (action == "summary")
+        {
+            const SalesLogSummary summary = summarize_sales_log(from, to);
+            printf("行数,售出件数,退回件数,销售额,退款,实收\n");
+            printf("%lld,%lld,%lld,%.2f,%.2f,%.2f\n", summary.lines, summary.quantity_sold,
+                   summary.quantity_returned, summary.gross, summary.refunds, summary.net);
+        }
+        else if (action == "products")
+        {
+            const int limit = std::atoi(option(args, "limit", "20").c_str());
+            const std::vector<ProductSales> products = get_sales_log_products(from, to);
+            printf("商品ID,售出数量,退回数量,销售额\n");
+            for (size_t i = 0; i < products.size() && (limit <= 0 || i < static_cast<size_t>(limit)); ++i)
+            {
+                printf("%d,%d,%d,%.2f\n", products[i].product_id, products[i].quantity,
+                       products[i].returned_quantity, products[i].revenue);
+            }
+        }
+        else
+            status = usage();
+        close_sales_log();
+        return status;
+    }
+
+    int run_journal(const Arguments& args)
+    {
+        if (args.positional.size() != 2)
+            return usage();
+        const std::string& action = args.positional[1];
+        bool ok = true;
+        if (action == "enable")
+            ok = enable_sales_journal();
+        else if (action == "disable")
+            ok = disable_sales_journal();
+        else if (action == "project")
+            ok = project_sales_journal();
+        else if (action == "snapshot")
+            ok = snapshot_sales_journal();
+        else if (action == "replay")
+            ok = replay_sales_journal(std::atoll(option(args, "from", "9223372036854775807").c_str()));
+        else if (action != "status")
+            return usage();
+        if (!ok)
+            return 1;
+        const JournalStatus status = get_journal_status();
+        printf("事件溯源模式,最新事件ID,已投影事件ID,待投影销售,最新快照事件ID,快照数\n");
+        printf("%s,%lld,%lld,%lld,%lld,%d\n", status.enabled ? "开启" : "关闭", status.last_event_id,
+               status.projected_event_id, status.pending_sales, status.last_snapshot_event_id, status.snapshots);
+        return 0;
+    }
+
+    void print_ship_result(const ReplicationShipResult& result)
+    {
+        printf("批次数,发件箱记录,行变更,变更集字节数,传送字节数,耗时秒,行变更/秒\n");
+        printf("%d,%lld,%lld,%lld,%lld,%.3f,%.1f\n", result.batches, result.outbox_rows, result.changes,
+               result.raw_bytes, result.wire_bytes, result.seconds,
+               result.seconds > 0 ? static_cast<double>(result.changes) / result.seconds : 0.0);
+    }
+
+    int run_replicate(const Arguments& args)
+    {
+        if (args.positional.size() < 2)
+            return usage();
+        const std::string& action = args.positional[1];
+        const std::string hq = option(args, "hq");
+        if (action == "enable" && args.positional.size() == 2)
+        {
+            if (!enable_replication(option(args, "store")))
+                return 1;
+        }
+        else if (action == "disable" && args.positional.size() == 2)
+        {
+            if (!disable_replication())
+                return 1;
+        }
+        else if (action == "ship" && args.positional.size() == 2 && !hq.empty())
+        {
+            ReplicationShipResult result;
+            if (!ship_replication(hq, &result))
+                return 1;
+            print_ship_result(result);
+            return 0;
+        }
+        else if (action == "export" && args.positional.size() == 3)
+        {
+            ReplicationShipResult result;
+            if (!export_replication_batch(args.positional[2], &result))
+                return 1;
+            print_ship_result(result);
+            return 0;
+        }
+        else if (action == "apply" && args.positional.size() == 3 && !hq.empty())
+            return apply_replication_batch_file(hq, args.positional[2]) ? 0 : 1;
+        else if (action == "hq" && args.positional.size() == 2 && !hq.empty())
+        {
+            std::string err;
+            const std::vector<HqStoreStatus> stores = get_hq_replication_status(hq, &err);
+            if (!err.empty())
+                return 1;
+            printf("门店编号,已应用记录ID,最近应用时间,最近延迟秒,批次数,行变更,传送字节数,行变更/秒\n");
+            for (const auto& store : stores)
+            {
+                printf("%s,%lld,%lld,%lld,%lld,%lld,%lld,%.1f\n", store.store_id.c_str(), store.applied_batch_id,
+                       store.applied_at, store.last_delay_seconds, store.batches, store.changes, store.wire_bytes,
+                       store.changes_per_second);
+            }
+            return 0;
+        }
+        else if (action != "status" || args.positional.size() != 2)
+            return usage();
+
+        const ReplicationStatus status = get_replication_status();
+        printf("会话扩展,复制,门店编号,最新记录ID,已发送记录ID,待发送记录,待发送字节数,延迟秒\n");
+        printf("%s,%s,%s,%lld,%lld,%lld,%lld,%lld\n", status.available ? "可用" : "不可用",
+               status.enabled ? "开启" : "关闭", status.store_id.c_str(), status.last_batch_id,
+               status.shipped_batch_id, status.pending_batches, status.pending_bytes, status.lag_seconds);
+        return 0;
+    }
+
+    int run_backup(const Arguments& args)
+    {
+        if (args.positional.size() != 3)
+            return usage();
+        const std::string& action = args.positional[1];
+        const std::string& target = args.positional[2];
+        if (action == "run")
+        {
+            BackupOptions options = get_backup_options();
+            options.pages_per_step = std::atoi(option(args, "pages", std::to_string(options.pages_per_step)).c_str());
+            options.pause_ms = std::atoi(option(args, "pause", std::to_string(options.pause_ms)).c_str());
+            options.keep = std::atoi(option(args, "keep", std::to_string(options.keep)).c_str());
+            set_backup_options(options);
+            BackupResult result;
+            if (!backup_database(target, &result))
+                return 1;
+            printf("快照文件,页数,字节数,步数,重来次数,最长一步毫秒,复制秒,校验秒,删除旧快照\n");
+            printf("%s,%lld,%lld,%d,%d,%.1f,%.3f,%.3f,%d\n", result.path.c_str(), result.pages, result.bytes,
+                   result.steps, result.restarts, result.max_step_ms, result.copy_seconds, result.verify_seconds,
+                   result.removed);
+            return 0;
+        }
+        if (action == "list")
+        {
+            printf("快照文件,修改时间,字节数\n");
+            for (const auto& file : list_backups(target))
+                printf("%s,%lld,%lld\n", file.path.c_str(), file.created_at, file.bytes);
+            return 0;
+        }
+        if (action == "verify")
+        {
+            if (!verify_backup(target))
+                return 1;
+            printf("完整性检查通过: %s\n", target.c_str());
+            return 0;
+        }
+        return usage();
+    }
+
+    int run_maintenance(const Arguments& args)
+    {
+        if (args.positional.size() < 2)
+            return usage();
+        const std::string& action = args.positional[1];
+        if (action == "run" && args.positional.size() == 3)
+        {
+            MaintenanceOptions options = get_maintenance_options();
+            options.budget_ms = std::atoi(option(args, "budget", std::to_string(options.budget_ms)).c_str());
+            set_maintenance_options(options);
+            MaintenanceRun run;
+            if (!run_maintenance_job(args.positional[2], &run))
+                return 1;
+            printf("任务,耗时秒,完成,超出预算,说明\n");
+            printf("%s,%.3f,%s,%s,%s\n", run.job.c_str(), run.seconds, run.ok ? "是" : "否",
+                   run.over_budget ? "是" : "否", run.detail.c_str());
+            return 0;
+        }
+        if (action == "convert" && args.positional.size() == 2)
+            return convert_to_incremental_vacuum() ? 0 : 1;
+        if (action != "status" || args.positional.size() != 2)
+            return usage();
+
+        const DatabaseHealth health = get_database_health();
+        printf("页大小,页数,空闲页,自动清理,WAL字节数,统计行\n");
+        printf("%lld,%lld,%lld,%s,%lld,%lld\n", health.page_size, health.page_count, health.freelist_count,
+               health.auto_vacuum == 2 ? "增量" : health.auto_vacuum == 1 ? "完全" : "关闭", health.wal_bytes,
+               health.stat_rows);
+        printf("任务,执行时间,耗时秒,完成,超出预算,说明\n");
+        for (const auto& run : get_maintenance_runs())
+        {
+            printf("%s,%lld,%.3f,%s,%s,%s\n", run.job.c_str(), run.run_at, run.seconds, run.ok ? "是" : "否",
+                   run.over_budget ? "是" : "否", run.detail.c_str());
+        }
+        return 0;
+    }
+
+    void stop_daemon_on_signal(int)
+    {
+        stop_sales_daemon();
+    }
+
+    int run_daemon(const std::string& path, const Arguments& args)
+    {
+        if (args.positional.size() != 2)
+            return usage();
+        const std::string& action = args.positional[1];
+        DaemonOptions options;
+        options.socket_path = option(args, "socket", path + ".sock");
+        if (action == "stats")
+        {
+            DaemonStats stats;
+            if (!connect_sales_daemon(options.socket_path) || !query_daemon_stats(stats))
+                return 1;
+            printf("累计连接,当前连接,请求,结账,组提交,平均批次,最大批次,整批失败\n");
+            printf("%lld,%lld,%lld,%lld,%lld,%.2f,%lld,%lld\n", stats.connections, stats.active_connections,
+                   stats.requests, stats.checkouts, stats.batches,
+                   stats.batches ? static_cast<double>(stats.checkouts) / static_cast<double>(stats.batches) : 0.0,
+                   stats.max_batch, stats.batch_failures);
+            disconnect_sales_daemon();
+            return 0;
+        }
+        if (action != "serve")
+            return usage();
+
+        options.commit_delay_us = std::atoi(option(args, "commit-delay-us", std::to_string(options.commit_delay_us)).c_str());
+        options.max_batch = std::atoi(option(args, "max-batch", std::to_string(options.max_batch)).c_str());
+        options.max_clients = std::atoi(option(args, "max-clients", std::to_string(options.max_clients)).c_str());
+
+        // 服务进程承担收银端的后台工作：商品目录快照、销售日志、事件投影和空闲维护只在这里运行一份
+        std::string err;
+        if (!open_catalog_snapshot(path + ".catalog", &err))
+            fprintf(stderr, "商品目录快照不可用: %s\n", err.c_str());
+        if (!open_sales_log(path + ".saleslog", &err))
+            fprintf(stderr, "销售日志不可用: %s\n", err.c_str());
+        start_journal_projector();
+        start_maintenance_scheduler();
+        start_startup_warmup();
+
+        std::signal(SIGINT, stop_daemon_on_signal);
+        std::signal(SIGTERM, stop_daemon_on_signal);
+        const bool ok = run_sales_daemon(options, &err);
+        if (!ok)
+            fprintf(stderr, "%s\n", err.c_str());
+        stop_maintenance_scheduler();
+        stop_journal_projector();
+        return ok ? 0 : 1;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    Arguments args;
+    if (!parse_arguments(argc, argv, args))
+        return usage();
+
+    const std::string path = option(args, "db", getenv("SALES_DB_PATH") ? getenv("SALES_DB_PATH") : "sales.db");
+    if (!init_db(path))
+        return 1;
+
+    const std::string& command = args.positional[0];
+    int status;
+    if (command == "import")
+        status = run_import(args);
+    else if (command == "export")
+        status = run_export(args);
+    else if (command == "rollup" && args.positional.size() == 2 && args.positional[1] == "rebuild")
+        status = rebuild_sales_rollup() ? 0 : 1;
+    else if (command == "archive")
+        status = run_archive(args);
+    else if (command == "integrity")
+        status = run_integrity();
+    else if (command == "report")
+        status = run_report(args);
+    else if (command == "catalog")
+        status = run_catalog(path, args);
+    else if (command == "barcode")
+        status = run_barcode(path, args);
+    else if (command == "promotion")
+        status = run_promotion(args);
+    else if (command == "saleslog")
+        status = run_sales_log(path, args);
+    else if (command == "journal")
+        status = run_journal(args);
+    else if (command == "replicate")
+        status = run_replicate(args);
+    else if (command == "backup")
+        status = run_backup(args);
+    else if (command == "maintenance")
+        status = run_maintenance(args);
+    else if (command == "daemon")
+        status = run_daemon(path, args);
+    else
+        status = usage();
+
+    close_db();
+    flush_log();
+    return status;
+}
@@ -1,19 +1,113 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "asyncdb_qt.h"
+#include "sqlite/backup.h"
+#include "sqlite/catalog.h"
+#include "sqlite/daemon.h"
 #include "sqlite/database.h"
+#include "sqlite/journal.h"
+#include "sqlite/maintenance.h"
+#include "sqlite/querystats.h"
+#include "sqlite/replication.h"
+#include "sqlite/saleslog.h"
+#include "sqlite/startup.h"
+#include <QTimer>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+
+// 直接访问数据库时由本进程承担的后台工作，经由收银服务时由服务进程负责
+static void start_local_services(const std::string& db_path)
+{
+    // 商品目录快照：版本与数据库一致时直接映射，否则在这里重新生成
+    std::string catalog_err;
+    if (!open_catalog_snapshot(db_path + ".catalog", &catalog_err))
+        std::cerr << "商品目录快照不可用: " << catalog_err << "\n";
+    // 列式销售日志与数据库放在一起，首次打开时从数据库生成，之后随每笔提交追加
+    std::string log_err;
+    if (!open_sales_log(db_path + ".saleslog", &log_err))
+        std::cerr << "销售日志不可用: " << log_err << "\n";
+    // 事件溯源模式下把待投影的销售写入当前状态表，未开启时只做一次轻量读查询
+    start_journal_projector();
+    // 设置了SALES_HQ_DB环境变量时，在后台把门店复制批次发送到总部库
+    if (const char* hq_path = std::getenv("SALES_HQ_DB"))
+        start_replication_shipper(hq_path);
+    // 设置了SALES_BACKUP_DIR环境变量时在后台在线备份，间隔默认15分钟，可用SALES_BACKUP_INTERVAL_MIN调整
+    if (const char* backup_dir = std::getenv("SALES_BACKUP_DIR"))
+    {
+        const char* interval = std::getenv("SALES_BACKUP_INTERVAL_MIN");
+        start_backup_scheduler(backup_dir, interval ? std::atoi(interval) : 15);
+    }
+    // 没有结账时在后台更新统计信息、回收空闲页和做WAL检查点
+    start_maintenance_scheduler();
+}
+
+static void stop_local_services()
+{
+    stop_maintenance_scheduler();
+    stop_backup_scheduler();
+    stop_replication_shipper();
+    stop_journal_projector();
+}
 
 int main(int argc, char* argv[])
 {
+    mark_boot_start();
+
+    // 数据库路径：命令行--db优先，其次环境变量SALES_DB_PATH，默认当前目录下的sales.db
+    std::string db_path = std::getenv("SALES_DB_PATH") ? std::getenv("SALES_DB_PATH") : "sales.db";
+    // 收银服务套接字：命令行--daemon优先，其次环境变量SALES_DAEMON_SOCKET，未指定时直接访问数据库
+    std::string daemon_socket = std::getenv("SALES_DAEMON_SOCKET") ? std::getenv("SALES_DAEMON_SOCKET") : "";
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--db") == 0)
+            db_path = argv[i + 1];
+        else if (std::strcmp(argv[i], "--daemon") == 0)
+            daemon_socket = argv[i + 1];
+    }
+
     // 初始化数据库
-    if (!init_db())
+    if (!init_db(db_path))
     {
         std::cerr << "数据库初始化失败\n";
         return 1;
     }
+    // 设置了SALES_STATS_FILE环境变量时，每分钟导出一次数据层查询统计
+    if (const char* stats_path = std::getenv("SALES_STATS_FILE"))
+        start_query_stats_dump(stats_path, 60);
+    // 经由收银服务时，database.h的调用和全部写入都由服务执行，目录快照、销售日志、事件投影、复制、
+    // 备份和维护也由服务进程负责；本进程的连接只供报表、促销规则等读取
+    const bool via_daemon = !daemon_socket.empty();
+    std::string daemon_err;
+    if (via_daemon && !connect_sales_daemon(daemon_socket, &daemon_err))
+    {
+        std::cerr << "连接收银服务失败: " << daemon_err << "\n";
+        return 1;
+    }
+    if (!via_daemon)
+        start_local_services(db_path);
+    // 商品目录和最近交易在后台预热，与界面创建并行
+    start_startup_warmup();
+    // 可扫码耗时目标，可用SALES_BOOT_TARGET_MS调整
+    if (const char* target = std::getenv("SALES_BOOT_TARGET_MS"))
+        set_boot_target_ms(std::atoi(target));
 
     QApplication a(argc, argv);
+    // 对话框中co_await的查询在工作线程执行，结果经事件循环回到界面线程；打开失败时查询在界面线程同步执行
+    install_qt_resume_executor();
+    std::string async_err;
+    if (!async_database().open(2, &async_err))
+        std::cerr << "异步查询线程未启动: " << async_err << "\n";
     MainWindow w;
     w.show();
-    return QApplication::exec();
+    // 事件循环处理完首次绘制后才算界面就绪
+    QTimer::singleShot(0, [] { mark_ui_ready(); });
+    const int rc = QApplication::exec();
+    async_database().close();
+    if (!via_daemon)
+        stop_local_services();
+    else
+        disconnect_sales_daemon();
+    return rc;
 }
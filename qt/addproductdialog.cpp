@@ -1,4 +1,5 @@
 #include "addproductdialog.h"
+#include "database.h"
 #include <QMessageBox>
 
 AddProductDialog::AddProductDialog(QWidget* parent)
@@ -31,6 +32,11 @@ AddProductDialog::AddProductDialog(QWidget* parent)
     m_productAlertThresholdEdit->setPlaceholderText("请输入预警阈值，库存低于此值时会报警");
     m_productAlertThresholdEdit->setText("10"); // 默认阈值为10
 
+    auto* productBarcodeLabel = new QLabel("商品条码:");
+    m_productBarcodeEdit = new QLineEdit();
+    m_productBarcodeEdit->setValidator(new QRegularExpressionValidator(QRegularExpression("\\d{0,14}"), this));
+    m_productBarcodeEdit->setPlaceholderText("可扫码录入，没有条码时留空");
+
     m_okButton = new QPushButton("确认");
     m_cancelButton = new QPushButton("取消");
 
@@ -53,6 +59,10 @@ AddProductDialog::AddProductDialog(QWidget* parent)
     alertThresholdLayout->addWidget(productAlertThresholdLabel);
     alertThresholdLayout->addWidget(m_productAlertThresholdEdit);
 
+    auto* barcodeLayout = new QHBoxLayout();
+    barcodeLayout->addWidget(productBarcodeLabel);
+    barcodeLayout->addWidget(m_productBarcodeEdit);
+
     auto* buttonLayout = new QHBoxLayout();
     buttonLayout->addStretch();
     buttonLayout->addWidget(m_okButton);
@@ -62,6 +72,7 @@ AddProductDialog::AddProductDialog(QWidget* parent)
     mainLayout->addLayout(priceLayout);
     mainLayout->addLayout(stockLayout);
     mainLayout->addLayout(alertThresholdLayout);
+    mainLayout->addLayout(barcodeLayout);
     mainLayout->addLayout(buttonLayout);
 
     // 连接信号与槽
@@ -69,7 +80,7 @@ AddProductDialog::AddProductDialog(QWidget* parent)
     connect(m_cancelButton, &QPushButton::clicked, this, &AddProductDialog::onCancelClicked);
 
     // 设置对话框大小
-    resize(350, 220);
+    resize(350, 250);
 }
 
 AddProductDialog::~AddProductDialog()
@@ -97,6 +108,11 @@ int AddProductDialog::getProductAlertThreshold() const
     return m_productAlertThresholdEdit->text().toInt();
 }
 
+std::string AddProductDialog::getProductBarcode() const
+{
+    return m_productBarcodeEdit->text().trimmed().toStdString();
+}
+
 void AddProductDialog::onOkClicked()
 {
     // 验证输入
@@ -120,6 +136,12 @@ void AddProductDialog::onOkClicked()
         return;
     }
 
+    const std::string barcode = getProductBarcode();
+    if (!barcode.empty() && !is_valid_barcode(barcode)) {
+        QMessageBox::warning(this, "警告", "条码无效：应为8、12、13或14位数字且校验位正确");
+        return;
+    }
+
     // 输入验证通过，关闭对话框
     accept();
 }
@@ -9,6 +9,7 @@
 #include <QHBoxLayout>
 #include <QDoubleValidator>
 #include <QIntValidator>
+#include <QRegularExpressionValidator>
 
 class AddProductDialog final : public QDialog
 {
@@ -23,12 +24,14 @@ public:
     double getProductPrice() const;
     int getProductStock() const;
     int getProductAlertThreshold() const;
+    std::string getProductBarcode() const;
 
 private:
     QLineEdit* m_productNameEdit;
     QLineEdit* m_productPriceEdit;
     QLineEdit* m_productStockEdit;
     QLineEdit* m_productAlertThresholdEdit;
+    QLineEdit* m_productBarcodeEdit;
     QPushButton* m_okButton;
     QPushButton* m_cancelButton;
 
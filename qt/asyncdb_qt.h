@@ -0,0 +1,26 @@
+#ifndef ASYNCDB_QT_H
+#define ASYNCDB_QT_H
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QObject>
+#include <QPointer>
+#include "../sqlite/asyncdb.h"
+
+// 查询结果就绪后经事件循环回到界面线程恢复协程，在创建QApplication之后调用
+inline void install_qt_resume_executor()
+{
+    set_resume_executor([](std::function<void()> resume)
+    {
+        QMetaObject::invokeMethod(qApp, std::move(resume), Qt::QueuedConnection);
+    });
+}
+
+// 在协程开头co_await bind_to(this)：对象销毁后查询结果到达时不再恢复协程
+inline LifetimeBinding bind_to(QObject* object)
+{
+    QPointer<QObject> guard(object);
+    return LifetimeBinding{[guard] { return !guard.isNull(); }};
+}
+
+#endif // ASYNCDB_QT_H
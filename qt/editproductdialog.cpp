@@ -1,4 +1,5 @@
 #include "editproductdialog.h"
+#include "database.h"
 #include <QMessageBox>
 
 EditProductDialog::EditProductDialog(QWidget* parent)
@@ -36,6 +37,11 @@ EditProductDialog::EditProductDialog(QWidget* parent)
     m_productAlertThresholdEdit->setPlaceholderText("请输入预警阈值，库存低于此值时会报警");
     m_productAlertThresholdEdit->setText("10"); // 默认阈值为10
 
+    auto* productBarcodeLabel = new QLabel("商品条码:");
+    m_productBarcodeEdit = new QLineEdit();
+    m_productBarcodeEdit->setValidator(new QRegularExpressionValidator(QRegularExpression("\\d{0,14}"), this));
+    m_productBarcodeEdit->setPlaceholderText("可扫码录入，没有条码时留空");
+
     m_okButton = new QPushButton("确认修改");
     m_cancelButton = new QPushButton("取消");
 
@@ -62,6 +68,10 @@ EditProductDialog::EditProductDialog(QWidget* parent)
     alertThresholdLayout->addWidget(productAlertThresholdLabel);
     alertThresholdLayout->addWidget(m_productAlertThresholdEdit);
 
+    auto* barcodeLayout = new QHBoxLayout();
+    barcodeLayout->addWidget(productBarcodeLabel);
+    barcodeLayout->addWidget(m_productBarcodeEdit);
+
     auto* buttonLayout = new QHBoxLayout();
     buttonLayout->addStretch();
     buttonLayout->addWidget(m_okButton);
@@ -72,6 +82,7 @@ EditProductDialog::EditProductDialog(QWidget* parent)
     mainLayout->addLayout(priceLayout);
     mainLayout->addLayout(stockLayout);
     mainLayout->addLayout(alertThresholdLayout);
+    mainLayout->addLayout(barcodeLayout);
     mainLayout->addLayout(buttonLayout);
 
     // 连接信号与槽
@@ -79,7 +90,7 @@ EditProductDialog::EditProductDialog(QWidget* parent)
     connect(m_cancelButton, &QPushButton::clicked, this, &EditProductDialog::onCancelClicked);
 
     // 设置对话框大小
-    resize(350, 250);
+    resize(350, 280);
 }
 
 EditProductDialog::~EditProductDialog()
@@ -94,6 +105,7 @@ void EditProductDialog::setProductInfo(const Product& product)
     m_productNameEdit->setText(QString::fromStdString(product.name));
     m_productPriceEdit->setText(QString::number(product.price, 'f', 2));
     m_productStockEdit->setText(QString::number(product.stock));
+    m_productBarcodeEdit->setText(QString::fromStdString(product.barcode));
     // 预警阈值会通过单独的函数设置
 }
 
@@ -123,6 +135,11 @@ int EditProductDialog::getProductAlertThreshold() const
     return m_productAlertThresholdEdit->text().toInt();
 }
 
+std::string EditProductDialog::getProductBarcode() const
+{
+    return m_productBarcodeEdit->text().trimmed().toStdString();
+}
+
 int EditProductDialog::getProductId() const
 {
     return m_productId;
@@ -151,6 +168,12 @@ void EditProductDialog::onOkClicked()
         return;
     }
 
+    const std::string barcode = getProductBarcode();
+    if (!barcode.empty() && !is_valid_barcode(barcode)) {
+        QMessageBox::warning(this, "警告", "条码无效：应为8、12、13或14位数字且校验位正确");
+        return;
+    }
+
     // 输入验证通过，关闭对话框
     accept();
 }
@@ -9,6 +9,7 @@
 #include <QHBoxLayout>
 #include <QDoubleValidator>
 #include <QIntValidator>
+#include <QRegularExpressionValidator>
 #include "saleStruct.h"
 
 class EditProductDialog final : public QDialog
@@ -28,6 +29,7 @@ public:
     int getProductStock() const;
     int getProductId() const;
     int getProductAlertThreshold() const;
+    std::string getProductBarcode() const;
     
     // 设置商品预警阈值
     void setProductAlertThreshold(int threshold);
@@ -38,6 +40,7 @@ private:
     QLineEdit* m_productPriceEdit;
     QLineEdit* m_productStockEdit;
     QLineEdit* m_productAlertThresholdEdit;
+    QLineEdit* m_productBarcodeEdit;
     QPushButton* m_okButton;
     QPushButton* m_cancelButton;
     
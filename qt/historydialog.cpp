@@ -1,11 +1,134 @@
 #include "historydialog.h"
 #include "ui_historydialog.h"
 #include "returndialog.h"
+#include "reportsdialog.h"
 #include "../sqlite/database.h"
+#include "../sqlite/detailcache.h"
 #include "../sale/saleStruct.h"
+#include "asyncdb_qt.h"
 #include <QStandardItemModel>
 #include <QMessageBox>
 #include <QDateTime>
+#include <QShowEvent>
+#include <QTimer>
+#include <unordered_map>
+
+namespace
+{
+    // 退货记录与商品列表互不依赖，同时在两个工作线程上读取，再按商品ID合并，不再逐条查询商品
+    AsyncTask loadReturnRecords(QStandardItemModel* model)
+    {
+        co_await bind_to(model);
+        auto pendingReturns = async_database().get_all_returns();
+        auto pendingProducts = async_database().get_all_products();
+        const auto returns = co_await pendingReturns;
+        const auto products = co_await pendingProducts;
+
+        std::unordered_map<int, const Product*> productById;
+        for (const auto& product : products)
+            productById[product.id] = &product;
+
+        model->setRowCount(0);
+        for (const auto& returnItem : returns)
+        {
+            // 获取商品信息
+            const auto it = productById.find(returnItem.product_id);
+            if (it == productById.end())
+                continue;
+            const Product& product = *it->second;
+
+            // 计算退货金额
+            float returnAmount = product.price * returnItem.quantity;
+
+            QList<QStandardItem*> row;
+
+            // 退货ID
+            row << new QStandardItem(QString::number(returnItem.return_id));
+            // 交易ID
+            row << new QStandardItem(QString::number(returnItem.transaction_id));
+            // 商品ID
+            row << new QStandardItem(QString::number(returnItem.product_id));
+            // 商品名称
+            row << new QStandardItem(QString::fromStdString(product.name));
+            // 退货数量
+            row << new QStandardItem(QString::number(returnItem.quantity));
+            // 退货金额
+            row << new QStandardItem(QString::asprintf("%.2f", returnAmount));
+            // 退货时间
+            QDateTime returnTime = QDateTime::fromSecsSinceEpoch(returnItem.return_time);
+            row << new QStandardItem(returnTime.toString("yyyy-MM-dd HH:mm:ss"));
+
+            model->appendRow(row);
+        }
+    }
+
+    // 读取交易明细后再弹出详情窗口，读取期间界面照常响应
+    AsyncTask showReturnTransactionDetail(QDialog* returnDialog, const int transactionId)
+    {
+        co_await bind_to(returnDialog);
+        const TransactionDetail detail = co_await async_database().get_transaction_detail(transactionId);
+        const Transaction& transaction = detail.transaction;
+
+        // 显示交易详情
+        QDialog* detailDialog = new QDialog(returnDialog);
+        detailDialog->setWindowTitle(QString("交易详情 - ID: %1").arg(transactionId));
+        detailDialog->resize(800, 600);
+
+        auto* detailLayout = new QVBoxLayout(detailDialog);
+
+        // 显示交易基本信息
+        auto* basicInfoGroup = new QGroupBox("交易基本信息", detailDialog);
+        auto* basicInfoLayout = new QVBoxLayout(basicInfoGroup);
+
+        if (transaction.transaction_id != -1)
+        {
+            QDateTime transactionTime = QDateTime::fromSecsSinceEpoch(transaction.create_time);
+
+            QString basicInfo = QString("交易ID: %1\n交易时间: %2\n是否支付: %3\n总金额: %4\n支付金额: %5\n找零: %6")
+                .arg(transaction.transaction_id)
+                .arg(transactionTime.toString("yyyy-MM-dd HH:mm:ss"))
+                .arg(transaction.is_paid ? "已支付" : "未支付")
+                .arg(transaction.total_price, 0, 'f', 2)
+                .arg(transaction.amount_paid, 0, 'f', 2)
+                .arg(transaction.change, 0, 'f', 2);
+
+            auto* infoLabel = new QLabel(basicInfo, basicInfoGroup);
+            basicInfoLayout->addWidget(infoLabel);
+        }
+        detailLayout->addWidget(basicInfoGroup);
+
+        // 显示交易商品详情
+        auto* productGroup = new QGroupBox("交易商品详情", detailDialog);
+        auto* productLayout = new QVBoxLayout(productGroup);
+
+        auto* productTable = new QTableView(productGroup);
+        auto* productModel = new QStandardItemModel(0, 7, productGroup);
+        productModel->setHorizontalHeaderLabels({"商品ID", "商品名称", "单价", "购买数量", "已退货数量", "剩余数量", "小计"});
+
+        for (const auto& line : detail.lines)
+        {
+            const CartItem& item = line.item;
+            QList<QStandardItem*> productRow;
+            productRow << new QStandardItem(QString::number(item.product.id));
+            productRow << new QStandardItem(QString::fromStdString(item.product.name));
+            productRow << new QStandardItem(QString::asprintf("%.2f", item.product.price));
+            productRow << new QStandardItem(QString::number(item.quantity));
+            productRow << new QStandardItem(QString::number(item.returned_quantity));
+            productRow << new QStandardItem(QString::number(item.quantity - item.returned_quantity));
+            productRow << new QStandardItem(QString::asprintf("%.2f", item.subtotal));
+
+            productModel->appendRow(productRow);
+        }
+
+        productTable->setModel(productModel);
+        productTable->horizontalHeader()->setStretchLastSection(true);
+        productLayout->addWidget(productTable);
+        detailLayout->addWidget(productGroup);
+
+        detailDialog->exec();
+        delete detailDialog;
+    }
+}
 
 HistoryDialog::HistoryDialog(QWidget* parent) :
     QDialog(parent),
@@ -29,12 +152,20 @@ HistoryDialog::HistoryDialog(QWidget* parent) :
     // 手动连接信号和槽
     connect(ui->transactionTable, &QTableView::doubleClicked, this,
             &HistoryDialog::on_transactionTable_doubleClicked);
+    // 键盘或鼠标切换选中行时即时显示明细，并预取相邻交易
+    connect(ui->transactionTable->selectionModel(), &QItemSelectionModel::currentRowChanged, this,
+            &HistoryDialog::onCurrentTransactionChanged);
+}
 
-    // 加载交易记录
+void HistoryDialog::showEvent(QShowEvent* event)
+{
+    QDialog::showEvent(event);
+    if (m_loaded)
+        return;
+    m_loaded = true;
+    // 交易记录在工作线程读取，不阻塞对话框显示；低库存提示等对话框显示出来后再弹出
     loadTransactions();
-
-    // 检查低库存
-    checkLowStock();
+    QTimer::singleShot(0, this, &HistoryDialog::checkLowStock);
 }
 
 HistoryDialog::~HistoryDialog()
@@ -42,9 +173,10 @@ HistoryDialog::~HistoryDialog()
     delete ui;
 }
 
-void HistoryDialog::loadTransactions()
+AsyncTask HistoryDialog::loadTransactions(const int selectTransactionId, const bool notifyDone)
 {
-    auto transactions = get_all_transactions();
+    co_await bind_to(this);
+    const auto transactions = co_await async_database().get_all_transactions();
     QStandardItemModel* model = static_cast<QStandardItemModel*>(ui->transactionTable->model());
     model->setRowCount(0);
 
@@ -84,6 +216,28 @@ void HistoryDialog::loadTransactions()
 
     // 显示总交易金额
     ui->totalAmountLabel->setText(QString::asprintf("¥%.2f", totalAmount));
+
+    if (selectTransactionId > 0)
+        selectTransaction(selectTransactionId);
+    if (notifyDone)
+        QMessageBox::information(this, "刷新成功", "交易记录已刷新");
+}
+
+void HistoryDialog::selectTransaction(const int transactionId)
+{
+    // 查找刷新后的交易行
+    QStandardItemModel* model = static_cast<QStandardItemModel*>(ui->transactionTable->model());
+    for (int row = 0; row < model->rowCount(); ++row)
+    {
+        if (model->item(row, 0)->text().toInt() == transactionId)
+        {
+            // 选中该行
+            ui->transactionTable->selectRow(row);
+            // 显示交易详情
+            showTransactionDetails(transactionId);
+            break;
+        }
+    }
 }
 
 void HistoryDialog::on_transactionTable_doubleClicked(const QModelIndex& index)
@@ -94,13 +248,42 @@ void HistoryDialog::on_transactionTable_doubleClicked(const QModelIndex& index)
         QStandardItemModel* model = static_cast<QStandardItemModel*>(ui->transactionTable->model());
         int transactionId = model->item(row, 0)->text().toInt();
         showTransactionDetails(transactionId);
+        prefetchNeighbourDetails(row);
+    }
+}
+
+void HistoryDialog::onCurrentTransactionChanged(const QModelIndex& current, const QModelIndex& previous)
+{
+    Q_UNUSED(previous);
+    if (!current.isValid())
+        return;
+
+    const int row = current.row();
+    QStandardItemModel* model = static_cast<QStandardItemModel*>(ui->transactionTable->model());
+    showTransactionDetails(model->item(row, 0)->text().toInt());
+    prefetchNeighbourDetails(row);
+}
+
+void HistoryDialog::prefetchNeighbourDetails(const int row) const
+{
+    // 预取上下各两笔交易，按距离由近到远排列
+    constexpr int kPrefetchRadius = 2;
+    QStandardItemModel* model = static_cast<QStandardItemModel*>(ui->transactionTable->model());
+    std::vector<int> transactionIds;
+    for (int offset = 1; offset <= kPrefetchRadius; ++offset)
+    {
+        for (const int neighbour : {row + offset, row - offset})
+        {
+            if (neighbour >= 0 && neighbour < model->rowCount())
+                transactionIds.push_back(model->item(neighbour, 0)->text().toInt());
+        }
     }
+    prefetch_transaction_details(transactionIds);
 }
 
 void HistoryDialog::showTransactionDetails(const int transactionId) const
 {
-    auto cartItems = get_cart_items_by_transaction_id(transactionId);
-    auto returnItems = get_returns_by_transaction_id(transactionId);
+    const TransactionDetail detail = get_transaction_detail_cached(transactionId);
     QStandardItemModel* model = static_cast<QStandardItemModel*>(ui->detailTable->model());
     model->setRowCount(0);
 
@@ -108,8 +291,9 @@ void HistoryDialog::showTransactionDetails(const int transactionId) const
     model->setHorizontalHeaderLabels({"商品ID", "商品名称", "单价", "购买数量", "已退货数量", "剩余数量", "小计", "退货时间", "退货原因"});
 
     // 显示商品基本信息
-    for (const auto& item : cartItems)
+    for (const auto& line : detail.lines)
     {
+        const CartItem& item = line.item;
         QList<QStandardItem*> row;
 
         // 商品ID
@@ -152,66 +336,64 @@ void HistoryDialog::showTransactionDetails(const int transactionId) const
         // 将行添加到模型
         model->appendRow(row);
 
-        // 为每条退货记录生成单独的行
-        for (const auto& returnItem : returnItems) {
-            if (returnItem.product_id == item.product.id) {
-                QList<QStandardItem*> returnRow;
-                returnRow << new QStandardItem("");
-                returnRow << new QStandardItem(QString("→ 退货") + QString::fromStdString(item.product.name));
-                returnRow << new QStandardItem(QString::asprintf("%.2f", item.product.price));
-                returnRow << new QStandardItem("");
-                returnRow << new QStandardItem("-"); // 已退货数量列显示"-"
-                returnRow << new QStandardItem(QString::number(returnItem.quantity)); // 剩余数量列显示本次退货数量
-                returnRow << new QStandardItem(QString::asprintf("-%.2f", item.product.price * returnItem.quantity));
-                
-                // 退货时间
-                QDateTime returnTime = QDateTime::fromSecsSinceEpoch(returnItem.return_time);
-                returnRow << new QStandardItem(returnTime.toString("yyyy-MM-dd HH:mm:ss"));
-                
-                // 退货原因
-                returnRow << new QStandardItem(QString::fromStdString(returnItem.reason));
-                
-                // 设置退货行的样式
-                for (auto* itemWidget : returnRow) {
-                    itemWidget->setForeground(QBrush(Qt::red));
-                    QFont font = itemWidget->font();
-                    font.setItalic(true);
-                    itemWidget->setFont(font);
-                }
-                
-                model->appendRow(returnRow);
+        // 为每条退货记录生成单独的行（退货记录已按商品归入明细行）
+        for (const auto& returnItem : line.returns) {
+            QList<QStandardItem*> returnRow;
+            returnRow << new QStandardItem("");
+            returnRow << new QStandardItem(QString("→ 退货") + QString::fromStdString(item.product.name));
+            returnRow << new QStandardItem(QString::asprintf("%.2f", item.product.price));
+            returnRow << new QStandardItem("");
+            returnRow << new QStandardItem("-"); // 已退货数量列显示"-"
+            returnRow << new QStandardItem(QString::number(returnItem.quantity)); // 剩余数量列显示本次退货数量
+            // 退款按该行实付单价计算，含促销折扣
+            returnRow << new QStandardItem(QString::asprintf("-%.2f", item.subtotal / item.quantity * returnItem.quantity));
+            
+            // 退货时间
+            QDateTime returnTime = QDateTime::fromSecsSinceEpoch(returnItem.return_time);
+            returnRow << new QStandardItem(returnTime.toString("yyyy-MM-dd HH:mm:ss"));
+            
+            // 退货原因
+            returnRow << new QStandardItem(QString::fromStdString(returnItem.reason));
+            
+            // 设置退货行的样式
+            for (auto* itemWidget : returnRow) {
+                itemWidget->setForeground(QBrush(Qt::red));
+                QFont font = itemWidget->font();
+                font.setItalic(true);
+                itemWidget->setFont(font);
             }
+            
+            model->appendRow(returnRow);
         }
     }
 }
 
 void HistoryDialog::on_refreshButton_clicked()
 {
-    loadTransactions();
+    loadTransactions(0, true);
     checkLowStock();
-    QMessageBox::information(this, "刷新成功", "交易记录已刷新");
 }
 
 void HistoryDialog::checkLowStock()
 {
-    const auto lowStockProducts = get_low_stock_products();
-    if (!lowStockProducts.empty())
+    // 低库存集合由数据层增量维护，这里只读取当前集合
+    const auto lowStockEntries = get_low_stock_entries();
+    if (!lowStockEntries.empty())
     {
-        showLowStockWarning();
+        showLowStockWarning(lowStockEntries);
     }
 }
 
-void HistoryDialog::showLowStockWarning()
+void HistoryDialog::showLowStockWarning(const std::vector<LowStockEntry>& lowStockEntries)
 {
-    const auto lowStockProducts = get_low_stock_products();
-    if (lowStockProducts.empty())
+    if (lowStockEntries.empty())
         return;
 
     QString warningText = "以下商品库存过低，需要补货：\n\n";
-    for (const auto& product : lowStockProducts)
+    for (const auto& entry : lowStockEntries)
     {
-        warningText += QString::fromStdString(product.name) + ": 库存 " + QString::number(
-            product.stock) + " (预警阈值: " + QString::number(get_product_alert_threshold(product.id)) + ")\n";
+        warningText += QString::fromStdString(entry.name) + ": 库存 " + QString::number(
+            entry.stock) + " (预警阈值: " + QString::number(entry.alert_threshold) + ")\n";
     }
 
     QMessageBox::warning(this, "库存警告", warningText);
@@ -239,33 +421,12 @@ void HistoryDialog::on_returnButton_clicked()
     }
     dialog.exec();
 
-    // 刷新交易记录
-    loadTransactions();
-    
-    // 如果原来有选中的交易，重新选中并显示详情
-    if (transactionId > 0)
-    {
-        // 查找刷新后的交易行
-        QStandardItemModel* model = static_cast<QStandardItemModel*>(ui->transactionTable->model());
-        for (int row = 0; row < model->rowCount(); ++row)
-        {
-            if (model->item(row, 0)->text().toInt() == transactionId)
-            {
-                // 选中该行
-                ui->transactionTable->selectRow(row);
-                // 显示交易详情
-                showTransactionDetails(transactionId);
-                break;
-            }
-        }
-    }
+    // 刷新交易记录，如果原来有选中的交易，刷新后重新选中并显示详情
+    loadTransactions(transactionId);
 }
 
 void HistoryDialog::on_returnRecordButton_clicked()
 {
-    // 获取所有退货记录
-    const auto returns = get_all_returns();
-    
     // 创建退货记录对话框
     QDialog* returnDialog = new QDialog(this);
     returnDialog->setWindowTitle("退货记录");
@@ -280,41 +441,10 @@ void HistoryDialog::on_returnRecordButton_clicked()
     returnTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
     returnTable->horizontalHeader()->setStretchLastSection(true);
     
-    // 创建模型
+    // 创建模型，退货记录在后台读取，对话框先显示出来
     QStandardItemModel* model = new QStandardItemModel(0, 7, returnDialog);
     model->setHorizontalHeaderLabels({"退货ID", "交易ID", "商品ID", "商品名称", "退货数量", "退货金额", "退货时间"});
-    
-    // 添加数据
-    for (const auto& returnItem : returns)
-    {
-        // 获取商品信息
-        Product product = query_product(returnItem.product_id);
-        if (product.id == -1)
-            continue;
-        
-        // 计算退货金额
-        float returnAmount = product.price * returnItem.quantity;
-        
-        QList<QStandardItem*> row;
-        
-        // 退货ID
-        row << new QStandardItem(QString::number(returnItem.return_id));
-        // 交易ID
-        row << new QStandardItem(QString::number(returnItem.transaction_id));
-        // 商品ID
-        row << new QStandardItem(QString::number(returnItem.product_id));
-        // 商品名称
-        row << new QStandardItem(QString::fromStdString(product.name));
-        // 退货数量
-        row << new QStandardItem(QString::number(returnItem.quantity));
-        // 退货金额
-        row << new QStandardItem(QString::asprintf("%.2f", returnAmount));
-        // 退货时间
-        QDateTime returnTime = QDateTime::fromSecsSinceEpoch(returnItem.return_time);
-        row << new QStandardItem(returnTime.toString("yyyy-MM-dd HH:mm:ss"));
-        
-        model->appendRow(row);
-    }
+    loadReturnRecords(model);
     
     returnTable->setModel(model);
     layout->addWidget(returnTable);
@@ -329,28 +459,7 @@ void HistoryDialog::on_returnRecordButton_clicked()
     // 连接信号槽
     connect(refreshButton, &QPushButton::clicked, [=]() {
         // 重新加载退货记录
-        model->setRowCount(0);
-        const auto updatedReturns = get_all_returns();
-        for (const auto& returnItem : updatedReturns)
-        {
-            Product product = query_product(returnItem.product_id);
-            if (product.id == -1)
-                continue;
-            
-            float returnAmount = product.price * returnItem.quantity;
-            
-            QList<QStandardItem*> row;
-            row << new QStandardItem(QString::number(returnItem.return_id));
-            row << new QStandardItem(QString::number(returnItem.transaction_id));
-            row << new QStandardItem(QString::number(returnItem.product_id));
-            row << new QStandardItem(QString::fromStdString(product.name));
-            row << new QStandardItem(QString::number(returnItem.quantity));
-            row << new QStandardItem(QString::asprintf("%.2f", returnAmount));
-            QDateTime returnTime = QDateTime::fromSecsSinceEpoch(returnItem.return_time);
-            row << new QStandardItem(returnTime.toString("yyyy-MM-dd HH:mm:ss"));
-            
-            model->appendRow(row);
-        }
+        loadReturnRecords(model);
     });
     
     // 双击查看交易详情
@@ -359,72 +468,17 @@ void HistoryDialog::on_returnRecordButton_clicked()
         {
             int row = index.row();
             int transactionId = model->item(row, 1)->text().toInt();
-            
-            // 显示交易详情
-            QDialog* detailDialog = new QDialog(returnDialog);
-            detailDialog->setWindowTitle(QString("交易详情 - ID: %1").arg(transactionId));
-            detailDialog->resize(800, 600);
-            
-            auto* detailLayout = new QVBoxLayout(detailDialog);
-            
-            // 显示交易基本信息
-            auto* basicInfoGroup = new QGroupBox("交易基本信息", detailDialog);
-            auto* basicInfoLayout = new QVBoxLayout(basicInfoGroup);
-            
-            const auto transactions = get_all_transactions();
-            const auto transactionIt = std::find_if(transactions.begin(), transactions.end(),
-                [transactionId](const Transaction& t) { return t.transaction_id == transactionId; });
-            
-            if (transactionIt != transactions.end())
-            {
-                QDateTime transactionTime = QDateTime::fromSecsSinceEpoch(transactionIt->create_time);
-                
-                QString basicInfo = QString("交易ID: %1\n交易时间: %2\n是否支付: %3\n总金额: %4\n支付金额: %5\n找零: %6")
-                    .arg(transactionIt->transaction_id)
-                    .arg(transactionTime.toString("yyyy-MM-dd HH:mm:ss"))
-                    .arg(transactionIt->is_paid ? "已支付" : "未支付")
-                    .arg(transactionIt->total_price, 0, 'f', 2)
-                    .arg(transactionIt->amount_paid, 0, 'f', 2)
-                    .arg(transactionIt->change, 0, 'f', 2);
-                
-                auto* infoLabel = new QLabel(basicInfo, basicInfoGroup);
-                basicInfoLayout->addWidget(infoLabel);
-            }
-            detailLayout->addWidget(basicInfoGroup);
-            
-            // 显示交易商品详情
-            auto* productGroup = new QGroupBox("交易商品详情", detailDialog);
-            auto* productLayout = new QVBoxLayout(productGroup);
-            
-            auto* productTable = new QTableView(productGroup);
-            auto* productModel = new QStandardItemModel(0, 7, productGroup);
-            productModel->setHorizontalHeaderLabels({"商品ID", "商品名称", "单价", "购买数量", "已退货数量", "剩余数量", "小计"});
-            
-            const auto cartItems = get_cart_items_by_transaction_id(transactionId);
-            for (const auto& item : cartItems)
-            {
-                QList<QStandardItem*> productRow;
-                productRow << new QStandardItem(QString::number(item.product.id));
-                productRow << new QStandardItem(QString::fromStdString(item.product.name));
-                productRow << new QStandardItem(QString::asprintf("%.2f", item.product.price));
-                productRow << new QStandardItem(QString::number(item.quantity));
-                productRow << new QStandardItem(QString::number(item.returned_quantity));
-                productRow << new QStandardItem(QString::number(item.quantity - item.returned_quantity));
-                productRow << new QStandardItem(QString::asprintf("%.2f", item.subtotal));
-                
-                productModel->appendRow(productRow);
-            }
-            
-            productTable->setModel(productModel);
-            productTable->horizontalHeader()->setStretchLastSection(true);
-            productLayout->addWidget(productTable);
-            detailLayout->addWidget(productGroup);
-            
-            detailDialog->exec();
-            delete detailDialog;
+            showReturnTransactionDetail(returnDialog, transactionId);
         }
     });
     
     returnDialog->exec();
     delete returnDialog;
 }
+
+void HistoryDialog::on_reportButton_clicked()
+{
+    // 打开销售报表
+    ReportsDialog dialog(this);
+    dialog.exec();
+}
@@ -3,6 +3,9 @@
 
 #include <QDialog>
 #include "saleStruct.h"
+#include "lowstock.h"
+#include "asyncdb.h"
+#include <vector>
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -18,17 +21,26 @@ public:
     explicit HistoryDialog(QWidget *parent = nullptr);
     ~HistoryDialog() override;
 
+protected:
+    void showEvent(QShowEvent *event) override;
+
 private slots:
     void on_transactionTable_doubleClicked(const QModelIndex &index);
     void on_refreshButton_clicked();
     void on_returnButton_clicked();
     void on_returnRecordButton_clicked();
+    void on_reportButton_clicked();
     void checkLowStock();
+    void onCurrentTransactionChanged(const QModelIndex &current, const QModelIndex &previous);
 
 private:
     Ui::HistoryDialog *ui;
-    void loadTransactions();
+    bool m_loaded = false;  // 首次显示时才加载数据
+    // 在数据库工作线程读取交易记录，完成后回到界面线程填表；selectTransactionId大于0时重新选中该交易
+    AsyncTask loadTransactions(int selectTransactionId = 0, bool notifyDone = false);
+    void selectTransaction(int transactionId);
     void showTransactionDetails(int transactionId) const;
-    void showLowStockWarning();
+    void prefetchNeighbourDetails(int row) const;
+    void showLowStockWarning(const std::vector<LowStockEntry>& lowStockEntries);
 };
 #endif // HISTORYDIALOG_H
\ No newline at end of file
@@ -1,10 +1,13 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include <QApplication>
 #include <QPushButton>
 #include <QTableWidgetItem>
 #include <QMessageBox>
 #include "manualadddialog.h"
 #include "settlementdialog.h"
+#include "lowstock.h"
+#include "database.h"
 
 MainWindow::MainWindow(QWidget* parent) :
     QMainWindow(parent),
@@ -17,13 +20,31 @@ MainWindow::MainWindow(QWidget* parent) :
     m_cart.items.clear();
 
     connect(ui->mngm, &QPushButton::clicked, this, &MainWindow::onMngmClicked);
+    // 扫码枪以回车结束一次输入，处理后清空输入框并保持焦点，连续扫码不需要碰鼠标
+    connect(ui->scanEdit, &QLineEdit::returnPressed, this, &MainWindow::onScanReturnPressed);
+
+    // 订阅低库存穿越事件，在状态栏提示；回调可能来自写操作所在线程，排队到界面线程处理
+    m_lowStockListenerId = add_low_stock_listener([this](const LowStockCrossing& crossing)
+    {
+        const QString name = QString::fromStdString(crossing.entry.name);
+        const QString message = crossing.entered
+            ? QString("库存警告：商品 '%1' 库存降至 %2（预警阈值 %3）")
+              .arg(name).arg(crossing.entry.stock).arg(crossing.entry.alert_threshold)
+            : QString("商品 '%1' 库存已恢复").arg(name);
+        QMetaObject::invokeMethod(this, [this, message]()
+        {
+            ui->statusbar->showMessage(message, 10000);
+        }, Qt::QueuedConnection);
+    });
 
     // 更新购物车显示
     updateCartDisplay();
+    ui->scanEdit->setFocus();
 }
 
 MainWindow::~MainWindow()
 {
+    remove_low_stock_listener(m_lowStockListenerId);
     // 释放UI资源
     delete ui;
 }
@@ -34,53 +55,183 @@ ShoppingCart& MainWindow::getCart()
 }
 
 
-void MainWindow::updateCartDisplay()
+void MainWindow::setCartRow(const int row, const CartItem& item)
 {
-    ui->productTable->setRowCount(0);
-    // 遍历购物车中的商品
+    // 依次为商品ID、商品名称、单价、小计、数量、优惠
+    const QString texts[] = {
+        QString::number(item.product.id),
+        QString::fromStdString(item.product.name),
+        QString::number(item.product.price, 'f', 2),
+        QString::number(item.subtotal, 'f', 2),
+        QString::number(item.quantity),
+        item.discount > 0 ? QString::number(item.discount, 'f', 2) : QString(),
+    };
+    for (int column = 0; column < 6; ++column)
+    {
+        QTableWidgetItem* cell = ui->productTable->item(row, column);
+        if (!cell)
+        {
+            cell = new QTableWidgetItem();
+            cell->setFlags(cell->flags() & ~Qt::ItemIsEditable);
+            ui->productTable->setItem(row, column, cell);
+        }
+        cell->setText(texts[column]);
+    }
+}
+
+void MainWindow::repriceCart()
+{
+    // 促销可能已在其他终端修改，限时促销按当前时间判断；规则未变时load_promotion_rules直接返回缓存
+    m_pricer.clear();
+    m_pricer.reset(load_promotion_rules(), time(nullptr));
     for (const auto& item : m_cart.items)
+        m_pricer.set_line(item.product.id, item.product.price, item.quantity);
+    m_cart.total_price = 0.0f;
+    for (auto& item : m_cart.items)
     {
-        const auto& product = item.product;
-        const auto quantity = item.quantity;
-        const auto subtotal = item.subtotal;
+        item.discount = static_cast<float>(m_pricer.discount(item.product.id));
+        item.promotion_id = m_pricer.promotion_id(item.product.id);
+        item.subtotal = item.product.price * item.quantity - item.discount;
+        m_cart.total_price += item.subtotal;
+    }
+}
 
-        // 添加新行
-        const int row = ui->productTable->rowCount();
-        ui->productTable->insertRow(row);
+void MainWindow::applyDiscounts(const std::vector<int>& productIds)
+{
+    for (const int productId : productIds)
+    {
+        const auto found = m_cartRows.find(productId);
+        if (found == m_cartRows.end())
+            continue;
+        CartItem& item = m_cart.items[found->second];
+        const float oldSubtotal = item.subtotal;
+        item.discount = static_cast<float>(m_pricer.discount(productId));
+        item.promotion_id = m_pricer.promotion_id(productId);
+        item.subtotal = item.product.price * item.quantity - item.discount;
+        m_cart.total_price += item.subtotal - oldSubtotal;
+        setCartRow(found->second, item);
+    }
+}
 
-        // 商品ID
-        auto* idItem = new QTableWidgetItem(QString::number(product.id));
-        idItem->setFlags(idItem->flags() & ~Qt::ItemIsEditable);
-        ui->productTable->setItem(row, 0, idItem);
-
-        // 商品名称
-        auto* nameItem = new
-            QTableWidgetItem(QString::fromStdString(product.name));
-        nameItem->setFlags(nameItem->flags() & ~Qt::ItemIsEditable);
-        ui->productTable->setItem(row, 1, nameItem);
-
-        // 单价
-        auto* priceItem = new QTableWidgetItem(
-            QString::number(product.price, 'f', 2));
-        priceItem->setFlags(priceItem->flags() & ~Qt::ItemIsEditable);
-        ui->productTable->setItem(row, 2, priceItem);
-
-        // 小计
-        auto* subtotalItem = new QTableWidgetItem(
-            QString::number(subtotal, 'f', 2));
-        subtotalItem->setFlags(subtotalItem->flags() & ~Qt::ItemIsEditable);
-        ui->productTable->setItem(row, 3, subtotalItem);
-
-        // 数量
-        auto* quantityItem = new QTableWidgetItem(QString::number(quantity));
-        quantityItem->setFlags(quantityItem->flags() & ~Qt::ItemIsEditable);
-        ui->productTable->setItem(row, 4, quantityItem);
+void MainWindow::updateCartDisplay()
+{
+    // 其他窗口整体修改了购物车，按促销整车重算后重建表格
+    repriceCart();
+    ui->productTable->setRowCount(0);
+    ui->productTable->setRowCount(static_cast<int>(m_cart.items.size()));
+    m_cartRows.clear();
+    // 遍历购物车中的商品，同时重建商品ID到行号的索引
+    for (int row = 0; row < static_cast<int>(m_cart.items.size()); ++row)
+    {
+        setCartRow(row, m_cart.items[row]);
+        m_cartRows[m_cart.items[row].product.id] = row;
     }
 
     // 更新总计金额
     ui->label_totalMoney->setText(QString::number(m_cart.total_price, 'f', 2));
 }
 
+bool MainWindow::addToCart(const QString& code, const int quantity, QString* errorMsg)
+{
+    const auto fail = [errorMsg](const QString& message)
+    {
+        if (errorMsg) *errorMsg = message;
+        return false;
+    };
+    if (quantity <= 0)
+        return fail("请输入有效的数量");
+
+    // 8位及以上的数字按条码查找（目录快照中的条码哈希索引），较短的按商品ID查找
+    const std::string text = code.trimmed().toStdString();
+    Product product{};
+    product.id = -1;
+    if (text.size() >= 8)
+        product = query_product_by_barcode(text);
+    else if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos)
+        product = query_product(std::stoi(text));
+    if (product.id == -1)
+        return fail(QString("未找到条码或商品ID为 %1 的商品").arg(code.trimmed()));
+
+    // 其他窗口直接修改购物车后都会调用updateCartDisplay，行号索引与购物车一致；不一致时先整表刷新
+    if (m_cartRows.size() != m_cart.items.size())
+        updateCartDisplay();
+    // 新顾客的第一件商品：重新取促销规则和计价时间
+    if (m_cart.items.empty())
+    {
+        m_pricer.clear();
+        m_pricer.reset(load_promotion_rules(), time(nullptr));
+    }
+
+    const auto found = m_cartRows.find(product.id);
+    const int inCart = found != m_cartRows.end() ? m_cart.items[found->second].quantity : 0;
+    if (inCart + quantity > product.stock)
+    {
+        return fail(QString("商品 '%1' 库存不足，当前库存 %2，购物车中已有 %3")
+                    .arg(QString::fromStdString(product.name)).arg(product.stock).arg(inCart));
+    }
+
+    int row;
+    if (found != m_cartRows.end())
+    {
+        row = found->second;
+        CartItem& cartItem = m_cart.items[row];
+        const float oldSubtotal = cartItem.subtotal;
+        cartItem.quantity += quantity;
+        cartItem.subtotal = cartItem.product.price * cartItem.quantity - cartItem.discount;
+        m_cart.total_price += cartItem.subtotal - oldSubtotal;
+    }
+    else
+    {
+        CartItem cartItem;
+        cartItem.product = product;
+        cartItem.quantity = quantity;
+        cartItem.subtotal = product.price * quantity;
+        m_cart.items.push_back(cartItem);
+        m_cart.total_price += cartItem.subtotal;
+        row = static_cast<int>(m_cart.items.size()) - 1;
+        m_cartRows[product.id] = row;
+        ui->productTable->insertRow(row);
+    }
+
+    // 只重算引用该商品的促销，只刷新该行、折扣有变化的行和总计，购物车很长时扫码也不需要重建表格
+    applyDiscounts(m_pricer.set_line(product.id, m_cart.items[row].product.price, m_cart.items[row].quantity));
+    setCartRow(row, m_cart.items[row]);
+    ui->productTable->selectRow(row);
+    ui->productTable->scrollToItem(ui->productTable->item(row, 0));
+    ui->label_totalMoney->setText(QString::number(m_cart.total_price, 'f', 2));
+    return true;
+}
+
+void MainWindow::onScanReturnPressed()
+{
+    // 支持“数量*条码”一次录入多件，如 6*6901234567892
+    const QString input = ui->scanEdit->text().trimmed();
+    ui->scanEdit->clear();
+    if (input.isEmpty())
+        return;
+    QString code = input;
+    int quantity = 1;
+    const int star = input.indexOf('*');
+    if (star > 0)
+    {
+        bool ok = false;
+        quantity = input.left(star).toInt(&ok);
+        code = input.mid(star + 1);
+        if (!ok)
+            quantity = 0;
+    }
+
+    // 出错时提示音加状态栏提示，不弹出对话框，收银员可以直接扫下一件
+    QString errorMsg;
+    if (!addToCart(code, quantity, &errorMsg))
+    {
+        QApplication::beep();
+        ui->statusbar->showMessage(errorMsg, 5000);
+        return;
+    }
+    ui->statusbar->showMessage(QString("已添加 %1 × %2").arg(code).arg(quantity), 2000);
+}
+
 void MainWindow::onMngmClicked()
 {
     // 创建并显示模拟窗口，设置为独立窗口
@@ -95,6 +246,7 @@ void MainWindow::on_sdtj_clicked()
     // 弹出手动添加商品对话框
     ManualAddDialog dialog(this);
     dialog.exec();
+    ui->scanEdit->setFocus();
 }
 
 void MainWindow::on_qk_clicked()
@@ -104,6 +256,7 @@ void MainWindow::on_qk_clicked()
     m_cart.total_price = 0.0;
     updateCartDisplay();
     QMessageBox::information(this, "提示", "购物车已清空");
+    ui->scanEdit->setFocus();
 }
 
 void MainWindow::on_jiesuan_clicked()
@@ -115,9 +268,13 @@ void MainWindow::on_jiesuan_clicked()
         return;
     }
 
+    // 限时促销以结算时刻为准，结算前整车重算一次
+    updateCartDisplay();
+
     // 弹出结算对话框
     SettlementDialog dialog(this, m_cart.total_price);
     dialog.exec();
+    ui->scanEdit->setFocus();
 }
 
 void MainWindow::on_historyButton_clicked()
@@ -2,9 +2,11 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <unordered_map>
 #include "simulate.h"
 #include "saleStruct.h"
 #include "historydialog.h"
+#include "promotion.h"
 
 class ManualAddDialog;
 class SettlementDialog;
@@ -33,9 +35,22 @@ public:
     // 更新购物车显示
     void updateCartDisplay();
 
+    // 按条码或商品ID加入购物车，已有的行增加数量，只刷新该行和总计；库存不足或找不到商品时返回false
+    bool addToCart(const QString& code, int quantity, QString* errorMsg = nullptr);
+
 private:
     Ui::MainWindow* ui;
     ShoppingCart m_cart; // 购物车实例
+    std::unordered_map<int, int> m_cartRows; // 商品ID到购物车行号，扫码时直接定位已有的行
+    CartPricer m_pricer; // 购物车的促销计算状态，修改一行时只重算引用该商品的促销
+    int m_lowStockListenerId; // 低库存事件监听器ID
+
+    // 把购物车项写入表格的一行
+    void setCartRow(int row, const CartItem& item);
+    // 按当前促销规则和时间整车重算折扣、小计和总计
+    void repriceCart();
+    // 把促销计算中折扣有变化的行写回购物车并刷新这些行
+    void applyDiscounts(const std::vector<int>& productIds);
 
 
 private slots:
@@ -44,5 +59,6 @@ private slots:
     void on_qk_clicked();
     void on_jiesuan_clicked();
     void on_historyButton_clicked();
+    void onScanReturnPressed();
 };
 #endif // MAINWINDOW_H
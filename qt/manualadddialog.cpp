@@ -3,6 +3,7 @@
 #include "database.h"
 #include <QMessageBox>
 #include <QIntValidator>
+#include <QRegularExpressionValidator>
 
 ManualAddDialog::ManualAddDialog(MainWindow* parent)
     : QDialog(parent), m_mainWindow(parent)
@@ -11,10 +12,10 @@ ManualAddDialog::ManualAddDialog(MainWindow* parent)
     setWindowTitle("手动添加商品");
 
     // 创建UI组件
-    auto* productIdLabel = new QLabel("商品ID:");
+    auto* productIdLabel = new QLabel("商品ID或条码:");
     m_productIdEdit = new QLineEdit();
-    m_productIdEdit->setValidator(new QIntValidator(1, 9999, this));
-    m_productIdEdit->setPlaceholderText("请输入商品ID");
+    m_productIdEdit->setValidator(new QRegularExpressionValidator(QRegularExpression("\\d{1,14}"), this));
+    m_productIdEdit->setPlaceholderText("请输入商品ID或条码");
 
     auto* quantityLabel = new QLabel("数量:");
     m_quantityEdit = new QLineEdit();
@@ -59,13 +60,13 @@ ManualAddDialog::~ManualAddDialog()
 
 void ManualAddDialog::onOkClicked()
 {
-    // 获取商品ID和数量
-    int productId = m_productIdEdit->text().toInt();
+    // 获取商品ID或条码和数量
+    const QString code = m_productIdEdit->text().trimmed();
     int quantity = m_quantityEdit->text().toInt();
 
     // 验证输入
-    if (productId <= 0) {
-        QMessageBox::warning(this, "警告", "请输入有效的商品ID");
+    if (code.isEmpty()) {
+        QMessageBox::warning(this, "警告", "请输入有效的商品ID或条码");
         return;
     }
 
@@ -74,50 +75,14 @@ void ManualAddDialog::onOkClicked()
         return;
     }
 
-    // 查询商品是否存在
-    Product product = query_product(productId);
-    if (product.id == -1) {
-        QMessageBox::warning(this, "警告", QString("商品ID %1 不存在").arg(productId));
-        return;
-    }
-
-    // 检查数量是否超过库存
-    if (quantity > product.stock) {
-        QMessageBox::warning(this, "警告", QString("商品ID %1 的库存不足，当前库存为 %2").arg(productId).arg(product.stock));
-        return;
-    }
-
-    // 添加到购物车
+    // 与扫码共用加入购物车的逻辑：查找商品、检查库存（含购物车中已有数量）、更新对应的行
     if (m_mainWindow) {
-        ShoppingCart& cart = m_mainWindow->getCart();
-
-        // 检查购物车中是否已有该商品
-        bool found = false;
-        for (auto& cartItem : cart.items) {
-            if (cartItem.product.id == productId) {
-                // 更新已有商品的数量
-                float oldSubtotal = cartItem.subtotal;
-                cartItem.quantity += quantity;
-                cartItem.subtotal = cartItem.product.price * cartItem.quantity;
-                cart.total_price += (cartItem.subtotal - oldSubtotal);
-                found = true;
-                break;
-            }
-        }
-
-        if (!found) {
-            // 添加新商品到购物车
-            CartItem cartItem;
-            cartItem.product = product;
-            cartItem.quantity = quantity;
-            cartItem.subtotal = product.price * quantity;
-            cart.items.push_back(cartItem);
-            cart.total_price += cartItem.subtotal;
+        QString errorMsg;
+        if (!m_mainWindow->addToCart(code, quantity, &errorMsg)) {
+            QMessageBox::warning(this, "警告", errorMsg);
+            return;
         }
 
-        // 更新主窗口的购物车显示
-        m_mainWindow->updateCartDisplay();
-
         // 关闭对话框
         accept();
     }
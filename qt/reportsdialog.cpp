@@ -0,0 +1,181 @@
+#include "reportsdialog.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QTableWidgetItem>
+#include <QVBoxLayout>
+#include "analytics.h"
+
+namespace
+{
+    QTableWidgetItem* cell(const QString& text)
+    {
+        auto* item = new QTableWidgetItem(text);
+        item->setTextAlignment(Qt::AlignCenter);
+        return item;
+    }
+
+    QString percent(const double ratio)
+    {
+        return QString::number(ratio * 100.0, 'f', 1) + "%";
+    }
+}
+
+ReportsDialog::ReportsDialog(QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle("销售报表");
+    resize(800, 600);
+
+    // 查询条件，默认最近30天
+    m_fromEdit = new QDateEdit(QDate::currentDate().addDays(-29));
+    m_fromEdit->setCalendarPopup(true);
+    m_fromEdit->setDisplayFormat("yyyy-MM-dd");
+    m_toEdit = new QDateEdit(QDate::currentDate());
+    m_toEdit->setCalendarPopup(true);
+    m_toEdit->setDisplayFormat("yyyy-MM-dd");
+    m_limitSpinBox = new QSpinBox();
+    m_limitSpinBox->setRange(1, 1000);
+    m_limitSpinBox->setValue(20);
+    m_queryButton = new QPushButton("查询");
+    m_closeButton = new QPushButton("关闭");
+
+    auto* conditionLayout = new QHBoxLayout();
+    conditionLayout->addWidget(new QLabel("开始日期:"));
+    conditionLayout->addWidget(m_fromEdit);
+    conditionLayout->addWidget(new QLabel("结束日期:"));
+    conditionLayout->addWidget(m_toEdit);
+    conditionLayout->addWidget(new QLabel("排行数量:"));
+    conditionLayout->addWidget(m_limitSpinBox);
+    conditionLayout->addWidget(m_queryButton);
+    conditionLayout->addStretch();
+
+    // 报表页
+    m_revenueTable = createTable({"排名", "商品ID", "商品名称", "售出数量", "销售额", "销售额占比"});
+    m_quantityTable = createTable({"排名", "商品ID", "商品名称", "售出数量", "销售额", "销售额占比"});
+    m_hourTable = createTable({"时段", "交易笔数", "售出件数", "销售额", "销售额占比"});
+    m_returnTable = createTable({"商品ID", "商品名称", "售出数量", "退回数量", "退货率", "整体退货率"});
+    m_tabs = new QTabWidget();
+    m_tabs->addTab(m_revenueTable, "销售额排行");
+    m_tabs->addTab(m_quantityTable, "销量排行");
+    m_tabs->addTab(m_hourTable, "分时段销售");
+    m_tabs->addTab(m_returnTable, "退货率");
+
+    m_basketLabel = new QLabel();
+    m_timingLabel = new QLabel();
+    auto* bottomLayout = new QHBoxLayout();
+    bottomLayout->addWidget(m_basketLabel);
+    bottomLayout->addStretch();
+    bottomLayout->addWidget(m_timingLabel);
+    bottomLayout->addWidget(m_closeButton);
+
+    auto* mainLayout = new QVBoxLayout(this);
+    mainLayout->addLayout(conditionLayout);
+    mainLayout->addWidget(m_tabs);
+    mainLayout->addLayout(bottomLayout);
+
+    connect(m_queryButton, &QPushButton::clicked, this, &ReportsDialog::onQueryClicked);
+    connect(m_closeButton, &QPushButton::clicked, this, &QDialog::accept);
+
+    loadReports();
+}
+
+ReportsDialog::~ReportsDialog()
+{
+    // 不需要手动释放UI组件，Qt的布局会自动处理
+}
+
+QTableWidget* ReportsDialog::createTable(const QStringList& headers)
+{
+    auto* table = new QTableWidget();
+    table->setColumnCount(static_cast<int>(headers.size()));
+    table->setHorizontalHeaderLabels(headers);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->setVisible(false);
+    return table;
+}
+
+void ReportsDialog::loadReports()
+{
+    // 结束日期当天包含在内
+    const long long from = QDateTime(m_fromEdit->date(), QTime(0, 0)).toSecsSinceEpoch();
+    const long long to = QDateTime(m_toEdit->date().addDays(1), QTime(0, 0)).toSecsSinceEpoch();
+
+    QElapsedTimer timer;
+    timer.start();
+    const SalesAnalytics analytics = get_sales_analytics(from, to, m_limitSpinBox->value());
+    const qint64 elapsed = timer.elapsed();
+
+    fillRankingTable(m_revenueTable, analytics.top_by_revenue);
+    fillRankingTable(m_quantityTable, analytics.top_by_quantity);
+    fillHourTable(analytics.by_hour);
+    fillReturnTable(analytics.return_rates);
+
+    const BasketStats& basket = analytics.basket;
+    m_basketLabel->setText(QString("交易 %1 笔，平均每单 %2 件（中位数 %3），%4 种商品，客单价 %5")
+                           .arg(basket.transactions)
+                           .arg(basket.average_items, 0, 'f', 2)
+                           .arg(basket.median_items, 0, 'f', 1)
+                           .arg(basket.average_lines, 0, 'f', 2)
+                           .arg(basket.average_amount, 0, 'f', 2));
+    m_timingLabel->setText(QString("查询耗时 %1 ms").arg(elapsed));
+}
+
+void ReportsDialog::fillRankingTable(QTableWidget* table, const std::vector<ProductRanking>& rankings)
+{
+    const bool byQuantity = table == m_quantityTable;
+    table->setRowCount(static_cast<int>(rankings.size()));
+    for (int row = 0; row < static_cast<int>(rankings.size()); ++row)
+    {
+        const ProductRanking& ranking = rankings[row];
+        table->setItem(row, 0, cell(QString::number(byQuantity ? ranking.quantity_rank : ranking.revenue_rank)));
+        table->setItem(row, 1, cell(QString::number(ranking.product_id)));
+        table->setItem(row, 2, cell(ranking.name.empty() ? "（已删除）" : QString::fromStdString(ranking.name)));
+        table->setItem(row, 3, cell(QString::number(ranking.quantity)));
+        table->setItem(row, 4, cell(QString::number(ranking.revenue, 'f', 2)));
+        table->setItem(row, 5, cell(percent(ranking.revenue_share)));
+    }
+}
+
+void ReportsDialog::fillHourTable(const std::vector<HourlySales>& hours)
+{
+    m_hourTable->setRowCount(static_cast<int>(hours.size()));
+    for (int row = 0; row < static_cast<int>(hours.size()); ++row)
+    {
+        const HourlySales& hour = hours[row];
+        m_hourTable->setItem(row, 0, cell(QString("%1:00-%2:00").arg(hour.hour, 2, 10, QChar('0'))
+                                          .arg(hour.hour + 1, 2, 10, QChar('0'))));
+        m_hourTable->setItem(row, 1, cell(QString::number(hour.transactions)));
+        m_hourTable->setItem(row, 2, cell(QString::number(hour.items)));
+        m_hourTable->setItem(row, 3, cell(QString::number(hour.revenue, 'f', 2)));
+        m_hourTable->setItem(row, 4, cell(percent(hour.revenue_share)));
+    }
+}
+
+void ReportsDialog::fillReturnTable(const std::vector<ProductReturnRate>& rates)
+{
+    m_returnTable->setRowCount(static_cast<int>(rates.size()));
+    for (int row = 0; row < static_cast<int>(rates.size()); ++row)
+    {
+        const ProductReturnRate& rate = rates[row];
+        m_returnTable->setItem(row, 0, cell(QString::number(rate.product_id)));
+        m_returnTable->setItem(row, 1, cell(rate.name.empty() ? "（已删除）" : QString::fromStdString(rate.name)));
+        m_returnTable->setItem(row, 2, cell(QString::number(rate.sold)));
+        m_returnTable->setItem(row, 3, cell(QString::number(rate.returned)));
+        m_returnTable->setItem(row, 4, cell(percent(rate.return_rate)));
+        m_returnTable->setItem(row, 5, cell(percent(rate.overall_rate)));
+    }
+}
+
+void ReportsDialog::onQueryClicked()
+{
+    if (m_fromEdit->date() > m_toEdit->date())
+    {
+        m_timingLabel->setText("开始日期不能晚于结束日期");
+        return;
+    }
+    loadReports();
+}
@@ -0,0 +1,50 @@
+#ifndef REPORTSDIALOG_H
+#define REPORTSDIALOG_H
+
+#include <QDialog>
+#include <QDateEdit>
+#include <QPushButton>
+#include <QLabel>
+#include <QSpinBox>
+#include <QTabWidget>
+#include <QTableWidget>
+#include <QStringList>
+#include "saleStruct.h"
+
+// 销售报表：销售额与销量排行、分时段销售、商品退货率和客单统计
+class ReportsDialog final : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit ReportsDialog(QWidget* parent = nullptr);
+    ~ReportsDialog() override;
+
+private:
+    QDateEdit* m_fromEdit;
+    QDateEdit* m_toEdit;
+    QSpinBox* m_limitSpinBox;
+    QPushButton* m_queryButton;
+    QPushButton* m_closeButton;
+    QLabel* m_basketLabel;
+    QLabel* m_timingLabel;
+
+    QTabWidget* m_tabs;
+    QTableWidget* m_revenueTable;
+    QTableWidget* m_quantityTable;
+    QTableWidget* m_hourTable;
+    QTableWidget* m_returnTable;
+
+    // 创建只读表格
+    QTableWidget* createTable(const QStringList& headers);
+    // 按日期区间查询并刷新全部报表
+    void loadReports();
+    void fillRankingTable(QTableWidget* table, const std::vector<ProductRanking>& rankings);
+    void fillHourTable(const std::vector<HourlySales>& hours);
+    void fillReturnTable(const std::vector<ProductReturnRate>& rates);
+
+private slots:
+    void onQueryClicked();
+};
+
+#endif // REPORTSDIALOG_H
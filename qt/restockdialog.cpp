@@ -1,16 +1,37 @@
 #include "restockdialog.h"
 #include <QMessageBox>
 #include <QTableWidgetItem>
+#include <QFileDialog>
+#include <QGroupBox>
+#include <algorithm>
 #include <climits>
+#include <functional>
 #include "database.h"
 
+namespace
+{
+    // 库存状态文字
+    QString stockStatus(const int stock)
+    {
+        if (stock <= 10)
+        {
+            return "低库存";
+        }
+        if (stock <= 50)
+        {
+            return "正常";
+        }
+        return "充足";
+    }
+}
+
 RestockDialog::RestockDialog(QWidget* parent)
     : QDialog(parent)
 {
     // 设置对话框标题
     setWindowTitle("商品补货");
     // 设置对话框大小
-    resize(600, 400);
+    resize(700, 600);
 
     // 创建UI组件
     auto* productLabel = new QLabel("选择商品:");
@@ -49,15 +70,46 @@ RestockDialog::RestockDialog(QWidget* parent)
     restockLayout->addWidget(m_refreshButton);
     restockLayout->addWidget(m_cancelButton);
 
+    // 进货单区域：可逐行添加或从CSV送货单导入，一次提交
+    auto* orderGroup = new QGroupBox("进货单");
+    auto* orderLayout = new QVBoxLayout(orderGroup);
+
+    m_orderTable = new QTableWidget();
+    m_orderTable->setColumnCount(3);
+    m_orderTable->setHorizontalHeaderLabels({"商品ID", "商品名称", "进货数量"});
+    m_orderTable->horizontalHeader()->setStretchLastSection(true);
+    m_orderTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_orderTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    m_addToOrderButton = new QPushButton("加入进货单");
+    m_importCsvButton = new QPushButton("导入送货单CSV");
+    m_removeOrderLineButton = new QPushButton("移除选中行");
+    m_submitOrderButton = new QPushButton("提交进货单");
+
+    auto* orderButtonLayout = new QHBoxLayout();
+    orderButtonLayout->addWidget(m_addToOrderButton);
+    orderButtonLayout->addWidget(m_importCsvButton);
+    orderButtonLayout->addWidget(m_removeOrderLineButton);
+    orderButtonLayout->addStretch();
+    orderButtonLayout->addWidget(m_submitOrderButton);
+
+    orderLayout->addWidget(m_orderTable);
+    orderLayout->addLayout(orderButtonLayout);
+
     // 将布局添加到主布局
     mainLayout->addLayout(restockLayout);
     mainLayout->addWidget(m_productTable);
+    mainLayout->addWidget(orderGroup);
 
     // 连接信号与槽
     connect(m_restockButton, &QPushButton::clicked, this, &RestockDialog::onRestockClicked);
     connect(m_cancelButton, &QPushButton::clicked, this, &RestockDialog::onCancelClicked);
     connect(m_refreshButton, &QPushButton::clicked, this, &RestockDialog::onRefreshClicked);
     connect(m_productTable, &QTableWidget::doubleClicked, this, &RestockDialog::onProductTableDoubleClicked);
+    connect(m_addToOrderButton, &QPushButton::clicked, this, &RestockDialog::onAddToOrderClicked);
+    connect(m_importCsvButton, &QPushButton::clicked, this, &RestockDialog::onImportCsvClicked);
+    connect(m_removeOrderLineButton, &QPushButton::clicked, this, &RestockDialog::onRemoveOrderLineClicked);
+    connect(m_submitOrderButton, &QPushButton::clicked, this, &RestockDialog::onSubmitOrderClicked);
 
     // 初始化商品列表
     updateProductList();
@@ -77,10 +129,11 @@ void RestockDialog::updateProductList()
     loadAllProducts();
 }
 
-void RestockDialog::loadAllProducts() const
+void RestockDialog::loadAllProducts()
 {
     // 清空表格
     m_productTable->setRowCount(0);
+    m_productRows.clear();
 
     // 从数据库获取所有商品
     const std::vector<Product> products = get_all_products();
@@ -94,6 +147,7 @@ void RestockDialog::loadAllProducts() const
         // 添加到表格
         const int row = m_productTable->rowCount();
         m_productTable->insertRow(row);
+        m_productRows[product.id] = row;
 
         // 商品ID
         auto* idItem = new QTableWidgetItem(QString::number(product.id));
@@ -116,19 +170,7 @@ void RestockDialog::loadAllProducts() const
         m_productTable->setItem(row, 3, stockItem);
 
         // 库存状态
-        QString status;
-        if (product.stock <= 10)
-        {
-            status = "低库存";
-        }
-        else if (product.stock <= 50)
-        {
-            status = "正常";
-        }
-        else
-        {
-            status = "充足";
-        }
+        const QString status = stockStatus(product.stock);
         auto* statusItem = new QTableWidgetItem(status);
         statusItem->setTextAlignment(Qt::AlignCenter);
         m_productTable->setItem(row, 4, statusItem);
@@ -141,70 +183,132 @@ void RestockDialog::loadAllProducts() const
     }
 }
 
-void RestockDialog::restockProduct()
+void RestockDialog::updateProductRows(const std::vector<Product>& products)
 {
-    // 获取选中的商品ID
-    int productId = m_productComboBox->currentData().toInt();
-    if (productId <= 0)
+    for (const auto& product : products)
     {
-        QMessageBox::warning(this, "警告", "请选择要补货的商品");
-        return;
+        const auto it = m_productRows.constFind(product.id);
+        if (it == m_productRows.constEnd())
+            continue;
+
+        const int row = it.value();
+        m_productTable->item(row, 3)->setText(QString::number(product.stock));
+        m_productTable->item(row, 4)->setText(stockStatus(product.stock));
     }
+}
 
-    // 获取补货数量
+int RestockDialog::readRestockQuantity()
+{
     bool conversionOk;
-    long long restockQuantityLL = m_restockQuantityEdit->text().toLongLong(&conversionOk);
+    const long long restockQuantityLL = m_restockQuantityEdit->text().toLongLong(&conversionOk);
     if (!conversionOk || restockQuantityLL <= 0 || restockQuantityLL > INT_MAX)
     {
         QMessageBox::warning(this, "警告", "请输入有效的补货数量");
-        return;
+        return -1;
     }
-    
-    int restockQuantity = static_cast<int>(restockQuantityLL);
+    return static_cast<int>(restockQuantityLL);
+}
 
-    // 获取商品当前库存
-    Product product = query_product(productId);
-    if (product.id == -1)
+void RestockDialog::restockProduct()
+{
+    // 获取选中的商品ID
+    int productId = m_productComboBox->currentData().toInt();
+    if (productId <= 0)
     {
-        QMessageBox::warning(this, "警告", "选中的商品不存在");
+        QMessageBox::warning(this, "警告", "请选择要补货的商品");
         return;
     }
 
-    // 计算新库存
-    long long newStockLL = static_cast<long long>(product.stock) + restockQuantity;
-    
-    // 检查是否溢出
-    if (newStockLL > INT_MAX)
+    // 获取补货数量
+    const int restockQuantity = readRestockQuantity();
+    if (restockQuantity <= 0)
     {
-        QMessageBox::warning(this, "警告",
-                             QString("商品 '%1' 补货失败！\n库存总和超过系统最大值(%2)")
-                             .arg(QString::fromStdString(product.name))
-                             .arg(INT_MAX));
         return;
     }
-    
-    int newStock = static_cast<int>(newStockLL);
 
-    // 更新库存
-    if (update_stock(productId, newStock))
+    // 以相对增量入账，不会覆盖同时发生的销售
+    std::vector<Product> updated;
+    std::string errorMsg;
+    if (restock_products({{productId, restockQuantity}}, &updated, &errorMsg) && !updated.empty())
     {
+        const Product& product = updated.front();
         // 补货成功
         QMessageBox::information(this, "提示",
                                  QString("商品 '%1' 补货成功！\n当前库存: %2 → %3").arg(
                                      QString::fromStdString(product.name))
-                                 .arg(product.stock).arg(newStock));
+                                 .arg(product.stock - restockQuantity).arg(product.stock));
 
         // 清空输入
         m_restockQuantityEdit->clear();
 
-        // 更新商品列表
-        updateProductList();
+        // 只刷新该商品所在行
+        updateProductRows(updated);
     }
     else
     {
         // 补货失败
-        QMessageBox::critical(this, "错误", "商品补货失败，请检查数据库连接");
+        QMessageBox::critical(this, "错误", QString("商品补货失败！\n\n%1").arg(QString::fromStdString(errorMsg)));
+    }
+}
+
+void RestockDialog::addOrderLine(const int productId, const QString& productName, const int quantity)
+{
+    // 同一商品已在进货单中时累加数量
+    for (int row = 0; row < m_orderTable->rowCount(); ++row)
+    {
+        if (m_orderTable->item(row, 0)->text().toInt() == productId)
+        {
+            QTableWidgetItem* quantityItem = m_orderTable->item(row, 2);
+            const long long total = quantityItem->text().toLongLong() + quantity;
+            quantityItem->setText(QString::number(qMin<long long>(total, INT_MAX)));
+            return;
+        }
+    }
+
+    const int row = m_orderTable->rowCount();
+    m_orderTable->insertRow(row);
+
+    auto* idItem = new QTableWidgetItem(QString::number(productId));
+    idItem->setTextAlignment(Qt::AlignCenter);
+    m_orderTable->setItem(row, 0, idItem);
+
+    auto* nameItem = new QTableWidgetItem(productName);
+    nameItem->setTextAlignment(Qt::AlignCenter);
+    m_orderTable->setItem(row, 1, nameItem);
+
+    auto* quantityItem = new QTableWidgetItem(QString::number(quantity));
+    quantityItem->setTextAlignment(Qt::AlignCenter);
+    m_orderTable->setItem(row, 2, quantityItem);
+}
+
+void RestockDialog::submitOrder()
+{
+    if (m_orderTable->rowCount() == 0)
+    {
+        QMessageBox::warning(this, "警告", "进货单为空");
+        return;
+    }
+
+    std::vector<RestockLine> lines;
+    lines.reserve(m_orderTable->rowCount());
+    for (int row = 0; row < m_orderTable->rowCount(); ++row)
+    {
+        lines.push_back({m_orderTable->item(row, 0)->text().toInt(), m_orderTable->item(row, 2)->text().toInt()});
+    }
+
+    // 整张进货单在一个事务内入账
+    std::vector<Product> updated;
+    std::string errorMsg;
+    if (!restock_products(lines, &updated, &errorMsg))
+    {
+        QMessageBox::critical(this, "错误", QString("进货单入账失败，库存未做任何修改！\n\n%1").arg(
+                                  QString::fromStdString(errorMsg)));
+        return;
     }
+
+    updateProductRows(updated);
+    m_orderTable->setRowCount(0);
+    QMessageBox::information(this, "提示", QString("进货单入账成功，共 %1 种商品").arg(updated.size()));
 }
 
 void RestockDialog::onRestockClicked()
@@ -225,6 +329,71 @@ void RestockDialog::onRefreshClicked()
     QMessageBox::information(this, "提示", "商品列表已刷新");
 }
 
+void RestockDialog::onAddToOrderClicked()
+{
+    const int productId = m_productComboBox->currentData().toInt();
+    if (productId <= 0)
+    {
+        QMessageBox::warning(this, "警告", "请选择要补货的商品");
+        return;
+    }
+
+    const int quantity = readRestockQuantity();
+    if (quantity <= 0)
+    {
+        return;
+    }
+
+    addOrderLine(productId, m_productComboBox->currentText(), quantity);
+    m_restockQuantityEdit->clear();
+}
+
+void RestockDialog::onImportCsvClicked()
+{
+    const QString path = QFileDialog::getOpenFileName(this, "导入送货单", QString(), "CSV文件 (*.csv);;所有文件 (*)");
+    if (path.isEmpty())
+    {
+        return;
+    }
+
+    std::vector<RestockLine> lines;
+    std::string errorMsg;
+    if (!load_restock_csv(path.toStdString(), lines, &errorMsg))
+    {
+        QMessageBox::critical(this, "错误", QString("导入送货单失败！\n\n%1").arg(QString::fromStdString(errorMsg)));
+        return;
+    }
+
+    // 商品名称从已加载的下拉列表中取，不再逐行查询数据库
+    for (const auto& line : lines)
+    {
+        const int comboIndex = m_productComboBox->findData(line.product_id);
+        const QString name = comboIndex != -1 ? m_productComboBox->itemText(comboIndex) : QString();
+        addOrderLine(line.product_id, name, line.quantity);
+    }
+}
+
+void RestockDialog::onRemoveOrderLineClicked()
+{
+    const QModelIndexList selectedRows = m_orderTable->selectionModel()->selectedRows();
+    QList<int> rows;
+    for (const auto& index : selectedRows)
+    {
+        rows.append(index.row());
+    }
+    // 从后往前删除，避免行号变化
+    std::sort(rows.begin(), rows.end(), std::greater<int>());
+    for (const int row : rows)
+    {
+        m_orderTable->removeRow(row);
+    }
+}
+
+void RestockDialog::onSubmitOrderClicked()
+{
+    submitOrder();
+}
+
 void RestockDialog::onProductTableDoubleClicked(const QModelIndex& index) const
 {
     // 获取双击的行号
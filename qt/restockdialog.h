@@ -11,6 +11,9 @@
 #include <QComboBox>
 #include <QTableWidget>
 #include <QHeaderView>
+#include <QHash>
+#include <vector>
+#include "saleStruct.h"
 
 class RestockDialog final : public QDialog
 {
@@ -28,18 +31,40 @@ private:
     QPushButton* m_cancelButton;
     QPushButton* m_refreshButton;
 
+    // 进货单
+    QTableWidget* m_orderTable;
+    QPushButton* m_addToOrderButton;
+    QPushButton* m_importCsvButton;
+    QPushButton* m_removeOrderLineButton;
+    QPushButton* m_submitOrderButton;
+
+    // 商品ID到商品表格行号的映射，用于增量刷新
+    QHash<int, int> m_productRows;
+
     // 更新商品下拉列表和表格
     void updateProductList();
     // 加载所有商品信息
-    void loadAllProducts() const;
+    void loadAllProducts();
+    // 只刷新发生变化的商品行
+    void updateProductRows(const std::vector<Product>& products);
     // 补货操作
     void restockProduct();
+    // 读取输入框中的补货数量，无效时返回-1
+    int readRestockQuantity();
+    // 向进货单添加一行，同一商品累加数量
+    void addOrderLine(int productId, const QString& productName, int quantity);
+    // 提交进货单
+    void submitOrder();
 
 private slots:
     void onRestockClicked();
     void onCancelClicked();
     void onRefreshClicked();
     void onProductTableDoubleClicked(const QModelIndex& index) const;
+    void onAddToOrderClicked();
+    void onImportCsvClicked();
+    void onRemoveOrderLineClicked();
+    void onSubmitOrderClicked();
 };
 
-#endif // RESTOCKDIALOG_H
\ No newline at end of file
+#endif // RESTOCKDIALOG_H
@@ -3,7 +3,9 @@
 #include <QTableWidgetItem>
 #include <QDateTime>
 #include <QApplication>
+#include <QSpinBox>
 #include <climits>
+#include <map>
 #include "../sqlite/database.h"
 
 ReturnDialog::ReturnDialog(QWidget* parent)
@@ -87,8 +89,8 @@ void ReturnDialog::initUI()
     auto* productLayout = new QVBoxLayout(productGroup);
     
     m_productTable = new QTableWidget();
-    m_productTable->setColumnCount(4);
-    m_productTable->setHorizontalHeaderLabels({"商品ID", "商品名称", "单价", "剩余可退货数量"});
+    m_productTable->setColumnCount(5);
+    m_productTable->setHorizontalHeaderLabels({"商品ID", "商品名称", "单价", "剩余可退货数量", "本次退货数量"});
     m_productTable->horizontalHeader()->setStretchLastSection(true);
     m_productTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     m_productTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
@@ -226,6 +228,14 @@ void ReturnDialog::loadTransactionProducts(int transactionId) const
         auto* quantityItem = new QTableWidgetItem(QString::number(remainingQuantity));
         quantityItem->setTextAlignment(Qt::AlignCenter);
         m_productTable->setItem(row, 3, quantityItem);
+
+        // 本次退货数量，可一次填写多种商品组成退货单
+        auto* returnSpinBox = new QSpinBox();
+        returnSpinBox->setMinimum(0);
+        returnSpinBox->setMaximum(remainingQuantity);
+        returnSpinBox->setAlignment(Qt::AlignCenter);
+        returnSpinBox->setEnabled(remainingQuantity > 0);
+        m_productTable->setCellWidget(row, 4, returnSpinBox);
     }
     
     // 调整列宽
@@ -265,63 +275,109 @@ bool ReturnDialog::validateInput() const
     return true;
 }
 
-void ReturnDialog::processReturn()
+std::vector<ReturnLine> ReturnDialog::collectSlipLines(const std::string& reason) const
 {
-    if (!validateInput())
+    std::vector<ReturnLine> lines;
+    for (int row = 0; row < m_productTable->rowCount(); ++row)
     {
-        return;
+        const auto* spinBox = qobject_cast<QSpinBox*>(m_productTable->cellWidget(row, 4));
+        const QTableWidgetItem* idItem = m_productTable->item(row, 0);
+        if (!spinBox || !idItem || spinBox->value() <= 0)
+            continue;
+        lines.push_back({idItem->text().toInt(), spinBox->value(), reason});
     }
-    
+    return lines;
+}
+
+void ReturnDialog::processReturn()
+{
     // 获取输入数据
     const int transactionId = m_transactionIdEdit->text().toInt();
-    const int productId = m_productComboBox->currentData().toInt();
-    const int returnQuantity = m_returnQuantityEdit->text().toInt();
     const std::string reason = m_returnReasonEdit->toPlainText().toStdString();
-    
-    // 检查交易是否存在
-    const std::vector<Transaction> transactions = get_all_transactions();
-    const auto transactionIt = std::find_if(transactions.begin(), transactions.end(),
-        [transactionId](const Transaction& t) { return t.transaction_id == transactionId; });
-    
-    if (transactionIt == transactions.end())
+
+    // 优先使用商品列表中填写的退货单；没有填写时使用上方的单个商品表单
+    std::vector<ReturnLine> lines = collectSlipLines(reason);
+    if (lines.empty())
     {
-        QMessageBox::warning(this, "警告", "交易不存在");
+        if (!validateInput())
+        {
+            return;
+        }
+        lines.push_back({m_productComboBox->currentData().toInt(), m_returnQuantityEdit->text().toInt(), reason});
+    }
+    else if (transactionId <= 0)
+    {
+        QMessageBox::warning(this, "警告", "请输入有效的交易ID");
         return;
     }
     
-    // 检查该商品是否在交易中
-    const std::vector<CartItem> cartItems = get_cart_items_by_transaction_id(transactionId);
-    const auto cartItemIt = std::find_if(cartItems.begin(), cartItems.end(),
-        [productId](const CartItem& item) { return item.product.id == productId; });
-    
-    if (cartItemIt == cartItems.end())
+    // 按交易ID直接取回该交易的明细聚合
+    const TransactionDetail detail = get_transaction_detail(transactionId);
+    if (detail.transaction.transaction_id == -1)
     {
-        QMessageBox::warning(this, "警告", "该商品不在所选交易中");
+        QMessageBox::warning(this, "警告", "交易不存在");
         return;
     }
     
-    // 计算剩余可退货数量
-    int remainingReturnable = cartItemIt->quantity - cartItemIt->returned_quantity;
-    
-    // 检查退货数量是否超过剩余可退货数量
-    if (returnQuantity > remainingReturnable)
+    // 同一商品可能分多行出现在交易和退货单中：按商品汇总申请数量，与各行剩余可退数量之和比较
+    std::map<int, int> requested;
+    for (const auto& returnLine : lines)
     {
-        QMessageBox::warning(this, "警告",
-            QString("退货数量不能超过剩余可退货数量！\n购买数量: %1\n已退货: %2\n剩余可退货: %3")
-            .arg(cartItemIt->quantity)
-            .arg(cartItemIt->returned_quantity)
-            .arg(remainingReturnable));
-        return;
+        requested[returnLine.product_id] += returnLine.quantity;
+    }
+
+    for (const auto& [productId, quantity] : requested)
+    {
+        bool found = false;
+        std::string productName;
+        int purchased = 0;
+        int returned = 0;
+        for (const auto& line : detail.lines)
+        {
+            if (line.item.product.id != productId)
+                continue;
+            found = true;
+            productName = line.item.product.name;
+            purchased += line.item.quantity;
+            returned += line.item.returned_quantity;
+        }
+
+        // 检查该商品是否在交易中
+        if (!found)
+        {
+            QMessageBox::warning(this, "警告", "该商品不在所选交易中");
+            return;
+        }
+
+        // 检查退货数量是否超过剩余可退货数量
+        const int remainingReturnable = purchased - returned;
+        if (quantity > remainingReturnable)
+        {
+            QMessageBox::warning(this, "警告",
+                QString("商品 '%1' 退货数量不能超过剩余可退货数量！\n购买数量: %2\n已退货: %3\n剩余可退货: %4")
+                .arg(QString::fromStdString(productName))
+                .arg(purchased)
+                .arg(returned)
+                .arg(remainingReturnable));
+            return;
+        }
     }
     
-    // 执行退货操作
-    if (add_return(transactionId, productId, returnQuantity, reason))
+    // 整张退货单在一个事务内提交
+    std::string errorMsg;
+    if (add_return_slip(transactionId, lines, &errorMsg))
     {
+        int totalQuantity = 0;
+        for (const auto& returnLine : lines)
+        {
+            totalQuantity += returnLine.quantity;
+        }
+
         // 退货成功
         QMessageBox::information(this, "提示",
-            QString("商品 '%1' 退货成功！\n退货数量: %2")
-            .arg(QString::fromStdString(cartItemIt->product.name))
-            .arg(returnQuantity));
+            QString("退货成功！\n商品种数: %1\n退货总数量: %2")
+            .arg(lines.size())
+            .arg(totalQuantity));
         
         // 关闭窗口
         accept();
@@ -329,7 +385,7 @@ void ReturnDialog::processReturn()
     else
     {
         // 退货失败
-        QMessageBox::critical(this, "错误", "商品退货失败，请检查数据库连接");
+        QMessageBox::critical(this, "错误", QString("商品退货失败！\n\n%1").arg(QString::fromStdString(errorMsg)));
     }
 }
 
@@ -14,6 +14,8 @@
 #include <QTextEdit>
 #include <QDateEdit>
 #include <QGroupBox>
+#include <vector>
+#include "saleStruct.h"
 
 class ReturnDialog final : public QDialog
 {
@@ -52,6 +54,8 @@ private:
     void processReturn();
     // 验证输入
     bool validateInput() const;
+    // 收集商品列表中填写了本次退货数量的行，组成退货单
+    std::vector<ReturnLine> collectSlipLines(const std::string& reason) const;
 
 private slots:
     void onReturnClicked();
@@ -101,9 +101,22 @@ void SettlementDialog::onCashButtonClicked()
         transaction.change = change;
         transaction.cart = cart;
         
-        // 保存交易记录到数据库
-        if (save_transaction(transaction)) {
+        // 保存交易记录到数据库，库存以提交时数据库中的实际值为准
+        std::vector<StockConflict> conflicts;
+        if (save_transaction(transaction, &conflicts)) {
             // 交易记录保存成功
+        } else if (!conflicts.empty()) {
+            // 其他终端已先售出，列出库存不足的商品
+            QString conflictText = "以下商品库存不足，交易未保存，请调整购物车后重试：\n\n";
+            for (const auto& conflict : conflicts) {
+                conflictText += QString("%1（ID %2）：需要 %3，当前库存 %4\n")
+                    .arg(QString::fromStdString(conflict.name))
+                    .arg(conflict.product_id)
+                    .arg(conflict.requested)
+                    .arg(conflict.available);
+            }
+            QMessageBox::warning(this, "库存冲突", conflictText);
+            return;
         } else {
             QMessageBox::warning(this, "警告", "保存交易记录失败");
             return;
@@ -301,6 +301,7 @@ void simulate::on_addProductButton_clicked()
         double productPrice = dialog.getProductPrice();
         int productStock = dialog.getProductStock();
         int productThreshold = dialog.getProductAlertThreshold();
+        std::string productBarcode = dialog.getProductBarcode();
 
         // 检查商品名称是否已存在
         Product existingProduct = query_product(productName);
@@ -322,7 +323,8 @@ void simulate::on_addProductButton_clicked()
         }
 
         // 添加商品到数据库，使用用户设置的预警阈值
-        if (add_product(productName, productPrice, productStock, productThreshold))
+        std::string errorMsg;
+        if (add_product(productName, productPrice, productStock, productThreshold, productBarcode, &errorMsg))
         {
             // 添加成功，更新商品表格
             updateProductTable(ui->searchEdit->text(), ui->stockFilterComboBox->currentIndex());
@@ -334,8 +336,8 @@ void simulate::on_addProductButton_clicked()
         {
             // 添加失败
             QMessageBox::critical(this, "错误",
-                                  QString("商品 '%1' 添加失败！").arg(
-                                      QString::fromStdString(productName)));
+                                  QString("商品 '%1' 添加失败！\n\n详细错误信息：%2").arg(
+                                      QString::fromStdString(productName), QString::fromStdString(errorMsg)));
         }
     }
 }
@@ -395,6 +397,7 @@ void simulate::on_editProductButton_clicked()
         double newPrice = dialog.getProductPrice();
         int newStock = dialog.getProductStock();
         int newThreshold = dialog.getProductAlertThreshold();
+        std::string newBarcode = dialog.getProductBarcode();
 
         // 检查商品名称是否已被其他商品使用
         Product existingProduct = query_product(newName);
@@ -408,7 +411,8 @@ void simulate::on_editProductButton_clicked()
 
         // 更新商品信息
         std::string errorMsg;
-        if (update_product(productId, newName, newPrice, newStock, newThreshold, &errorMsg))
+        if (update_product(productId, newName, newPrice, newStock, newThreshold, &errorMsg) &&
+            (newBarcode == product.barcode || set_product_barcode(productId, newBarcode, &errorMsg)))
         {
             // 更新成功，刷新商品表格
             updateProductTable(ui->searchEdit->text(), ui->stockFilterComboBox->currentIndex());
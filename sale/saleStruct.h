@@ -12,6 +12,7 @@ typedef struct {
     std::string name;        // 商品名称
     float price;        // 商品单价
     int stock;          // 商品库存
+    std::string barcode;     // 商品条码（EAN-13等），没有时为空
 } Product;
 
 /* ========== 2. 定义购物车项结构体 ========== */
@@ -19,7 +20,9 @@ typedef struct {
     Product product;    // 商品信息
     int quantity;       // 购买数量
     int returned_quantity; // 已退货数量
-    float subtotal;     // 小计金额 = price * quantity
+    float subtotal;     // 小计金额 = price * quantity - discount
+    float discount = 0.0f;  // 促销折扣金额
+    int promotion_id = 0;   // 折扣所取的促销，没有折扣时为0
 } CartItem;
 
 /* ========== 3. 定义购物车结构体 ========== */
@@ -49,5 +52,122 @@ typedef struct {
     time_t return_time;     // 退货时间
 } ReturnItem;
 
+/* ========== 6. 定义交易明细行结构体 ========== */
+typedef struct {
+    CartItem item;                      // 购物车项（含商品信息）
+    std::vector<ReturnItem> returns;    // 该商品在本交易中的退货记录，按退货时间倒序
+} TransactionLine;
+
+/* ========== 7. 定义交易明细聚合结构体 ========== */
+typedef struct {
+    Transaction transaction;            // 交易头信息，transaction_id为-1表示交易不存在
+    std::vector<TransactionLine> lines; // 交易商品明细，按购物车项顺序排列
+} TransactionDetail;
+
+/* ========== 8. 定义进货单行结构体 ========== */
+typedef struct {
+    int product_id;         // 商品编号
+    int quantity;           // 进货数量
+} RestockLine;
+
+/* ========== 9. 定义库存冲突结构体 ========== */
+typedef struct {
+    int product_id;         // 商品编号
+    std::string name;       // 商品名称
+    int requested;          // 本次需要扣减的数量
+    int available;          // 提交时数据库中的实际库存，商品不存在时为0
+} StockConflict;
+
+/* ========== 10. 定义退货单行结构体 ========== */
+typedef struct {
+    int product_id;         // 退货商品ID
+    int quantity;           // 退货数量
+    std::string reason;     // 退货原因
+} ReturnLine;
+
+/* ========== 11. 定义每日销售汇总结构体 ========== */
+typedef struct {
+    std::string day;        // 日期，本地时间YYYY-MM-DD
+    int transactions;       // 交易笔数
+    int items_sold;         // 售出件数
+    int items_returned;     // 退回件数
+    double gross;           // 销售额（商品小计之和）
+    double net;             // 扣除退款后的实收金额
+} DailySales;
+
+/* ========== 12. 定义商品销售汇总结构体 ========== */
+typedef struct {
+    int product_id;         // 商品编号
+    std::string name;       // 商品名称，商品已删除时为空
+    int quantity;           // 售出数量
+    int returned_quantity;  // 退回数量
+    double revenue;         // 销售额
+} ProductSales;
+
+/* ========== 13. 定义归档结果结构体 ========== */
+typedef struct {
+    int transactions;       // 归档的交易笔数
+    int cart_items;         // 归档的购物车项数
+    int returns;            // 归档的退货记录数
+} ArchiveResult;
+
+/* ========== 14. 定义商品销售排名结构体 ========== */
+typedef struct {
+    int product_id;         // 商品编号
+    std::string name;       // 商品名称，商品已删除时为空
+    int quantity;           // 售出数量
+    double revenue;         // 销售额
+    int revenue_rank;       // 按销售额排名，并列同名次
+    int quantity_rank;      // 按售出数量排名
+    double revenue_share;   // 占区间总销售额的比例
+} ProductRanking;
+
+/* ========== 15. 定义分时段销售结构体 ========== */
+typedef struct {
+    int hour;               // 本地时间的小时，0-23
+    int transactions;       // 交易笔数
+    int items;              // 售出件数
+    double revenue;         // 销售额
+    double revenue_share;   // 占区间总销售额的比例
+} HourlySales;
+
+/* ========== 16. 定义商品退货率结构体 ========== */
+typedef struct {
+    int product_id;         // 商品编号
+    std::string name;       // 商品名称，商品已删除时为空
+    int sold;               // 区间内售出数量
+    int returned;           // 其中已退回数量
+    double return_rate;     // 退货率
+    double overall_rate;    // 区间内全部商品的退货率，便于对比
+} ProductReturnRate;
+
+/* ========== 17. 定义客单统计结构体 ========== */
+typedef struct {
+    int transactions;       // 交易笔数
+    double average_items;   // 平均每单件数
+    double median_items;    // 每单件数中位数
+    double average_lines;   // 平均每单商品种数
+    double average_amount;  // 平均客单价
+} BasketStats;
+
+/* ========== 18. 定义销售分析结果结构体 ========== */
+typedef struct {
+    std::vector<ProductRanking> top_by_revenue;     // 销售额排行
+    std::vector<ProductRanking> top_by_quantity;    // 销量排行
+    std::vector<HourlySales> by_hour;               // 有销售的小时，按小时排序
+    std::vector<ProductReturnRate> return_rates;    // 按退货率降序
+    BasketStats basket;                             // 客单统计
+} SalesAnalytics;
+
+/* ========== 19. 定义销售日志汇总结构体 ========== */
+typedef struct {
+    long long lines;                // 扫描命中的行数（销售行与退货行）
+    long long quantity_sold;        // 售出件数
+    long long quantity_returned;    // 退回件数
+    double gross;                   // 销售额
+    double refunds;                 // 退款额
+    double net;                     // 销售额减退款额
+} SalesLogSummary;
+
 
 #endif // SALE_STRUCT_H
@@ -0,0 +1,374 @@
+#include "analytics.h"
+#include "db_internal.h"
+#include "log.h"
+#include "timeutil.h"
+#include <algorithm>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace
+{
+    // 每类结果最多缓存的区间数，超过时整体清空
+    constexpr size_t kMaxCachedEntries = 32;
+
+    // 单笔交易的件数、商品种数和金额。
+    // 用相关子查询按交易取明细而不是连接后GROUP BY，区间查询始终走create_time索引，不必对整段排序
+    const char* const sql_baskets =
+        "WITH baskets AS ("
+        "  SELECT t.create_time, t.total_price, "
+        "         (SELECT SUM(quantity) FROM cart_items c WHERE c.transaction_id = t.transaction_id) AS items, "
+        "         (SELECT COUNT(*) FROM cart_items c WHERE c.transaction_id = t.transaction_id) AS lines "
+        "  FROM transactions t "
+        "  WHERE t.create_time >= ?1 AND t.create_time < ?2) ";
+
+    // 区间内每种售出商品的汇总，排行和退货率都由它派生，同一区间只查询一次
+    struct ProductSummary
+    {
+        ProductRanking ranking;
+        int returned;
+        double return_rate;
+        double overall_rate;
+    };
+
+    // 区间内的分时段销售和客单统计，来自同一次扫描
+    struct BasketSummary
+    {
+        std::vector<HourlySales> by_hour;
+        BasketStats basket{};
+    };
+
+    // 缓存有效性：PRAGMA data_version只反映其他连接的提交，本连接自己的修改由total_changes反映，
+    // 两者都没变且仍是同一个连接时缓存有效
+    struct Stamp
+    {
+        sqlite3* conn = nullptr;
+        long long data_version = -1;
+        sqlite3_int64 total_changes = -1;
+
+        bool operator==(const Stamp&) const = default;
+    };
+
+    struct AnalyticsCache
+    {
+        Stamp stamp;
+        std::map<std::string, std::vector<ProductSummary>> products;
+        std::map<std::string, BasketSummary> baskets;
+
+        void clear()
+        {
+            products.clear();
+            baskets.clear();
+        }
+    };
+
+    // 分析结果与连接一样按线程保存
+    AnalyticsCache& cache()
+    {
+        thread_local AnalyticsCache instance;
+        return instance;
+    }
+
+    Stamp current_stamp()
+    {
+        Stamp stamp;
+        stamp.conn = db;
+        if (!db)
+            return stamp;
+        const CachedStatement stmt("PRAGMA data_version;");
+        if (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+            stamp.data_version = sqlite3_column_int64(stmt.get(), 0);
+        stamp.total_changes = sqlite3_total_changes64(db);
+        return stamp;
+    }
+
+    std::string cache_key(const long long from, const long long to)
+    {
+        return std::to_string(from) + ":" + std::to_string(to);
+    }
+
+    // 命中时返回缓存，否则调用compute计算，成功时放入缓存。
+    // 返回的引用在当前线程下一次分析查询前有效
+    template <typename T>
+    const T& cached(std::map<std::string, T> AnalyticsCache::* member, const std::string& key,
+             const std::function<bool(T&)>& compute)
+    {
+        AnalyticsCache& instance = cache();
+        const Stamp stamp = current_stamp();
+        if (!(stamp == instance.stamp))
+        {
+            instance.clear();
+            instance.stamp = stamp;
+        }
+
+        auto& entries = instance.*member;
+        if (const auto it = entries.find(key); it != entries.end())
+            return it->second;
+
+        T value{};
+        if (!compute(value))
+        {
+            thread_local T failed;
+            failed = T{};
+            return failed;
+        }
+        if (entries.size() >= kMaxCachedEntries)
+            entries.clear();
+        return entries.emplace(key, std::move(value)).first->second;
+    }
+
+    std::string column_text(sqlite3_stmt* stmt, const int column)
+    {
+        const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        return text ? text : "";
+    }
+
+    // timestamp时刻本地时间相对UTC的秒数；区间跨夏令时切换时按起点的时差计算
+    long long utc_offset(const long long timestamp)
+    {
+        const time_t t = static_cast<time_t>(timestamp);
+        // 报表可能在异步查询线程上计算，使用可重入的转换
+        std::tm local{};
+        std::tm utc{};
+        if (!local_time(t, local) || !utc_time(t, utc))
+            return 0;
+        utc.tm_isdst = local.tm_isdst;
+        return static_cast<long long>(difftime(mktime(&local), mktime(&utc)));
+    }
+
+    bool step_failed(const int rc, const char* what)
+    {
+        if (rc == SQLITE_DONE)
+            return false;
+        SLOG_ERROR("%s失败: %s", what, sqlite3_errmsg(db));
+        return true;
+    }
+
+    // 排名、占比和退货率在分组之后用窗口函数一次算出
+    const std::vector<ProductSummary>& product_summary(const long long from, const long long to)
+    {
+        return cached<std::vector<ProductSummary>>(
+            &AnalyticsCache::products, cache_key(from, to),
+            [&](std::vector<ProductSummary>& products)
+            {
+                const CachedStatement stmt(
+                    "SELECT s.product_id, p.name, sold, returned, revenue, "
+                    "       RANK() OVER (ORDER BY revenue DESC), "
+                    "       RANK() OVER (ORDER BY sold DESC), "
+                    "       revenue / NULLIF(SUM(revenue) OVER (), 0), "
+                    "       CAST(returned AS REAL) / sold, "
+                    "       CAST(SUM(returned) OVER () AS REAL) / SUM(sold) OVER () "
+                    "FROM ("
+                    "  SELECT c.product_id, SUM(c.quantity) AS sold, "
+                    "         SUM(c.returned_quantity) AS returned, SUM(c.subtotal) AS revenue "
+                    "  FROM transactions t JOIN cart_items c ON c.transaction_id = t.transaction_id "
+                    "  WHERE t.create_time >= ?1 AND t.create_time < ?2 "
+                    "  GROUP BY c.product_id) s "
+                    // 先分组再取商品名称，名称只查一次而不是每个明细行一次
+                    "LEFT JOIN products p ON p.id = s.product_id "
+                    "ORDER BY s.product_id;");
+                if (!stmt)
+                    return false;
+                sqlite3_bind_int64(stmt.get(), 1, from);
+                sqlite3_bind_int64(stmt.get(), 2, to);
+                int rc;
+                while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+                {
+                    ProductSummary product;
+                    product.ranking.product_id = sqlite3_column_int(stmt.get(), 0);
+                    product.ranking.name = column_text(stmt.get(), 1);
+                    product.ranking.quantity = sqlite3_column_int(stmt.get(), 2);
+                    product.returned = sqlite3_column_int(stmt.get(), 3);
+                    product.ranking.revenue = sqlite3_column_double(stmt.get(), 4);
+                    product.ranking.revenue_rank = sqlite3_column_int(stmt.get(), 5);
+                    product.ranking.quantity_rank = sqlite3_column_int(stmt.get(), 6);
+                    product.ranking.revenue_share = sqlite3_column_double(stmt.get(), 7);
+                    product.return_rate = sqlite3_column_double(stmt.get(), 8);
+                    product.overall_rate = sqlite3_column_double(stmt.get(), 9);
+                    products.push_back(product);
+                }
+                return !step_failed(rc, "查询商品销售汇总");
+            });
+    }
+
+    // 按比较函数取前limit个
+    template <typename Compare>
+    std::vector<const ProductSummary*> top_products(const std::vector<ProductSummary>& products, const int limit,
+                                                    Compare compare)
+    {
+        std::vector<const ProductSummary*> order;
+        order.reserve(products.size());
+        for (const auto& product : products)
+            order.push_back(&product);
+        const size_t count = std::min(order.size(), static_cast<size_t>(std::max(limit, 0)));
+        std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(count), order.end(), compare);
+        order.resize(count);
+        return order;
+    }
+
+    // 按小时和每单件数分组的一次扫描同时得到分时段销售和客单统计，分组后的行数很少，
+    // 占比和中位数在内存中累计
+    const BasketSummary& basket_summary(const long long from, const long long to)
+    {
+        return cached<BasketSummary>(
+            &AnalyticsCache::baskets, cache_key(from, to),
+            [&](BasketSummary& summary)
+            {
+                static const std::string sql = std::string(sql_baskets) +
+                    // 用固定时差换算小时，避免逐行调用strftime的本地时间转换
+                    "SELECT (create_time + ?3) / 3600 % 24 AS hour, "
+                    "       items, COUNT(*), SUM(lines), SUM(total_price) "
+                    "FROM baskets GROUP BY hour, items ORDER BY hour;";
+                const CachedStatement stmt(sql.c_str());
+                if (!stmt)
+                    return false;
+                sqlite3_bind_int64(stmt.get(), 1, from);
+                sqlite3_bind_int64(stmt.get(), 2, to);
+                sqlite3_bind_int64(stmt.get(), 3, utc_offset(from));
+
+                std::map<int, long long> item_counts;  // 每单件数 -> 交易笔数
+                long long transactions = 0;
+                long long items = 0;
+                long long lines = 0;
+                double revenue = 0;
+                int rc;
+                while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+                {
+                    const int hour = sqlite3_column_int(stmt.get(), 0);
+                    const int basket_items = sqlite3_column_int(stmt.get(), 1);
+                    const int count = sqlite3_column_int(stmt.get(), 2);
+                    const double amount = sqlite3_column_double(stmt.get(), 4);
+                    if (summary.by_hour.empty() || summary.by_hour.back().hour != hour)
+                        summary.by_hour.push_back(HourlySales{hour, 0, 0, 0.0, 0.0});
+                    HourlySales& slot = summary.by_hour.back();
+                    slot.transactions += count;
+                    slot.items += basket_items * count;
+                    slot.revenue += amount;
+
+                    item_counts[basket_items] += count;
+                    transactions += count;
+                    items += static_cast<long long>(basket_items) * count;
+                    lines += sqlite3_column_int64(stmt.get(), 3);
+                    revenue += amount;
+                }
+                if (step_failed(rc, "查询客单统计"))
+                    return false;
+
+                for (auto& hour : summary.by_hour)
+                    hour.revenue_share = revenue > 0 ? hour.revenue / revenue : 0.0;
+
+                BasketStats& stats = summary.basket;
+                stats.transactions = static_cast<int>(transactions);
+                if (transactions > 0)
+                {
+                    stats.average_items = static_cast<double>(items) / transactions;
+                    stats.average_lines = static_cast<double>(lines) / transactions;
+                    stats.average_amount = revenue / transactions;
+                    // 中位数：第(n+1)/2和第n/2+1笔的平均，n为奇数时两者相同
+                    const long long lower = (transactions + 1) / 2;
+                    const long long upper = transactions / 2 + 1;
+                    long long running = 0;
+                    int lower_items = -1;
+                    for (const auto& [basket_items, count] : item_counts)
+                    {
+                        running += count;
+                        if (lower_items < 0 && running >= lower)
+                            lower_items = basket_items;
+                        if (running >= upper)
+                        {
+                            stats.median_items = (lower_items + basket_items) / 2.0;
+                            break;
+                        }
+                    }
+                }
+                return true;
+            });
+    }
+}
+
+std::vector<ProductRanking> get_top_sellers(const long long from, const long long to, const int limit,
+                                            const bool by_quantity)
+{
+    QueryCall call("get_top_sellers");
+    const auto top = top_products(product_summary(from, to), limit,
+                                  [by_quantity](const ProductSummary* a, const ProductSummary* b)
+                                  {
+                                      const int rank_a = by_quantity ? a->ranking.quantity_rank : a->ranking.revenue_rank;
+                                      const int rank_b = by_quantity ? b->ranking.quantity_rank : b->ranking.revenue_rank;
+                                      if (rank_a != rank_b)
+                                          return rank_a < rank_b;
+                                      return a->ranking.product_id < b->ranking.product_id;
+                                  });
+    std::vector<ProductRanking> result;
+    result.reserve(top.size());
+    for (const auto* product : top)
+        result.push_back(product->ranking);
+    call.rows(result.size());
+    return result;
+}
+
+std::vector<HourlySales> get_sales_by_hour(const long long from, const long long to)
+{
+    QueryCall call("get_sales_by_hour");
+    std::vector<HourlySales> result = basket_summary(from, to).by_hour;
+    call.rows(result.size());
+    return result;
+}
+
+std::vector<ProductReturnRate> get_return_rates(const long long from, const long long to, const int limit)
+{
+    QueryCall call("get_return_rates");
+    // 按售出时间归属退货：统计区间内卖出的商品后来被退回了多少
+    const auto top = top_products(product_summary(from, to), limit,
+                                  [](const ProductSummary* a, const ProductSummary* b)
+                                  {
+                                      if (a->return_rate != b->return_rate)
+                                          return a->return_rate > b->return_rate;
+                                      if (a->returned != b->returned)
+                                          return a->returned > b->returned;
+                                      return a->ranking.product_id < b->ranking.product_id;
+                                  });
+    std::vector<ProductReturnRate> result;
+    result.reserve(top.size());
+    for (const auto* product : top)
+    {
+        ProductReturnRate rate;
+        rate.product_id = product->ranking.product_id;
+        rate.name = product->ranking.name;
+        rate.sold = product->ranking.quantity;
+        rate.returned = product->returned;
+        rate.return_rate = product->return_rate;
+        rate.overall_rate = product->overall_rate;
+        result.push_back(rate);
+    }
+    call.rows(result.size());
+    return result;
+}
+
+BasketStats get_basket_stats(const long long from, const long long to)
+{
+    QueryCall call("get_basket_stats");
+    const BasketStats result = basket_summary(from, to).basket;
+    call.rows(1);
+    return result;
+}
+
+SalesAnalytics get_sales_analytics(const long long from, const long long to, const int limit)
+{
+    QueryCall call("get_sales_analytics");
+    SalesAnalytics analytics;
+    analytics.top_by_revenue = get_top_sellers(from, to, limit, false);
+    analytics.top_by_quantity = get_top_sellers(from, to, limit, true);
+    analytics.by_hour = get_sales_by_hour(from, to);
+    analytics.return_rates = get_return_rates(from, to, limit);
+    analytics.basket = get_basket_stats(from, to);
+    return analytics;
+}
+
+void clear_analytics_cache()
+{
+    cache().clear();
+    cache().stamp = Stamp{};
+}
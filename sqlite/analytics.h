@@ -0,0 +1,23 @@
+#ifndef ANALYTICS_H
+#define ANALYTICS_H
+#include <string>
+#include <vector>
+#include "saleStruct.h"
+
+// 销售分析：直接在交易明细上用窗口函数计算，时间区间为本地时间的Unix时间戳，左闭右开。
+// 结果按区间和参数缓存，数据库没有变化时重复查询直接返回缓存
+
+// 销售排行，by_quantity为true时按售出数量排序，否则按销售额
+std::vector<ProductRanking> get_top_sellers(long long from, long long to, int limit, bool by_quantity = false);
+// 按小时汇总的销售，只包含有交易的小时
+std::vector<HourlySales> get_sales_by_hour(long long from, long long to);
+// 区间内售出商品的退货率，按退货率降序
+std::vector<ProductReturnRate> get_return_rates(long long from, long long to, int limit);
+// 客单件数、商品种数和客单价
+BasketStats get_basket_stats(long long from, long long to);
+// 一次取得报表对话框需要的全部分析结果
+SalesAnalytics get_sales_analytics(long long from, long long to, int limit);
+// 清空当前线程的分析结果缓存
+void clear_analytics_cache();
+
+#endif // ANALYTICS_H
@@ -0,0 +1,292 @@
+#include "asyncdb.h"
+#include "database.h"
+#include "db_internal.h"
+#include "log.h"
+#include <deque>
+#include <exception>
+#include <thread>
+
+namespace
+{
+    std::mutex g_executorMutex;
+    ResumeExecutor g_executor;
+
+    void fail(std::string* errorMsg, const std::string& message)
+    {
+        if (errorMsg)
+            *errorMsg = message;
+    }
+
+    // 恢复前检查协程绑定的生命周期，已失效则销毁协程帧
+    void resume_waiter(const std::coroutine_handle<> handle, std::function<bool()> alive)
+    {
+        ResumeExecutor executor;
+        {
+            std::lock_guard<std::mutex> lock(g_executorMutex);
+            executor = g_executor;
+        }
+        auto resume = [handle, alive = std::move(alive)]
+        {
+            if (!alive || alive())
+                handle.resume();
+            else
+                handle.destroy();
+        };
+        if (executor)
+            executor(std::move(resume));
+        else
+            resume();
+    }
+}
+
+void set_resume_executor(ResumeExecutor executor)
+{
+    std::lock_guard<std::mutex> lock(g_executorMutex);
+    g_executor = std::move(executor);
+}
+
+namespace asyncdb_detail
+{
+    bool FutureState::suspend(const std::coroutine_handle<> handle, std::function<bool()> alive)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_done)
+            return false;
+        m_waiter = handle;
+        m_alive = std::move(alive);
+        return true;
+    }
+
+    void FutureState::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this] { return m_done; });
+    }
+
+    bool FutureState::ready()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_done;
+    }
+
+    void FutureState::complete(std::unique_lock<std::mutex>& lock)
+    {
+        m_done = true;
+        const std::coroutine_handle<> waiter = std::exchange(m_waiter, nullptr);
+        std::function<bool()> alive = std::move(m_alive);
+        lock.unlock();
+        m_cv.notify_all();
+        if (waiter)
+            resume_waiter(waiter, std::move(alive));
+    }
+}
+
+// 工作线程各自持有thread_local数据库连接，从同一队列取任务
+struct AsyncDatabase::Pool
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::function<void()>> jobs;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    void run(const std::string& path)
+    {
+        const bool opened = init_db(path);
+        if (!opened)
+            SLOG_ERROR("异步查询线程打开数据库失败: %s", path.c_str());
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            // 停止时先执行完已提交的任务，等待中的协程都能得到结果
+            if (jobs.empty())
+                break;
+            std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+        lock.unlock();
+        if (opened)
+            close_db();
+    }
+};
+
+AsyncDatabase::~AsyncDatabase()
+{
+    close();
+}
+
+bool AsyncDatabase::open(int workers, std::string* errorMsg)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pool)
+        return true;
+    const char* filename = db ? sqlite3_db_filename(db, "main") : nullptr;
+    if (!filename || !*filename)
+    {
+        fail(errorMsg, "异步查询需要先打开数据库文件");
+        return false;
+    }
+    if (workers < 1)
+        workers = 1;
+
+    const std::string path = filename;
+    m_pool = std::make_unique<Pool>();
+    for (int i = 0; i < workers; ++i)
+        m_pool->threads.emplace_back(&Pool::run, m_pool.get(), path);
+    SLOG_INFO("异步查询线程已启动: %d个", workers);
+    return true;
+}
+
+void AsyncDatabase::close()
+{
+    std::unique_ptr<Pool> pool;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pool = std::move(m_pool);
+    }
+    if (!pool)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->stopping = true;
+    }
+    pool->cv.notify_all();
+    for (std::thread& thread : pool->threads)
+        thread.join();
+}
+
+bool AsyncDatabase::is_open() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pool != nullptr;
+}
+
+void AsyncDatabase::post(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pool)
+        {
+            {
+                std::lock_guard<std::mutex> poolLock(m_pool->mutex);
+                m_pool->jobs.push_back(std::move(job));
+            }
+            m_pool->cv.notify_one();
+            return;
+        }
+    }
+    job();
+}
+
+DbFuture<Product> AsyncDatabase::query_product(const int id)
+{
+    return run([id] { return ::query_product(id); });
+}
+
+DbFuture<Product> AsyncDatabase::query_product(std::string name)
+{
+    return run([name = std::move(name)] { return ::query_product(name); });
+}
+
+DbFuture<Product> AsyncDatabase::query_product_by_barcode(std::string barcode)
+{
+    return run([barcode = std::move(barcode)] { return ::query_product_by_barcode(barcode); });
+}
+
+DbFuture<std::vector<Product>> AsyncDatabase::get_all_products()
+{
+    return run([] { return ::get_all_products(); });
+}
+
+DbFuture<std::vector<Product>> AsyncDatabase::get_low_stock_products()
+{
+    return run([] { return ::get_low_stock_products(); });
+}
+
+DbFuture<std::vector<Transaction>> AsyncDatabase::get_all_transactions()
+{
+    return run([] { return ::get_all_transactions(); });
+}
+
+DbFuture<TransactionDetail> AsyncDatabase::get_transaction_detail(const int transaction_id)
+{
+    return run([transaction_id] { return ::get_transaction_detail(transaction_id); });
+}
+
+DbFuture<std::vector<CartItem>> AsyncDatabase::get_cart_items_by_transaction_id(const int transaction_id)
+{
+    return run([transaction_id] { return ::get_cart_items_by_transaction_id(transaction_id); });
+}
+
+DbFuture<std::vector<ReturnItem>> AsyncDatabase::get_all_returns()
+{
+    return run([] { return ::get_all_returns(); });
+}
+
+DbFuture<std::vector<ReturnItem>> AsyncDatabase::get_returns_by_transaction_id(const int transaction_id)
+{
+    return run([transaction_id] { return ::get_returns_by_transaction_id(transaction_id); });
+}
+
+DbFuture<std::vector<ReturnItem>> AsyncDatabase::get_returns_by_product_id(const int product_id)
+{
+    return run([product_id] { return ::get_returns_by_product_id(product_id); });
+}
+
+DbFuture<DbCommitResult> AsyncDatabase::commit(Transaction transaction)
+{
+    return run([transaction = std::move(transaction)]
+    {
+        DbCommitResult result;
+        result.ok = save_transaction(transaction, &result.conflicts);
+        return result;
+    });
+}
+
+DbFuture<DbWriteResult> AsyncDatabase::add_return_slip(const int transaction_id, std::vector<ReturnLine> lines)
+{
+    return run([transaction_id, lines = std::move(lines)]
+    {
+        DbWriteResult result;
+        result.ok = ::add_return_slip(transaction_id, lines, &result.error);
+        return result;
+    });
+}
+
+DbFuture<DbWriteResult> AsyncDatabase::update_product(const int id, std::string name, const double price, const int stock,
+                                                      const int alert_threshold)
+{
+    return run([id, name = std::move(name), price, stock, alert_threshold]
+    {
+        DbWriteResult result;
+        result.ok = ::update_product(id, name, price, stock, alert_threshold, &result.error);
+        return result;
+    });
+}
+
+AsyncDatabase& async_database()
+{
+    static AsyncDatabase instance;
+    return instance;
+}
+
+void AsyncTask::promise_type::unhandled_exception() noexcept
+{
+    try
+    {
+        throw;
+    }
+    catch (const std::exception& e)
+    {
+        SLOG_ERROR("异步任务异常: %s", e.what());
+    }
+    catch (...)
+    {
+        SLOG_ERROR("异步任务异常");
+    }
+}
@@ -0,0 +1,232 @@
+#ifndef ASYNCDB_H
+#define ASYNCDB_H
+#include <condition_variable>
+#include <coroutine>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "saleStruct.h"
+
+// 协程式数据访问：AsyncDatabase的函数立即把查询交给数据库工作线程执行并返回DbFuture，
+// 在协程中co_await取得结果。连续发起的几个查询在不同工作线程上同时执行，再依次co_await即可。
+// 结果就绪后协程经set_resume_executor设置的执行器恢复（界面程序设为界面线程的事件循环），
+// 未设置时直接在工作线程上恢复。工作线程各自init_db同一数据库文件；连接收银服务后经由服务执行。
+// 线程池未打开时查询在调用线程上同步执行，co_await不挂起
+
+// 协程恢复执行器：接收一个恢复函数，在合适的线程上调用它
+using ResumeExecutor = std::function<void(std::function<void()>)>;
+void set_resume_executor(ResumeExecutor executor);
+
+namespace asyncdb_detail
+{
+    // 结果的完成状态与等待中的协程，工作线程与等待方共享
+    class FutureState
+    {
+    public:
+        // 结果未就绪时登记等待的协程并返回true；已就绪时返回false，协程不挂起
+        bool suspend(std::coroutine_handle<> handle, std::function<bool()> alive);
+        void wait();
+        bool ready();
+
+    protected:
+        // 在持有m_mutex时写入结果后调用，释放锁后恢复等待的协程
+        void complete(std::unique_lock<std::mutex>& lock);
+        std::mutex m_mutex;
+
+    private:
+        std::condition_variable m_cv;
+        bool m_done = false;
+        std::coroutine_handle<> m_waiter;
+        std::function<bool()> m_alive;
+    };
+
+    template <typename T>
+    class ValueState : public FutureState
+    {
+    public:
+        void set(T value)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_value.emplace(std::move(value));
+            complete(lock);
+        }
+
+        T take()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return std::move(*m_value);
+        }
+
+    private:
+        std::optional<T> m_value;
+    };
+}
+
+// 数据库查询的结果，只能取一次：co_await或get()
+template <typename T>
+class DbFuture
+{
+public:
+    explicit DbFuture(std::shared_ptr<asyncdb_detail::ValueState<T>> state) : m_state(std::move(state))
+    {
+    }
+
+    bool await_ready() const
+    {
+        return m_state->ready();
+    }
+
+    // 协程的promise提供alive时，恢复前先检查，返回false则销毁协程而不恢复
+    template <typename Promise>
+    bool await_suspend(std::coroutine_handle<Promise> handle)
+    {
+        std::function<bool()> alive;
+        if constexpr (requires { handle.promise().alive; })
+            alive = handle.promise().alive;
+        return m_state->suspend(handle, std::move(alive));
+    }
+
+    T await_resume()
+    {
+        return m_state->take();
+    }
+
+    // 阻塞等待结果，用于非协程代码
+    T get()
+    {
+        m_state->wait();
+        return m_state->take();
+    }
+
+    bool ready() const
+    {
+        return m_state->ready();
+    }
+
+private:
+    std::shared_ptr<asyncdb_detail::ValueState<T>> m_state;
+};
+
+struct DbCommitResult
+{
+    bool ok = false;
+    std::vector<StockConflict> conflicts;   // 库存不足时的冲突商品
+};
+
+struct DbWriteResult
+{
+    bool ok = false;
+    std::string error;
+};
+
+class AsyncDatabase
+{
+public:
+    AsyncDatabase() = default;
+    ~AsyncDatabase();
+    AsyncDatabase(const AsyncDatabase&) = delete;
+    AsyncDatabase& operator=(const AsyncDatabase&) = delete;
+
+    // 在当前线程init_db成功后调用，启动workers个工作线程，各自打开同一数据库文件。
+    // 内存数据库无法被其他连接访问，返回false，查询仍在调用线程同步执行
+    bool open(int workers = 2, std::string* errorMsg = nullptr);
+    // 执行完已提交的查询后停止工作线程
+    void close();
+    bool is_open() const;
+
+    // 在工作线程上执行work并返回其结果，work不能返回void
+    template <typename F>
+    auto run(F work) -> DbFuture<std::invoke_result_t<F&>>
+    {
+        using T = std::invoke_result_t<F&>;
+        static_assert(!std::is_void_v<T>, "work必须返回结果");
+        auto state = std::make_shared<asyncdb_detail::ValueState<T>>();
+        post([state, work = std::move(work)]() mutable { state->set(work()); });
+        return DbFuture<T>(state);
+    }
+
+    DbFuture<Product> query_product(int id);
+    DbFuture<Product> query_product(std::string name);
+    DbFuture<Product> query_product_by_barcode(std::string barcode);
+    DbFuture<std::vector<Product>> get_all_products();
+    DbFuture<std::vector<Product>> get_low_stock_products();
+    DbFuture<std::vector<Transaction>> get_all_transactions();
+    DbFuture<TransactionDetail> get_transaction_detail(int transaction_id);
+    DbFuture<std::vector<CartItem>> get_cart_items_by_transaction_id(int transaction_id);
+    DbFuture<std::vector<ReturnItem>> get_all_returns();
+    DbFuture<std::vector<ReturnItem>> get_returns_by_transaction_id(int transaction_id);
+    DbFuture<std::vector<ReturnItem>> get_returns_by_product_id(int product_id);
+
+    // 保存交易，同save_transaction
+    DbFuture<DbCommitResult> commit(Transaction transaction);
+    DbFuture<DbWriteResult> add_return_slip(int transaction_id, std::vector<ReturnLine> lines);
+    DbFuture<DbWriteResult> update_product(int id, std::string name, double price, int stock, int alert_threshold);
+
+private:
+    struct Pool;
+
+    // 交给工作线程执行，线程池未打开时在当前线程执行
+    void post(std::function<void()> job);
+
+    std::unique_ptr<Pool> m_pool;
+    mutable std::mutex m_mutex;
+};
+
+AsyncDatabase& async_database();
+
+// 协程绑定的生命周期：co_await LifetimeBinding{...}之后，每次恢复前调用alive，
+// 返回false时（如所属窗口已关闭）协程被销毁而不再继续执行
+struct LifetimeBinding
+{
+    std::function<bool()> alive;
+};
+
+// 发起即执行、不需要等待结束的协程，如界面的槽函数。协程体抛出的异常写入日志
+class AsyncTask
+{
+public:
+    struct promise_type
+    {
+        std::function<bool()> alive;
+
+        AsyncTask get_return_object() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception() noexcept;
+
+        std::suspend_never await_transform(LifetimeBinding&& binding)
+        {
+            alive = std::move(binding.alive);
+            return {};
+        }
+
+        template <typename Awaitable>
+        Awaitable&& await_transform(Awaitable&& awaitable) noexcept
+        {
+            return std::forward<Awaitable>(awaitable);
+        }
+    };
+};
+
+#endif // ASYNCDB_H
@@ -0,0 +1,379 @@
+#include "backup.h"
+#include "database.h"
+#include "db_internal.h"
+#include "log.h"
+#include "timeutil.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    // 快照名中“库文件名-”之后的部分：YYYYMMDD-HHMMSS-mmm
+    constexpr size_t kStampLength = 19;
+
+    std::mutex g_optionsMutex;
+    BackupOptions g_options;
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+
+    double elapsed_seconds(const std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    std::string source_path()
+    {
+        const char* path = db ? sqlite3_db_filename(db, "main") : nullptr;
+        return path ? path : "";
+    }
+
+    std::string snapshot_prefix(const std::string& source)
+    {
+        return std::filesystem::path(source).stem().string() + "-";
+    }
+
+    std::string snapshot_stamp()
+    {
+        const auto now = std::chrono::system_clock::now();
+        const time_t seconds = std::chrono::system_clock::to_time_t(now);
+        const long long millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch()).count() % 1000;
+        std::tm tm{};
+        local_time(seconds, tm);
+        char text[32];
+        const size_t length = strftime(text, sizeof(text), "%Y%m%d-%H%M%S", &tm);
+        snprintf(text + length, sizeof(text) - length, "-%03lld", millis);
+        return text;
+    }
+
+    // 只认本模块生成的快照名，轮换时不会删除目录中的其他文件
+    bool is_snapshot(const std::string& name, const std::string& prefix)
+    {
+        if (name.size() != prefix.size() + kStampLength + 3 || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - 3, 3, ".db") != 0)
+            return false;
+        for (size_t i = 0; i < kStampLength; ++i)
+        {
+            const char c = name[prefix.size() + i];
+            if (i == 8 || i == 15 ? c != '-' : !std::isdigit(static_cast<unsigned char>(c)))
+                return false;
+        }
+        return true;
+    }
+
+    std::vector<BackupFile> scan_snapshots(const std::string& dir, const std::string& prefix)
+    {
+        std::vector<BackupFile> files;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(dir, ec))
+        {
+            if (!entry.is_regular_file(ec) || !is_snapshot(entry.path().filename().string(), prefix))
+                continue;
+            BackupFile file;
+            file.path = entry.path().string();
+            const auto bytes = entry.file_size(ec);
+            if (ec)
+                continue;
+            const auto modified = entry.last_write_time(ec);
+            if (ec)
+                continue;
+            file.bytes = static_cast<long long>(bytes);
+            file.created_at = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::file_clock::to_sys(modified).time_since_epoch()).count();
+            files.push_back(std::move(file));
+        }
+        // 时间戳定宽，按文件名倒序即从新到旧
+        std::sort(files.begin(), files.end(), [](const BackupFile& a, const BackupFile& b)
+        {
+            return a.path > b.path;
+        });
+        return files;
+    }
+
+    // 按小批页面从当前线程的连接复制到dest，cancel置位时中断
+    bool copy_pages(sqlite3* dest, const BackupOptions& options, const std::atomic<bool>* cancel,
+                    BackupResult& result, std::string& err)
+    {
+        sqlite3_backup* backup = sqlite3_backup_init(dest, "main", db, "main");
+        if (!backup)
+        {
+            err = std::string("开始备份失败: ") + sqlite3_errmsg(dest);
+            return false;
+        }
+
+        int step_pages = std::max(1, options.pages_per_step);
+        long long last_copied = 0;
+        int rc = SQLITE_OK;
+        while (true)
+        {
+            if (cancel && cancel->load())
+            {
+                rc = SQLITE_INTERRUPT;
+                break;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            rc = sqlite3_backup_step(backup, step_pages);
+            result.max_step_ms = std::max(result.max_step_ms, elapsed_seconds(start) * 1000.0);
+            ++result.steps;
+            if (rc == SQLITE_DONE)
+                break;
+            if (rc != SQLITE_OK && rc != SQLITE_BUSY && rc != SQLITE_LOCKED)
+                break;
+            if (rc == SQLITE_OK)
+            {
+                // 其他连接提交修改后，这一步从第一页重新复制，已复制页数不增反降
+                const long long copied = sqlite3_backup_pagecount(backup) - sqlite3_backup_remaining(backup);
+                if (result.steps > 1 && copied <= last_copied && ++result.restarts > options.max_restarts)
+                    step_pages = -1;
+                last_copied = copied;
+            }
+            if (step_pages > 0 && options.pause_ms > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(options.pause_ms));
+        }
+        result.pages = sqlite3_backup_pagecount(backup);
+        sqlite3_backup_finish(backup);
+
+        if (rc == SQLITE_INTERRUPT)
+            err = "备份已中断";
+        else if (rc != SQLITE_DONE)
+            err = std::string("复制页面失败: ") + sqlite3_errstr(rc);
+        return rc == SQLITE_DONE;
+    }
+
+    bool run_backup(const std::string& dir, const std::atomic<bool>* cancel, BackupResult* result,
+                    std::string* errorMsg)
+    {
+        const std::string source = source_path();
+        if (source.empty())
+        {
+            fail(errorMsg, "内存数据库不能在线备份");
+            return false;
+        }
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        if (ec)
+        {
+            fail(errorMsg, "创建备份目录失败: " + ec.message());
+            return false;
+        }
+
+        const BackupOptions options = get_backup_options();
+        const std::string prefix = snapshot_prefix(source);
+        BackupResult done;
+        done.path = (std::filesystem::path(dir) / (prefix + snapshot_stamp() + ".db")).string();
+        // 复制和校验都在临时文件上进行，中途失败不会留下看似完整的快照
+        const std::string temp = done.path + ".partial";
+        std::filesystem::remove(temp, ec);
+
+        sqlite3* dest = nullptr;
+        std::string err;
+        const auto copy_start = std::chrono::steady_clock::now();
+        bool ok = sqlite3_open_v2(temp.c_str(), &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) == SQLITE_OK;
+        if (!ok)
+            err = std::string("创建备份文件失败: ") + sqlite3_errmsg(dest);
+        ok = ok && copy_pages(dest, options, cancel, done, err);
+        // 源库是WAL模式，快照改回单文件，拷走即可打开
+        if (ok && sqlite3_exec(dest, "PRAGMA journal_mode = DELETE;", nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            err = std::string("写入备份文件失败: ") + sqlite3_errmsg(dest);
+            ok = false;
+        }
+        sqlite3_close(dest);
+        done.copy_seconds = elapsed_seconds(copy_start);
+
+        const auto verify_start = std::chrono::steady_clock::now();
+        ok = ok && verify_backup(temp, &err);
+        done.verify_seconds = elapsed_seconds(verify_start);
+        if (ok)
+        {
+            std::filesystem::rename(temp, done.path, ec);
+            if (ec)
+            {
+                err = "保存备份文件失败: " + ec.message();
+                ok = false;
+            }
+        }
+        if (!ok)
+        {
+            std::filesystem::remove(temp, ec);
+            fail(errorMsg, err);
+            return false;
+        }
+
+        done.bytes = static_cast<long long>(std::filesystem::file_size(done.path, ec));
+        const std::vector<BackupFile> files = scan_snapshots(dir, prefix);
+        for (size_t i = std::max(1, options.keep); i < files.size(); ++i)
+        {
+            if (std::filesystem::remove(files[i].path, ec))
+                ++done.removed;
+        }
+        SLOG_INFO("在线备份完成: %s, %lld 页, %d 步, 重来 %d 次, 最长一步 %.1f 毫秒, 复制 %.2f 秒, 校验 %.2f 秒",
+                  done.path.c_str(), done.pages, done.steps, done.restarts, done.max_step_ms, done.copy_seconds,
+                  done.verify_seconds);
+        if (result) *result = done;
+        return true;
+    }
+
+    // 后台备份线程，连接只在本线程使用
+    class Scheduler
+    {
+    public:
+        ~Scheduler() { stop(); }
+
+        void start(const std::string& path, const std::string& dir, const int interval_minutes)
+        {
+            stop();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = false;
+            m_worker = std::thread(&Scheduler::run, this, path, dir, std::max(1, interval_minutes));
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            if (m_worker.joinable())
+                m_worker.join();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::atomic<bool> m_stop{false};
+        std::thread m_worker;
+
+        void run(const std::string& path, const std::string& dir, const int interval_minutes)
+        {
+            if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK)
+            {
+                SLOG_ERROR("备份线程连接打开失败: %s", sqlite3_errmsg(db));
+                sqlite3_close(db);
+                db = nullptr;
+                return;
+            }
+            sqlite3_busy_timeout(db, 2000);
+            install_query_tracing(db);
+
+            // 按最新快照的时间续上间隔，频繁重启也不会一直推迟备份；启动后至少等一分钟，避开开机预热
+            const std::chrono::seconds interval(interval_minutes * 60LL);
+            std::chrono::seconds wait = interval;
+            const std::vector<BackupFile> files = scan_snapshots(dir, snapshot_prefix(path));
+            if (!files.empty())
+            {
+                const long long age = static_cast<long long>(time(nullptr)) - files.front().created_at;
+                wait = std::chrono::seconds(std::clamp<long long>(interval.count() - age, 60, interval.count()));
+            }
+            else
+                wait = std::min(interval, std::chrono::seconds(60));
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_cv.wait_for(lock, wait, [this] { return m_stop.load(); }))
+            {
+                lock.unlock();
+                run_backup(dir, &m_stop, nullptr, nullptr);
+                wait = interval;
+                lock.lock();
+            }
+            lock.unlock();
+            close_db();
+        }
+    };
+
+    Scheduler& scheduler()
+    {
+        static Scheduler instance;
+        return instance;
+    }
+}
+
+void set_backup_options(const BackupOptions& options)
+{
+    std::lock_guard<std::mutex> lock(g_optionsMutex);
+    g_options = options;
+}
+
+BackupOptions get_backup_options()
+{
+    std::lock_guard<std::mutex> lock(g_optionsMutex);
+    return g_options;
+}
+
+bool backup_database(const std::string& dir, BackupResult* result, std::string* errorMsg)
+{
+    QueryCall call("backup_database");
+    return run_backup(dir, nullptr, result, errorMsg);
+}
+
+bool verify_backup(const std::string& path, std::string* errorMsg)
+{
+    QueryCall call("verify_backup");
+    sqlite3* conn = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+    {
+        fail(errorMsg, std::string("打开备份文件失败: ") + sqlite3_errmsg(conn));
+        sqlite3_close(conn);
+        return false;
+    }
+    sqlite3_stmt* stmt = nullptr;
+    std::string problems;
+    int rc = sqlite3_prepare_v2(conn, "PRAGMA integrity_check;", -1, &stmt, nullptr);
+    while (rc == SQLITE_OK && (rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        const char* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        const std::string line = text ? text : "";
+        if (line != "ok")
+            problems += (problems.empty() ? "" : "; ") + line;
+        rc = SQLITE_OK;
+    }
+    if (rc != SQLITE_DONE && problems.empty())
+        problems = sqlite3_errmsg(conn);
+    sqlite3_finalize(stmt);
+    sqlite3_close(conn);
+    if (!problems.empty())
+    {
+        fail(errorMsg, "备份文件完整性检查未通过: " + path + ": " + problems);
+        return false;
+    }
+    return true;
+}
+
+std::vector<BackupFile> list_backups(const std::string& dir)
+{
+    QueryCall call("list_backups");
+    const std::string source = source_path();
+    if (source.empty())
+        return {};
+    std::vector<BackupFile> files = scan_snapshots(dir, snapshot_prefix(source));
+    call.rows(files.size());
+    return files;
+}
+
+void start_backup_scheduler(const std::string& dir, const int interval_minutes)
+{
+    const std::string path = source_path();
+    if (path.empty())
+    {
+        SLOG_WARN("内存数据库不启动备份线程");
+        return;
+    }
+    scheduler().start(path, dir, interval_minutes);
+}
+
+void stop_backup_scheduler()
+{
+    scheduler().stop();
+}
@@ -0,0 +1,57 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+#include <string>
+#include <vector>
+
+// 在线备份：用sqlite3_backup把主库每步复制一小批页面到备份目录，步与步之间让出一段时间，
+// 复制过程中收银照常结账。其他连接在复制中途提交修改时SQLite会从头重新复制，
+// 连续重来超过次数后改为一步复制剩余页面（WAL模式下读事务不阻塞写事务）。
+// 复制完成的文件改为非WAL的单文件并做完整性检查，通过后才改名为正式快照，
+// 快照名为“库文件名-日期-时间.db”，按时间保留最近若干个
+
+// 备份参数
+struct BackupOptions
+{
+    int pages_per_step = 256;   // 每步复制的页数
+    int pause_ms = 10;          // 每步之后让出的毫秒数
+    int max_restarts = 3;       // 源库被修改导致重来的次数上限，超过后一步复制剩余页面
+    int keep = 8;               // 保留的快照数
+};
+
+// 一次备份的统计
+struct BackupResult
+{
+    std::string path;           // 快照文件
+    long long pages = 0;        // 源库页数
+    long long bytes = 0;        // 快照文件字节数
+    int steps = 0;              // 复制步数
+    int restarts = 0;           // 源库被修改导致从头复制的次数
+    double max_step_ms = 0.0;   // 最长的一步复制耗时，即结账可能等待的上限
+    double copy_seconds = 0.0;  // 复制耗时（含让出时间）
+    double verify_seconds = 0.0;// 完整性检查耗时
+    int removed = 0;            // 轮换删除的旧快照数
+};
+
+// 备份目录中的快照
+struct BackupFile
+{
+    std::string path;
+    long long created_at = 0;   // 文件修改时间
+    long long bytes = 0;
+};
+
+void set_backup_options(const BackupOptions& options);
+BackupOptions get_backup_options();
+// 把当前线程连接的主库备份到dir（不存在时创建），校验通过后轮换旧快照
+bool backup_database(const std::string& dir, BackupResult* result = nullptr, std::string* errorMsg = nullptr);
+// 对快照文件做完整性检查
+bool verify_backup(const std::string& path, std::string* errorMsg = nullptr);
+// 当前主库在dir中的快照，从新到旧
+std::vector<BackupFile> list_backups(const std::string& dir);
+
+// 后台备份线程：用独立连接每interval_minutes分钟备份一次，距最新快照已超过间隔时启动后一分钟即备份；
+// 在当前线程init_db成功后调用，重复调用会先停止之前的线程，停止时中断正在进行的复制
+void start_backup_scheduler(const std::string& dir, int interval_minutes = 15);
+void stop_backup_scheduler();
+
+#endif // BACKUP_H
@@ -0,0 +1,578 @@
+#include "batch.h"
+#include "database.h"
+#include "db_internal.h"
+#include "detailcache.h"
+#include "lowstock.h"
+#include "log.h"
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    // 局部语句的RAII包装，批处理语句执行次数少，不进入语句缓存
+    class Statement
+    {
+    public:
+        explicit Statement(const char* sql)
+        {
+            if (sqlite3_prepare_v2(db, sql, -1, &m_stmt, nullptr) != SQLITE_OK)
+            {
+                SLOG_ERROR("编译SQL语句失败: %s", sqlite3_errmsg(db));
+                sqlite3_finalize(m_stmt);
+                m_stmt = nullptr;
+            }
+        }
+        ~Statement() { sqlite3_finalize(m_stmt); }
+        Statement(const Statement&) = delete;
+        Statement& operator=(const Statement&) = delete;
+
+        sqlite3_stmt* get() const { return m_stmt; }
+        explicit operator bool() const { return m_stmt != nullptr; }
+
+    private:
+        sqlite3_stmt* m_stmt = nullptr;
+    };
+
+    std::string column_text(sqlite3_stmt* stmt, const int column)
+    {
+        const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt, column));
+        return text ? text : "";
+    }
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+
+    // 按RFC 4180拆分一行CSV，支持带引号和转义引号的字段
+    std::vector<std::string> split_csv(const std::string& row)
+    {
+        std::vector<std::string> fields(1);
+        bool quoted = false;
+        for (size_t i = 0; i < row.size(); ++i)
+        {
+            const char c = row[i];
+            if (quoted)
+            {
+                if (c == '"' && i + 1 < row.size() && row[i + 1] == '"')
+                {
+                    fields.back() += '"';
+                    ++i;
+                }
+                else if (c == '"')
+                    quoted = false;
+                else
+                    fields.back() += c;
+            }
+            else if (c == '"')
+                quoted = true;
+            else if (c == ',')
+                fields.emplace_back();
+            else if (c != '\r')
+                fields.back() += c;
+        }
+        for (auto& field : fields)
+        {
+            const auto begin = field.find_first_not_of(" \t");
+            const auto end = field.find_last_not_of(" \t");
+            field = begin == std::string::npos ? "" : field.substr(begin, end - begin + 1);
+        }
+        return fields;
+    }
+
+    std::string csv_field(const std::string& text)
+    {
+        if (text.find_first_of(",\"\r\n") == std::string::npos)
+            return text;
+        std::string quoted = "\"";
+        for (const char c : text)
+        {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // 把查询结果逐行写成CSV，表头取列名
+    bool write_csv(sqlite3_stmt* stmt, const std::string& path, std::string* errorMsg)
+    {
+        FILE* file = fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            fail(errorMsg, "无法写入文件: " + path);
+            return false;
+        }
+        // 带BOM以便表格软件正确识别中文
+        fputs("\xEF\xBB\xBF", file);
+        const int columns = sqlite3_column_count(stmt);
+        for (int i = 0; i < columns; ++i)
+            fprintf(file, "%s%s", i ? "," : "", sqlite3_column_name(stmt, i));
+        fputs("\r\n", file);
+
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            for (int i = 0; i < columns; ++i)
+                fprintf(file, "%s%s", i ? "," : "", csv_field(column_text(stmt, i)).c_str());
+            fputs("\r\n", file);
+        }
+        fclose(file);
+        if (rc != SQLITE_DONE)
+        {
+            fail(errorMsg, std::string("导出失败: ") + sqlite3_errmsg(db));
+            return false;
+        }
+        return true;
+    }
+
+    const char* sql_create_rollup =
+        "CREATE TABLE IF NOT EXISTS sales_daily ("
+        "day TEXT PRIMARY KEY,"
+        "transactions INTEGER NOT NULL,"
+        "items_sold INTEGER NOT NULL,"
+        "items_returned INTEGER NOT NULL,"
+        "gross REAL NOT NULL,"
+        "net REAL NOT NULL"
+        ") WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS sales_daily_product ("
+        "day TEXT NOT NULL,"
+        "product_id INTEGER NOT NULL,"
+        "quantity INTEGER NOT NULL,"
+        "returned_quantity INTEGER NOT NULL,"
+        "revenue REAL NOT NULL,"
+        "PRIMARY KEY(day, product_id)"
+        ") WITHOUT ROWID;";
+
+    bool ensure_rollup_tables(std::string* errorMsg)
+    {
+        char* err = nullptr;
+        if (sqlite3_exec(db, sql_create_rollup, nullptr, nullptr, &err) != SQLITE_OK)
+        {
+            fail(errorMsg, std::string("创建汇总表失败: ") + (err ? err : ""));
+            sqlite3_free(err);
+            return false;
+        }
+        return true;
+    }
+
+    // 在当前写事务中重算主库中仍有交易的日期
+    WriteStatus refresh_rollup(std::string& err)
+    {
+        const char* sql =
+            "DELETE FROM sales_daily WHERE day >= IFNULL("
+            "  (SELECT date(MIN(create_time), 'unixepoch', 'localtime') FROM transactions), '9999-12-31');"
+            "DELETE FROM sales_daily_product WHERE day >= IFNULL("
+            "  (SELECT date(MIN(create_time), 'unixepoch', 'localtime') FROM transactions), '9999-12-31');"
+            "INSERT INTO sales_daily (day, transactions, items_sold, items_returned, gross, net) "
+            "SELECT date(t.create_time, 'unixepoch', 'localtime') AS day, COUNT(*), "
+            "       IFNULL(SUM(c.quantity), 0), IFNULL(SUM(c.returned_quantity), 0), "
+            "       round(IFNULL(SUM(c.gross), 0), 2), round(SUM(t.total_price), 2) "
+            "FROM transactions t LEFT JOIN ("
+            "  SELECT transaction_id, SUM(quantity) AS quantity, SUM(returned_quantity) AS returned_quantity, "
+            "         SUM(subtotal) AS gross FROM cart_items GROUP BY transaction_id) c "
+            "ON c.transaction_id = t.transaction_id GROUP BY day;"
+            "INSERT INTO sales_daily_product (day, product_id, quantity, returned_quantity, revenue) "
+            "SELECT date(t.create_time, 'unixepoch', 'localtime') AS day, c.product_id, SUM(c.quantity), "
+            "       SUM(c.returned_quantity), round(SUM(c.subtotal), 2) "
+            "FROM cart_items c JOIN transactions t ON t.transaction_id = c.transaction_id "
+            "GROUP BY day, c.product_id;";
+        const int rc = sqlite3_exec(db, sql, nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK)
+            err = std::string("重建销售汇总失败: ") + sqlite3_errmsg(db);
+        return write_status_of(rc);
+    }
+
+    // 执行只返回描述文本的检查查询，每行作为一条问题
+    void collect_problems(const char* sql, std::vector<std::string>& problems)
+    {
+        Statement stmt(sql);
+        if (!stmt)
+        {
+            problems.push_back(std::string("检查语句执行失败: ") + sqlite3_errmsg(db));
+            return;
+        }
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+            problems.push_back(column_text(stmt.get(), 0));
+    }
+}
+
+bool import_products_csv(const std::string& path, int* inserted, int* updated, std::string* errorMsg)
+{
+    QueryCall call("import_products_csv");
+    std::ifstream file(path);
+    if (!file)
+    {
+        fail(errorMsg, "打开商品文件失败: " + path);
+        return false;
+    }
+
+    struct Row
+    {
+        std::string name;
+        double price;
+        int stock;
+        int alert_threshold;
+        std::string barcode;
+    };
+    std::vector<Row> rows;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line))
+    {
+        ++line_number;
+        if (line_number == 1 && line.rfind("\xEF\xBB\xBF", 0) == 0)
+            line.erase(0, 3);
+        const auto fields = split_csv(line);
+        if (fields.size() == 1 && (fields[0].empty() || fields[0][0] == '#'))
+            continue;
+        try
+        {
+            if (fields.size() < 3 || fields[0].empty())
+                throw std::invalid_argument(line);
+            Row row{fields[0], std::stod(fields[1]), 0, 10, ""};
+            const long long stock = std::stoll(fields[2]);
+            if (row.price < 0 || stock < 0 || stock > INT_MAX)
+                throw std::out_of_range(line);
+            row.stock = static_cast<int>(stock);
+            if (fields.size() > 3 && !fields[3].empty())
+                row.alert_threshold = std::stoi(fields[3]);
+            if (fields.size() > 4 && !fields[4].empty())
+            {
+                if (!is_valid_barcode(fields[4]))
+                    throw std::invalid_argument(line);
+                row.barcode = fields[4];
+            }
+            rows.push_back(row);
+        }
+        catch (const std::exception&)
+        {
+            // 第一行不是数据时视为表头
+            if (rows.empty() && line_number == 1)
+                continue;
+            fail(errorMsg, "商品文件第 " + std::to_string(line_number) + " 行格式无效: " + line);
+            return false;
+        }
+    }
+
+    int inserted_count = 0;
+    int updated_count = 0;
+    std::string err;
+    const bool ok = run_write_transaction("导入商品", [&]
+    {
+        inserted_count = 0;
+        updated_count = 0;
+        // 条码列为空时保留原有条码
+        CachedStatement update("UPDATE products SET price = ?1, stock = ?2, alert_threshold = ?3, barcode = IFNULL(?5, barcode) "
+                               "WHERE id = (SELECT id FROM products WHERE name = ?4 LIMIT 1);");
+        CachedStatement insert("INSERT INTO products (name, price, stock, alert_threshold, barcode) "
+                               "VALUES (?4, ?1, ?2, ?3, ?5);");
+        if (!update || !insert)
+            return WriteStatus::Failed;
+        for (const auto& row : rows)
+        {
+            for (sqlite3_stmt* stmt : {update.get(), insert.get()})
+            {
+                sqlite3_reset(stmt);
+                sqlite3_bind_double(stmt, 1, row.price);
+                sqlite3_bind_int(stmt, 2, row.stock);
+                sqlite3_bind_int(stmt, 3, row.alert_threshold);
+                sqlite3_bind_text(stmt, 4, row.name.c_str(), -1, SQLITE_TRANSIENT);
+                if (row.barcode.empty())
+                    sqlite3_bind_null(stmt, 5);
+                else
+                    sqlite3_bind_text(stmt, 5, row.barcode.c_str(), -1, SQLITE_TRANSIENT);
+            }
+            int rc = sqlite3_step(update.get());
+            if (rc != SQLITE_DONE)
+                return write_status_of(rc);
+            if (sqlite3_changes(db) > 0)
+            {
+                ++updated_count;
+                continue;
+            }
+            rc = sqlite3_step(insert.get());
+            if (rc != SQLITE_DONE)
+                return write_status_of(rc);
+            ++inserted_count;
+        }
+        return WriteStatus::Ok;
+    });
+    if (!ok)
+    {
+        if (errorMsg) *errorMsg = std::string("导入商品失败: ") + sqlite3_errmsg(db);
+        return false;
+    }
+
+    // 导入绕过了逐条维护，价格和库存相关的派生状态整体刷新
+    clear_transaction_detail_cache();
+    reload_low_stock_set();
+    note_catalog_changed();
+    if (inserted) *inserted = inserted_count;
+    if (updated) *updated = updated_count;
+    call.rows(rows.size());
+    SLOG_INFO("商品导入完成: 新增 %d 种, 更新 %d 种", inserted_count, updated_count);
+    return true;
+}
+
+bool export_products_csv(const std::string& path, std::string* errorMsg)
+{
+    QueryCall call("export_products_csv");
+    Statement stmt("SELECT id, name, price, stock, alert_threshold, IFNULL(barcode, '') AS barcode FROM products ORDER BY id;");
+    return stmt && write_csv(stmt.get(), path, errorMsg);
+}
+
+bool export_transactions_csv(const std::string& path, const long long from, const long long to, std::string* errorMsg)
+{
+    QueryCall call("export_transactions_csv");
+    Statement stmt(
+        "SELECT t.transaction_id, datetime(t.create_time, 'unixepoch', 'localtime') AS create_time, "
+        "       t.total_price, t.amount_paid, t.change, c.product_id, IFNULL(p.name, '') AS product_name, "
+        "       c.quantity, c.returned_quantity, c.subtotal "
+        "FROM transactions t JOIN cart_items c ON c.transaction_id = t.transaction_id "
+        "LEFT JOIN products p ON p.id = c.product_id "
+        "WHERE t.create_time >= ?1 AND t.create_time < ?2 ORDER BY t.transaction_id, c.item_id;");
+    if (!stmt)
+        return false;
+    sqlite3_bind_int64(stmt.get(), 1, from);
+    sqlite3_bind_int64(stmt.get(), 2, to);
+    return write_csv(stmt.get(), path, errorMsg);
+}
+
+bool export_returns_csv(const std::string& path, const long long from, const long long to, std::string* errorMsg)
+{
+    QueryCall call("export_returns_csv");
+    Statement stmt(
+        "SELECT r.return_id, r.transaction_id, r.product_id, IFNULL(p.name, '') AS product_name, r.quantity, "
+        "       IFNULL(r.reason, '') AS reason, datetime(r.return_time, 'unixepoch', 'localtime') AS return_time "
+        "FROM returns r LEFT JOIN products p ON p.id = r.product_id "
+        "WHERE r.return_time >= ?1 AND r.return_time < ?2 ORDER BY r.return_id;");
+    if (!stmt)
+        return false;
+    sqlite3_bind_int64(stmt.get(), 1, from);
+    sqlite3_bind_int64(stmt.get(), 2, to);
+    return write_csv(stmt.get(), path, errorMsg);
+}
+
+bool rebuild_sales_rollup(std::string* errorMsg)
+{
+    QueryCall call("rebuild_sales_rollup");
+    if (!ensure_rollup_tables(errorMsg))
+        return false;
+    std::string err;
+    if (!run_write_transaction("重建销售汇总", [&] { return refresh_rollup(err); }))
+    {
+        if (errorMsg) *errorMsg = err.empty() ? "重建销售汇总失败" : err;
+        return false;
+    }
+    SLOG_INFO("销售汇总重建完成");
+    return true;
+}
+
+bool archive_transactions(const long long before, const std::string& archive_path, ArchiveResult* result,
+                          std::string* errorMsg)
+{
+    QueryCall call("archive_transactions");
+    if (!ensure_rollup_tables(errorMsg))
+        return false;
+
+    // ATTACH不能在事务中执行，归档库与主库在同一个写事务中完成搬移，中途失败两边都不变
+    {
+        Statement attach("ATTACH DATABASE ? AS archive;");
+        if (!attach)
+            return false;
+        sqlite3_bind_text(attach.get(), 1, archive_path.c_str(), -1, SQLITE_TRANSIENT);
+        if (sqlite3_step(attach.get()) != SQLITE_DONE)
+        {
+            fail(errorMsg, std::string("打开归档库失败: ") + sqlite3_errmsg(db));
+            return false;
+        }
+    }
+
+    ArchiveResult moved{0, 0, 0};
+    std::string err;
+    const bool ok = run_write_transaction("归档交易", [&]
+    {
+        moved = {0, 0, 0};
+        // 先刷新汇总，归档后的日期仍能出现在报表中
+        WriteStatus status = refresh_rollup(err);
+        if (status != WriteStatus::Ok)
+            return status;
+
+        const char* sql_create =
+            "CREATE TABLE IF NOT EXISTS archive.transactions AS SELECT * FROM main.transactions WHERE 0;"
+            "CREATE TABLE IF NOT EXISTS archive.cart_items AS SELECT * FROM main.cart_items WHERE 0;"
+            "CREATE TABLE IF NOT EXISTS archive.returns AS SELECT * FROM main.returns WHERE 0;";
+        int rc = sqlite3_exec(db, sql_create, nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK)
+            return write_status_of(rc);
+        // 早期建的归档库中购物车项没有促销列、退货没有金额列，按主库追加的顺序补齐，INSERT ... SELECT *的列才能对上
+        bool has_discount = false;
+        {
+            Statement stmt("SELECT 1 FROM pragma_table_info('cart_items', 'archive') WHERE name = 'discount';");
+            if (!stmt)
+                return write_status_of(sqlite3_errcode(db));
+            has_discount = sqlite3_step(stmt.get()) == SQLITE_ROW;
+        }
+        if (!has_discount)
+        {
+            rc = sqlite3_exec(db, "ALTER TABLE archive.cart_items ADD COLUMN discount REAL NOT NULL DEFAULT 0;"
+                              "ALTER TABLE archive.cart_items ADD COLUMN promotion_id INTEGER;", nullptr, nullptr, nullptr);
+            if (rc != SQLITE_OK)
+                return write_status_of(rc);
+        }
+        bool has_amount = false;
+        {
+            Statement stmt("SELECT 1 FROM pragma_table_info('returns', 'archive') WHERE name = 'amount';");
+            if (!stmt)
+                return write_status_of(sqlite3_errcode(db));
+            has_amount = sqlite3_step(stmt.get()) == SQLITE_ROW;
+        }
+        if (!has_amount)
+        {
+            rc = sqlite3_exec(db, "ALTER TABLE archive.returns ADD COLUMN amount REAL;", nullptr, nullptr, nullptr);
+            if (rc != SQLITE_OK)
+                return write_status_of(rc);
+        }
+
+        // 子表先于交易表搬移，每一步都以同一个时间条件选取；搬移不复制到总部，总部保留完整历史
+        const ReplicationMute mute;
+        const char* steps[][2] = {
+            {"INSERT INTO archive.returns SELECT * FROM main.returns WHERE transaction_id IN "
+             "(SELECT transaction_id FROM main.transactions WHERE create_time < ?1);",
+             "DELETE FROM main.returns WHERE transaction_id IN "
+             "(SELECT transaction_id FROM main.transactions WHERE create_time < ?1);"},
+            {"INSERT INTO archive.cart_items SELECT * FROM main.cart_items WHERE transaction_id IN "
+             "(SELECT transaction_id FROM main.transactions WHERE create_time < ?1);",
+             "DELETE FROM main.cart_items WHERE transaction_id IN "
+             "(SELECT transaction_id FROM main.transactions WHERE create_time < ?1);"},
+            {"INSERT INTO archive.transactions SELECT * FROM main.transactions WHERE create_time < ?1;",
+             "DELETE FROM main.transactions WHERE create_time < ?1;"},
+        };
+        int* counters[] = {&moved.returns, &moved.cart_items, &moved.transactions};
+        for (int i = 0; i < 3; ++i)
+        {
+            for (const char* sql : steps[i])
+            {
+                Statement stmt(sql);
+                if (!stmt)
+                    return WriteStatus::Failed;
+                sqlite3_bind_int64(stmt.get(), 1, before);
+                rc = sqlite3_step(stmt.get());
+                if (rc != SQLITE_DONE)
+                    return write_status_of(rc);
+            }
+            *counters[i] = sqlite3_changes(db);
+        }
+        return WriteStatus::Ok;
+    });
+    sqlite3_exec(db, "DETACH DATABASE archive;", nullptr, nullptr, nullptr);
+
+    if (!ok)
+    {
+        if (errorMsg) *errorMsg = err.empty() ? std::string("归档交易失败: ") + sqlite3_errmsg(db) : err;
+        return false;
+    }
+    clear_transaction_detail_cache();
+    if (result) *result = moved;
+    SLOG_INFO("归档完成: 交易 %d 笔, 购物车项 %d 条, 退货记录 %d 条",
+              moved.transactions, moved.cart_items, moved.returns);
+    return true;
+}
+
+bool check_integrity(std::vector<std::string>& problems)
+{
+    QueryCall call("check_integrity");
+    const size_t before = problems.size();
+
+    {
+        Statement stmt("PRAGMA integrity_check;");
+        while (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+        {
+            const std::string row = column_text(stmt.get(), 0);
+            if (row != "ok")
+                problems.push_back("结构损坏: " + row);
+        }
+    }
+    collect_problems(
+        "SELECT '外键失效: 表 ' || \"table\" || ' 行 ' || IFNULL(rowid, '?') || ' 引用 ' || parent "
+        "FROM pragma_foreign_key_check;", problems);
+    collect_problems(
+        "SELECT '库存为负: 商品ID ' || id || ' 库存 ' || stock FROM products WHERE stock < 0;", problems);
+    collect_problems(
+        "SELECT '已退数量超过购买数量: 交易ID ' || transaction_id || ' 商品ID ' || product_id "
+        "FROM cart_items WHERE returned_quantity > quantity;", problems);
+    collect_problems(
+        "SELECT '已退数量与退货记录不符: 交易ID ' || c.transaction_id || ' 商品ID ' || c.product_id || "
+        "       ' 已退 ' || c.returned_quantity || ' 退货记录合计 ' || IFNULL(r.total, 0) "
+        "FROM cart_items c LEFT JOIN ("
+        "  SELECT transaction_id, product_id, SUM(quantity) AS total FROM returns GROUP BY transaction_id, product_id"
+        ") r ON r.transaction_id = c.transaction_id AND r.product_id = c.product_id "
+        "WHERE c.returned_quantity <> IFNULL(r.total, 0);", problems);
+    collect_problems(
+        "SELECT '退货记录没有对应的购买行: 退货ID ' || r.return_id FROM returns r "
+        "WHERE NOT EXISTS (SELECT 1 FROM cart_items c "
+        "  WHERE c.transaction_id = r.transaction_id AND c.product_id = r.product_id);", problems);
+
+    call.rows(problems.size() - before);
+    return problems.size() == before;
+}
+
+std::vector<DailySales> get_daily_sales(const std::string& from_day, const std::string& to_day)
+{
+    QueryCall call("get_daily_sales");
+    std::vector<DailySales> days;
+    if (!ensure_rollup_tables(nullptr))
+        return days;
+    Statement stmt("SELECT day, transactions, items_sold, items_returned, gross, net FROM sales_daily "
+                   "WHERE (?1 = '' OR day >= ?1) AND (?2 = '' OR day <= ?2) ORDER BY day;");
+    if (!stmt)
+        return days;
+    sqlite3_bind_text(stmt.get(), 1, from_day.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 2, to_day.c_str(), -1, SQLITE_TRANSIENT);
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+    {
+        DailySales day;
+        day.day = column_text(stmt.get(), 0);
+        day.transactions = sqlite3_column_int(stmt.get(), 1);
+        day.items_sold = sqlite3_column_int(stmt.get(), 2);
+        day.items_returned = sqlite3_column_int(stmt.get(), 3);
+        day.gross = sqlite3_column_double(stmt.get(), 4);
+        day.net = sqlite3_column_double(stmt.get(), 5);
+        days.push_back(day);
+    }
+    call.rows(days.size());
+    return days;
+}
+
+std::vector<ProductSales> get_top_products(const std::string& from_day, const std::string& to_day, const int limit)
+{
+    QueryCall call("get_top_products");
+    std::vector<ProductSales> products;
+    if (!ensure_rollup_tables(nullptr))
+        return products;
+    Statement stmt(
+        "SELECT s.product_id, IFNULL(p.name, ''), SUM(s.quantity), SUM(s.returned_quantity), round(SUM(s.revenue), 2) "
+        "FROM sales_daily_product s LEFT JOIN products p ON p.id = s.product_id "
+        "WHERE (?1 = '' OR s.day >= ?1) AND (?2 = '' OR s.day <= ?2) "
+        "GROUP BY s.product_id ORDER BY SUM(s.quantity) - SUM(s.returned_quantity) DESC, s.product_id LIMIT ?3;");
+    if (!stmt)
+        return products;
+    sqlite3_bind_text(stmt.get(), 1, from_day.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt.get(), 2, to_day.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt.get(), 3, limit);
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+    {
+        ProductSales product;
+        product.product_id = sqlite3_column_int(stmt.get(), 0);
+        product.name = column_text(stmt.get(), 1);
+        product.quantity = sqlite3_column_int(stmt.get(), 2);
+        product.returned_quantity = sqlite3_column_int(stmt.get(), 3);
+        product.revenue = sqlite3_column_double(stmt.get(), 4);
+        products.push_back(product);
+    }
+    call.rows(products.size());
+    return products;
+}
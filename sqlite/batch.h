@@ -0,0 +1,29 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include <string>
+#include <vector>
+#include "saleStruct.h"
+
+// 批处理操作：导入导出、销售汇总、归档和完整性检查，供salesctl等后台任务使用。
+// 时间区间均为本地时间的Unix时间戳，左闭右开
+
+// 商品CSV导入，每行“名称,单价,库存[,预警阈值[,条码]]”，允许表头；同名商品更新，否则新增，条码为空时不改原有条码
+bool import_products_csv(const std::string& path, int* inserted = nullptr, int* updated = nullptr, std::string* errorMsg = nullptr);
+bool export_products_csv(const std::string& path, std::string* errorMsg = nullptr);
+// 按购物车行导出交易，每行包含交易头、商品和已退数量
+bool export_transactions_csv(const std::string& path, long long from, long long to, std::string* errorMsg = nullptr);
+bool export_returns_csv(const std::string& path, long long from, long long to, std::string* errorMsg = nullptr);
+
+// 重建每日汇总表sales_daily和sales_daily_product。
+// 只重算主库中仍有交易的日期，已归档日期的汇总保持不变
+bool rebuild_sales_rollup(std::string* errorMsg = nullptr);
+// 把before之前的交易连同购物车项和退货记录移入归档库，移出前先刷新汇总
+bool archive_transactions(long long before, const std::string& archive_path, ArchiveResult* result = nullptr, std::string* errorMsg = nullptr);
+// 检查数据库结构完整性、外键和退货数量等业务约束，返回是否没有发现问题
+bool check_integrity(std::vector<std::string>& problems);
+
+// 从汇总表读取报表，日期格式YYYY-MM-DD，空字符串表示不限
+std::vector<DailySales> get_daily_sales(const std::string& from_day, const std::string& to_day);
+std::vector<ProductSales> get_top_products(const std::string& from_day, const std::string& to_day, int limit);
+
+#endif // BATCH_H
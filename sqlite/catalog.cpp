@@ -0,0 +1,716 @@
+#include "catalog.h"
+#include "db_internal.h"
+#include "log.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr char kMagic[8] = {'S', 'A', 'L', 'E', 'S', 'C', 'T', '1'};
+    constexpr std::uint32_t kFormat = 2;
+
+    // 文件布局：文件头、按ID升序的定宽记录、名称哈希索引、条码哈希索引、字符串池（名称和条码）
+    struct SnapshotHeader
+    {
+        char magic[8];
+        std::uint32_t format;
+        std::uint32_t count;
+        std::int64_t token;             // catalog_state.token，区分不同的数据库
+        std::int64_t catalog_version;   // catalog_state.version
+        std::uint32_t name_slots;       // 名称哈希表槽数，2的幂
+        std::uint32_t barcode_slots;    // 条码哈希表槽数，2的幂
+        std::uint64_t pool_size;
+        std::uint64_t reserved[2];
+    };
+    static_assert(sizeof(SnapshotHeader) == 64);
+
+    struct SnapshotRecord
+    {
+        std::int32_t id;
+        std::int32_t stock;             // 生成快照时的库存
+        std::int32_t alert_threshold;
+        std::uint32_t name_length;
+        std::uint64_t name_offset;      // 在字符串池中的偏移
+        double price;
+        std::uint64_t barcode_offset;
+        std::uint32_t barcode_length;   // 0表示没有条码
+        std::uint32_t reserved;
+    };
+    static_assert(sizeof(SnapshotRecord) == 48);
+
+    // 哈希槽存放记录下标加一，0为空槽
+    using Slot = std::uint32_t;
+
+    struct CatalogVersion
+    {
+        std::int64_t token = 0;
+        std::int64_t version = -1;
+
+        bool operator==(const CatalogVersion&) const = default;
+    };
+
+    std::uint32_t slots_for(const std::uint32_t count)
+    {
+        std::uint32_t slots = 16;
+        while (slots < count * 2)
+            slots <<= 1;
+        return slots;
+    }
+
+    // FNV-1a
+    std::uint64_t hash_name(const char* name, const size_t length)
+    {
+        std::uint64_t h = 0xCBF29CE484222325ULL;
+        for (size_t i = 0; i < length; ++i)
+        {
+            h ^= static_cast<unsigned char>(name[i]);
+            h *= 0x100000001B3ULL;
+        }
+        return h;
+    }
+
+    bool read_catalog_version(CatalogVersion& version)
+    {
+        const CachedStatement stmt("SELECT token, version FROM catalog_state WHERE id = 1;");
+        if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW)
+            return false;
+        version.token = sqlite3_column_int64(stmt.get(), 0);
+        version.version = sqlite3_column_int64(stmt.get(), 1);
+        return true;
+    }
+
+    // 只读映射的快照文件；替换文件后旧映射仍指向旧内容，持有者用完即释放
+    class Snapshot
+    {
+    public:
+        static std::shared_ptr<const Snapshot> open(const std::string& path)
+        {
+            auto snapshot = std::shared_ptr<Snapshot>(new Snapshot());
+            if (!snapshot->map(path) || !snapshot->validate())
+                return nullptr;
+            return snapshot;
+        }
+
+        ~Snapshot()
+        {
+#ifdef _WIN32
+            if (m_data)
+                UnmapViewOfFile(m_data);
+            if (m_mapping)
+                CloseHandle(m_mapping);
+#else
+            if (m_data)
+                munmap(const_cast<char*>(m_data), m_size);
+#endif
+        }
+
+        const SnapshotHeader& header() const { return *reinterpret_cast<const SnapshotHeader*>(m_data); }
+        CatalogVersion version() const { return {header().token, header().catalog_version}; }
+        std::uint32_t count() const { return header().count; }
+        std::uint64_t bytes() const { return m_size; }
+        const SnapshotRecord& record(const std::uint32_t index) const { return m_records[index]; }
+
+        std::string name(const SnapshotRecord& record) const
+        {
+            return {m_pool + record.name_offset, record.name_length};
+        }
+
+        std::string barcode(const SnapshotRecord& record) const
+        {
+            return {m_pool + record.barcode_offset, record.barcode_length};
+        }
+
+        // 按名称查找，返回记录下标，不存在返回-1
+        long find(const std::string& name) const
+        {
+            const std::uint32_t mask = header().name_slots - 1;
+            for (std::uint64_t slot = hash_name(name.data(), name.size()) & mask;; slot = (slot + 1) & mask)
+            {
+                const Slot value = m_nameIndex[slot];
+                if (value == 0)
+                    return -1;
+                const SnapshotRecord& candidate = m_records[value - 1];
+                if (candidate.name_length == name.size() &&
+                    std::memcmp(m_pool + candidate.name_offset, name.data(), name.size()) == 0)
+                    return value - 1;
+            }
+        }
+
+        // 按条码查找，返回记录下标，不存在返回-1
+        long find_barcode(const std::string& barcode) const
+        {
+            const std::uint32_t mask = header().barcode_slots - 1;
+            for (std::uint64_t slot = hash_name(barcode.data(), barcode.size()) & mask;; slot = (slot + 1) & mask)
+            {
+                const Slot value = m_barcodeIndex[slot];
+                if (value == 0)
+                    return -1;
+                const SnapshotRecord& candidate = m_records[value - 1];
+                if (candidate.barcode_length == barcode.size() &&
+                    std::memcmp(m_pool + candidate.barcode_offset, barcode.data(), barcode.size()) == 0)
+                    return value - 1;
+            }
+        }
+
+    private:
+        Snapshot() = default;
+
+#ifdef _WIN32
+        HANDLE m_mapping = nullptr;
+#endif
+        const char* m_data = nullptr;
+        std::uint64_t m_size = 0;
+        const SnapshotRecord* m_records = nullptr;
+        const Slot* m_nameIndex = nullptr;
+        const Slot* m_barcodeIndex = nullptr;
+        const char* m_pool = nullptr;
+
+        bool map(const std::string& path)
+        {
+#ifdef _WIN32
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER size;
+            if (GetFileSizeEx(file, &size) && size.QuadPart >= static_cast<LONGLONG>(sizeof(SnapshotHeader)))
+            {
+                m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (m_mapping)
+                    m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+                m_size = static_cast<std::uint64_t>(size.QuadPart);
+            }
+            // 映射持有文件的引用，句柄可以立即关闭
+            CloseHandle(file);
+#else
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st{};
+            if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(SnapshotHeader)))
+            {
+                void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    m_data = static_cast<const char*>(data);
+                    m_size = static_cast<std::uint64_t>(st.st_size);
+                }
+            }
+            ::close(fd);
+#endif
+            return m_data != nullptr;
+        }
+
+        bool validate()
+        {
+            const SnapshotHeader& h = header();
+            if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.format != kFormat ||
+                h.name_slots != slots_for(h.count) || h.barcode_slots == 0 ||
+                (h.barcode_slots & (h.barcode_slots - 1)) != 0)
+                return false;
+            const std::uint64_t expected = sizeof(SnapshotHeader) + std::uint64_t{h.count} * sizeof(SnapshotRecord) +
+                (std::uint64_t{h.name_slots} + h.barcode_slots) * sizeof(Slot) + h.pool_size;
+            if (m_size != expected)
+                return false;
+            m_records = reinterpret_cast<const SnapshotRecord*>(m_data + sizeof(SnapshotHeader));
+            m_nameIndex = reinterpret_cast<const Slot*>(m_records + h.count);
+            m_barcodeIndex = m_nameIndex + h.name_slots;
+            m_pool = reinterpret_cast<const char*>(m_barcodeIndex + h.barcode_slots);
+            return true;
+        }
+    };
+
+    // 在一个读事务内读取目录版本和全部商品，写入临时文件后原子替换快照文件
+    bool write_snapshot(const std::string& path, std::string& err)
+    {
+        const bool own_transaction = sqlite3_get_autocommit(db) != 0;
+        if (own_transaction)
+            sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.format = kFormat;
+        std::vector<SnapshotRecord> records;
+        std::string pool;
+        CatalogVersion version;
+        bool ok = read_catalog_version(version);
+        if (ok)
+        {
+            const CachedStatement stmt("SELECT id, name, price, stock, alert_threshold, barcode FROM products ORDER BY id;");
+            int rc = stmt ? SQLITE_ROW : SQLITE_ERROR;
+            while (stmt && (rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+            {
+                SnapshotRecord record{};
+                record.id = sqlite3_column_int(stmt.get(), 0);
+                const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+                record.name_length = static_cast<std::uint32_t>(sqlite3_column_bytes(stmt.get(), 1));
+                record.name_offset = pool.size();
+                if (name)
+                    pool.append(name, record.name_length);
+                record.price = sqlite3_column_double(stmt.get(), 2);
+                record.stock = sqlite3_column_int(stmt.get(), 3);
+                record.alert_threshold = sqlite3_column_int(stmt.get(), 4);
+                const auto* barcode = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 5));
+                record.barcode_length = static_cast<std::uint32_t>(sqlite3_column_bytes(stmt.get(), 5));
+                record.barcode_offset = pool.size();
+                if (barcode)
+                    pool.append(barcode, record.barcode_length);
+                records.push_back(record);
+            }
+            ok = rc == SQLITE_DONE;
+        }
+        if (!ok)
+            err = std::string("读取商品目录失败: ") + sqlite3_errmsg(db);
+        if (own_transaction)
+            sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+        if (!ok)
+            return false;
+
+        header.token = version.token;
+        header.catalog_version = version.version;
+        header.count = static_cast<std::uint32_t>(records.size());
+        header.name_slots = slots_for(header.count);
+        header.pool_size = pool.size();
+        std::uint32_t barcodes = 0;
+        for (const SnapshotRecord& record : records)
+            barcodes += record.barcode_length != 0 ? 1 : 0;
+        header.barcode_slots = slots_for(barcodes);
+
+        std::vector<Slot> name_index(header.name_slots, 0);
+        for (std::uint32_t i = 0; i < header.count; ++i)
+        {
+            const SnapshotRecord& record = records[i];
+            const char* name = pool.data() + record.name_offset;
+            const std::uint64_t mask = name_index.size() - 1;
+            std::uint64_t slot = hash_name(name, record.name_length) & mask;
+            // 重名商品只索引ID最大的一个，与按名称查询ID的结果一致
+            for (; name_index[slot] != 0; slot = (slot + 1) & mask)
+            {
+                const SnapshotRecord& existing = records[name_index[slot] - 1];
+                if (existing.name_length == record.name_length &&
+                    std::memcmp(pool.data() + existing.name_offset, name, record.name_length) == 0)
+                    break;
+            }
+            name_index[slot] = i + 1;
+        }
+
+        // 条码在数据库中唯一，直接线性探测插入
+        std::vector<Slot> barcode_index(header.barcode_slots, 0);
+        for (std::uint32_t i = 0; i < header.count; ++i)
+        {
+            const SnapshotRecord& record = records[i];
+            if (record.barcode_length == 0)
+                continue;
+            const std::uint64_t mask = barcode_index.size() - 1;
+            std::uint64_t slot = hash_name(pool.data() + record.barcode_offset, record.barcode_length) & mask;
+            while (barcode_index[slot] != 0)
+                slot = (slot + 1) & mask;
+            barcode_index[slot] = i + 1;
+        }
+
+        // 多个终端可能同时重新生成，各自写入不同的临时文件
+        const std::string temp = path + ".tmp" +
+            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        FILE* file = fopen(temp.c_str(), "wb");
+        if (!file)
+        {
+            err = "无法写入商品目录快照: " + temp;
+            return false;
+        }
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+            fwrite(records.data(), sizeof(SnapshotRecord), records.size(), file) == records.size() &&
+            fwrite(name_index.data(), sizeof(Slot), name_index.size(), file) == name_index.size() &&
+            fwrite(barcode_index.data(), sizeof(Slot), barcode_index.size(), file) == barcode_index.size() &&
+            fwrite(pool.data(), 1, pool.size(), file) == pool.size();
+        ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+        ok = ok && MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        ok = ok && std::rename(temp.c_str(), path.c_str()) == 0;
+#endif
+        if (!ok)
+        {
+            std::remove(temp.c_str());
+            err = "写入商品目录快照失败: " + path;
+            return false;
+        }
+        SLOG_INFO("商品目录快照已生成：%u 种商品，目录版本 %lld", header.count,
+                  static_cast<long long>(header.catalog_version));
+        return true;
+    }
+
+    class Catalog
+    {
+    public:
+        ~Catalog()
+        {
+            stopWorker();
+        }
+
+        bool open(const std::string& path, std::string& err)
+        {
+            stopWorker();
+            std::lock_guard<std::mutex> build(m_buildMutex);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_path = path;
+            // 后台重新生成使用独立的只读连接；内存数据库无法被其他连接访问，只能在写入线程上生成
+            const char* filename = db ? sqlite3_db_filename(db, "main") : nullptr;
+            m_dbPath = filename ? filename : "";
+            m_snapshot = Snapshot::open(path);
+            CatalogVersion version;
+            if (m_snapshot && read_catalog_version(version) && m_snapshot->version() == version)
+                return true;
+            return rebuildLocked(err);
+        }
+
+        void close()
+        {
+            stopWorker();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_path.clear();
+            m_snapshot.reset();
+        }
+
+        bool rebuild(std::string& err)
+        {
+            std::lock_guard<std::mutex> build(m_buildMutex);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_path.empty())
+            {
+                err = "商品目录快照未打开";
+                return false;
+            }
+            return rebuildLocked(err);
+        }
+
+        // 标记快照过期并交给后台线程重新生成，调用方不等待；生成完成前读取方发现版本不一致，改为直接查询
+        void markStale()
+        {
+            bool inline_rebuild = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_path.empty())
+                    return;
+                inline_rebuild = m_dbPath.empty();
+                if (!inline_rebuild)
+                {
+                    m_rebuildRequested = true;
+                    if (!m_worker.joinable())
+                    {
+                        m_stopping = false;
+                        m_worker = std::thread(&Catalog::run, this);
+                    }
+                }
+            }
+            if (!inline_rebuild)
+            {
+                m_cv.notify_one();
+                return;
+            }
+            std::string err;
+            if (!rebuild(err))
+                SLOG_WARN("重新生成商品目录快照失败: %s", err.c_str());
+        }
+
+        bool isOpen()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return !m_path.empty();
+        }
+
+        std::shared_ptr<const Snapshot> current()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_snapshot;
+        }
+
+        // 返回与数据库目录版本一致的快照：其他进程已重新生成时重新映射；
+        // 否则请求后台重新生成并返回空，调用方这一次直接查询
+        std::shared_ptr<const Snapshot> fresh()
+        {
+            CatalogVersion version;
+            if (!read_catalog_version(version))
+                return nullptr;
+            std::shared_ptr<const Snapshot> snapshot = current();
+            if (snapshot && snapshot->version() == version)
+                return snapshot;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_path.empty())
+                    return nullptr;
+                if (!m_snapshot || m_snapshot->version() != version)
+                {
+                    std::shared_ptr<const Snapshot> mapped = Snapshot::open(m_path);
+                    if (mapped)
+                        m_snapshot = std::move(mapped);
+                }
+                if (m_snapshot && m_snapshot->version() == version)
+                    return m_snapshot;
+            }
+            markStale();
+            return nullptr;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::mutex m_buildMutex;    // 同一时刻只有一个线程生成快照文件，先于m_mutex获取
+        std::string m_path;
+        std::string m_dbPath;
+        std::shared_ptr<const Snapshot> m_snapshot;
+
+        std::condition_variable m_cv;
+        std::thread m_worker;
+        bool m_rebuildRequested = false;
+        bool m_stopping = false;
+
+        bool rebuildLocked(std::string& err)
+        {
+            if (!db)
+            {
+                err = "当前线程没有打开数据库";
+                return false;
+            }
+            if (!write_snapshot(m_path, err))
+                return false;
+            m_snapshot = Snapshot::open(m_path);
+            if (!m_snapshot)
+            {
+                err = "映射商品目录快照失败: " + m_path;
+                return false;
+            }
+            return true;
+        }
+
+        void stopWorker()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+                m_rebuildRequested = false;
+            }
+            m_cv.notify_all();
+            if (m_worker.joinable())
+                m_worker.join();
+        }
+
+        // 后台线程把本线程的db设为独立的只读连接，write_snapshot与写入线程使用同一套语句；
+        // 连续的多次修改合并为一次生成
+        void run()
+        {
+            std::string db_path;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                db_path = m_dbPath;
+            }
+            sqlite3* conn = nullptr;
+            if (sqlite3_open_v2(db_path.c_str(), &conn, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+            {
+                SLOG_ERROR("商品目录快照连接打开失败: %s", sqlite3_errmsg(conn));
+                sqlite3_close(conn);
+                conn = nullptr;
+            }
+            else
+            {
+                sqlite3_busy_timeout(conn, 200);
+                install_query_tracing(conn);
+            }
+            db = conn;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true)
+            {
+                m_cv.wait(lock, [this] { return m_stopping || m_rebuildRequested; });
+                if (m_stopping)
+                    break;
+                m_rebuildRequested = false;
+                if (!conn)
+                    continue;
+                lock.unlock();
+                rebuildInBackground();
+                lock.lock();
+            }
+            lock.unlock();
+
+            finalize_cached_statements();
+            sqlite3_close(conn);
+            db = nullptr;
+        }
+
+        void rebuildInBackground()
+        {
+            std::lock_guard<std::mutex> build(m_buildMutex);
+            CatalogVersion version;
+            std::string path;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_path.empty())
+                    return;
+                path = m_path;
+                // 其他进程或之前的请求已生成当前版本时不再生成
+                if (m_snapshot && read_catalog_version(version) && m_snapshot->version() == version)
+                    return;
+            }
+
+            // 读取商品表和写文件都不持有m_mutex，读取方照常取得旧快照或回退到直接查询
+            std::string err;
+            std::shared_ptr<const Snapshot> snapshot;
+            if (write_snapshot(path, err))
+                snapshot = Snapshot::open(path);
+            else
+                SLOG_WARN("重新生成商品目录快照失败: %s", err.c_str());
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (snapshot && m_path == path)
+                m_snapshot = std::move(snapshot);
+        }
+    };
+
+    Catalog& catalog()
+    {
+        static Catalog instance;
+        return instance;
+    }
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+}
+
+bool read_catalog_snapshot(std::vector<Product>& products)
+{
+    if (!catalog().isOpen())
+        return false;
+
+    // 目录版本和库存在同一个读事务中读取，两者对应同一时刻的商品表
+    const bool own_transaction = sqlite3_get_autocommit(db) != 0;
+    if (own_transaction)
+        sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+    const std::shared_ptr<const Snapshot> snapshot = catalog().fresh();
+    bool ok = snapshot != nullptr;
+    if (ok)
+    {
+        products.clear();
+        products.reserve(snapshot->count());
+        const CachedStatement stmt("SELECT id, stock FROM products ORDER BY id;");
+        std::uint32_t index = 0;
+        int rc = stmt ? SQLITE_ROW : SQLITE_ERROR;
+        while (stmt && (rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+        {
+            // 版本一致时商品集合相同，两边按ID升序逐行对应
+            if (index >= snapshot->count() || snapshot->record(index).id != sqlite3_column_int(stmt.get(), 0))
+            {
+                rc = SQLITE_ERROR;
+                break;
+            }
+            const SnapshotRecord& record = snapshot->record(index++);
+            products.push_back({record.id, snapshot->name(record), static_cast<float>(record.price),
+                                sqlite3_column_int(stmt.get(), 1), snapshot->barcode(record)});
+        }
+        ok = rc == SQLITE_DONE && index == snapshot->count();
+        if (!ok)
+            SLOG_WARN("商品目录快照与商品表不一致，改为直接查询");
+    }
+    if (own_transaction)
+        sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    return ok;
+}
+
+bool find_catalog_snapshot_id(const std::string& name, int& id)
+{
+    if (!catalog().isOpen())
+        return false;
+    const std::shared_ptr<const Snapshot> snapshot = catalog().fresh();
+    if (!snapshot)
+        return false;
+    const long index = snapshot->find(name);
+    id = index < 0 ? -1 : snapshot->record(static_cast<std::uint32_t>(index)).id;
+    return true;
+}
+
+bool find_catalog_snapshot_barcode(const std::string& barcode, Product& product)
+{
+    if (!catalog().isOpen())
+        return false;
+    const std::shared_ptr<const Snapshot> snapshot = catalog().fresh();
+    if (!snapshot)
+        return false;
+    const long index = snapshot->find_barcode(barcode);
+    if (index < 0)
+    {
+        product.id = -1;
+        return true;
+    }
+    const SnapshotRecord& record = snapshot->record(static_cast<std::uint32_t>(index));
+    product.id = record.id;
+    product.name = snapshot->name(record);
+    product.price = static_cast<float>(record.price);
+    product.stock = record.stock;
+    product.barcode = snapshot->barcode(record);
+    return true;
+}
+
+void note_catalog_changed()
+{
+    catalog().markStale();
+}
+
+bool open_catalog_snapshot(const std::string& path, std::string* errorMsg)
+{
+    QueryCall call("open_catalog_snapshot");
+    std::string err;
+    if (!catalog().open(path, err))
+    {
+        fail(errorMsg, err);
+        return false;
+    }
+    return true;
+}
+
+void close_catalog_snapshot()
+{
+    catalog().close();
+}
+
+bool rebuild_catalog_snapshot(std::string* errorMsg)
+{
+    QueryCall call("rebuild_catalog_snapshot");
+    std::string err;
+    if (!catalog().rebuild(err))
+    {
+        fail(errorMsg, err);
+        return false;
+    }
+    return true;
+}
+
+CatalogSnapshotInfo get_catalog_snapshot_info()
+{
+    CatalogSnapshotInfo info;
+    info.open = catalog().isOpen();
+    const std::shared_ptr<const Snapshot> snapshot = catalog().current();
+    if (!snapshot)
+        return info;
+    CatalogVersion version;
+    info.current = db && read_catalog_version(version) && snapshot->version() == version;
+    info.catalog_version = snapshot->header().catalog_version;
+    info.products = snapshot->count();
+    info.file_bytes = snapshot->bytes();
+    return info;
+}
@@ -0,0 +1,31 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+#include <cstdint>
+#include <string>
+
+// 商品目录快照：把商品表导出为二进制文件（定宽记录、字符串池和按名称、按条码的哈希索引），
+// 终端以只读方式内存映射，读取商品列表和按名称、条码查找商品时不必逐行解析SQL结果。
+// 快照记录生成时数据库的目录版本（catalog_state），新增、删除商品或修改名称、单价、预警阈值
+// 或条码都会使版本加一；版本不一致的快照不会被使用，而是由后台线程用独立的只读连接重新生成，
+// 写操作不等待生成完成，生成完成前的读取直接查询数据库。
+// 库存随每笔交易变化，不计入目录版本，读取商品列表时从数据库覆盖
+
+// 快照状态
+struct CatalogSnapshotInfo
+{
+    bool open = false;                 // 已打开快照文件
+    bool current = false;              // 与数据库目录版本一致
+    long long catalog_version = -1;    // 快照对应的目录版本
+    unsigned products = 0;             // 商品数
+    std::uint64_t file_bytes = 0;      // 文件大小
+};
+
+// 映射快照文件，文件不存在或与数据库版本不一致时重新生成；重复调用会先关闭之前的快照。
+// 在当前线程init_db成功后调用
+bool open_catalog_snapshot(const std::string& path, std::string* errorMsg = nullptr);
+void close_catalog_snapshot();
+// 立即从数据库重新生成快照
+bool rebuild_catalog_snapshot(std::string* errorMsg = nullptr);
+CatalogSnapshotInfo get_catalog_snapshot_info();
+
+#endif // CATALOG_H
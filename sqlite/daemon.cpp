@@ -0,0 +1,577 @@
+#include "daemon.h"
+#include "database.h"
+#include "db_internal.h"
+#include "ipc.h"
+#include "log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    std::atomic<bool> g_stop{false};
+
+    std::atomic<long long> g_connections{0};
+    std::atomic<long long> g_activeConnections{0};
+    std::atomic<long long> g_requests{0};
+    std::atomic<long long> g_checkouts{0};
+    std::atomic<long long> g_batches{0};
+    std::atomic<long long> g_maxBatch{0};
+    std::atomic<long long> g_batchFailures{0};
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+
+    // 写操作队列：服务内的全部写操作按到达顺序逐个执行，同一时刻只有一个线程写，服务进程内没有写锁争用。
+    // 采用领导者组提交：排队的连接线程中没有人在写时，由它在自己的连接上执行队首的写操作，
+    // 连续排队的结账合并为一个写事务；写的期间到达的结账排成下一批，负载越高批次越大。
+    // 自己的请求完成后交出领导权，由仍在等待的线程接手，空闲时单笔结账不经过额外的线程切换
+    class GroupCommitter
+    {
+    public:
+        explicit GroupCommitter(const DaemonOptions& options) : m_options(options) {}
+
+        // 之后到达的写请求都返回失败，已排队的照常执行
+        void stop()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        // 提交一笔结账并等待所在批次提交
+        bool submit(const Transaction& transaction, std::vector<StockConflict>& conflicts)
+        {
+            Pending pending;
+            pending.sale.transaction = &transaction;
+            if (!enqueue(pending))
+                return false;
+            conflicts = std::move(pending.sale.conflicts);
+            return pending.sale.saved;
+        }
+
+        // 按顺序执行其他写操作并等待完成；服务正在退出时返回false，job不执行
+        bool write(const std::function<void()>& job)
+        {
+            Pending pending;
+            pending.job = &job;
+            return enqueue(pending);
+        }
+
+    private:
+        // 一笔结账或一个其他写操作
+        struct Pending
+        {
+            BatchedSale sale;
+            const std::function<void()>* job = nullptr;
+            bool done = false;
+        };
+
+        bool enqueue(Pending& pending)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_stop)
+                return false;
+            m_queue.push_back(&pending);
+            m_queued.notify_one();
+            while (!pending.done)
+            {
+                if (m_leading)
+                {
+                    m_done.wait(lock);
+                    continue;
+                }
+                m_leading = true;
+                while (!pending.done)
+                    lead(lock);
+                m_leading = false;
+                // 唤醒仍在等待的线程，其中一个接手领导权
+                m_done.notify_all();
+            }
+            return true;
+        }
+
+        // 执行队首的一个写操作或一批结账，调用时持有锁，执行期间释放
+        void lead(std::unique_lock<std::mutex>& lock)
+        {
+            if (Pending* front = m_queue.front(); front->job)
+            {
+                m_queue.pop_front();
+                lock.unlock();
+                (*front->job)();
+                lock.lock();
+                front->done = true;
+                m_done.notify_all();
+                return;
+            }
+
+            const size_t max_batch = static_cast<size_t>(std::max(1, m_options.max_batch));
+            if (m_options.commit_delay_us > 0 && m_queue.size() < max_batch)
+            {
+                m_queued.wait_for(lock, std::chrono::microseconds(m_options.commit_delay_us),
+                                [this, max_batch] { return m_queue.size() >= max_batch; });
+            }
+            // 取连续排队的结账，遇到其他写操作为止，保持到达顺序
+            std::vector<Pending*> batch;
+            while (!m_queue.empty() && !m_queue.front()->job && batch.size() < max_batch)
+            {
+                batch.push_back(m_queue.front());
+                m_queue.pop_front();
+            }
+            lock.unlock();
+
+            std::vector<BatchedSale> sales(batch.size());
+            for (size_t i = 0; i < batch.size(); ++i)
+                sales[i].transaction = batch[i]->sale.transaction;
+            if (!save_transaction_batch(sales))
+                g_batchFailures.fetch_add(1);
+            g_batches.fetch_add(1);
+            g_checkouts.fetch_add(static_cast<long long>(sales.size()));
+            // 最大批次笔数用比较交换更新，不会被并发的较小值覆盖
+            const long long size = static_cast<long long>(sales.size());
+            long long seen = g_maxBatch.load();
+            while (seen < size && !g_maxBatch.compare_exchange_weak(seen, size))
+            {
+            }
+
+            lock.lock();
+            for (size_t i = 0; i < batch.size(); ++i)
+            {
+                batch[i]->sale.saved = sales[i].saved;
+                batch[i]->sale.conflicts = std::move(sales[i].conflicts);
+                batch[i]->done = true;
+            }
+            m_done.notify_all();
+        }
+
+        const DaemonOptions m_options;
+        std::mutex m_mutex;
+        std::condition_variable m_done;
+        std::condition_variable m_queued;   // 新请求入队，等待凑批的领导者据此提前结束等待
+        std::deque<Pending*> m_queue;
+        bool m_leading = false;
+        bool m_stop = false;
+    };
+
+    // 解析请求并在当前线程的连接上执行，写操作经写操作队列按顺序执行，结账参与组提交；
+    // 请求无法解析或服务正在退出时返回false，服务端关闭连接
+    bool dispatch(WireReader& in, WireWriter& out, GroupCommitter& committer)
+    {
+        const auto op = static_cast<DaemonOp>(in.u8());
+        switch (op)
+        {
+        case DaemonOp::Stats:
+        {
+            if (!in.done()) return false;
+            write_wire(out, get_daemon_stats());
+            return true;
+        }
+        case DaemonOp::GetIdFromName:
+        {
+            const std::string name = in.str();
+            if (!in.done()) return false;
+            out.i32(getIdFromName(name));
+            return true;
+        }
+        case DaemonOp::AddProduct:
+        {
+            const std::string name = in.str();
+            const double price = in.f64();
+            const int stock = in.i32();
+            const int threshold = in.i32();
+            if (!in.done()) return false;
+            return committer.write([&] { out.boolean(add_product(name, price, stock, threshold)); });
+        }
+        case DaemonOp::AddProductWithBarcode:
+        {
+            const std::string name = in.str();
+            const double price = in.f64();
+            const int stock = in.i32();
+            const int threshold = in.i32();
+            const std::string barcode = in.str();
+            if (!in.done()) return false;
+            return committer.write([&]
+            {
+                std::string err;
+                out.boolean(add_product(name, price, stock, threshold, barcode, &err));
+                out.str(err);
+            });
+        }
+        case DaemonOp::QueryProductById:
+        {
+            const int id = in.i32();
+            if (!in.done()) return false;
+            write_wire(out, query_product(id));
+            return true;
+        }
+        case DaemonOp::QueryProductByName:
+        {
+            const std::string name = in.str();
+            if (!in.done()) return false;
+            write_wire(out, query_product(name));
+            return true;
+        }
+        case DaemonOp::QueryProductByBarcode:
+        {
+            const std::string barcode = in.str();
+            if (!in.done()) return false;
+            write_wire(out, query_product_by_barcode(barcode));
+            return true;
+        }
+        case DaemonOp::UpdateStockById:
+        {
+            const int id = in.i32();
+            const int stock = in.i32();
+            if (!in.done()) return false;
+            return committer.write([&] { out.boolean(update_stock(id, stock)); });
+        }
+        case DaemonOp::UpdateStockByName:
+        {
+            const std::string name = in.str();
+            const int stock = in.i32();
+            if (!in.done()) return false;
+            return committer.write([&] { out.i32(update_stock(name, stock)); });
+        }
+        case DaemonOp::GetAllProducts:
+        {
+            if (!in.done()) return false;
+            write_wire(out, get_all_products());
+            return true;
+        }
+        case DaemonOp::SaveTransaction:
+        {
+            Transaction transaction{};
+            read_wire(in, transaction);
+            if (!in.done()) return false;
+            std::vector<StockConflict> conflicts;
+            out.boolean(committer.submit(transaction, conflicts));
+            write_wire(out, conflicts);
+            return true;
+        }
+        case DaemonOp::GetAllTransactions:
+        {
+            if (!in.done()) return false;
+            write_wire(out, get_all_transactions());
+            return true;
+        }
+        case DaemonOp::GetCartItems:
+        {
+            const int transaction_id = in.i32();
+            if (!in.done()) return false;
+            write_wire(out, get_cart_items_by_transaction_id(transaction_id));
+            return true;
+        }
+        case DaemonOp::GetTransactionDetail:
+        {
+            const int transaction_id = in.i32();
+            if (!in.done()) return false;
+            write_wire(out, get_transaction_detail(transaction_id));
+            return true;
+        }
+        case DaemonOp::GetLowStockProducts:
+        {
+            if (!in.done()) return false;
+            write_wire(out, get_low_stock_products());
+            return true;
+        }
+        case DaemonOp::DeleteProductById:
+        {
+            const int id = in.i32();
+            if (!in.done()) return false;
+            return committer.write([&] { out.boolean(delete_product(id)); });
+        }
+        case DaemonOp::DeleteProductByName:
+        {
+            const std::string name = in.str();
+            if (!in.done()) return false;
+            return committer.write([&] { out.boolean(delete_product(name)); });
+        }
+        case DaemonOp::UpdateProductById:
+        {
+            const int id = in.i32();
+            const std::string name = in.str();
+            const double price = in.f64();
+            const int stock = in.i32();
+            const int threshold = in.i32();
+            if (!in.done()) return false;
+            return committer.write([&]
+            {
+                std::string err;
+                out.boolean(update_product(id, name, price, stock, threshold, &err));
+                out.str(err);
+            });
+        }
+        case DaemonOp::UpdateProductByName:
+        {
+            const std::string old_name = in.str();
+            const std::string new_name = in.str();
+            const double price = in.f64();
+            const int stock = in.i32();
+            const int threshold = in.i32();
+            if (!in.done()) return false;
+            return committer.write([&]
+            {
+                std::string err;
+                out.boolean(update_product(old_name, new_name, price, stock, threshold, &err));
+                out.str(err);
+            });
+        }
+        case DaemonOp::SetAlertThresholdById:
+        {
+            const int id = in.i32();
+            const int threshold = in.i32();
+            if (!in.done()) return false;
+            return committer.write([&] { out.boolean(set_product_alert_threshold(id, threshold)); });
+        }
+        case DaemonOp::SetAlertThresholdByName:
+        {
+            const std::string name = in.str();
+            const int threshold = in.i32();
+            if (!in.done()) return false;
+            return committer.write([&] { out.boolean(set_product_alert_threshold(name, threshold)); });
+        }
+        case DaemonOp::GetAlertThresholdById:
+        {
+            const int id = in.i32();
+            if (!in.done()) return false;
+            out.i32(get_product_alert_threshold(id));
+            return true;
+        }
+        case DaemonOp::GetAlertThresholdByName:
+        {
+            const std::string name = in.str();
+            if (!in.done()) return false;
+            out.i32(get_product_alert_threshold(name));
+            return true;
+        }
+        case DaemonOp::SetProductBarcode:
+        {
+            const int id = in.i32();
+            const std::string barcode = in.str();
+            if (!in.done()) return false;
+            return committer.write([&]
+            {
+                std::string err;
+                out.boolean(set_product_barcode(id, barcode, &err));
+                out.str(err);
+            });
+        }
+        case DaemonOp::RestockProducts:
+        {
+            std::vector<RestockLine> lines;
+            read_wire(in, lines);
+            const bool want_updated = in.boolean();
+            if (!in.done()) return false;
+            return committer.write([&]
+            {
+                std::string err;
+                std::vector<Product> updated;
+                out.boolean(restock_products(lines, want_updated ? &updated : nullptr, &err));
+                out.str(err);
+                write_wire(out, updated);
+            });
+        }
+        case DaemonOp::AddReturn:
+        {
+            const int transaction_id = in.i32();
+            const int product_id = in.i32();
+            const int quantity = in.i32();
+            const std::string reason = in.str();
+            if (!in.done()) return false;
+            return committer.write([&] { out.boolean(add_return(transaction_id, product_id, quantity, reason)); });
+        }
+        case DaemonOp::AddReturnSlip:
+        {
+            const int transaction_id = in.i32();
+            std::vector<ReturnLine> lines;
+            read_wire(in, lines);
+            if (!in.done()) return false;
+            return committer.write([&]
+            {
+                std::string err;
+                out.boolean(add_return_slip(transaction_id, lines, &err));
+                out.str(err);
+            });
+        }
+        case DaemonOp::GetAllReturns:
+        {
+            if (!in.done()) return false;
+            write_wire(out, get_all_returns());
+            return true;
+        }
+        case DaemonOp::GetReturnsByTransaction:
+        {
+            const int transaction_id = in.i32();
+            if (!in.done()) return false;
+            write_wire(out, get_returns_by_transaction_id(transaction_id));
+            return true;
+        }
+        case DaemonOp::GetReturnsByProduct:
+        {
+            const int product_id = in.i32();
+            if (!in.done()) return false;
+            write_wire(out, get_returns_by_product_id(product_id));
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+    // 一个终端连接：线程在连接期间保持自己的数据库连接，预编译语句常驻
+    void serve_connection(const LocalSocket socket, const std::string& path, GroupCommitter& committer)
+    {
+        std::string request;
+        WireWriter response;
+        if (!recv_frame(socket, request))
+            return;
+        WireReader hello(request);
+        const auto op = static_cast<DaemonOp>(hello.u8());
+        const std::uint32_t magic = hello.u32();
+        const std::uint16_t version = hello.u16();
+        if (!hello.done() || op != DaemonOp::Hello || magic != kDaemonMagic || version != kDaemonProtocolVersion)
+        {
+            SLOG_WARN("收银服务拒绝连接: 握手无效或协议版本 %u 不一致", static_cast<unsigned>(version));
+            return;
+        }
+        if (!init_db(path))
+            return;
+        response.u16(kDaemonProtocolVersion);
+        if (!send_frame(socket, response.data()))
+        {
+            close_db();
+            return;
+        }
+
+        while (recv_frame(socket, request))
+        {
+            response.clear();
+            WireReader in(request);
+            if (!dispatch(in, response, committer))
+            {
+                SLOG_WARN("收银服务收到无法解析的请求，关闭连接");
+                break;
+            }
+            g_requests.fetch_add(1, std::memory_order_relaxed);
+            if (!send_frame(socket, response.data()))
+                break;
+        }
+        close_db();
+    }
+
+    struct Connection
+    {
+        LocalSocket socket = kInvalidSocket;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    void join_finished(std::list<Connection>& connections, const bool all)
+    {
+        for (auto it = connections.begin(); it != connections.end();)
+        {
+            if (!all && !it->finished.load())
+            {
+                ++it;
+                continue;
+            }
+            if (all)
+                shutdown_local_socket(it->socket);
+            it->thread.join();
+            close_local_socket(it->socket);
+            it = connections.erase(it);
+        }
+    }
+}
+
+bool run_sales_daemon(const DaemonOptions& options, std::string* errorMsg)
+{
+    const char* filename = db ? sqlite3_db_filename(db, "main") : nullptr;
+    if (!filename || !*filename)
+    {
+        fail(errorMsg, "收银服务需要先打开数据库文件");
+        return false;
+    }
+    const std::string path = filename;
+
+    std::string err;
+    const LocalSocket listener = listen_local_socket(options.socket_path, &err);
+    if (listener == kInvalidSocket)
+    {
+        fail(errorMsg, err);
+        return false;
+    }
+    GroupCommitter committer(options);
+
+    g_stop.store(false);
+    SLOG_INFO("收银服务已启动，监听 %s，数据库 %s", options.socket_path.c_str(), path.c_str());
+    std::list<Connection> connections;
+    while (!g_stop.load())
+    {
+        // 定时醒来检查退出请求，顺便回收已断开的连接线程
+        const LocalSocket socket = accept_local_socket(listener, 200);
+        join_finished(connections, false);
+        if (socket == kInvalidSocket)
+            continue;
+        if (!local_peer_allowed(socket))
+        {
+            SLOG_WARN("拒绝其他用户的进程连接收银服务");
+            close_local_socket(socket);
+            continue;
+        }
+        if (static_cast<int>(connections.size()) >= options.max_clients)
+        {
+            SLOG_WARN("收银服务连接数已达上限 %d，拒绝新连接", options.max_clients);
+            close_local_socket(socket);
+            continue;
+        }
+        g_connections.fetch_add(1);
+        Connection& connection = connections.emplace_back();
+        connection.socket = socket;
+        connection.thread = std::thread([&connection, &committer, path]
+        {
+            g_activeConnections.fetch_add(1);
+            serve_connection(connection.socket, path, committer);
+            g_activeConnections.fetch_sub(1);
+            connection.finished.store(true);
+        });
+    }
+
+    close_local_socket(listener);
+    std::remove(options.socket_path.c_str());
+    // 不再接受新的写请求，已排队的结账提交完后各连接线程退出
+    committer.stop();
+    join_finished(connections, true);
+
+    const DaemonStats stats = get_daemon_stats();
+    SLOG_INFO("收银服务已退出: 请求 %lld 次，结账 %lld 笔，组提交 %lld 次，最大批次 %lld 笔",
+              stats.requests, stats.checkouts, stats.batches, stats.max_batch);
+    return true;
+}
+
+void stop_sales_daemon()
+{
+    g_stop.store(true);
+}
+
+DaemonStats get_daemon_stats()
+{
+    DaemonStats stats;
+    stats.connections = g_connections.load();
+    stats.active_connections = g_activeConnections.load();
+    stats.requests = g_requests.load();
+    stats.checkouts = g_checkouts.load();
+    stats.batches = g_batches.load();
+    stats.max_batch = g_maxBatch.load();
+    stats.batch_failures = g_batchFailures.load();
+    return stats;
+}
@@ -0,0 +1,52 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+#include <string>
+
+// 收银服务：一个进程独占数据库，多个收银终端经本地套接字调用database.h中的函数。
+// 服务端为每个终端连接保留一个线程和一个数据库连接，预编译语句、低库存集合、明细缓存和商品目录快照
+// 在各终端间共用且常驻。写操作按到达顺序逐个执行，同一时刻只有一个线程写；各终端同时提交的结账
+// 合并为组提交：一个写事务、一次写盘，每笔在各自的保存点中执行，库存不足只拒绝该笔。
+// 终端之间以及服务内部都不再争用数据库写锁
+// 终端进程调用connect_sales_daemon后，database.h中的函数（init_db、close_db和is_valid_barcode、
+// load_restock_csv除外）都经由服务执行，调用方式与返回值不变。写操作成功后本进程同步自己的派生状态：
+// 受影响的交易明细缓存失效，低库存集合按本进程连接重新读取并向本进程的监听器发布穿越事件。
+// 其他模块仍使用本进程的数据库连接读取（报表、促销规则等），WAL模式下不与服务的写入冲突。
+// 套接字文件只允许服务的用户连接，服务端还按对端凭据拒绝其他用户的进程
+
+struct DaemonOptions
+{
+    std::string socket_path = "sales.db.sock";
+    int commit_delay_us = 0;    // 组提交前等待更多结账的时间，0表示只合并已在排队的结账
+    int max_batch = 64;         // 每个组提交最多包含的结账笔数
+    int max_clients = 64;       // 同时连接的终端数上限
+};
+
+// 服务统计，服务端累计
+struct DaemonStats
+{
+    long long connections = 0;          // 累计接受的连接
+    long long active_connections = 0;   // 当前连接数
+    long long requests = 0;             // 已处理的请求
+    long long checkouts = 0;            // 经组提交保存的结账请求（含被拒绝的）
+    long long batches = 0;              // 组提交次数
+    long long max_batch = 0;            // 最大批次笔数
+    long long batch_failures = 0;       // 整批写入失败的次数
+};
+
+// 在当前线程运行服务，直到stop_sales_daemon；在当前线程init_db成功后调用，各终端连接使用同一数据库文件。
+// 套接字已被其他服务占用或无法创建时返回false
+bool run_sales_daemon(const DaemonOptions& options, std::string* errorMsg = nullptr);
+// 请求服务退出，可在信号处理函数中调用
+void stop_sales_daemon();
+DaemonStats get_daemon_stats();
+
+// 终端：连接收银服务并确认协议版本，成功后本进程所有线程调用database.h中的函数都经由服务执行，
+// 每个线程使用自己的连接。服务重启后下一次调用自动重新连接；写操作的连接在发送后中断时不重发，返回失败
+bool connect_sales_daemon(const std::string& socket_path, std::string* errorMsg = nullptr);
+// 恢复使用本进程的数据库连接，关闭当前线程的服务连接，其他线程的连接在线程结束时关闭
+void disconnect_sales_daemon();
+bool sales_daemon_connected();
+// 从终端读取服务统计
+bool query_daemon_stats(DaemonStats& stats, std::string* errorMsg = nullptr);
+
+#endif // DAEMON_H
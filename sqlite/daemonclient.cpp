@@ -0,0 +1,476 @@
+#include "daemon.h"
+#include "ipc.h"
+#include "log.h"
+#include "remote.h"
+#include <atomic>
+#include <mutex>
+
+namespace
+{
+    std::atomic<bool> g_connected{false};
+    std::mutex g_pathMutex;
+    std::string g_path;
+    // 每次connect_sales_daemon加一，线程发现与自己的连接不一致时重新连接
+    std::atomic<unsigned> g_generation{0};
+
+    // 当前线程到服务的连接，线程结束时关闭
+    struct ClientConnection
+    {
+        LocalSocket socket = kInvalidSocket;
+        unsigned generation = 0;
+        WireWriter request;
+        std::string response;
+
+        ~ClientConnection() { close_local_socket(socket); }
+
+        void reset()
+        {
+            close_local_socket(socket);
+            socket = kInvalidSocket;
+        }
+    };
+
+    thread_local ClientConnection t_connection;
+
+    constexpr bool kRead = true;    // 连接中断时可以重发
+    constexpr bool kWrite = false;
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+
+    std::string daemon_path()
+    {
+        std::lock_guard<std::mutex> lock(g_pathMutex);
+        return g_path;
+    }
+
+    // 连接并确认协议版本
+    LocalSocket open_connection(const std::string& path, std::string* errorMsg)
+    {
+        const LocalSocket socket = connect_local_socket(path, errorMsg);
+        if (socket == kInvalidSocket)
+            return kInvalidSocket;
+        WireWriter hello;
+        hello.u8(static_cast<std::uint8_t>(DaemonOp::Hello));
+        hello.u32(kDaemonMagic);
+        hello.u16(kDaemonProtocolVersion);
+        std::string reply;
+        if (!send_frame(socket, hello.data()) || !recv_frame(socket, reply))
+        {
+            if (errorMsg) *errorMsg = "收银服务 " + path + " 握手失败，可能是协议版本不一致";
+            close_local_socket(socket);
+            return kInvalidSocket;
+        }
+        WireReader in(reply);
+        const std::uint16_t version = in.u16();
+        if (!in.done() || version != kDaemonProtocolVersion)
+        {
+            if (errorMsg) *errorMsg = "收银服务协议版本 " + std::to_string(version) + " 与终端不一致";
+            close_local_socket(socket);
+            return kInvalidSocket;
+        }
+        return socket;
+    }
+
+    // 开始一个请求，返回当前线程复用的请求缓冲
+    WireWriter& begin(const DaemonOp op)
+    {
+        WireWriter& request = t_connection.request;
+        request.clear();
+        request.u8(static_cast<std::uint8_t>(op));
+        return request;
+    }
+
+    // 发送请求并把应答交给decode解析。只读请求在连接中断时重新连接重发一次；
+    // 写请求只在发送前发现连接已失效时重新连接，发送后中断时结果未知，不重发
+    template <typename Decode>
+    bool exchange(const char* name, const bool idempotent, Decode decode)
+    {
+        ClientConnection& conn = t_connection;
+        const unsigned generation = g_generation.load();
+        if (conn.socket != kInvalidSocket && (conn.generation != generation || local_peer_closed(conn.socket)))
+            conn.reset();
+
+        for (int attempt = 0; attempt < 2; ++attempt)
+        {
+            if (conn.socket == kInvalidSocket)
+            {
+                std::string err;
+                conn.socket = open_connection(daemon_path(), &err);
+                conn.generation = generation;
+                if (conn.socket == kInvalidSocket)
+                {
+                    SLOG_ERROR("%s失败: %s", name, err.c_str());
+                    return false;
+                }
+            }
+            if (send_frame(conn.socket, conn.request.data()) && recv_frame(conn.socket, conn.response))
+            {
+                WireReader reply(conn.response);
+                decode(reply);
+                if (reply.done())
+                    return true;
+                SLOG_ERROR("%s失败: 收银服务的应答无法解析", name);
+                conn.reset();
+                return false;
+            }
+            conn.reset();
+            if (!idempotent)
+                break;
+        }
+        SLOG_ERROR("%s失败: 与收银服务的连接中断", name);
+        return false;
+    }
+
+    // 返回bool和错误信息的写操作
+    bool exchange_status(const char* name, std::string* errorMsg)
+    {
+        bool ok = false;
+        std::string err;
+        if (!exchange(name, kWrite, [&](WireReader& reply) { ok = reply.boolean(); err = reply.str(); }))
+        {
+            if (errorMsg) *errorMsg = "与收银服务的连接中断，操作结果未知";
+            return false;
+        }
+        if (!ok && errorMsg) *errorMsg = err;
+        return ok;
+    }
+
+    bool exchange_bool(const char* name)
+    {
+        bool ok = false;
+        return exchange(name, kWrite, [&](WireReader& reply) { ok = reply.boolean(); }) && ok;
+    }
+
+    int exchange_int(const char* name, const bool idempotent, const int failed)
+    {
+        int value = failed;
+        if (!exchange(name, idempotent, [&](WireReader& reply) { value = reply.i32(); }))
+            return failed;
+        return value;
+    }
+
+    Product exchange_product(const char* name)
+    {
+        Product product{};
+        product.id = -1;
+        if (!exchange(name, kRead, [&](WireReader& reply) { read_wire(reply, product); }))
+        {
+            product = Product{};
+            product.id = -1;
+        }
+        return product;
+    }
+
+    template <typename T>
+    std::vector<T> exchange_list(const char* name)
+    {
+        std::vector<T> items;
+        if (!exchange(name, kRead, [&](WireReader& reply) { read_wire(reply, items); }))
+            items.clear();
+        return items;
+    }
+}
+
+bool connect_sales_daemon(const std::string& socket_path, std::string* errorMsg)
+{
+    std::string err;
+    const LocalSocket socket = open_connection(socket_path, &err);
+    if (socket == kInvalidSocket)
+    {
+        fail(errorMsg, err);
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_pathMutex);
+        g_path = socket_path;
+    }
+    // 握手用的连接直接留给当前线程
+    t_connection.reset();
+    t_connection.socket = socket;
+    t_connection.generation = g_generation.fetch_add(1) + 1;
+    g_connected.store(true);
+    SLOG_INFO("已连接收银服务 %s", socket_path.c_str());
+    return true;
+}
+
+void disconnect_sales_daemon()
+{
+    g_connected.store(false);
+    g_generation.fetch_add(1);
+    t_connection.reset();
+}
+
+bool sales_daemon_connected()
+{
+    return g_connected.load(std::memory_order_relaxed);
+}
+
+bool query_daemon_stats(DaemonStats& stats, std::string* errorMsg)
+{
+    if (!sales_daemon_connected())
+    {
+        fail(errorMsg, "未连接收银服务");
+        return false;
+    }
+    begin(DaemonOp::Stats);
+    if (!exchange("query_daemon_stats", kRead, [&](WireReader& reply) { read_wire(reply, stats); }))
+    {
+        if (errorMsg) *errorMsg = "读取收银服务统计失败";
+        return false;
+    }
+    return true;
+}
+
+namespace remote
+{
+    int getIdFromName(const std::string& name)
+    {
+        begin(DaemonOp::GetIdFromName).str(name);
+        return exchange_int("getIdFromName", kRead, -1);
+    }
+
+    bool add_product(const std::string& name, const double price, const int stock, const int alert_threshold)
+    {
+        WireWriter& request = begin(DaemonOp::AddProduct);
+        request.str(name);
+        request.f64(price);
+        request.i32(stock);
+        request.i32(alert_threshold);
+        return exchange_bool("add_product");
+    }
+
+    Product query_product(const int id)
+    {
+        begin(DaemonOp::QueryProductById).i32(id);
+        return exchange_product("query_product");
+    }
+
+    Product query_product(const std::string& name)
+    {
+        begin(DaemonOp::QueryProductByName).str(name);
+        return exchange_product("query_product");
+    }
+
+    bool update_stock(const int id, const int new_stock)
+    {
+        WireWriter& request = begin(DaemonOp::UpdateStockById);
+        request.i32(id);
+        request.i32(new_stock);
+        return exchange_bool("update_stock");
+    }
+
+    int update_stock(const std::string& name, const int new_stock)
+    {
+        WireWriter& request = begin(DaemonOp::UpdateStockByName);
+        request.str(name);
+        request.i32(new_stock);
+        return exchange_int("update_stock", kWrite, 0);
+    }
+
+    std::vector<Product> get_all_products()
+    {
+        begin(DaemonOp::GetAllProducts);
+        return exchange_list<Product>("get_all_products");
+    }
+
+    bool save_transaction(const Transaction& transaction, std::vector<StockConflict>* conflicts)
+    {
+        write_wire(begin(DaemonOp::SaveTransaction), transaction);
+        bool ok = false;
+        std::vector<StockConflict> found;
+        if (!exchange("save_transaction", kWrite, [&](WireReader& reply)
+            {
+                ok = reply.boolean();
+                read_wire(reply, found);
+            }))
+        {
+            ok = false;
+            found.clear();
+        }
+        if (conflicts) *conflicts = found;
+        return ok;
+    }
+
+    std::vector<Transaction> get_all_transactions()
+    {
+        begin(DaemonOp::GetAllTransactions);
+        return exchange_list<Transaction>("get_all_transactions");
+    }
+
+    std::vector<CartItem> get_cart_items_by_transaction_id(const int transaction_id)
+    {
+        begin(DaemonOp::GetCartItems).i32(transaction_id);
+        return exchange_list<CartItem>("get_cart_items_by_transaction_id");
+    }
+
+    TransactionDetail get_transaction_detail(const int transaction_id)
+    {
+        begin(DaemonOp::GetTransactionDetail).i32(transaction_id);
+        TransactionDetail detail{};
+        if (!exchange("get_transaction_detail", kRead, [&](WireReader& reply) { read_wire(reply, detail); }))
+        {
+            detail = TransactionDetail{};
+            detail.transaction.transaction_id = -1;
+        }
+        return detail;
+    }
+
+    std::vector<Product> get_low_stock_products()
+    {
+        begin(DaemonOp::GetLowStockProducts);
+        return exchange_list<Product>("get_low_stock_products");
+    }
+
+    bool delete_product(const int id)
+    {
+        begin(DaemonOp::DeleteProductById).i32(id);
+        return exchange_bool("delete_product");
+    }
+
+    bool delete_product(const std::string& name)
+    {
+        begin(DaemonOp::DeleteProductByName).str(name);
+        return exchange_bool("delete_product");
+    }
+
+    bool update_product(const int id, const std::string& name, const double price, const int stock,
+                        const int alert_threshold, std::string* errorMsg)
+    {
+        WireWriter& request = begin(DaemonOp::UpdateProductById);
+        request.i32(id);
+        request.str(name);
+        request.f64(price);
+        request.i32(stock);
+        request.i32(alert_threshold);
+        return exchange_status("update_product", errorMsg);
+    }
+
+    bool update_product(const std::string& old_name, const std::string& new_name, const double price, const int stock,
+                        const int alert_threshold, std::string* errorMsg)
+    {
+        WireWriter& request = begin(DaemonOp::UpdateProductByName);
+        request.str(old_name);
+        request.str(new_name);
+        request.f64(price);
+        request.i32(stock);
+        request.i32(alert_threshold);
+        return exchange_status("update_product", errorMsg);
+    }
+
+    bool set_product_alert_threshold(const int id, const int threshold)
+    {
+        WireWriter& request = begin(DaemonOp::SetAlertThresholdById);
+        request.i32(id);
+        request.i32(threshold);
+        return exchange_bool("set_product_alert_threshold");
+    }
+
+    bool set_product_alert_threshold(const std::string& name, const int threshold)
+    {
+        WireWriter& request = begin(DaemonOp::SetAlertThresholdByName);
+        request.str(name);
+        request.i32(threshold);
+        return exchange_bool("set_product_alert_threshold");
+    }
+
+    int get_product_alert_threshold(const int id)
+    {
+        begin(DaemonOp::GetAlertThresholdById).i32(id);
+        return exchange_int("get_product_alert_threshold", kRead, -1);
+    }
+
+    int get_product_alert_threshold(const std::string& name)
+    {
+        begin(DaemonOp::GetAlertThresholdByName).str(name);
+        return exchange_int("get_product_alert_threshold", kRead, -1);
+    }
+
+    bool set_product_barcode(const int id, const std::string& barcode, std::string* errorMsg)
+    {
+        WireWriter& request = begin(DaemonOp::SetProductBarcode);
+        request.i32(id);
+        request.str(barcode);
+        return exchange_status("set_product_barcode", errorMsg);
+    }
+
+    bool add_product(const std::string& name, const double price, const int stock, const int alert_threshold,
+                     const std::string& barcode, std::string* errorMsg)
+    {
+        WireWriter& request = begin(DaemonOp::AddProductWithBarcode);
+        request.str(name);
+        request.f64(price);
+        request.i32(stock);
+        request.i32(alert_threshold);
+        request.str(barcode);
+        return exchange_status("add_product", errorMsg);
+    }
+
+    Product query_product_by_barcode(const std::string& barcode)
+    {
+        begin(DaemonOp::QueryProductByBarcode).str(barcode);
+        return exchange_product("query_product_by_barcode");
+    }
+
+    bool restock_products(const std::vector<RestockLine>& lines, std::vector<Product>* updated, std::string* errorMsg)
+    {
+        WireWriter& request = begin(DaemonOp::RestockProducts);
+        write_wire(request, lines);
+        request.boolean(updated != nullptr);
+        bool ok = false;
+        std::string err;
+        std::vector<Product> products;
+        if (!exchange("restock_products", kWrite, [&](WireReader& reply)
+            {
+                ok = reply.boolean();
+                err = reply.str();
+                read_wire(reply, products);
+            }))
+        {
+            if (errorMsg) *errorMsg = "与收银服务的连接中断，操作结果未知";
+            return false;
+        }
+        if (!ok && errorMsg) *errorMsg = err;
+        if (ok && updated) *updated = std::move(products);
+        return ok;
+    }
+
+    bool add_return(const int transaction_id, const int product_id, const int quantity, const std::string& reason)
+    {
+        WireWriter& request = begin(DaemonOp::AddReturn);
+        request.i32(transaction_id);
+        request.i32(product_id);
+        request.i32(quantity);
+        request.str(reason);
+        return exchange_bool("add_return");
+    }
+
+    bool add_return_slip(const int transaction_id, const std::vector<ReturnLine>& lines, std::string* errorMsg)
+    {
+        WireWriter& request = begin(DaemonOp::AddReturnSlip);
+        request.i32(transaction_id);
+        write_wire(request, lines);
+        return exchange_status("add_return_slip", errorMsg);
+    }
+
+    std::vector<ReturnItem> get_all_returns()
+    {
+        begin(DaemonOp::GetAllReturns);
+        return exchange_list<ReturnItem>("get_all_returns");
+    }
+
+    std::vector<ReturnItem> get_returns_by_transaction_id(const int transaction_id)
+    {
+        begin(DaemonOp::GetReturnsByTransaction).i32(transaction_id);
+        return exchange_list<ReturnItem>("get_returns_by_transaction_id");
+    }
+
+    std::vector<ReturnItem> get_returns_by_product_id(const int product_id)
+    {
+        begin(DaemonOp::GetReturnsByProduct).i32(product_id);
+        return exchange_list<ReturnItem>("get_returns_by_product_id");
+    }
+}
@@ -1,37 +1,77 @@
 #include "database.h"
+#include "daemon.h"
+#include "db_internal.h"
+#include "detailcache.h"
+#include "lowstock.h"
+#include "log.h"
+#include "remote.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
 #include <cstdio>
 #include <ctime>
+#include <fstream>
+#include <map>
+#include <random>
 #include <sqlite3.h>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 
 
-sqlite3* db;
-char* err_msg;
-sqlite3_stmt* stmt_ap;
+// 每个线程持有自己的连接：SQLite按多线程模式编译（不带连接级互斥），同一连接不能被多个线程同时使用。
+// 只在界面线程init_db的程序行为与单一全局连接相同；后台线程、异步查询线程和压测终端各自init_db
+thread_local sqlite3* db;
+thread_local char* err_msg;
+thread_local sqlite3_stmt* stmt_ap;
 
-bool init_db()
+// 为按交易查询明细和退货建立索引，避免全表扫描
+static const char* sql_create_indexes =
+    "CREATE INDEX IF NOT EXISTS idx_cart_items_transaction ON cart_items(transaction_id);"
+    "CREATE INDEX IF NOT EXISTS idx_returns_transaction_product ON returns(transaction_id, product_id);"
+    // 报表、导出和归档都按交易时间区间查询
+    "CREATE INDEX IF NOT EXISTS idx_transactions_create_time ON transactions(create_time);"
+    // 只收录低库存行的覆盖部分索引，低库存冷启动无需扫描整个商品表
+    "CREATE INDEX IF NOT EXISTS idx_products_low_stock ON products(stock, alert_threshold, name) "
+    "WHERE stock <= alert_threshold;"
+    // 条码唯一，没有条码的商品不占索引；这是约束而不只是加速，批量导入时不删除
+    "CREATE UNIQUE INDEX IF NOT EXISTS idx_products_barcode ON products(barcode) WHERE barcode IS NOT NULL;";
+
+// 批量导入期间删除二级索引，导入结束后一次性重建，比逐行维护快得多
+static const char* sql_drop_indexes =
+    "DROP INDEX IF EXISTS idx_cart_items_transaction;"
+    "DROP INDEX IF EXISTS idx_returns_transaction_product;"
+    "DROP INDEX IF EXISTS idx_transactions_create_time;"
+    "DROP INDEX IF EXISTS idx_products_low_stock;";
+
+namespace
 {
-    int rc = sqlite3_open("sales.db", &db);
-    if (rc != SQLITE_OK)
-    {
-        fprintf(stderr, "Cannot open database: %s\n", sqlite3_errmsg(db));
-        return false;
-    }
-    rc = sqlite3_exec(db, "PRAGMA foreign_keys = ON;", 0, 0, &err_msg);
-    if (rc != SQLITE_OK)
-    {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        return false;
-    }
-    const char* sql_create_products =
+    std::atomic<unsigned long long> g_busyRetries{0};
+    std::atomic<unsigned long long> g_busyFailures{0};
+    std::atomic<unsigned long long> g_lockWaits{0};
+    std::atomic<unsigned long long> g_lockWaitMicros{0};
+
+    // busy_timeout的等待至少睡眠1毫秒，无冲突时BEGIN IMMEDIATE只需几微秒，超过该值即视为等过写锁
+    constexpr auto kLockWaitThreshold = std::chrono::milliseconds(1);
+}
+
+namespace
+{
+    // 表结构版本，记录在PRAGMA user_version中；修改建表语句或索引时加一，
+    // 已是当前版本的数据库启动时跳过全部建表语句
+    constexpr int kSchemaVersion = 9;
+
+    // 建表语句，按依赖顺序执行
+    const char* const sql_create_tables[] = {
         "CREATE TABLE IF NOT EXISTS products ("
         "id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "name TEXT NOT NULL,"
         "price REAL NOT NULL,"
         "stock INTEGER NOT NULL,"
-        "alert_threshold INTEGER DEFAULT 10 NOT NULL"
-        ");";
-    const char* sql_create_transactions =
+        "alert_threshold INTEGER DEFAULT 10 NOT NULL,"
+        "barcode TEXT"
+        ");",
         "CREATE TABLE IF NOT EXISTS transactions ("
         "transaction_id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "create_time INTEGER NOT NULL,"
@@ -39,8 +79,8 @@ bool init_db()
         "total_price REAL NOT NULL,"
         "amount_paid REAL NOT NULL,"
         "change REAL NOT NULL"
-        ");";
-    const char* sql_create_cart_items =
+        ");",
+        // discount为该行的促销折扣金额（已从subtotal中扣除），promotion_id为所取的促销；早期版本的表由migrate_schema补列
         "CREATE TABLE IF NOT EXISTS cart_items ("
         "item_id INTEGER PRIMARY KEY AUTOINCREMENT,"
         "transaction_id INTEGER NOT NULL,"
@@ -48,67 +88,478 @@ bool init_db()
         "quantity INTEGER NOT NULL CHECK(quantity > 0),"
         "returned_quantity INTEGER NOT NULL DEFAULT 0 CHECK(returned_quantity >= 0),"
         "subtotal REAL NOT NULL,"
+        "discount REAL NOT NULL DEFAULT 0,"
+        "promotion_id INTEGER,"
         "FOREIGN KEY(transaction_id) REFERENCES transactions(transaction_id),"
         "FOREIGN KEY(product_id) REFERENCES products(id)"
-        ");";
-    rc = sqlite3_exec(db, sql_create_products, nullptr, nullptr, &err_msg);
+        ");",
+        // 促销：promotion_items列出参与的商品，bundle种类的quantity为组合中该商品的数量
+        "CREATE TABLE IF NOT EXISTS promotions ("
+        "promotion_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "name TEXT NOT NULL,"
+        "kind TEXT NOT NULL CHECK(kind IN ('multibuy','bundle','percent')),"
+        "quantity INTEGER NOT NULL DEFAULT 0,"
+        "price REAL NOT NULL DEFAULT 0,"
+        "percent REAL NOT NULL DEFAULT 0,"
+        "start_time INTEGER NOT NULL DEFAULT 0,"
+        "end_time INTEGER NOT NULL DEFAULT 0,"
+        "day_start_minute INTEGER NOT NULL DEFAULT 0,"
+        "day_end_minute INTEGER NOT NULL DEFAULT 0,"
+        "active INTEGER NOT NULL DEFAULT 1 CHECK(active IN (0,1))"
+        ");",
+        "CREATE TABLE IF NOT EXISTS promotion_items ("
+        "promotion_id INTEGER NOT NULL REFERENCES promotions(promotion_id) ON DELETE CASCADE,"
+        "product_id INTEGER NOT NULL,"
+        "quantity INTEGER NOT NULL DEFAULT 1 CHECK(quantity > 0),"
+        "PRIMARY KEY(promotion_id, product_id)"
+        ") WITHOUT ROWID;",
+        // 促销版本：促销或其商品有任何修改时加一，终端据此判断编译好的规则是否过期
+        "CREATE TABLE IF NOT EXISTS promotion_state ("
+        "id INTEGER PRIMARY KEY CHECK(id = 1),"
+        "version INTEGER NOT NULL"
+        ");",
+        "INSERT OR IGNORE INTO promotion_state (id, version) VALUES (1, 0);",
+        "CREATE TRIGGER IF NOT EXISTS trg_promotions_insert AFTER INSERT ON promotions "
+        "BEGIN UPDATE promotion_state SET version = version + 1 WHERE id = 1; END;",
+        "CREATE TRIGGER IF NOT EXISTS trg_promotions_update AFTER UPDATE ON promotions "
+        "BEGIN UPDATE promotion_state SET version = version + 1 WHERE id = 1; END;",
+        "CREATE TRIGGER IF NOT EXISTS trg_promotions_delete AFTER DELETE ON promotions "
+        "BEGIN UPDATE promotion_state SET version = version + 1 WHERE id = 1; END;",
+        "CREATE TRIGGER IF NOT EXISTS trg_promotion_items_insert AFTER INSERT ON promotion_items "
+        "BEGIN UPDATE promotion_state SET version = version + 1 WHERE id = 1; END;",
+        "CREATE TRIGGER IF NOT EXISTS trg_promotion_items_delete AFTER DELETE ON promotion_items "
+        "BEGIN UPDATE promotion_state SET version = version + 1 WHERE id = 1; END;",
+        // 退货表；amount为该行的退货金额，按原购物车行的实付单价分摊，早期版本的记录为NULL
+        "CREATE TABLE IF NOT EXISTS returns ("
+        "return_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "transaction_id INTEGER NOT NULL,"
+        "product_id INTEGER NOT NULL,"
+        "quantity INTEGER NOT NULL CHECK(quantity > 0),"
+        "reason TEXT,"
+        "return_time INTEGER NOT NULL,"
+        "amount REAL,"
+        "FOREIGN KEY(transaction_id) REFERENCES transactions(transaction_id),"
+        "FOREIGN KEY(product_id) REFERENCES products(id)"
+        ");",
+        // 商品目录版本，供目录快照判断是否过期：新增、删除商品或修改名称、单价、预警阈值时加一，
+        // 库存变化不计入；token建库时随机生成，区分不同的数据库文件
+        "CREATE TABLE IF NOT EXISTS catalog_state ("
+        "id INTEGER PRIMARY KEY CHECK(id = 1),"
+        "token INTEGER NOT NULL,"
+        "version INTEGER NOT NULL"
+        ");",
+        "INSERT OR IGNORE INTO catalog_state (id, token, version) VALUES (1, random(), 0);",
+        "CREATE TRIGGER IF NOT EXISTS trg_products_catalog_insert AFTER INSERT ON products "
+        "BEGIN UPDATE catalog_state SET version = version + 1 WHERE id = 1; END;",
+        "CREATE TRIGGER IF NOT EXISTS trg_products_catalog_delete AFTER DELETE ON products "
+        "BEGIN UPDATE catalog_state SET version = version + 1 WHERE id = 1; END;",
+        // 条码也在目录快照中，早期版本的触发器不含条码列，先删除再建
+        "DROP TRIGGER IF EXISTS trg_products_catalog_update;",
+        "CREATE TRIGGER IF NOT EXISTS trg_products_catalog_update AFTER UPDATE OF name, price, alert_threshold, barcode ON products "
+        "BEGIN UPDATE catalog_state SET version = version + 1 WHERE id = 1; END;",
+        // 事件溯源日志：按发生顺序记录销售、退货、进货和商品修改，payload为JSON
+        "CREATE TABLE IF NOT EXISTS sales_journal ("
+        "event_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "event_time INTEGER NOT NULL,"
+        "kind TEXT NOT NULL CHECK(kind IN ('sale','return','restock','product')),"
+        "ref_id INTEGER NOT NULL,"
+        "payload TEXT NOT NULL"
+        ");",
+        // 事件溯源模式开关与投影位置，所有终端共用
+        "CREATE TABLE IF NOT EXISTS journal_state ("
+        "id INTEGER PRIMARY KEY CHECK(id = 1),"
+        "enabled INTEGER NOT NULL DEFAULT 0,"
+        "projected_event_id INTEGER NOT NULL DEFAULT 0"
+        ");",
+        "INSERT OR IGNORE INTO journal_state (id) VALUES (1);",
+        // 尚未投影的销售占用的库存，结账追加事件时累加，投影时扣回
+        "CREATE TABLE IF NOT EXISTS journal_reserved_stock ("
+        "product_id INTEGER PRIMARY KEY,"
+        "quantity INTEGER NOT NULL"
+        ");",
+        // 重放起点：投影到event_id时的商品表、各明细表最大ID和非零的已退货数量
+        "CREATE TABLE IF NOT EXISTS journal_snapshots ("
+        "event_id INTEGER PRIMARY KEY,"
+        "created_at INTEGER NOT NULL,"
+        "max_transaction_id INTEGER NOT NULL,"
+        "max_item_id INTEGER NOT NULL,"
+        "max_return_id INTEGER NOT NULL,"
+        "products TEXT NOT NULL,"
+        "returned_items TEXT NOT NULL"
+        ");",
+        // 门店复制：每个写事务的变更集，总部确认后删除
+        "CREATE TABLE IF NOT EXISTS replication_outbox ("
+        "batch_id INTEGER PRIMARY KEY AUTOINCREMENT,"
+        "created_at INTEGER NOT NULL,"
+        "data BLOB NOT NULL"
+        ");",
+        "CREATE TABLE IF NOT EXISTS replication_state ("
+        "id INTEGER PRIMARY KEY CHECK(id = 1),"
+        "enabled INTEGER NOT NULL DEFAULT 0,"
+        "store_id TEXT NOT NULL DEFAULT '',"
+        "shipped_batch_id INTEGER NOT NULL DEFAULT 0"
+        ");",
+        "INSERT OR IGNORE INTO replication_state (id) VALUES (1);",
+        // 后台维护：每项任务最近一次的执行结果，所有终端共用
+        "CREATE TABLE IF NOT EXISTS maintenance_runs ("
+        "job TEXT PRIMARY KEY,"
+        "run_at INTEGER NOT NULL,"
+        "seconds REAL NOT NULL,"
+        "ok INTEGER NOT NULL,"
+        "over_budget INTEGER NOT NULL,"
+        "detail TEXT NOT NULL"
+        ");",
+    };
+
+    int read_schema_version()
+    {
+        int version = 0;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            version = sqlite3_column_int(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+        return version;
+    }
+
+    bool has_column(const char* table, const char* column)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        bool found = false;
+        if (sqlite3_prepare_v2(db, "SELECT 1 FROM pragma_table_info(?) WHERE name = ?;", -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, column, -1, SQLITE_STATIC);
+            found = sqlite3_step(stmt) == SQLITE_ROW;
+        }
+        sqlite3_finalize(stmt);
+        return found;
+    }
+
+    // 在一个写事务中建表、补列、建索引并写入版本号；多个终端同时启动时只有一个执行，
+    // 其余在事务内看到已是当前版本后直接提交
+    bool migrate_schema()
+    {
+        int rc = sqlite3_exec(db, "BEGIN IMMEDIATE;", nullptr, nullptr, &err_msg);
+        if (rc == SQLITE_OK && read_schema_version() != kSchemaVersion)
+        {
+            for (const char* sql : sql_create_tables)
+            {
+                rc = sqlite3_exec(db, sql, nullptr, nullptr, &err_msg);
+                if (rc != SQLITE_OK)
+                    break;
+            }
+            // 早期版本的cart_items没有returned_quantity列；SQLite不支持ADD COLUMN IF NOT EXISTS，先查表结构
+            if (rc == SQLITE_OK && !has_column("cart_items", "returned_quantity"))
+            {
+                rc = sqlite3_exec(db, "ALTER TABLE cart_items ADD COLUMN returned_quantity INTEGER NOT NULL DEFAULT 0;",
+                                  nullptr, nullptr, &err_msg);
+            }
+            if (rc == SQLITE_OK && !has_column("products", "barcode"))
+                rc = sqlite3_exec(db, "ALTER TABLE products ADD COLUMN barcode TEXT;", nullptr, nullptr, &err_msg);
+            if (rc == SQLITE_OK && !has_column("cart_items", "discount"))
+            {
+                rc = sqlite3_exec(db, "ALTER TABLE cart_items ADD COLUMN discount REAL NOT NULL DEFAULT 0;"
+                                  "ALTER TABLE cart_items ADD COLUMN promotion_id INTEGER;", nullptr, nullptr, &err_msg);
+            }
+            if (rc == SQLITE_OK && !has_column("returns", "amount"))
+                rc = sqlite3_exec(db, "ALTER TABLE returns ADD COLUMN amount REAL;", nullptr, nullptr, &err_msg);
+            if (rc == SQLITE_OK)
+                rc = sqlite3_exec(db, sql_create_indexes, nullptr, nullptr, &err_msg);
+            if (rc == SQLITE_OK)
+            {
+                const std::string sql = "PRAGMA user_version = " + std::to_string(kSchemaVersion) + ";";
+                rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err_msg);
+            }
+            if (rc == SQLITE_OK)
+                SLOG_INFO("数据库表结构已升级到版本 %d", kSchemaVersion);
+        }
+        if (rc == SQLITE_OK)
+            rc = sqlite3_exec(db, "COMMIT;", nullptr, nullptr, &err_msg);
+        if (rc != SQLITE_OK)
+        {
+            SLOG_ERROR("SQL error: %s", err_msg);
+            sqlite3_free(err_msg);
+            sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        return true;
+    }
+}
+
+bool init_db(const std::string& path)
+{
+    close_db();
+    int rc = sqlite3_open(path.c_str(), &db);
     if (rc != SQLITE_OK)
     {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
-        sqlite3_free(err_msg);
+        SLOG_ERROR("Cannot open database: %s", sqlite3_errmsg(db));
         return false;
     }
-    rc = sqlite3_exec(db, sql_create_transactions, nullptr, nullptr, &err_msg);
+    rc = sqlite3_exec(db, "PRAGMA foreign_keys = ON;", 0, 0, &err_msg);
     if (rc != SQLITE_OK)
     {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
+        SLOG_ERROR("SQL error: %s", err_msg);
         sqlite3_free(err_msg);
         return false;
     }
-    rc = sqlite3_exec(db, sql_create_cart_items, nullptr, nullptr, &err_msg);
+
+    // 多个收银终端共享同一数据库：WAL模式下读不阻塞写，锁等待交给busy_timeout，
+    // 超时后由run_write_transaction做有界重试
+    sqlite3_busy_timeout(db, 2000);
+    install_query_tracing(db);
+    // 新建的库在写入第一页（切换WAL也会写入）之前设为增量自动清理，删除数据后的空闲页由后台维护分批归还；
+    // 已有的库上这条语句不生效
+    sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL;", nullptr, nullptr, nullptr);
+    rc = sqlite3_exec(db, "PRAGMA journal_mode = WAL;", nullptr, nullptr, &err_msg);
     if (rc != SQLITE_OK)
     {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
+        SLOG_WARN("切换WAL模式失败: %s", err_msg);
         sqlite3_free(err_msg);
+        // 继续使用默认日志模式
+    }
+
+    // 表结构已是当前版本时不执行任何DDL，启动只需读一次文件头
+    if (read_schema_version() != kSchemaVersion && !migrate_schema())
         return false;
+
+    // 事件溯源模式下记录商品表修改的临时触发器，每个连接各自创建
+    install_journal_capture();
+    // 开启门店复制时，不在写事务中的单条修改也由会话记录
+    ensure_replication_capture();
+
+    // 建立低库存集合（本进程只建立一次），之后由各写操作增量维护
+    ensure_low_stock_set();
+    return true;
+}
+
+namespace
+{
+    std::unordered_map<std::string, sqlite3_stmt*>& statement_cache()
+    {
+        thread_local std::unordered_map<std::string, sqlite3_stmt*> cache;
+        return cache;
     }
-    
-    // 为现有数据库添加returned_quantity列
-    const char* sql_alter_cart_items = 
-        "ALTER TABLE cart_items ADD COLUMN IF NOT EXISTS returned_quantity INTEGER NOT NULL DEFAULT 0;";
-    rc = sqlite3_exec(db, sql_alter_cart_items, nullptr, nullptr, &err_msg);
+}
+
+CachedStatement::CachedStatement(const char* sql)
+    : m_stmt(nullptr)
+{
+    sqlite3_stmt*& slot = statement_cache()[sql];
+    if (!slot && sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &slot, nullptr) != SQLITE_OK)
+    {
+        SLOG_ERROR("编译SQL语句失败: %s", sqlite3_errmsg(db));
+        sqlite3_finalize(slot);
+        slot = nullptr;
+    }
+    m_stmt = slot;
+}
+
+CachedStatement::~CachedStatement()
+{
+    if (m_stmt)
+    {
+        sqlite3_reset(m_stmt);
+        sqlite3_clear_bindings(m_stmt);
+    }
+}
+
+void finalize_cached_statements()
+{
+    for (auto& [sql, stmt] : statement_cache())
+        sqlite3_finalize(stmt);
+    statement_cache().clear();
+}
+
+WriteStatus write_status_of(const int rc)
+{
+    switch (rc & 0xff)
+    {
+    case SQLITE_OK:
+    case SQLITE_ROW:
+    case SQLITE_DONE:
+        return WriteStatus::Ok;
+    case SQLITE_BUSY:
+    case SQLITE_LOCKED:
+        return WriteStatus::Busy;
+    default:
+        return WriteStatus::Failed;
+    }
+}
+
+bool run_write_transaction(const char* operation, const std::function<WriteStatus()>& body)
+{
+    constexpr int kMaxAttempts = 5;
+    thread_local std::minstd_rand jitter(std::random_device{}());
+
+    for (int attempt = 1; attempt <= kMaxAttempts; ++attempt)
+    {
+        // IMMEDIATE在事务开始时就取得写锁，避免读锁升级写锁时的死锁
+        const auto begin_start = std::chrono::steady_clock::now();
+        int rc = sqlite3_exec(db, "BEGIN IMMEDIATE TRANSACTION;", nullptr, nullptr, nullptr);
+        const auto waited = std::chrono::steady_clock::now() - begin_start;
+        if (waited >= kLockWaitThreshold)
+        {
+            g_lockWaits.fetch_add(1, std::memory_order_relaxed);
+            g_lockWaitMicros.fetch_add(
+                static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::microseconds>(waited).count()),
+                std::memory_order_relaxed);
+        }
+        WriteStatus status = write_status_of(rc);
+        if (status == WriteStatus::Ok)
+        {
+            // 开启门店复制时，事务内的变更在提交前写入发件箱
+            ensure_replication_capture();
+            status = body();
+            if (status == WriteStatus::Ok)
+                status = stage_replication_changes();
+            if (status == WriteStatus::Ok)
+            {
+                rc = sqlite3_exec(db, "COMMIT TRANSACTION;", nullptr, nullptr, nullptr);
+                status = write_status_of(rc);
+                if (status == WriteStatus::Ok)
+                {
+                    finish_replication_capture(true);
+                    return true;
+                }
+            }
+            sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+            finish_replication_capture(false);
+        }
+
+        if (status != WriteStatus::Busy)
+        {
+            if (rc != SQLITE_OK)
+                SLOG_ERROR("%s失败: %s", operation, sqlite3_errmsg(db));
+            return false;
+        }
+
+        // 指数退避加随机抖动，避免多个终端同时重试
+        const int delay_ms = (10 << attempt) + static_cast<int>(jitter() % 10);
+        g_busyRetries.fetch_add(1, std::memory_order_relaxed);
+        SLOG_WARN("%s遇到数据库锁冲突，第 %d 次重试", operation, attempt);
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    }
+
+    g_busyFailures.fetch_add(1, std::memory_order_relaxed);
+    SLOG_ERROR("%s失败: 数据库持续繁忙，已重试 %d 次", operation, kMaxAttempts);
+    return false;
+}
+
+WriteContention get_write_contention()
+{
+    return {g_busyRetries.load(std::memory_order_relaxed), g_busyFailures.load(std::memory_order_relaxed),
+            g_lockWaits.load(std::memory_order_relaxed), g_lockWaitMicros.load(std::memory_order_relaxed)};
+}
+
+void close_db()
+{
+    if (!db)
+        return;
+    release_replication_capture();
+    finalize_cached_statements();
+    sqlite3_close(db);
+    db = nullptr;
+}
+
+// 进入批量导入前的同步级别，结束时恢复，保留编译期SQLITE_DEFAULT_WAL_SYNCHRONOUS的选择
+static thread_local int bulk_saved_synchronous = -1;
+
+bool begin_bulk_load()
+{
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "PRAGMA synchronous;", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        bulk_saved_synchronous = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    // 外键检查和同步写盘在批量导入时逐行代价最高；foreign_keys只能在事务外切换
+    const char* sql =
+        "PRAGMA foreign_keys = OFF;"
+        "PRAGMA synchronous = OFF;"
+        "PRAGMA temp_store = MEMORY;"
+        "PRAGMA cache_size = -262144;";
+    int rc = sqlite3_exec(db, sql, nullptr, nullptr, &err_msg);
+    // 导入期间清零表结构版本，中途退出时下次启动会重建被删除的索引
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, "PRAGMA user_version = 0;", nullptr, nullptr, &err_msg);
+    if (rc == SQLITE_OK)
+        rc = sqlite3_exec(db, sql_drop_indexes, nullptr, nullptr, &err_msg);
     if (rc != SQLITE_OK)
     {
-        fprintf(stderr, "修改cart_items表失败: %s\n", err_msg);
+        SLOG_ERROR("进入批量导入模式失败: %s", err_msg);
         sqlite3_free(err_msg);
-        // 继续执行，不中断初始化
+        return false;
+    }
+    return true;
+}
+
+bool end_bulk_load()
+{
+    int rc = sqlite3_exec(db, sql_create_indexes, nullptr, nullptr, &err_msg);
+    if (rc == SQLITE_OK)
+    {
+        const std::string sql =
+            "PRAGMA user_version = " + std::to_string(kSchemaVersion) + ";"
+            "PRAGMA synchronous = " + std::to_string(bulk_saved_synchronous >= 0 ? bulk_saved_synchronous : 2) + ";"
+            "PRAGMA foreign_keys = ON;"
+            "PRAGMA cache_size = -2000;"
+            "PRAGMA analysis_limit = 1000;"
+            "ANALYZE;"
+            "PRAGMA wal_checkpoint(TRUNCATE);";
+        rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err_msg);
     }
-    
-    // 创建退货表
-    const char* sql_create_returns =
-        "CREATE TABLE IF NOT EXISTS returns ("
-        "return_id INTEGER PRIMARY KEY AUTOINCREMENT,"
-        "transaction_id INTEGER NOT NULL,"
-        "product_id INTEGER NOT NULL,"
-        "quantity INTEGER NOT NULL CHECK(quantity > 0),"
-        "reason TEXT,"
-        "return_time INTEGER NOT NULL,"
-        "FOREIGN KEY(transaction_id) REFERENCES transactions(transaction_id),"
-        "FOREIGN KEY(product_id) REFERENCES products(id)"
-        ");";
-    rc = sqlite3_exec(db, sql_create_returns, nullptr, nullptr, &err_msg);
     if (rc != SQLITE_OK)
     {
-        fprintf(stderr, "SQL error: %s\n", err_msg);
+        SLOG_ERROR("结束批量导入失败: %s", err_msg);
         sqlite3_free(err_msg);
         return false;
     }
+
+    // 修改temp_store会删除连接上的全部临时表和触发器，重新创建事件日志触发器
+    install_journal_capture();
+
+    // 导入绕过了各写操作的增量维护，派生状态整体重建
+    clear_transaction_detail_cache();
+    reload_low_stock_set();
     return true;
 }
 
+namespace
+{
+    // 经由收银服务的写操作，服务端的增量维护只作用于服务进程。提交成功后在本进程同步派生状态：
+    // 使受影响的交易明细缓存失效，并用本进程的连接重新读取低库存集合（只读低库存的行），
+    // 与旧集合比较后照常向本进程的监听器发布穿越事件
+    template <typename T>
+    T synced_remote_write(const T result, const int transaction_id = 0, const bool details_changed = false)
+    {
+        if (!result)
+            return result;
+        if (details_changed)
+            clear_transaction_detail_cache();
+        else if (transaction_id > 0)
+            invalidate_transaction_detail(transaction_id);
+        reload_low_stock_set();
+        return result;
+    }
+}
+
 int getIdFromName(const std::string& name)
 {
+    if (sales_daemon_connected())
+        return remote::getIdFromName(name);
+    QueryCall call("getIdFromName");
     int id = -1;
+    // 快照可用时走名称哈希索引，否则扫描商品表
+    if (find_catalog_snapshot_id(name, id))
+    {
+        call.rows(id != -1 ? 1 : 0);
+        return id;
+    }
     const std::string sql = "SELECT id FROM products WHERE name = '" + name + "';";
     if (sqlite3_exec(db, sql.c_str(),
                      [](void* data, int argc, char** argv, char** col_name) -> int
@@ -121,16 +572,20 @@ int getIdFromName(const std::string& name)
                          return 0;
                      }, &id, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询商品ID失败: %s\n", err_msg);
+        SLOG_ERROR("查询商品ID失败: %s", err_msg);
         sqlite3_free(err_msg);
         return -1;
     }
 
+    call.rows(id != -1 ? 1 : 0);
     return id;
 }
 
 bool add_product(const std::string& name, const double price, const int stock, int alert_threshold)
 {
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::add_product(name, price, stock, alert_threshold));
+    QueryCall call("add_product");
     // 使用sprintf确保小数点分隔符是点，而非逗号
     char sql_buffer[512];
     snprintf(sql_buffer, sizeof(sql_buffer), 
@@ -140,17 +595,23 @@ bool add_product(const std::string& name, const double price, const int stock, i
     const std::string insert_sql(sql_buffer);
     if (sqlite3_exec(db, insert_sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "插入商品失败: %s\n", err_msg);
+        SLOG_ERROR("插入商品失败: %s", err_msg);
         sqlite3_free(err_msg);
         return false;
     }
-    printf("商品%s添加成功: \n", name.c_str());
+    note_product_stock(static_cast<int>(sqlite3_last_insert_rowid(db)), name, stock, alert_threshold);
+    note_catalog_changed();
+    SLOG_INFO("商品%s添加成功", name.c_str());
     return true;
 }
 
 Product query_product(const int id)
 {
-    Product product = {-1, "", 0.0f, 0};
+    if (sales_daemon_connected())
+        return remote::query_product(id);
+    QueryCall call("query_product");
+    Product product{};
+    product.id = -1;
     const std::string sql = "SELECT * FROM products WHERE id = " + std::to_string(id) + ";";
     if (sqlite3_exec(db, sql.c_str(),
                      [](void* data, int argc, char** argv, char** col_name) -> int
@@ -160,47 +621,101 @@ Product query_product(const int id)
                          product_ptr->name = argv[1];
                          product_ptr->price = std::stof(argv[2]);
                          product_ptr->stock = std::stoi(argv[3]);
+                         product_ptr->barcode = argc > 5 && argv[5] ? argv[5] : "";
                          // 注意：alert_threshold字段存在于数据库中，但Product结构体中没有对应字段
                          // 这里忽略该字段，因为我们会通过专门的函数获取预警阈值
                          return 0;
                      }, &product, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询商品失败: %s\n", err_msg);
+        SLOG_ERROR("查询商品失败: %s", err_msg);
         sqlite3_free(err_msg);
         return product;
     }
 
-    printf("商品查询完成\n");
+    SLOG_DEBUG("商品查询完成");
+    call.rows(product.id != -1 ? 1 : 0);
     return product;
 }
 
 Product query_product(const std::string& name)
 {
+    if (sales_daemon_connected())
+        return remote::query_product(name);
+    QueryCall call("query_product_by_name");
     return query_product(getIdFromName(name));
 }
 
+// 写入库存并取回低库存判断需要的字段，不负责发布事件，事务内的调用方在提交后再发布
+static bool write_stock(const int id, const int new_stock, LowStockEntry* after)
+{
+    const char* sql = "UPDATE products SET stock = ? WHERE id = ? RETURNING name, stock, alert_threshold;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        SLOG_ERROR("更新库存失败: %s", sqlite3_errmsg(db));
+        return false;
+    }
+    sqlite3_bind_int(stmt, 1, new_stock);
+    sqlite3_bind_int(stmt, 2, id);
+
+    after->product_id = -1;
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW)
+    {
+        after->product_id = id;
+        const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        after->name = name ? name : "";
+        after->stock = sqlite3_column_int(stmt, 1);
+        after->alert_threshold = sqlite3_column_int(stmt, 2);
+        rc = sqlite3_step(stmt);
+    }
+    if (rc != SQLITE_DONE)
+    {
+        SLOG_ERROR("更新库存失败: %s", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return false;
+    }
+    sqlite3_finalize(stmt);
+    return true;
+}
+
 bool update_stock(const int id, const int new_stock)
 {
-    const std::string sql = "UPDATE products SET stock = " + std::to_string(new_stock) +
-        " WHERE id = " + std::to_string(id) + ";";
-    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK)
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::update_stock(id, new_stock));
+    QueryCall call("update_stock");
+    LowStockEntry after;
+    if (!write_stock(id, new_stock, &after))
     {
-        fprintf(stderr, "更新库存失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
         return false;
     }
-    printf("商品ID %d 库存更新为 %d 成功\n", id, new_stock);
+    if (after.product_id != -1)
+    {
+        note_product_stock(after.product_id, after.name, after.stock, after.alert_threshold);
+    }
+    SLOG_DEBUG("商品ID %d 库存更新为 %d 成功", id, new_stock);
     return true;
 }
 
 int update_stock(const std::string& name, const int new_stock)
 {
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::update_stock(name, new_stock));
+    QueryCall call("update_stock_by_name");
     return update_stock(getIdFromName(name), new_stock);
 }
 
 std::vector<Product> get_all_products()
 {
+    if (sales_daemon_connected())
+        return remote::get_all_products();
+    QueryCall call("get_all_products");
     std::vector<Product> products;
+    if (read_catalog_snapshot(products))
+    {
+        call.rows(products.size());
+        return products;
+    }
     const char* sql = "SELECT * FROM products;";
     
     if (sqlite3_exec(db, sql, 
@@ -212,89 +727,284 @@ std::vector<Product> get_all_products()
                          product.name = argv[1];
                          product.price = std::stof(argv[2]);
                          product.stock = std::stoi(argv[3]);
+                         product.barcode = argc > 5 && argv[5] ? argv[5] : "";
                          // 注意：alert_threshold字段存在于数据库中，但Product结构体中没有对应字段
                          // 这里忽略该字段，因为我们会通过专门的函数获取预警阈值
                          products_ptr->push_back(product);
                          return 0;
                      }, &products, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询所有商品失败: %s\n", err_msg);
+        SLOG_ERROR("查询所有商品失败: %s", err_msg);
         sqlite3_free(err_msg);
         return products;
     }
     
+    call.rows(products.size());
     return products;
 }
 
-bool save_transaction(const Transaction& transaction)
+// 条件扣减库存：库存不足时不修改任何行，返回SQLITE_DONE且after->product_id为-1
+static int decrement_stock(sqlite3_stmt* stmt, const int id, const int quantity, LowStockEntry* after)
 {
-    // 开启事务
-    if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, &err_msg) != SQLITE_OK)
+    sqlite3_reset(stmt);
+    sqlite3_bind_int(stmt, 1, quantity);
+    sqlite3_bind_int(stmt, 2, id);
+
+    after->product_id = -1;
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW)
     {
-        fprintf(stderr, "开启事务失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        return false;
+        after->product_id = id;
+        const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        after->name = name ? name : "";
+        after->stock = sqlite3_column_int(stmt, 1);
+        after->alert_threshold = sqlite3_column_int(stmt, 2);
+        rc = sqlite3_step(stmt);
     }
-    
-    // 插入交易记录
-    char insert_transaction_sql[512];
-    snprintf(insert_transaction_sql, sizeof(insert_transaction_sql),
-             "INSERT INTO transactions (create_time, is_paid, total_price, amount_paid, change) VALUES (%ld, %d, %.2f, %.2f, %.2f);",
-             transaction.create_time, transaction.is_paid, transaction.total_price,
-             transaction.amount_paid, transaction.change);
-    
-    if (sqlite3_exec(db, insert_transaction_sql, nullptr, nullptr, &err_msg) != SQLITE_OK)
+    return rc;
+}
+
+// 读取冲突商品的当前名称和库存，用于生成冲突报告
+static StockConflict describe_conflict(const CartItem& item)
+{
+    StockConflict conflict = {item.product.id, item.product.name, item.quantity, 0};
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT name, stock FROM products WHERE id = ?;", -1, &stmt, nullptr) == SQLITE_OK)
     {
-        fprintf(stderr, "插入交易记录失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
-        return false;
+        sqlite3_bind_int(stmt, 1, item.product.id);
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            conflict.name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            conflict.available = sqlite3_column_int(stmt, 1);
+        }
     }
-    
+    sqlite3_finalize(stmt);
+    return conflict;
+}
+
+// 在写事务内保存一笔交易：扣减库存、插入交易和购物车项，事件溯源模式下改为追加销售事件。
+// 库存不足时填写conflicts并返回Failed，库存变化追加到changed_stock，提交后由调用方发布
+static WriteStatus write_sale(const Transaction& transaction, int& transaction_id,
+                              std::vector<LowStockEntry>& changed_stock, std::vector<StockConflict>& found_conflicts)
+{
+    // 事件溯源模式下只追加销售事件，交易、购物车项和库存扣减由投影线程写入
+    if (journal_enabled())
+        return append_sale_event(transaction, transaction_id, found_conflicts);
+
+    sqlite3_stmt* decrement_stmt = nullptr;
+    sqlite3_stmt* insert_transaction_stmt = nullptr;
+    sqlite3_stmt* insert_item_stmt = nullptr;
+    auto finish = [&](const WriteStatus status)
+    {
+        sqlite3_finalize(decrement_stmt);
+        sqlite3_finalize(insert_transaction_stmt);
+        sqlite3_finalize(insert_item_stmt);
+        return status;
+    };
+
+    // 1. 逐行条件扣减库存：以数据库中的实际库存为准，不使用购物车里的库存快照
+    int rc = sqlite3_prepare_v2(db,
+        "UPDATE products SET stock = stock - ?1 WHERE id = ?2 AND stock >= ?1 "
+        "RETURNING name, stock, alert_threshold;", -1, &decrement_stmt, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        SLOG_ERROR("更新商品库存失败: %s", sqlite3_errmsg(db));
+        return finish(write_status_of(rc));
+    }
+    for (const auto& item : transaction.cart.items)
+    {
+        LowStockEntry after;
+        rc = decrement_stock(decrement_stmt, item.product.id, item.quantity, &after);
+        if (rc != SQLITE_DONE)
+        {
+            SLOG_ERROR("更新商品库存失败，商品ID: %d: %s", item.product.id, sqlite3_errmsg(db));
+            return finish(write_status_of(rc));
+        }
+        if (after.product_id == -1)
+        {
+            // 前置条件不满足，继续检查其余行，以便一次报告所有冲突
+            found_conflicts.push_back(describe_conflict(item));
+            continue;
+        }
+        changed_stock.push_back(after);
+    }
+    if (!found_conflicts.empty())
+    {
+        return finish(WriteStatus::Failed);
+    }
+
+    // 2. 插入交易记录
+    rc = sqlite3_prepare_v2(db,
+        "INSERT INTO transactions (create_time, is_paid, total_price, amount_paid, change) "
+        "VALUES (?, ?, round(?, 2), round(?, 2), round(?, 2));", -1, &insert_transaction_stmt, nullptr);
+    if (rc == SQLITE_OK)
+    {
+        sqlite3_bind_int64(insert_transaction_stmt, 1, transaction.create_time);
+        sqlite3_bind_int(insert_transaction_stmt, 2, transaction.is_paid ? 1 : 0);
+        sqlite3_bind_double(insert_transaction_stmt, 3, transaction.total_price);
+        sqlite3_bind_double(insert_transaction_stmt, 4, transaction.amount_paid);
+        sqlite3_bind_double(insert_transaction_stmt, 5, transaction.change);
+        rc = sqlite3_step(insert_transaction_stmt);
+    }
+    if (rc != SQLITE_DONE)
+    {
+        SLOG_ERROR("插入交易记录失败: %s", sqlite3_errmsg(db));
+        return finish(write_status_of(rc));
+    }
+
     // 获取生成的transaction_id
-    int transaction_id = sqlite3_last_insert_rowid(db);
-    
-    // 插入购物车项
+    transaction_id = static_cast<int>(sqlite3_last_insert_rowid(db));
+
+    // 3. 插入购物车项
+    rc = sqlite3_prepare_v2(db,
+        "INSERT INTO cart_items (transaction_id, product_id, quantity, subtotal, discount, promotion_id) "
+        "VALUES (?, ?, ?, round(?, 2), round(?, 2), ?);",
+        -1, &insert_item_stmt, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        SLOG_ERROR("插入购物车项失败: %s", sqlite3_errmsg(db));
+        return finish(write_status_of(rc));
+    }
     for (const auto& item : transaction.cart.items)
     {
-        char insert_cart_item_sql[512];
-        snprintf(insert_cart_item_sql, sizeof(insert_cart_item_sql),
-                 "INSERT INTO cart_items (transaction_id, product_id, quantity, subtotal) VALUES (%d, %d, %d, %.2f);",
-                 transaction_id, item.product.id, item.quantity, item.subtotal);
-        
-        if (sqlite3_exec(db, insert_cart_item_sql, nullptr, nullptr, &err_msg) != SQLITE_OK)
+        sqlite3_reset(insert_item_stmt);
+        sqlite3_bind_int(insert_item_stmt, 1, transaction_id);
+        sqlite3_bind_int(insert_item_stmt, 2, item.product.id);
+        sqlite3_bind_int(insert_item_stmt, 3, item.quantity);
+        sqlite3_bind_double(insert_item_stmt, 4, item.subtotal);
+        sqlite3_bind_double(insert_item_stmt, 5, item.discount);
+        // 没有促销时记为NULL，与事件投影一致
+        if (item.promotion_id)
+            sqlite3_bind_int(insert_item_stmt, 6, item.promotion_id);
+        else
+            sqlite3_bind_null(insert_item_stmt, 6);
+        rc = sqlite3_step(insert_item_stmt);
+        if (rc != SQLITE_DONE)
         {
-            fprintf(stderr, "插入购物车项失败: %s\n", err_msg);
-            sqlite3_free(err_msg);
-            sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
-            return false;
+            SLOG_ERROR("插入购物车项失败: %s", sqlite3_errmsg(db));
+            return finish(write_status_of(rc));
         }
-        
-        // 更新商品库存
-        int new_stock = item.product.stock - item.quantity;
-        if (!update_stock(item.product.id, new_stock))
+    }
+    return finish(WriteStatus::Ok);
+}
+
+bool save_transaction(const Transaction& transaction, std::vector<StockConflict>* conflicts)
+{
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::save_transaction(transaction, conflicts));
+    QueryCall call("save_transaction");
+    // 提交后再发布低库存事件，回滚时不产生事件
+    std::vector<LowStockEntry> changed_stock;
+    std::vector<StockConflict> found_conflicts;
+    int transaction_id = -1;
+
+    const bool ok = run_write_transaction("保存交易记录", [&]() -> WriteStatus
+    {
+        changed_stock.clear();
+        found_conflicts.clear();
+        return write_sale(transaction, transaction_id, changed_stock, found_conflicts);
+    });
+
+    if (conflicts) *conflicts = found_conflicts;
+    if (!ok)
+    {
+        for (const auto& conflict : found_conflicts)
         {
-            fprintf(stderr, "更新商品库存失败，商品ID: %d\n", item.product.id);
-            sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
-            return false;
+            SLOG_WARN("库存不足，商品ID: %d，需要 %d，当前库存 %d",
+                    conflict.product_id, conflict.requested, conflict.available);
         }
+        return false;
     }
-    
-    // 提交事务
-    if (sqlite3_exec(db, "COMMIT TRANSACTION;", nullptr, nullptr, &err_msg) != SQLITE_OK)
+
+    for (const auto& entry : changed_stock)
     {
-        fprintf(stderr, "提交事务失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+        note_product_stock(entry.product_id, entry.name, entry.stock, entry.alert_threshold);
+    }
+
+    try_sync_sales_log();
+
+    SLOG_INFO("交易记录保存成功，交易ID: %d", transaction_id);
+    return true;
+}
+
+bool save_transaction_batch(std::vector<BatchedSale>& sales)
+{
+    QueryCall call("save_transaction_batch");
+    std::vector<LowStockEntry> changed_stock;
+    std::vector<int> transaction_ids;
+
+    const bool ok = run_write_transaction("批量保存交易记录", [&]() -> WriteStatus
+    {
+        changed_stock.clear();
+        transaction_ids.assign(sales.size(), -1);
+        for (size_t i = 0; i < sales.size(); ++i)
+        {
+            BatchedSale& sale = sales[i];
+            sale.saved = false;
+            sale.conflicts.clear();
+            int rc = sqlite3_exec(db, "SAVEPOINT batched_sale;", nullptr, nullptr, nullptr);
+            if (rc != SQLITE_OK)
+                return write_status_of(rc);
+            const size_t stock_mark = changed_stock.size();
+            const WriteStatus status = write_sale(*sale.transaction, transaction_ids[i], changed_stock, sale.conflicts);
+            if (status == WriteStatus::Busy)
+                return status;
+            if (status == WriteStatus::Ok)
+            {
+                rc = sqlite3_exec(db, "RELEASE batched_sale;", nullptr, nullptr, nullptr);
+                if (rc != SQLITE_OK)
+                    return write_status_of(rc);
+                sale.saved = true;
+                continue;
+            }
+
+            // 只回滚这一笔，批次中的其他交易照常提交；出错导致整个事务已被回滚时放弃整批
+            changed_stock.resize(stock_mark);
+            if (sqlite3_get_autocommit(db))
+                return WriteStatus::Failed;
+            rc = sqlite3_exec(db, "ROLLBACK TO batched_sale; RELEASE batched_sale;", nullptr, nullptr, nullptr);
+            if (rc != SQLITE_OK)
+                return write_status_of(rc);
+        }
+        return WriteStatus::Ok;
+    });
+    call.rows(sales.size());
+
+    for (const auto& sale : sales)
+    {
+        for (const auto& conflict : sale.conflicts)
+        {
+            SLOG_WARN("库存不足，商品ID: %d，需要 %d，当前库存 %d",
+                    conflict.product_id, conflict.requested, conflict.available);
+        }
+    }
+    if (!ok)
+    {
+        for (auto& sale : sales)
+            sale.saved = false;
         return false;
     }
-    
-    printf("交易记录保存成功，交易ID: %d\n", transaction_id);
+
+    for (const auto& entry : changed_stock)
+    {
+        note_product_stock(entry.product_id, entry.name, entry.stock, entry.alert_threshold);
+    }
+
+    try_sync_sales_log();
+
+    for (size_t i = 0; i < sales.size(); ++i)
+    {
+        if (sales[i].saved)
+            SLOG_INFO("交易记录保存成功，交易ID: %d", transaction_ids[i]);
+    }
     return true;
 }
 
 std::vector<Transaction> get_all_transactions()
 {
+    if (sales_daemon_connected())
+        return remote::get_all_transactions();
+    QueryCall call("get_all_transactions");
     std::vector<Transaction> transactions;
     const char* sql = "SELECT * FROM transactions ORDER BY create_time DESC;";
     
@@ -313,18 +1023,23 @@ std::vector<Transaction> get_all_transactions()
                          return 0;
                      }, &transactions, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询所有交易记录失败: %s\n", err_msg);
+        SLOG_ERROR("查询所有交易记录失败: %s", err_msg);
         sqlite3_free(err_msg);
         return transactions;
     }
     
+    call.rows(transactions.size());
     return transactions;
 }
 
 std::vector<CartItem> get_cart_items_by_transaction_id(const int transaction_id)
 {
+    if (sales_daemon_connected())
+        return remote::get_cart_items_by_transaction_id(transaction_id);
+    QueryCall call("get_cart_items_by_transaction_id");
     std::vector<CartItem> cart_items;
-    const std::string sql = "SELECT ci.*, p.id, p.name, p.price, p.stock "
+    const std::string sql = "SELECT ci.item_id, ci.transaction_id, ci.product_id, ci.quantity, ci.returned_quantity, "
+                           "ci.subtotal, p.id, p.name, p.price, p.stock, ci.discount, IFNULL(ci.promotion_id, 0) "
                            "FROM cart_items ci "
                            "JOIN products p ON ci.product_id = p.id "
                            "WHERE ci.transaction_id = " + std::to_string(transaction_id) + ";";
@@ -335,8 +1050,8 @@ std::vector<CartItem> get_cart_items_by_transaction_id(const int transaction_id)
                          auto* cart_items_ptr = static_cast<std::vector<CartItem>*>(data);
                          CartItem cart_item;
                          
-                         // cart_items表的列：item_id, transaction_id, product_id, quantity, returned_quantity, subtotal (6列)
-                         // 所以商品信息从索引6开始
+                         // 前6列为购物车项：item_id, transaction_id, product_id, quantity, returned_quantity, subtotal，
+                         // 商品信息从索引6开始，最后两列为促销折扣
                          Product product;
                          product.id = std::stoi(argv[6]);
                          product.name = argv[7];
@@ -347,21 +1062,125 @@ std::vector<CartItem> get_cart_items_by_transaction_id(const int transaction_id)
                          cart_item.quantity = std::stoi(argv[3]);
                          cart_item.returned_quantity = std::stoi(argv[4]);
                          cart_item.subtotal = std::stof(argv[5]);
+                         cart_item.discount = std::stof(argv[10]);
+                         cart_item.promotion_id = std::stoi(argv[11]);
                          
                          cart_items_ptr->push_back(cart_item);
                          return 0;
                      }, &cart_items, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询购物车项失败: %s\n", err_msg);
+        SLOG_ERROR("查询购物车项失败: %s", err_msg);
         sqlite3_free(err_msg);
         return cart_items;
     }
     
+    call.rows(cart_items.size());
     return cart_items;
 }
 
+TransactionDetail get_transaction_detail(const int transaction_id)
+{
+    if (sales_daemon_connected())
+        return remote::get_transaction_detail(transaction_id);
+    QueryCall call("get_transaction_detail");
+    TransactionDetail detail = load_transaction_detail(db, transaction_id);
+    call.rows(detail.lines.size());
+    return detail;
+}
+
+TransactionDetail load_transaction_detail(sqlite3* conn, const int transaction_id)
+{
+    TransactionDetail detail{};
+    detail.transaction.transaction_id = -1;
+
+    // 单条语句即为一个读快照：交易头、明细行和退货记录一次取回，
+    // 三张表都通过主键或索引按交易ID定位，代价只与该小票的大小有关
+    const char* sql =
+        "SELECT t.transaction_id, t.create_time, t.is_paid, t.total_price, t.amount_paid, t.change, "
+        "ci.item_id, ci.product_id, ci.quantity, ci.returned_quantity, ci.subtotal, "
+        "p.name, p.price, p.stock, "
+        "r.return_id, r.quantity, r.reason, r.return_time, ci.discount, IFNULL(ci.promotion_id, 0) "
+        "FROM transactions t "
+        "LEFT JOIN cart_items ci ON ci.transaction_id = t.transaction_id "
+        "LEFT JOIN products p ON p.id = ci.product_id "
+        "LEFT JOIN returns r ON r.transaction_id = ci.transaction_id AND r.product_id = ci.product_id "
+        "WHERE t.transaction_id = ? "
+        "ORDER BY ci.item_id, r.return_time DESC;";
+
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        SLOG_ERROR("查询交易明细失败: %s", sqlite3_errmsg(conn));
+        return detail;
+    }
+    sqlite3_bind_int(stmt, 1, transaction_id);
+
+    int current_item_id = -1;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if (detail.transaction.transaction_id == -1)
+        {
+            Transaction& transaction = detail.transaction;
+            transaction.transaction_id = sqlite3_column_int(stmt, 0);
+            transaction.create_time = sqlite3_column_int64(stmt, 1);
+            transaction.is_paid = sqlite3_column_int(stmt, 2) != 0;
+            transaction.total_price = static_cast<float>(sqlite3_column_double(stmt, 3));
+            transaction.amount_paid = static_cast<float>(sqlite3_column_double(stmt, 4));
+            transaction.change = static_cast<float>(sqlite3_column_double(stmt, 5));
+            transaction.cart.total_price = transaction.total_price;
+        }
+
+        // 没有任何购物车项的交易只有一行交易头
+        if (sqlite3_column_type(stmt, 6) == SQLITE_NULL)
+            continue;
+
+        // 同一购物车项因关联多条退货记录会出现多行，按item_id归并
+        const int item_id = sqlite3_column_int(stmt, 6);
+        if (item_id != current_item_id)
+        {
+            current_item_id = item_id;
+            TransactionLine line{};
+            line.item.product.id = sqlite3_column_int(stmt, 7);
+            const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 11));
+            line.item.product.name = name ? name : "";
+            line.item.product.price = static_cast<float>(sqlite3_column_double(stmt, 12));
+            line.item.product.stock = sqlite3_column_int(stmt, 13);
+            line.item.quantity = sqlite3_column_int(stmt, 8);
+            line.item.returned_quantity = sqlite3_column_int(stmt, 9);
+            line.item.subtotal = static_cast<float>(sqlite3_column_double(stmt, 10));
+            line.item.discount = static_cast<float>(sqlite3_column_double(stmt, 18));
+            line.item.promotion_id = sqlite3_column_int(stmt, 19);
+            detail.lines.push_back(line);
+        }
+
+        if (sqlite3_column_type(stmt, 14) != SQLITE_NULL)
+        {
+            ReturnItem return_item;
+            return_item.return_id = sqlite3_column_int(stmt, 14);
+            return_item.transaction_id = detail.transaction.transaction_id;
+            return_item.product_id = detail.lines.back().item.product.id;
+            return_item.quantity = sqlite3_column_int(stmt, 15);
+            const auto* reason = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 16));
+            return_item.reason = reason ? reason : "";
+            return_item.return_time = sqlite3_column_int64(stmt, 17);
+            detail.lines.back().returns.push_back(return_item);
+        }
+    }
+
+    if (rc != SQLITE_DONE)
+    {
+        SLOG_ERROR("查询交易明细失败: %s", sqlite3_errmsg(conn));
+    }
+    sqlite3_finalize(stmt);
+    return detail;
+}
+
 std::vector<Product> get_low_stock_products()
 {
+    if (sales_daemon_connected())
+        return remote::get_low_stock_products();
+    QueryCall call("get_low_stock_products");
     std::vector<Product> low_stock_products;
     // 查询库存低于或等于其预警阈值的商品
     const char* sql = "SELECT * FROM products WHERE stock <= alert_threshold;";
@@ -375,24 +1194,29 @@ std::vector<Product> get_low_stock_products()
                          product.name = argv[1];
                          product.price = std::stof(argv[2]);
                          product.stock = std::stoi(argv[3]);
+                         product.barcode = argc > 5 && argv[5] ? argv[5] : "";
                          products_ptr->push_back(product);
                          return 0;
                      }, &low_stock_products, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询低库存商品失败: %s\n", err_msg);
+        SLOG_ERROR("查询低库存商品失败: %s", err_msg);
         sqlite3_free(err_msg);
         return low_stock_products;
     }
     
+    call.rows(low_stock_products.size());
     return low_stock_products;
 }
 
 bool delete_product(const int id)
 {
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::delete_product(id), 0, true);
+    QueryCall call("delete_product");
     const std::string delete_sql = "DELETE FROM products WHERE id = " + std::to_string(id) + ";";
     if (sqlite3_exec(db, delete_sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "删除商品失败: %s\n", err_msg);
+        SLOG_ERROR("删除商品失败: %s", err_msg);
         sqlite3_free(err_msg);
         return false;
     }
@@ -401,43 +1225,63 @@ bool delete_product(const int id)
     int changes = sqlite3_changes(db);
     if (changes == 0)
     {
-        fprintf(stderr, "未找到ID为 %d 的商品\n", id);
+        SLOG_ERROR("未找到ID为 %d 的商品", id);
         return false;
     }
     
-    printf("商品ID %d 删除成功\n", id);
+    clear_transaction_detail_cache();
+    note_product_removed(id);
+    note_catalog_changed();
+    SLOG_INFO("商品ID %d 删除成功", id);
     return true;
 }
 
 bool delete_product(const std::string& name)
 {
-    const std::string delete_sql = "DELETE FROM products WHERE name = '" + name + "';";
-    if (sqlite3_exec(db, delete_sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK)
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::delete_product(name), 0, true);
+    QueryCall call("delete_product_by_name");
+    const std::string delete_sql = "DELETE FROM products WHERE name = '" + name + "' RETURNING id;";
+    std::vector<int> deleted_ids;
+    if (sqlite3_exec(db, delete_sql.c_str(),
+                     [](void* data, int argc, char** argv, char** col_name) -> int
+                     {
+                         static_cast<std::vector<int>*>(data)->push_back(std::stoi(argv[0]));
+                         return 0;
+                     }, &deleted_ids, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "删除商品失败: %s\n", err_msg);
+        SLOG_ERROR("删除商品失败: %s", err_msg);
         sqlite3_free(err_msg);
         return false;
     }
     
     // 检查是否有记录被删除
-    int changes = sqlite3_changes(db);
-    if (changes == 0)
+    if (deleted_ids.empty())
     {
-        fprintf(stderr, "未找到名称为 '%s' 的商品\n", name.c_str());
+        SLOG_ERROR("未找到名称为 '%s' 的商品", name.c_str());
         return false;
     }
     
-    printf("商品 '%s' 删除成功\n", name.c_str());
+    clear_transaction_detail_cache();
+    for (const int id : deleted_ids)
+    {
+        note_product_removed(id);
+    }
+    note_catalog_changed();
+    SLOG_INFO("商品 '%s' 删除成功", name.c_str());
     return true;
 }
 
 bool update_product(int id, const std::string& name, double price, int stock, int alert_threshold, std::string* errorMsg)
 {
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::update_product(id, name, price, stock, alert_threshold, errorMsg), 0, true);
+    QueryCall call("update_product");
     // 先查询商品是否存在
     Product existingProduct = query_product(id);
     if (existingProduct.id == -1) {
         std::string err = "更新商品失败: 未找到ID为 " + std::to_string(id) + " 的商品";
-        fprintf(stderr, "%s\n", err.c_str());
+        SLOG_ERROR("%s", err.c_str());
         if (errorMsg) *errorMsg = err;
         return false;
     }
@@ -449,14 +1293,14 @@ bool update_product(int id, const std::string& name, double price, int stock, in
              name.c_str(), price, stock, alert_threshold, id);
     
     const std::string update_sql(sql_buffer);
-    printf("执行SQL: %s\n", update_sql.c_str());
+    SLOG_DEBUG("执行SQL: %s", update_sql.c_str());
     
     // 执行SQL语句
     int rc = sqlite3_exec(db, update_sql.c_str(), nullptr, nullptr, &err_msg);
     if (rc != SQLITE_OK)
     {
         std::string err = "更新商品失败: " + std::string(err_msg);
-        fprintf(stderr, "%s\n", err.c_str());
+        SLOG_ERROR("%s", err.c_str());
         sqlite3_free(err_msg);
         if (errorMsg) *errorMsg = err;
         return false;
@@ -464,27 +1308,34 @@ bool update_product(int id, const std::string& name, double price, int stock, in
     
     // 检查是否有记录被更新
     int changes = sqlite3_changes(db);
-    printf("SQL执行影响的行数: %d\n", changes);
+    SLOG_DEBUG("SQL执行影响的行数: %d", changes);
+    note_product_stock(id, name, stock, alert_threshold);
     
     if (changes == 0)
     {
         // 没有记录被更新，可能是因为所有字段值都没有变化
-        fprintf(stderr, "更新商品提示: ID为 %d 的商品没有任何字段值变化\n", id);
+        SLOG_INFO("更新商品提示: ID为 %d 的商品没有任何字段值变化", id);
         // 返回true，因为商品信息已经是最新的
         return true;
     }
     
-    printf("商品ID %d 更新成功\n", id);
+    // 商品名称和单价会显示在交易明细中，清空明细缓存
+    clear_transaction_detail_cache();
+    note_catalog_changed();
+    SLOG_INFO("商品ID %d 更新成功", id);
     return true;
 }
 
 bool update_product(const std::string& old_name, const std::string& new_name, double price, int stock, int alert_threshold, std::string* errorMsg)
 {
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::update_product(old_name, new_name, price, stock, alert_threshold, errorMsg), 0, true);
+    QueryCall call("update_product_by_name");
     // 先查询商品是否存在
     int productId = getIdFromName(old_name);
     if (productId == -1) {
         std::string err = "更新商品失败: 未找到名称为 '" + old_name + "' 的商品";
-        fprintf(stderr, "%s\n", err.c_str());
+        SLOG_ERROR("%s", err.c_str());
         if (errorMsg) *errorMsg = err;
         return false;
     }
@@ -495,10 +1346,13 @@ bool update_product(const std::string& old_name, const std::string& new_name, do
 
 bool set_product_alert_threshold(int id, int threshold)
 {
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::set_product_alert_threshold(id, threshold));
+    QueryCall call("set_product_alert_threshold");
     // 先查询商品是否存在
     Product existingProduct = query_product(id);
     if (existingProduct.id == -1) {
-        fprintf(stderr, "更新商品预警阈值失败: 未找到ID为 %d 的商品\n", id);
+        SLOG_ERROR("更新商品预警阈值失败: 未找到ID为 %d 的商品", id);
         return false;
     }
     
@@ -512,31 +1366,36 @@ bool set_product_alert_threshold(int id, int threshold)
     
     if (sqlite3_exec(db, update_sql.c_str(), nullptr, nullptr, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "更新商品预警阈值失败: %s\n", err_msg);
+        SLOG_ERROR("更新商品预警阈值失败: %s", err_msg);
         sqlite3_free(err_msg);
         return false;
     }
+    note_product_stock(id, existingProduct.name, existingProduct.stock, threshold);
     
     // 检查是否有记录被更新
     int changes = sqlite3_changes(db);
     if (changes == 0)
     {
         // 没有记录被更新，可能是因为预警阈值没有变化
-        fprintf(stderr, "更新商品预警阈值提示: ID为 %d 的商品预警阈值没有变化\n", id);
+        SLOG_INFO("更新商品预警阈值提示: ID为 %d 的商品预警阈值没有变化", id);
         // 返回true，因为预警阈值已经是最新的
         return true;
     }
     
-    printf("商品ID %d 预警阈值更新成功\n", id);
+    note_catalog_changed();
+    SLOG_INFO("商品ID %d 预警阈值更新成功", id);
     return true;
 }
 
 bool set_product_alert_threshold(const std::string& name, int threshold)
 {
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::set_product_alert_threshold(name, threshold));
+    QueryCall call("set_product_alert_threshold_by_name");
     // 先通过名称获取商品ID
     int productId = getIdFromName(name);
     if (productId == -1) {
-        fprintf(stderr, "更新商品预警阈值失败: 未找到名称为 '%s' 的商品\n", name.c_str());
+        SLOG_ERROR("更新商品预警阈值失败: 未找到名称为 '%s' 的商品", name.c_str());
         return false;
     }
     
@@ -546,6 +1405,9 @@ bool set_product_alert_threshold(const std::string& name, int threshold)
 
 int get_product_alert_threshold(int id)
 {
+    if (sales_daemon_connected())
+        return remote::get_product_alert_threshold(id);
+    QueryCall call("get_product_alert_threshold");
     int threshold = -1;
     const std::string sql = "SELECT alert_threshold FROM products WHERE id = " + std::to_string(id) + ";";
     
@@ -557,7 +1419,7 @@ int get_product_alert_threshold(int id)
                          return 0;
                      }, &threshold, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询商品预警阈值失败: %s\n", err_msg);
+        SLOG_ERROR("查询商品预警阈值失败: %s", err_msg);
         sqlite3_free(err_msg);
         return -1;
     }
@@ -567,6 +1429,9 @@ int get_product_alert_threshold(int id)
 
 int get_product_alert_threshold(const std::string& name)
 {
+    if (sales_daemon_connected())
+        return remote::get_product_alert_threshold(name);
+    QueryCall call("get_product_alert_threshold_by_name");
     int id = getIdFromName(name);
     if (id == -1)
     {
@@ -576,164 +1441,640 @@ int get_product_alert_threshold(const std::string& name)
     return get_product_alert_threshold(id);
 }
 
-// 退货相关函数实现
+// 条码相关函数实现
 
-bool add_return(int transaction_id, int product_id, int quantity, const std::string& reason)
+bool is_valid_barcode(const std::string& barcode)
 {
-    // 开启事务
-    if (sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, nullptr, &err_msg) != SQLITE_OK)
-    {
-        fprintf(stderr, "开启事务失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
+    const size_t length = barcode.size();
+    if (length != 8 && length != 12 && length != 13 && length != 14)
         return false;
+    int sum = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (barcode[i] < '0' || barcode[i] > '9')
+            return false;
+        // 从校验位左边一位起向左，权重依次为3、1、3、1……
+        if (i + 1 < length)
+            sum += (barcode[i] - '0') * ((length - 1 - i) % 2 == 1 ? 3 : 1);
     }
-    
-    // 1. 查询当前购物车项的已退货数量
-    char select_cart_item_sql[512];
-    snprintf(select_cart_item_sql, sizeof(select_cart_item_sql),
-             "SELECT item_id, returned_quantity FROM cart_items WHERE transaction_id = %d AND product_id = %d;",
-             transaction_id, product_id);
-    
-    int results[2] = {-1, 0}; // [0] = cart_item_id, [1] = current_returned
-    
-    if (sqlite3_exec(db, select_cart_item_sql, 
-                     [](void* data, int argc, char** argv, char** col_name) -> int 
-                     {
-                         int* results = static_cast<int*>(data);
-                         results[0] = std::stoi(argv[0]); // item_id
-                         results[1] = std::stoi(argv[1]); // returned_quantity
-                         return 0;
-                     }, results, &err_msg) != SQLITE_OK)
+    return (10 - sum % 10) % 10 == barcode[length - 1] - '0';
+}
+
+bool set_product_barcode(const int id, const std::string& barcode, std::string* errorMsg)
+{
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::set_product_barcode(id, barcode, errorMsg));
+    QueryCall call("set_product_barcode");
+    std::string err;
+    if (!barcode.empty() && !is_valid_barcode(barcode))
+        err = "条码 " + barcode + " 无效：应为8、12、13或14位数字且校验位正确";
+    else
     {
-        fprintf(stderr, "查询购物车项失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
-        return false;
+        const CachedStatement stmt("UPDATE products SET barcode = ?1 WHERE id = ?2;");
+        if (!stmt)
+            err = std::string("设置商品条码失败: ") + sqlite3_errmsg(db);
+        else
+        {
+            if (barcode.empty())
+                sqlite3_bind_null(stmt.get(), 1);
+            else
+                sqlite3_bind_text(stmt.get(), 1, barcode.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt.get(), 2, id);
+            const int rc = sqlite3_step(stmt.get());
+            if (rc == SQLITE_CONSTRAINT)
+            {
+                const Product owner = query_product_by_barcode(barcode);
+                err = "条码 " + barcode + " 已被商品 '" + owner.name + "'（ID " + std::to_string(owner.id) + "）使用";
+            }
+            else if (rc != SQLITE_DONE)
+                err = std::string("设置商品条码失败: ") + sqlite3_errmsg(db);
+            else if (sqlite3_changes(db) == 0)
+                err = "设置商品条码失败: 未找到ID为 " + std::to_string(id) + " 的商品";
+        }
     }
-    
-    int cart_item_id = results[0];
-    int current_returned = results[1];
-    
-    if (cart_item_id == -1)
+    if (!err.empty())
     {
-        fprintf(stderr, "购物车项不存在\n");
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
         return false;
     }
-    
-    // 2. 添加退货记录
-    char insert_return_sql[512];
-    time_t now = time(nullptr);
-    snprintf(insert_return_sql, sizeof(insert_return_sql),
-             "INSERT INTO returns (transaction_id, product_id, quantity, reason, return_time) VALUES (%d, %d, %d, '%s', %ld);",
-             transaction_id, product_id, quantity, reason.c_str(), now);
-    
-    if (sqlite3_exec(db, insert_return_sql, nullptr, nullptr, &err_msg) != SQLITE_OK)
+    note_catalog_changed();
+    SLOG_INFO("商品ID %d 条码设置为 %s", id, barcode.empty() ? "空" : barcode.c_str());
+    return true;
+}
+
+bool add_product(const std::string& name, const double price, const int stock, const int alert_threshold,
+                 const std::string& barcode, std::string* errorMsg)
+{
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::add_product(name, price, stock, alert_threshold, barcode, errorMsg));
+    if (barcode.empty())
     {
-        fprintf(stderr, "插入退货记录失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+        if (add_product(name, price, stock, alert_threshold))
+            return true;
+        if (errorMsg) *errorMsg = "商品 '" + name + "' 添加失败";
         return false;
     }
-    
-    // 3. 更新购物车项的已退货数量
-    int new_returned = current_returned + quantity;
-    char update_cart_item_sql[512];
-    snprintf(update_cart_item_sql, sizeof(update_cart_item_sql),
-             "UPDATE cart_items SET returned_quantity = %d WHERE item_id = %d;",
-             new_returned, cart_item_id);
-    
-    if (sqlite3_exec(db, update_cart_item_sql, nullptr, nullptr, &err_msg) != SQLITE_OK)
+    QueryCall call("add_product_with_barcode");
+    std::string err;
+    bool duplicate = false;
+    int id = -1;
+    if (!is_valid_barcode(barcode))
+        err = "条码 " + barcode + " 无效：应为8、12、13或14位数字且校验位正确";
+    // 商品与条码在同一条INSERT中写入：条码重复时整条不插入，不会留下没有条码的商品
+    else if (!run_write_transaction("新增商品", [&]() -> WriteStatus
     {
-        fprintf(stderr, "更新购物车项退货数量失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
-        return false;
+        err.clear();
+        duplicate = false;
+        const CachedStatement stmt(
+            "INSERT INTO products (name, price, stock, alert_threshold, barcode) VALUES (?1, round(?2, 2), ?3, ?4, ?5);");
+        if (!stmt)
+        {
+            err = "插入商品失败: " + std::string(sqlite3_errmsg(db));
+            return write_status_of(sqlite3_errcode(db));
+        }
+        sqlite3_bind_text(stmt.get(), 1, name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_double(stmt.get(), 2, price);
+        sqlite3_bind_int(stmt.get(), 3, stock);
+        sqlite3_bind_int(stmt.get(), 4, alert_threshold);
+        sqlite3_bind_text(stmt.get(), 5, barcode.c_str(), -1, SQLITE_STATIC);
+        const int rc = sqlite3_step(stmt.get());
+        if (rc == SQLITE_CONSTRAINT)
+        {
+            duplicate = true;
+            return WriteStatus::Failed;
+        }
+        if (rc != SQLITE_DONE)
+        {
+            err = "插入商品失败: " + std::string(sqlite3_errmsg(db));
+            return write_status_of(rc);
+        }
+        id = static_cast<int>(sqlite3_last_insert_rowid(db));
+        return WriteStatus::Ok;
+    }))
+    {
+        if (duplicate)
+        {
+            const Product owner = query_product_by_barcode(barcode);
+            err = "条码 " + barcode + " 已被商品 '" + owner.name + "'（ID " + std::to_string(owner.id) + "）使用";
+        }
+        else if (err.empty())
+            err = "商品 '" + name + "' 添加失败";
     }
-    
-    // 4. 查询当前商品库存
-    Product product = query_product(product_id);
-    if (product.id == -1)
+    if (!err.empty())
     {
-        fprintf(stderr, "查询商品失败: 未找到ID为 %d 的商品\n", product_id);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
         return false;
     }
-    
-    // 5. 更新商品库存（增加退货数量）
-    int newStock = product.stock + quantity;
-    if (!update_stock(product_id, newStock))
+    note_product_stock(id, name, stock, alert_threshold);
+    note_catalog_changed();
+    SLOG_INFO("商品%s添加成功，条码 %s", name.c_str(), barcode.c_str());
+    return true;
+}
+
+Product query_product_by_barcode(const std::string& barcode)
+{
+    if (sales_daemon_connected())
+        return remote::query_product_by_barcode(barcode);
+    QueryCall call("query_product_by_barcode");
+    Product product{};
+    product.id = -1;
+    if (barcode.empty())
+        return product;
+
+    // 目录快照的条码索引给出ID、名称和单价，库存按主键读取当前值
+    if (find_catalog_snapshot_barcode(barcode, product))
     {
-        fprintf(stderr, "更新商品库存失败，商品ID: %d\n", product_id);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
-        return false;
+        if (product.id != -1)
+        {
+            const CachedStatement stmt("SELECT stock FROM products WHERE id = ?;");
+            if (stmt)
+                sqlite3_bind_int(stmt.get(), 1, product.id);
+            if (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+                product.stock = sqlite3_column_int(stmt.get(), 0);
+            else
+            {
+                product = Product{};
+                product.id = -1;
+            }
+        }
+        call.rows(product.id != -1 ? 1 : 0);
+        return product;
     }
-    
-    // 6. 更新交易总金额
-    // 计算退货金额
-    float returnAmount = product.price * quantity;
-    
-    // 查询当前交易信息
-    char select_transaction_sql[512];
-    snprintf(select_transaction_sql, sizeof(select_transaction_sql),
-             "SELECT total_price, amount_paid, change FROM transactions WHERE transaction_id = %d;",
-             transaction_id);
-    
-    float currentTotal = 0.0f;
-    float currentPaid = 0.0f;
-    float currentChange = 0.0f;
-    
-    if (sqlite3_exec(db, select_transaction_sql, 
-                     [](void* data, int argc, char** argv, char** col_name) -> int 
-                     {
-                         float* results = static_cast<float*>(data);
-                         results[0] = std::stof(argv[0]); // total_price
-                         results[1] = std::stof(argv[1]); // amount_paid
-                         results[2] = std::stof(argv[2]); // change
-                         return 0;
-                     }, &currentTotal, &err_msg) != SQLITE_OK)
+
+    const CachedStatement stmt("SELECT id, name, price, stock FROM products WHERE barcode = ?;");
+    if (!stmt)
+        return product;
+    sqlite3_bind_text(stmt.get(), 1, barcode.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt.get()) == SQLITE_ROW)
     {
-        fprintf(stderr, "查询交易信息失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+        product.id = sqlite3_column_int(stmt.get(), 0);
+        const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+        product.name = name ? name : "";
+        product.price = static_cast<float>(sqlite3_column_double(stmt.get(), 2));
+        product.stock = sqlite3_column_int(stmt.get(), 3);
+        product.barcode = barcode;
+    }
+    call.rows(product.id != -1 ? 1 : 0);
+    return product;
+}
+
+// 进货相关函数实现
+
+bool restock_products(const std::vector<RestockLine>& lines, std::vector<Product>* updated, std::string* errorMsg)
+{
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::restock_products(lines, updated, errorMsg));
+    QueryCall call("restock_products");
+    // 合并同一商品的多行，并检查数量
+    std::map<int, long long> merged;
+    for (const auto& line : lines)
+    {
+        if (line.quantity <= 0)
+        {
+            std::string err = "进货失败: 商品ID " + std::to_string(line.product_id) + " 的进货数量无效";
+            SLOG_ERROR("%s", err.c_str());
+            if (errorMsg) *errorMsg = err;
+            return false;
+        }
+        merged[line.product_id] += line.quantity;
+    }
+    if (merged.empty())
+    {
+        return true;
+    }
+
+    std::vector<LowStockEntry> changed_stock;
+    std::vector<Product> updated_products;
+    std::string err;
+
+    // 整张进货单在一个写事务内入账，要么全部入账要么全部不入账
+    const bool ok = run_write_transaction("进货单入账", [&]() -> WriteStatus
+    {
+        changed_stock.clear();
+        updated_products.clear();
+        err.clear();
+        // 事件溯源模式：直接入账并记录进货事件，库存增量与待投影的销售先后无关
+        const bool journaled = journal_enabled();
+        const JournalMute mute(journaled);
+
+        // 相对增量更新，不依赖之前读到的库存；同时防止库存超过INT_MAX
+        const char* sql =
+            "UPDATE products SET stock = stock + ?1 WHERE id = ?2 AND stock <= 2147483647 - ?1 "
+            "RETURNING id, name, price, stock, alert_threshold;";
+        sqlite3_stmt* stmt = nullptr;
+        int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+        if (rc != SQLITE_OK)
+        {
+            err = "进货失败: " + std::string(sqlite3_errmsg(db));
+            return write_status_of(rc);
+        }
+
+        WriteStatus status = WriteStatus::Ok;
+        for (const auto& [product_id, quantity] : merged)
+        {
+            if (quantity > INT_MAX)
+            {
+                err = "进货失败: 商品ID " + std::to_string(product_id) + " 的进货数量超过系统最大值";
+                status = WriteStatus::Failed;
+                break;
+            }
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, static_cast<int>(quantity));
+            sqlite3_bind_int(stmt, 2, product_id);
+
+            rc = sqlite3_step(stmt);
+            if (rc == SQLITE_ROW)
+            {
+                Product product;
+                product.id = sqlite3_column_int(stmt, 0);
+                const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                product.name = name ? name : "";
+                product.price = static_cast<float>(sqlite3_column_double(stmt, 2));
+                product.stock = sqlite3_column_int(stmt, 3);
+                updated_products.push_back(product);
+                changed_stock.push_back({product.id, product.name, product.stock, sqlite3_column_int(stmt, 4)});
+                continue;
+            }
+            if (rc == SQLITE_DONE)
+            {
+                // 没有行被更新：商品不存在或库存将溢出
+                err = query_product(product_id).id == -1
+                          ? "进货失败: 未找到ID为 " + std::to_string(product_id) + " 的商品"
+                          : "进货失败: 商品ID " + std::to_string(product_id) + " 的库存总和超过系统最大值";
+                status = WriteStatus::Failed;
+            }
+            else
+            {
+                err = "进货失败: " + std::string(sqlite3_errmsg(db));
+                status = write_status_of(rc);
+            }
+            break;
+        }
+        sqlite3_finalize(stmt);
+        if (status == WriteStatus::Ok && journaled)
+            status = append_restock_event(merged);
+        return status;
+    });
+
+    if (!ok)
+    {
+        if (err.empty()) err = "进货失败: 数据库繁忙或写入失败";
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
         return false;
     }
-    
-    // 计算新的总金额、支付金额和找零
-    float newTotal = currentTotal - returnAmount;
-    // 支付金额和找零保持不变，因为这是实际的支付情况
-    // 只有总金额需要调整为扣除退货后的金额
-    
-    // 更新交易记录
-    char update_transaction_sql[512];
-    snprintf(update_transaction_sql, sizeof(update_transaction_sql),
-             "UPDATE transactions SET total_price = %.2f WHERE transaction_id = %d;",
-             newTotal, transaction_id);
-    
-    if (sqlite3_exec(db, update_transaction_sql, nullptr, nullptr, &err_msg) != SQLITE_OK)
+
+    for (const auto& entry : changed_stock)
     {
-        fprintf(stderr, "更新交易总金额失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+        note_product_stock(entry.product_id, entry.name, entry.stock, entry.alert_threshold);
+    }
+    if (updated) *updated = std::move(updated_products);
+
+    SLOG_INFO("进货单入账成功，共 %zu 种商品", merged.size());
+    return true;
+}
+
+bool load_restock_csv(const std::string& path, std::vector<RestockLine>& lines, std::string* errorMsg)
+{
+    QueryCall call("load_restock_csv");
+    // 送货单格式：每行“商品ID或商品名称,数量”，允许表头、空行和以#开头的注释行
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::string err = "打开送货单失败: " + path;
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
         return false;
     }
-    
-    // 提交事务
-    if (sqlite3_exec(db, "COMMIT TRANSACTION;", nullptr, nullptr, &err_msg) != SQLITE_OK)
+
+    auto trim = [](std::string text)
     {
-        fprintf(stderr, "提交事务失败: %s\n", err_msg);
-        sqlite3_free(err_msg);
-        sqlite3_exec(db, "ROLLBACK TRANSACTION;", nullptr, nullptr, nullptr);
+        const auto begin = text.find_first_not_of(" \t\r\"");
+        if (begin == std::string::npos) return std::string();
+        const auto end = text.find_last_not_of(" \t\r\"");
+        return text.substr(begin, end - begin + 1);
+    };
+
+    std::vector<RestockLine> parsed;
+    std::string row;
+    int line_number = 0;
+    while (std::getline(file, row))
+    {
+        ++line_number;
+        // 去掉UTF-8 BOM
+        if (line_number == 1 && row.rfind("\xEF\xBB\xBF", 0) == 0)
+            row.erase(0, 3);
+        row = trim(row);
+        if (row.empty() || row[0] == '#')
+            continue;
+
+        const auto comma = row.find(',');
+        const std::string key = comma == std::string::npos ? "" : trim(row.substr(0, comma));
+        const std::string quantity_text = comma == std::string::npos ? "" : trim(row.substr(comma + 1));
+
+        int quantity = 0;
+        try
+        {
+            size_t used = 0;
+            const long long value = std::stoll(quantity_text, &used);
+            if (used != quantity_text.size() || value <= 0 || value > INT_MAX)
+                throw std::out_of_range(quantity_text);
+            quantity = static_cast<int>(value);
+        }
+        catch (const std::exception&)
+        {
+            // 第一行数量不是数字时视为表头
+            if (parsed.empty() && line_number == 1)
+                continue;
+            std::string err = "送货单第 " + std::to_string(line_number) + " 行数量无效: " + row;
+            SLOG_ERROR("%s", err.c_str());
+            if (errorMsg) *errorMsg = err;
+            return false;
+        }
+
+        int product_id = -1;
+        if (!key.empty() && key.size() <= 9 && key.find_first_not_of("0123456789") == std::string::npos)
+            product_id = std::stoi(key);
+        else if (!key.empty())
+            product_id = getIdFromName(key);
+        if (product_id <= 0)
+        {
+            std::string err = "送货单第 " + std::to_string(line_number) + " 行商品不存在: " + key;
+            SLOG_ERROR("%s", err.c_str());
+            if (errorMsg) *errorMsg = err;
+            return false;
+        }
+        parsed.push_back({product_id, quantity});
+    }
+
+    lines.insert(lines.end(), parsed.begin(), parsed.end());
+    return true;
+}
+
+// 退货相关函数实现
+
+WriteStatus mark_returned_items(const long long transaction_id, const int product_id, const int quantity, bool& enough,
+                                double& amount)
+{
+    enough = false;
+    amount = 0.0;
+    const CachedStatement returnable(
+        "SELECT item_id, quantity - returned_quantity, subtotal / quantity FROM cart_items "
+        "WHERE transaction_id = ?1 AND product_id = ?2 AND returned_quantity < quantity ORDER BY item_id;");
+    const CachedStatement mark_returned(
+        "UPDATE cart_items SET returned_quantity = returned_quantity + ?1 WHERE item_id = ?2;");
+    if (!returnable || !mark_returned)
+        return write_status_of(sqlite3_errcode(db));
+
+    struct Portion
+    {
+        long long item_id;
+        int quantity;
+        double unit_price;
+    };
+    std::vector<Portion> portions;
+    int left = quantity;
+    sqlite3_stmt* stmt = returnable.get();
+    sqlite3_bind_int64(stmt, 1, transaction_id);
+    sqlite3_bind_int(stmt, 2, product_id);
+    int rc = SQLITE_DONE;
+    while (left > 0 && (rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        const int take = std::min(left, sqlite3_column_int(stmt, 1));
+        portions.push_back({sqlite3_column_int64(stmt, 0), take, sqlite3_column_double(stmt, 2)});
+        left -= take;
+    }
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+        return write_status_of(rc);
+    sqlite3_reset(stmt);
+    if (left > 0)
+        return WriteStatus::Ok;
+
+    stmt = mark_returned.get();
+    for (const Portion& portion : portions)
+    {
+        sqlite3_reset(stmt);
+        sqlite3_bind_int(stmt, 1, portion.quantity);
+        sqlite3_bind_int64(stmt, 2, portion.item_id);
+        rc = sqlite3_step(stmt);
+        if (rc != SQLITE_DONE)
+            return write_status_of(rc);
+        amount += portion.unit_price * portion.quantity;
+    }
+    enough = true;
+    return WriteStatus::Ok;
+}
+
+double take_return_amount(double& amount_left, long long& quantity_left, const int quantity)
+{
+    const double share = quantity >= quantity_left
+                             ? amount_left
+                             : std::round(amount_left * quantity / static_cast<double>(quantity_left) * 100.0) / 100.0;
+    amount_left -= share;
+    quantity_left -= quantity;
+    return share;
+}
+
+// 退货单的写入与提交后的维护，add_return和add_return_slip共用；入口统计由调用方各记一次
+static bool write_return_slip(const int transaction_id, const std::vector<ReturnLine>& lines, std::string* errorMsg)
+{
+    // 同一商品的多行合并后校验剩余可退数量，退货记录仍按原始行写入以保留各自的原因
+    std::map<int, long long> merged;
+    for (const auto& line : lines)
+    {
+        if (line.quantity <= 0)
+        {
+            std::string err = "退货失败: 商品ID " + std::to_string(line.product_id) + " 的退货数量无效";
+            SLOG_ERROR("%s", err.c_str());
+            if (errorMsg) *errorMsg = err;
+            return false;
+        }
+        merged[line.product_id] += line.quantity;
+    }
+    if (merged.empty())
+    {
+        return true;
+    }
+
+    std::vector<LowStockEntry> changed_stock;
+    double returnAmount = 0.0;
+    // 各商品分摊到的退货金额和数量，写退货记录时再分给该商品的各行
+    std::map<int, std::pair<double, long long>> refunds;
+    std::string err;
+
+    // 整张退货单一个事务、一次提交；每种语句只编译一次，按行重置后复用
+    const bool ok = run_write_transaction("添加退货记录", [&]() -> WriteStatus
+    {
+        changed_stock.clear();
+        returnAmount = 0.0;
+        refunds.clear();
+        err.clear();
+
+        // 事件溯源模式：先投影待投影的销售，刚售出的交易才能退货；之后照常写入并记录退货事件
+        const bool journaled = journal_enabled();
+        const JournalMute mute(journaled);
+        if (journaled)
+        {
+            const WriteStatus status = project_pending_events(changed_stock);
+            if (status != WriteStatus::Ok)
+            {
+                err = "退货失败: 投影待投影的销售失败";
+                return status;
+            }
+        }
+
+        // 与进货相同，防止库存超过INT_MAX
+        const CachedStatement restore_stock(
+            "UPDATE products SET stock = stock + ?1 WHERE id = ?2 AND stock <= 2147483647 - ?1 "
+            "RETURNING name, price, stock, alert_threshold;");
+        const CachedStatement insert_return(
+            "INSERT INTO returns (transaction_id, product_id, quantity, reason, return_time, amount) "
+            "VALUES (?, ?, ?, ?, ?, round(?, 2));");
+        const CachedStatement update_total(
+            "UPDATE transactions SET total_price = round(total_price - ?, 2) WHERE transaction_id = ?;");
+        if (!restore_stock || !insert_return || !update_total)
+        {
+            err = "退货失败: " + std::string(sqlite3_errmsg(db));
+            return write_status_of(sqlite3_errcode(db));
+        }
+
+        for (const auto& [product_id, quantity] : merged)
+        {
+            if (quantity > INT_MAX)
+            {
+                err = "退货失败: 商品ID " + std::to_string(product_id) + " 的退货数量超过剩余可退货数量";
+                return WriteStatus::Failed;
+            }
+
+            // 1. 累加已退货数量，分摊到该商品的各购物车项：剩余可退数量不足或购物车项不存在时不修改任何行
+            bool enough = false;
+            double amount = 0.0;
+            const WriteStatus marked = mark_returned_items(transaction_id, product_id, static_cast<int>(quantity), enough,
+                                                           amount);
+            if (marked != WriteStatus::Ok)
+            {
+                err = "更新购物车项退货数量失败: " + std::string(sqlite3_errmsg(db));
+                return marked;
+            }
+            if (!enough)
+            {
+                err = "退货失败: 商品ID " + std::to_string(product_id) + " 不在交易中或退货数量超过剩余可退货数量";
+                return WriteStatus::Failed;
+            }
+
+            // 退货金额按各行实付单价（小计除以数量，已扣除促销折扣）计算，而不是商品现在的单价
+            returnAmount += amount;
+            refunds[product_id] = {amount, quantity};
+
+            // 2. 相对增加商品库存，不依赖之前读到的库存
+            sqlite3_stmt* stmt = restore_stock.get();
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, static_cast<int>(quantity));
+            sqlite3_bind_int(stmt, 2, product_id);
+            const int rc = sqlite3_step(stmt);
+            if (rc != SQLITE_ROW)
+            {
+                // 没有行被更新：商品不存在或库存将溢出
+                if (rc == SQLITE_DONE)
+                    err = query_product(product_id).id == -1
+                              ? "查询商品失败: 未找到ID为 " + std::to_string(product_id) + " 的商品"
+                              : "退货失败: 商品ID " + std::to_string(product_id) + " 的库存总和超过系统最大值";
+                else
+                    err = "更新商品库存失败: " + std::string(sqlite3_errmsg(db));
+                return rc == SQLITE_DONE ? WriteStatus::Failed : write_status_of(rc);
+            }
+            const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            changed_stock.push_back({product_id, name ? name : "", sqlite3_column_int(stmt, 2),
+                                     sqlite3_column_int(stmt, 3)});
+        }
+
+        // 3. 逐行写入退货记录
+        const time_t now = time(nullptr);
+        sqlite3_stmt* stmt = insert_return.get();
+        for (const auto& line : lines)
+        {
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, transaction_id);
+            sqlite3_bind_int(stmt, 2, line.product_id);
+            sqlite3_bind_int(stmt, 3, line.quantity);
+            sqlite3_bind_text(stmt, 4, line.reason.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 5, now);
+            auto& [amount_left, quantity_left] = refunds[line.product_id];
+            sqlite3_bind_double(stmt, 6, take_return_amount(amount_left, quantity_left, line.quantity));
+            const int rc = sqlite3_step(stmt);
+            if (rc != SQLITE_DONE)
+            {
+                err = "插入退货记录失败: " + std::string(sqlite3_errmsg(db));
+                return write_status_of(rc);
+            }
+        }
+
+        // 4. 一次性扣减交易总金额；支付金额和找零保持不变，因为这是实际的支付情况
+        stmt = update_total.get();
+        sqlite3_reset(stmt);
+        sqlite3_bind_double(stmt, 1, returnAmount);
+        sqlite3_bind_int(stmt, 2, transaction_id);
+        const int rc = sqlite3_step(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            err = "更新交易总金额失败: " + std::string(sqlite3_errmsg(db));
+            return write_status_of(rc);
+        }
+        if (journaled)
+        {
+            const WriteStatus status = append_return_event(transaction_id, lines, now, returnAmount);
+            if (status != WriteStatus::Ok)
+                err = "退货失败: 写入退货事件失败";
+            return status;
+        }
+        return WriteStatus::Ok;
+    });
+
+    if (!ok)
+    {
+        if (err.empty()) err = "退货失败: 数据库繁忙或写入失败";
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
         return false;
     }
-    
-    printf("退货记录添加成功，交易ID: %d, 商品ID: %d, 数量: %d, 退货金额: %.2f\n", 
-           transaction_id, product_id, quantity, returnAmount);
+
+    // 该交易的明细已变化，使缓存失效
+    invalidate_transaction_detail(transaction_id);
+    for (const auto& entry : changed_stock)
+    {
+        note_product_stock(entry.product_id, entry.name, entry.stock, entry.alert_threshold);
+    }
+
+    try_sync_sales_log();
+
+    SLOG_INFO("退货单提交成功，交易ID: %d, 共 %zu 行, 退货金额: %.2f",
+           transaction_id, lines.size(), returnAmount);
     return true;
 }
 
+bool add_return(int transaction_id, int product_id, int quantity, const std::string& reason)
+{
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::add_return(transaction_id, product_id, quantity, reason), transaction_id);
+    QueryCall call("add_return");
+    return write_return_slip(transaction_id, {{product_id, quantity, reason}}, nullptr);
+}
+
+bool add_return_slip(const int transaction_id, const std::vector<ReturnLine>& lines, std::string* errorMsg)
+{
+    if (sales_daemon_connected())
+        return synced_remote_write(remote::add_return_slip(transaction_id, lines, errorMsg), transaction_id);
+    QueryCall call("add_return_slip");
+    return write_return_slip(transaction_id, lines, errorMsg);
+}
+
 std::vector<ReturnItem> get_all_returns()
 {
+    if (sales_daemon_connected())
+        return remote::get_all_returns();
+    QueryCall call("get_all_returns");
     std::vector<ReturnItem> returnItems;
     const char* sql = "SELECT * FROM returns ORDER BY return_time DESC;";
     
@@ -752,16 +2093,20 @@ std::vector<ReturnItem> get_all_returns()
                          return 0;
                      }, &returnItems, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询所有退货记录失败: %s\n", err_msg);
+        SLOG_ERROR("查询所有退货记录失败: %s", err_msg);
         sqlite3_free(err_msg);
         return returnItems;
     }
     
+    call.rows(returnItems.size());
     return returnItems;
 }
 
 std::vector<ReturnItem> get_returns_by_transaction_id(int transaction_id)
 {
+    if (sales_daemon_connected())
+        return remote::get_returns_by_transaction_id(transaction_id);
+    QueryCall call("get_returns_by_transaction_id");
     std::vector<ReturnItem> returns;
     const std::string sql = "SELECT * FROM returns WHERE transaction_id = " + std::to_string(transaction_id) + " ORDER BY return_time DESC;";
     
@@ -780,16 +2125,20 @@ std::vector<ReturnItem> get_returns_by_transaction_id(int transaction_id)
                          return 0;
                      }, &returns, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询交易退货记录失败: %s\n", err_msg);
+        SLOG_ERROR("查询交易退货记录失败: %s", err_msg);
         sqlite3_free(err_msg);
         return returns;
     }
     
+    call.rows(returns.size());
     return returns;
 }
 
 std::vector<ReturnItem> get_returns_by_product_id(int product_id)
 {
+    if (sales_daemon_connected())
+        return remote::get_returns_by_product_id(product_id);
+    QueryCall call("get_returns_by_product_id");
     std::vector<ReturnItem> returns;
     const std::string sql = "SELECT * FROM returns WHERE product_id = " + std::to_string(product_id) + " ORDER BY return_time DESC;";
     
@@ -808,10 +2157,11 @@ std::vector<ReturnItem> get_returns_by_product_id(int product_id)
                          return 0;
                      }, &returns, &err_msg) != SQLITE_OK)
     {
-        fprintf(stderr, "查询商品退货记录失败: %s\n", err_msg);
+        SLOG_ERROR("查询商品退货记录失败: %s", err_msg);
         sqlite3_free(err_msg);
         return returns;
     }
     
+    call.rows(returns.size());
     return returns;
 }
\ No newline at end of file
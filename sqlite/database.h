@@ -3,7 +3,8 @@
 #include <string>
 #include "saleStruct.h"
 
-bool init_db();
+bool init_db(const std::string& path = "sales.db");
+void close_db();
 int getIdFromName(const std::string& name);
 bool add_product(const std::string& name, double price, int stock, int alert_threshold = 10);
 Product query_product(int id);
@@ -11,9 +12,10 @@ Product query_product(const std::string& name);
 bool update_stock(int id, int new_stock);
 int update_stock(const std::string& name, int new_stock);
 std::vector<Product> get_all_products();
-bool save_transaction(const Transaction& transaction);
+bool save_transaction(const Transaction& transaction, std::vector<StockConflict>* conflicts = nullptr);
 std::vector<Transaction> get_all_transactions();
 std::vector<CartItem> get_cart_items_by_transaction_id(int transaction_id);
+TransactionDetail get_transaction_detail(int transaction_id);
 std::vector<Product> get_low_stock_products();
 bool delete_product(int id);
 bool delete_product(const std::string& name);
@@ -24,8 +26,24 @@ bool set_product_alert_threshold(const std::string& name, int threshold);
 int get_product_alert_threshold(int id);
 int get_product_alert_threshold(const std::string& name);
 
+// 条码相关函数
+// GS1条码（EAN-8、UPC-A、EAN-13、GTIN-14）：全为数字且末位校验位正确
+bool is_valid_barcode(const std::string& barcode);
+// 设置商品条码，barcode为空时清除；条码无效或已被其他商品使用时失败
+bool set_product_barcode(int id, const std::string& barcode, std::string* errorMsg = nullptr);
+// 新增带条码的商品，barcode为空时同add_product；条码无效或已被其他商品使用时不新增
+bool add_product(const std::string& name, double price, int stock, int alert_threshold, const std::string& barcode,
+                 std::string* errorMsg = nullptr);
+// 扫码查找商品，优先使用商品目录快照的条码索引，找不到时id为-1
+Product query_product_by_barcode(const std::string& barcode);
+
+// 进货相关函数
+bool restock_products(const std::vector<RestockLine>& lines, std::vector<Product>* updated = nullptr, std::string* errorMsg = nullptr);
+bool load_restock_csv(const std::string& path, std::vector<RestockLine>& lines, std::string* errorMsg = nullptr);
+
 // 退货相关函数
 bool add_return(int transaction_id, int product_id, int quantity, const std::string& reason = "");
+bool add_return_slip(int transaction_id, const std::vector<ReturnLine>& lines, std::string* errorMsg = nullptr);
 std::vector<ReturnItem> get_all_returns();
 std::vector<ReturnItem> get_returns_by_transaction_id(int transaction_id);
 std::vector<ReturnItem> get_returns_by_product_id(int product_id);
@@ -0,0 +1,171 @@
+#ifndef DB_INTERNAL_H
+#define DB_INTERNAL_H
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include "saleStruct.h"
+#include "lowstock.h"
+
+// 数据层内部共享的连接与工具函数，仅供sqlite目录下的模块使用
+
+// 当前线程的连接，由init_db打开；未调用init_db的线程为nullptr，不能借用其他线程的连接
+extern thread_local sqlite3* db;
+
+// 在指定连接上加载交易明细聚合，后台线程使用自己的只读连接调用
+TransactionDetail load_transaction_detail(sqlite3* conn, int transaction_id);
+
+// 缓存的预编译语句：同一线程的连接上反复执行的语句只编译一次。
+// 析构时自动reset，避免语句保持活动状态而占用读锁
+class CachedStatement
+{
+public:
+    explicit CachedStatement(const char* sql);
+    ~CachedStatement();
+    CachedStatement(const CachedStatement&) = delete;
+    CachedStatement& operator=(const CachedStatement&) = delete;
+
+    sqlite3_stmt* get() const { return m_stmt; }
+    explicit operator bool() const { return m_stmt != nullptr; }
+
+private:
+    sqlite3_stmt* m_stmt;
+};
+
+// 释放当前线程缓存的全部语句，关闭连接前调用
+void finalize_cached_statements();
+
+// 写事务体的执行结果
+enum class WriteStatus
+{
+    Ok,     // 提交事务
+    Busy,   // 遇到SQLITE_BUSY/SQLITE_LOCKED，回滚后重试
+    Failed  // 回滚并放弃
+};
+
+// 将sqlite返回码归类为写事务结果
+WriteStatus write_status_of(int rc);
+
+// 在BEGIN IMMEDIATE写事务中执行body并提交，忙或锁冲突时回滚并有界退避重试。
+// body可能被执行多次，每次执行前需要自行清空上一次收集的结果
+bool run_write_transaction(const char* operation, const std::function<WriteStatus()>& body);
+
+// 写事务的锁冲突统计，所有线程累计
+struct WriteContention
+{
+    unsigned long long busy_retries;   // 因SQLITE_BUSY/SQLITE_LOCKED回滚重试的次数
+    unsigned long long busy_failures;  // 重试耗尽后放弃的事务数
+    unsigned long long lock_waits;     // BEGIN IMMEDIATE在busy_timeout内等待写锁的次数
+    unsigned long long lock_wait_us;   // 上述等待的总时长（微秒）
+};
+
+WriteContention get_write_contention();
+
+// 入口函数计时：在数据层公开函数开头构造，析构时把耗时、返回行数和修改行数记入统计
+class QueryCall
+{
+public:
+    explicit QueryCall(const char* name);
+    ~QueryCall();
+    QueryCall(const QueryCall&) = delete;
+    QueryCall& operator=(const QueryCall&) = delete;
+
+    void rows(const std::uint64_t count) { m_rows = count; }
+
+private:
+    const char* m_name;
+    std::uint64_t m_rows;
+    sqlite3_int64 m_changesBefore;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// 在连接上注册sqlite3_trace_v2回调，按语句汇总sqlite3_stmt_status计数并记录慢查询
+void install_query_tracing(sqlite3* conn);
+
+// 在写事务中把退货数量按item_id顺序分摊到该交易中该商品的各购物车项（同一商品可能分在多行），
+// amount为按各行实付单价计算的退货金额；剩余可退数量合计不足时不修改任何行，enough为false
+WriteStatus mark_returned_items(long long transaction_id, int product_id, int quantity, bool& enough, double& amount);
+// 同一商品的退货金额按数量分给退货单中该商品的各行，最后一行取剩余金额，各行之和等于分摊的金额
+double take_return_amount(double& amount_left, long long& quantity_left, int quantity);
+
+// 写事务提交后把新的销售行追加到列式销售日志；日志未打开或正被其他线程、进程占用时直接返回，
+// 未追加的行由下一次同步按水位补上
+void try_sync_sales_log();
+
+// 从商品目录快照读取全部商品并覆盖当前库存；快照未打开、已过期且无法重新生成时返回false，调用方回退到SQL
+bool read_catalog_snapshot(std::vector<Product>& products);
+// 在快照中按名称查找商品ID，找不到时id为-1；快照不可用时返回false
+bool find_catalog_snapshot_id(const std::string& name, int& id);
+// 在快照中按条码查找商品，填写ID、名称、单价、条码和生成快照时的库存，找不到时id为-1；快照不可用时返回false
+bool find_catalog_snapshot_barcode(const std::string& barcode, Product& product);
+// 新增、删除商品或修改名称、单价、预警阈值提交后调用，快照已打开时立即重新生成
+void note_catalog_changed();
+
+// 事件溯源（journal.cpp）
+// 在当前连接上创建记录商品表修改的临时触发器，init_db调用
+void install_journal_capture();
+// 是否处于事件溯源模式，在写事务内调用时与事务看到的状态一致
+bool journal_enabled();
+// 写操作自己记录事件时屏蔽临时触发器，析构时恢复；只在写事务体内构造，active为false或连接没有触发器时什么也不做
+class JournalMute
+{
+public:
+    explicit JournalMute(bool active);
+    ~JournalMute();
+    JournalMute(const JournalMute&) = delete;
+    JournalMute& operator=(const JournalMute&) = delete;
+
+private:
+    bool m_active;
+};
+// 在写事务内投影全部待投影的销售事件，库存变化追加到changed，提交后由调用方发布
+WriteStatus project_pending_events(std::vector<LowStockEntry>& changed);
+// 在写事务内追加事件。销售事件扣除待投影销售后校验库存，不足时填写conflicts并返回Failed，
+// 成功时分配交易ID
+WriteStatus append_sale_event(const Transaction& transaction, int& transaction_id, std::vector<StockConflict>& conflicts);
+WriteStatus append_return_event(int transaction_id, const std::vector<ReturnLine>& lines, long long return_time, double amount);
+WriteStatus append_restock_event(const std::map<int, long long>& quantities);
+
+// 门店复制（replication.cpp）
+// 开启复制时确保当前连接有记录变更的会话，关闭时释放；init_db和每个写事务开始时调用
+void ensure_replication_capture();
+// 写事务提交前调用：把会话记录的变更写入发件箱，与业务修改一同提交
+WriteStatus stage_replication_changes();
+// 写事务结束后调用：提交成功时丢弃已写入发件箱的会话，回滚时恢复原会话
+void finish_replication_capture(bool committed);
+// 关闭连接前释放会话
+void release_replication_capture();
+// 在写事务体内暂停会话记录，析构时恢复；归档从门店库搬走的交易不应在总部被删除
+class ReplicationMute
+{
+public:
+    ReplicationMute();
+    ~ReplicationMute();
+    ReplicationMute(const ReplicationMute&) = delete;
+    ReplicationMute& operator=(const ReplicationMute&) = delete;
+
+private:
+    bool m_active;
+};
+
+// 组提交中的一笔交易
+struct BatchedSale
+{
+    const Transaction* transaction = nullptr;
+    bool saved = false;                     // 是否随批次提交
+    std::vector<StockConflict> conflicts;   // 库存不足的行
+};
+
+// 组提交：在一个写事务中依次保存多笔交易，每笔在各自的保存点中执行，库存不足等失败只回滚该笔，
+// 整批只提交一次、写盘一次。整个事务失败时返回false，各笔saved均为false
+bool save_transaction_batch(std::vector<BatchedSale>& sales);
+
+// 批量导入模式：关闭外键检查与同步写盘并删除二级索引，
+// 调用方自行分批提交事务，结束时重建索引、更新统计信息并重建低库存集合与明细缓存
+bool begin_bulk_load();
+bool end_bulk_load();
+
+#endif // DB_INTERNAL_H
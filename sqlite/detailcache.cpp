@@ -0,0 +1,336 @@
+#include "detailcache.h"
+#include "database.h"
+#include "db_internal.h"
+#include "log.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace
+{
+    // 缓存项读取时的数据库状态：退货表最大return_id与商品目录版本。两者都是已提交的数据，
+    // 任何连接读到的都相同，因此其他终端、salesctl或收银服务写入的退货和商品修改也能发现
+    struct DetailStamp
+    {
+        long long returns_mark = -1;
+        long long catalog_version = -1;
+
+        bool valid() const { return returns_mark >= 0 && catalog_version >= 0; }
+        bool operator==(const DetailStamp&) const = default;
+    };
+
+    constexpr const char* kStampSql =
+        "SELECT IFNULL((SELECT MAX(return_id) FROM returns), 0), "
+        "IFNULL((SELECT version FROM catalog_state WHERE id = 1), 0);";
+    constexpr const char* kReturnedSinceSql =
+        "SELECT EXISTS(SELECT 1 FROM returns WHERE return_id > ? AND transaction_id = ?);";
+
+    DetailStamp step_stamp(sqlite3_stmt* stmt)
+    {
+        DetailStamp stamp;
+        if (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            stamp.returns_mark = sqlite3_column_int64(stmt, 0);
+            stamp.catalog_version = sqlite3_column_int64(stmt, 1);
+        }
+        return stamp;
+    }
+
+    // 预取线程的独立连接上读取
+    DetailStamp read_stamp(sqlite3* conn)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(conn, kStampSql, -1, &stmt, nullptr) != SQLITE_OK)
+            stmt = nullptr;
+        const DetailStamp stamp = step_stamp(stmt);
+        sqlite3_finalize(stmt);
+        return stamp;
+    }
+
+    // 当前线程的连接上读取
+    DetailStamp read_stamp()
+    {
+        const CachedStatement stmt(kStampSql);
+        return step_stamp(stmt.get());
+    }
+
+    // 缓存项之后新增的退货是否属于该交易，退货表按主键范围扫描，只涉及新增的几行
+    bool returned_since(const int transaction_id, const long long returns_mark)
+    {
+        const CachedStatement stmt(kReturnedSinceSql);
+        if (!stmt)
+            return true;
+        sqlite3_bind_int64(stmt.get(), 1, returns_mark);
+        sqlite3_bind_int(stmt.get(), 2, transaction_id);
+        return sqlite3_step(stmt.get()) != SQLITE_ROW || sqlite3_column_int(stmt.get(), 0) != 0;
+    }
+
+    class DetailCache
+    {
+    public:
+        ~DetailCache()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+                m_pending.clear();
+            }
+            m_cv.notify_all();
+            if (m_worker.joinable())
+                m_worker.join();
+        }
+
+        bool lookup(const int transaction_id, TransactionDetail* out, DetailStamp* stamp)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const auto it = m_index.find(transaction_id);
+            if (it == m_index.end())
+                return false;
+            // 移到链表头部，表示最近使用
+            m_entries.splice(m_entries.begin(), m_entries, it->second);
+            if (out)
+                *out = it->second->second.detail;
+            if (stamp)
+                *stamp = it->second->second.stamp;
+            return true;
+        }
+
+        // 缓存项仍然有效，记录新的读取状态，下次命中时不必再检查同一批退货
+        void restamp(const int transaction_id, const DetailStamp& stamp)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const auto it = m_index.find(transaction_id);
+            if (it != m_index.end())
+                it->second->second.stamp = stamp;
+        }
+
+        unsigned long long generation()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_generation;
+        }
+
+        // 仅当加载期间没有发生失效时才放入缓存，避免把旧数据写回
+        void insert(const TransactionDetail& detail, const DetailStamp& stamp, const unsigned long long loaded_generation)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (loaded_generation != m_generation)
+                return;
+            insertLocked({detail, stamp});
+        }
+
+        void invalidate(const int transaction_id)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_generation;
+            const auto it = m_index.find(transaction_id);
+            if (it == m_index.end())
+                return;
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+
+        void clear()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_generation;
+            m_entries.clear();
+            m_index.clear();
+        }
+
+        void setCapacity(const std::size_t capacity)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_capacity = capacity > 0 ? capacity : 1;
+            evictLocked();
+        }
+
+        void prefetch(const std::vector<int>& transaction_ids, const std::string& db_path)
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_stopping)
+                    return;
+                m_pending.clear();
+                for (const int id : transaction_ids)
+                {
+                    if (!m_index.contains(id))
+                        m_pending.push_back(id);
+                }
+                if (m_pending.empty())
+                    return;
+                if (m_dbPath != db_path)
+                {
+                    m_dbPath = db_path;
+                    m_reopen = true;
+                }
+                if (!m_worker.joinable())
+                    m_worker = std::thread(&DetailCache::run, this);
+            }
+            m_cv.notify_one();
+        }
+
+    private:
+        struct CachedDetail
+        {
+            TransactionDetail detail;
+            DetailStamp stamp;
+        };
+        using Entry = std::pair<int, CachedDetail>;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::list<Entry> m_entries;
+        std::unordered_map<int, std::list<Entry>::iterator> m_index;
+        std::size_t m_capacity = 64;
+        unsigned long long m_generation = 0;
+
+        std::thread m_worker;
+        std::deque<int> m_pending;
+        std::string m_dbPath;
+        bool m_reopen = false;
+        bool m_stopping = false;
+
+        void insertLocked(CachedDetail cached)
+        {
+            const int id = cached.detail.transaction.transaction_id;
+            const auto it = m_index.find(id);
+            if (it != m_index.end())
+            {
+                it->second->second = std::move(cached);
+                m_entries.splice(m_entries.begin(), m_entries, it->second);
+                return;
+            }
+            m_entries.emplace_front(id, std::move(cached));
+            m_index[id] = m_entries.begin();
+            evictLocked();
+        }
+
+        void evictLocked()
+        {
+            while (m_entries.size() > m_capacity)
+            {
+                m_index.erase(m_entries.back().first);
+                m_entries.pop_back();
+            }
+        }
+
+        // 预取线程使用独立的只读连接，不与界面线程共享连接上的事务状态
+        void run()
+        {
+            sqlite3* conn = nullptr;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (true)
+            {
+                m_cv.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+                if (m_stopping)
+                    break;
+
+                if (m_reopen || !conn)
+                {
+                    const std::string path = m_dbPath;
+                    m_reopen = false;
+                    lock.unlock();
+                    sqlite3_close(conn);
+                    conn = nullptr;
+                    if (sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+                    {
+                        SLOG_ERROR("预取连接打开失败: %s", sqlite3_errmsg(conn));
+                        sqlite3_close(conn);
+                        conn = nullptr;
+                    }
+                    else
+                    {
+                        sqlite3_busy_timeout(conn, 200);
+                        install_query_tracing(conn);
+                    }
+                    lock.lock();
+                    if (!conn)
+                    {
+                        m_pending.clear();
+                        continue;
+                    }
+                }
+
+                const int id = m_pending.front();
+                m_pending.pop_front();
+                if (m_index.contains(id))
+                    continue;
+                const unsigned long long loaded_generation = m_generation;
+
+                lock.unlock();
+                // 先取状态再读明细，期间提交的退货只会让下次命中时多检查一次
+                const DetailStamp stamp = read_stamp(conn);
+                TransactionDetail detail = load_transaction_detail(conn, id);
+                lock.lock();
+
+                if (detail.transaction.transaction_id != -1 && stamp.valid() && loaded_generation == m_generation)
+                    insertLocked({std::move(detail), stamp});
+            }
+            lock.unlock();
+            sqlite3_close(conn);
+        }
+    };
+
+    DetailCache& cache()
+    {
+        static DetailCache instance;
+        return instance;
+    }
+}
+
+TransactionDetail get_transaction_detail_cached(const int transaction_id)
+{
+    TransactionDetail detail;
+    DetailStamp cached_stamp;
+    if (cache().lookup(transaction_id, &detail, &cached_stamp))
+    {
+        // 命中时确认读取之后没有影响该小票的提交：商品目录未变，且新增的退货都不属于该交易
+        const DetailStamp current = read_stamp();
+        if (current == cached_stamp)
+            return detail;
+        if (current.valid() && current.catalog_version == cached_stamp.catalog_version &&
+            !returned_since(transaction_id, cached_stamp.returns_mark))
+        {
+            cache().restamp(transaction_id, current);
+            return detail;
+        }
+    }
+
+    const unsigned long long loaded_generation = cache().generation();
+    const DetailStamp stamp = read_stamp();
+    detail = get_transaction_detail(transaction_id);
+    if (detail.transaction.transaction_id != -1 && stamp.valid())
+        cache().insert(detail, stamp, loaded_generation);
+    return detail;
+}
+
+void prefetch_transaction_details(const std::vector<int>& transaction_ids)
+{
+    const char* path = sqlite3_db_filename(db, "main");
+    // 内存数据库没有文件名，其他连接无法访问，不做预取
+    if (!path || path[0] == '\0')
+        return;
+    cache().prefetch(transaction_ids, path);
+}
+
+void invalidate_transaction_detail(const int transaction_id)
+{
+    cache().invalidate(transaction_id);
+}
+
+void clear_transaction_detail_cache()
+{
+    cache().clear();
+}
+
+void set_transaction_detail_cache_capacity(const std::size_t capacity)
+{
+    cache().setCapacity(capacity);
+}
@@ -0,0 +1,19 @@
+#ifndef DETAILCACHE_H
+#define DETAILCACHE_H
+#include <cstddef>
+#include <vector>
+#include "saleStruct.h"
+
+// 交易明细LRU缓存：未命中时查询数据库并放入缓存。命中时先确认读取之后商品目录未变、也没有该交易的新退货，
+// 其他进程（其他终端、salesctl、收银服务）提交的退货和商品修改同样会使缓存项重新读取；库存数量不做检查
+TransactionDetail get_transaction_detail_cached(int transaction_id);
+// 在后台线程预取一组交易明细（如当前选中行的相邻行），新请求会替换尚未处理的旧请求
+void prefetch_transaction_details(const std::vector<int>& transaction_ids);
+// 使某笔交易的缓存失效，退货等修改交易明细的操作之后调用
+void invalidate_transaction_detail(int transaction_id);
+// 清空全部缓存，商品名称或单价变化时调用
+void clear_transaction_detail_cache();
+// 设置缓存容量（交易笔数），默认64
+void set_transaction_detail_cache_capacity(std::size_t capacity);
+
+#endif // DETAILCACHE_H
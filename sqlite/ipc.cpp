@@ -0,0 +1,571 @@
+#include "ipc.h"
+#include "daemon.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+void WireWriter::u16(const std::uint16_t value)
+{
+    u8(static_cast<std::uint8_t>(value));
+    u8(static_cast<std::uint8_t>(value >> 8));
+}
+
+void WireWriter::u32(const std::uint32_t value)
+{
+    for (int shift = 0; shift < 32; shift += 8)
+        u8(static_cast<std::uint8_t>(value >> shift));
+}
+
+void WireWriter::i64(const std::int64_t value)
+{
+    const auto bits = static_cast<std::uint64_t>(value);
+    for (int shift = 0; shift < 64; shift += 8)
+        u8(static_cast<std::uint8_t>(bits >> shift));
+}
+
+void WireWriter::f32(const float value)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    u32(bits);
+}
+
+void WireWriter::f64(const double value)
+{
+    std::int64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    i64(bits);
+}
+
+void WireWriter::str(const std::string& value)
+{
+    u32(static_cast<std::uint32_t>(value.size()));
+    m_buf.append(value);
+}
+
+bool WireReader::take(void* out, const size_t size)
+{
+    if (!m_ok || static_cast<size_t>(m_end - m_pos) < size)
+    {
+        m_ok = false;
+        std::memset(out, 0, size);
+        return false;
+    }
+    std::memcpy(out, m_pos, size);
+    m_pos += size;
+    return true;
+}
+
+std::uint8_t WireReader::u8()
+{
+    std::uint8_t value;
+    take(&value, 1);
+    return value;
+}
+
+std::uint16_t WireReader::u16()
+{
+    unsigned char bytes[2];
+    take(bytes, sizeof(bytes));
+    return static_cast<std::uint16_t>(bytes[0] | bytes[1] << 8);
+}
+
+std::uint32_t WireReader::u32()
+{
+    unsigned char bytes[4];
+    take(bytes, sizeof(bytes));
+    std::uint32_t value = 0;
+    for (int i = 3; i >= 0; --i)
+        value = value << 8 | bytes[i];
+    return value;
+}
+
+std::int64_t WireReader::i64()
+{
+    unsigned char bytes[8];
+    take(bytes, sizeof(bytes));
+    std::uint64_t value = 0;
+    for (int i = 7; i >= 0; --i)
+        value = value << 8 | bytes[i];
+    return static_cast<std::int64_t>(value);
+}
+
+float WireReader::f32()
+{
+    const std::uint32_t bits = u32();
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+double WireReader::f64()
+{
+    const std::int64_t bits = i64();
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string WireReader::str()
+{
+    const std::uint32_t size = u32();
+    if (!m_ok || static_cast<size_t>(m_end - m_pos) < size)
+    {
+        m_ok = false;
+        return {};
+    }
+    std::string value(m_pos, size);
+    m_pos += size;
+    return value;
+}
+
+std::uint32_t WireReader::count()
+{
+    const std::uint32_t size = u32();
+    if (m_ok && static_cast<size_t>(m_end - m_pos) < size)
+        m_ok = false;
+    return m_ok ? size : 0;
+}
+
+void write_wire(WireWriter& out, const Product& product)
+{
+    out.i32(product.id);
+    out.str(product.name);
+    out.f32(product.price);
+    out.i32(product.stock);
+    out.str(product.barcode);
+}
+
+void read_wire(WireReader& in, Product& product)
+{
+    product.id = in.i32();
+    product.name = in.str();
+    product.price = in.f32();
+    product.stock = in.i32();
+    product.barcode = in.str();
+}
+
+void write_wire(WireWriter& out, const CartItem& item)
+{
+    write_wire(out, item.product);
+    out.i32(item.quantity);
+    out.i32(item.returned_quantity);
+    out.f32(item.subtotal);
+    out.f32(item.discount);
+    out.i32(item.promotion_id);
+}
+
+void read_wire(WireReader& in, CartItem& item)
+{
+    read_wire(in, item.product);
+    item.quantity = in.i32();
+    item.returned_quantity = in.i32();
+    item.subtotal = in.f32();
+    item.discount = in.f32();
+    item.promotion_id = in.i32();
+}
+
+void write_wire(WireWriter& out, const Transaction& transaction)
+{
+    out.i32(transaction.transaction_id);
+    write_wire(out, transaction.cart.items);
+    out.f32(transaction.cart.total_price);
+    out.i64(transaction.create_time);
+    out.boolean(transaction.is_paid);
+    out.f32(transaction.total_price);
+    out.f32(transaction.amount_paid);
+    out.f32(transaction.change);
+}
+
+void read_wire(WireReader& in, Transaction& transaction)
+{
+    transaction.transaction_id = in.i32();
+    read_wire(in, transaction.cart.items);
+    transaction.cart.total_price = in.f32();
+    transaction.create_time = static_cast<time_t>(in.i64());
+    transaction.is_paid = in.boolean();
+    transaction.total_price = in.f32();
+    transaction.amount_paid = in.f32();
+    transaction.change = in.f32();
+}
+
+void write_wire(WireWriter& out, const ReturnItem& item)
+{
+    out.i32(item.return_id);
+    out.i32(item.transaction_id);
+    out.i32(item.product_id);
+    out.i32(item.quantity);
+    out.str(item.reason);
+    out.i64(item.return_time);
+}
+
+void read_wire(WireReader& in, ReturnItem& item)
+{
+    item.return_id = in.i32();
+    item.transaction_id = in.i32();
+    item.product_id = in.i32();
+    item.quantity = in.i32();
+    item.reason = in.str();
+    item.return_time = static_cast<time_t>(in.i64());
+}
+
+void write_wire(WireWriter& out, const TransactionLine& line)
+{
+    write_wire(out, line.item);
+    write_wire(out, line.returns);
+}
+
+void read_wire(WireReader& in, TransactionLine& line)
+{
+    read_wire(in, line.item);
+    read_wire(in, line.returns);
+}
+
+void write_wire(WireWriter& out, const TransactionDetail& detail)
+{
+    write_wire(out, detail.transaction);
+    write_wire(out, detail.lines);
+}
+
+void read_wire(WireReader& in, TransactionDetail& detail)
+{
+    read_wire(in, detail.transaction);
+    read_wire(in, detail.lines);
+}
+
+void write_wire(WireWriter& out, const StockConflict& conflict)
+{
+    out.i32(conflict.product_id);
+    out.str(conflict.name);
+    out.i32(conflict.requested);
+    out.i32(conflict.available);
+}
+
+void read_wire(WireReader& in, StockConflict& conflict)
+{
+    conflict.product_id = in.i32();
+    conflict.name = in.str();
+    conflict.requested = in.i32();
+    conflict.available = in.i32();
+}
+
+void write_wire(WireWriter& out, const RestockLine& line)
+{
+    out.i32(line.product_id);
+    out.i32(line.quantity);
+}
+
+void read_wire(WireReader& in, RestockLine& line)
+{
+    line.product_id = in.i32();
+    line.quantity = in.i32();
+}
+
+void write_wire(WireWriter& out, const ReturnLine& line)
+{
+    out.i32(line.product_id);
+    out.i32(line.quantity);
+    out.str(line.reason);
+}
+
+void read_wire(WireReader& in, ReturnLine& line)
+{
+    line.product_id = in.i32();
+    line.quantity = in.i32();
+    line.reason = in.str();
+}
+
+void write_wire(WireWriter& out, const DaemonStats& stats)
+{
+    out.i64(stats.connections);
+    out.i64(stats.active_connections);
+    out.i64(stats.requests);
+    out.i64(stats.checkouts);
+    out.i64(stats.batches);
+    out.i64(stats.max_batch);
+    out.i64(stats.batch_failures);
+}
+
+void read_wire(WireReader& in, DaemonStats& stats)
+{
+    stats.connections = in.i64();
+    stats.active_connections = in.i64();
+    stats.requests = in.i64();
+    stats.checkouts = in.i64();
+    stats.batches = in.i64();
+    stats.max_batch = in.i64();
+    stats.batch_failures = in.i64();
+}
+
+namespace
+{
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        if (errorMsg) *errorMsg = err;
+    }
+
+    std::string last_socket_error()
+    {
+#ifdef _WIN32
+        return "WSA错误 " + std::to_string(WSAGetLastError());
+#else
+        return std::strerror(errno);
+#endif
+    }
+
+    // Winsock在进程内初始化一次
+    bool ensure_sockets()
+    {
+#ifdef _WIN32
+        static const bool ready = []
+        {
+            WSADATA data;
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        return ready;
+#else
+        return true;
+#endif
+    }
+
+    bool make_address(const std::string& path, sockaddr_un& address, std::string* errorMsg)
+    {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+        {
+            fail(errorMsg, "套接字路径为空或过长: " + path);
+            return false;
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size());
+        return true;
+    }
+
+    LocalSocket open_socket(std::string* errorMsg)
+    {
+        if (!ensure_sockets())
+        {
+            fail(errorMsg, "初始化套接字失败");
+            return kInvalidSocket;
+        }
+        const LocalSocket s = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (s == kInvalidSocket)
+            fail(errorMsg, "创建套接字失败: " + last_socket_error());
+        return s;
+    }
+
+    bool send_all(const LocalSocket s, const char* data, size_t size)
+    {
+        while (size > 0)
+        {
+#ifdef _WIN32
+            const int sent = send(s, data, static_cast<int>(size), 0);
+#elif defined(MSG_NOSIGNAL)
+            const ssize_t sent = send(s, data, size, MSG_NOSIGNAL);
+#else
+            const ssize_t sent = send(s, data, size, 0);
+#endif
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            data += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool recv_all(const LocalSocket s, char* data, size_t size)
+    {
+        while (size > 0)
+        {
+#ifdef _WIN32
+            const int got = recv(s, data, static_cast<int>(size), 0);
+#else
+            const ssize_t got = recv(s, data, size, 0);
+#endif
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                return false;
+            data += got;
+            size -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    int poll_socket(const LocalSocket s, const int timeout_ms)
+    {
+#ifdef _WIN32
+        WSAPOLLFD entry = {s, POLLIN, 0};
+        return WSAPoll(&entry, 1, timeout_ms) > 0 ? entry.revents : 0;
+#else
+        pollfd entry = {s, POLLIN, 0};
+        return poll(&entry, 1, timeout_ms) > 0 ? entry.revents : 0;
+#endif
+    }
+}
+
+LocalSocket listen_local_socket(const std::string& path, std::string* errorMsg)
+{
+    sockaddr_un address;
+    if (!make_address(path, address, errorMsg))
+        return kInvalidSocket;
+
+    // 能连上说明已有服务在运行；连不上的套接字文件是上次异常退出留下的
+    const LocalSocket probe = connect_local_socket(path);
+    if (probe != kInvalidSocket)
+    {
+        close_local_socket(probe);
+        fail(errorMsg, "已有收银服务在监听 " + path);
+        return kInvalidSocket;
+    }
+    std::remove(path.c_str());
+
+    const LocalSocket s = open_socket(errorMsg);
+    if (s == kInvalidSocket)
+        return kInvalidSocket;
+    if (bind(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        fail(errorMsg, "监听 " + path + " 失败: " + last_socket_error());
+        close_local_socket(s);
+        return kInvalidSocket;
+    }
+#ifndef _WIN32
+    // 连接需要对套接字文件有写权限：只允许服务的用户连接。在listen之前修改，不留可连接的窗口
+    if (chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0)
+    {
+        fail(errorMsg, "设置 " + path + " 的权限失败: " + std::string(std::strerror(errno)));
+        close_local_socket(s);
+        std::remove(path.c_str());
+        return kInvalidSocket;
+    }
+#endif
+    if (listen(s, 64) != 0)
+    {
+        fail(errorMsg, "监听 " + path + " 失败: " + last_socket_error());
+        close_local_socket(s);
+        std::remove(path.c_str());
+        return kInvalidSocket;
+    }
+    return s;
+}
+
+LocalSocket connect_local_socket(const std::string& path, std::string* errorMsg)
+{
+    sockaddr_un address;
+    if (!make_address(path, address, errorMsg))
+        return kInvalidSocket;
+    const LocalSocket s = open_socket(errorMsg);
+    if (s == kInvalidSocket)
+        return kInvalidSocket;
+    if (connect(s, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        fail(errorMsg, "连接收银服务 " + path + " 失败: " + last_socket_error());
+        close_local_socket(s);
+        return kInvalidSocket;
+    }
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+    const int on = 1;
+    setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    return s;
+}
+
+LocalSocket accept_local_socket(const LocalSocket listener, const int timeout_ms)
+{
+    if (!(poll_socket(listener, timeout_ms) & POLLIN))
+        return kInvalidSocket;
+    const LocalSocket s = accept(listener, nullptr, nullptr);
+#if !defined(_WIN32) && !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+    if (s != kInvalidSocket)
+    {
+        const int on = 1;
+        setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    }
+#endif
+    return s;
+}
+
+bool local_peer_allowed(const LocalSocket socket)
+{
+#if defined(_WIN32)
+    // Windows的AF_UNIX按套接字文件的访问控制列表限制连接，没有对端凭据
+    (void)socket;
+    return true;
+#elif defined(SO_PEERCRED)
+    ucred credentials{};
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0)
+        return false;
+    return credentials.uid == geteuid() || credentials.uid == 0;
+#else
+    uid_t uid = 0;
+    gid_t gid = 0;
+    if (getpeereid(socket, &uid, &gid) != 0)
+        return false;
+    return uid == geteuid() || uid == 0;
+#endif
+}
+
+void close_local_socket(const LocalSocket socket)
+{
+    if (socket == kInvalidSocket)
+        return;
+#ifdef _WIN32
+    closesocket(socket);
+#else
+    close(socket);
+#endif
+}
+
+void shutdown_local_socket(const LocalSocket socket)
+{
+#ifdef _WIN32
+    shutdown(socket, SD_BOTH);
+#else
+    shutdown(socket, SHUT_RDWR);
+#endif
+}
+
+bool local_peer_closed(const LocalSocket socket)
+{
+    // 请求应答严格交替，空闲连接上可读只可能是对端关闭
+    return poll_socket(socket, 0) != 0;
+}
+
+bool send_frame(const LocalSocket socket, const std::string& payload)
+{
+    if (payload.size() > kMaxFrameBytes)
+        return false;
+    // 长度和负载一次发送，小请求只需一次系统调用
+    std::string frame;
+    frame.reserve(4 + payload.size());
+    for (int shift = 0; shift < 32; shift += 8)
+        frame.push_back(static_cast<char>(payload.size() >> shift));
+    frame.append(payload);
+    return send_all(socket, frame.data(), frame.size());
+}
+
+bool recv_frame(const LocalSocket socket, std::string& payload)
+{
+    unsigned char header[4];
+    if (!recv_all(socket, reinterpret_cast<char*>(header), sizeof(header)))
+        return false;
+    const std::uint32_t size = header[0] | header[1] << 8 | header[2] << 16 | static_cast<std::uint32_t>(header[3]) << 24;
+    if (size > kMaxFrameBytes)
+        return false;
+    payload.resize(size);
+    return size == 0 || recv_all(socket, payload.data(), size);
+}
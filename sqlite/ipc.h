@@ -0,0 +1,173 @@
+#ifndef IPC_H
+#define IPC_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "saleStruct.h"
+
+struct DaemonStats;
+
+// 收银服务的本地套接字与二进制协议，仅供daemon.cpp和daemonclient.cpp使用。
+// 每条消息为4字节小端长度加负载；请求负载以1字节操作码开头，随后依次是参数，应答负载依次是返回值和输出参数。
+// 整数按小端定长编码，float和double按IEEE 754位模式编码，字符串和数组以4字节长度开头。
+// 连接建立后客户端先发送Hello（魔数和协议版本），服务端回复版本；版本不一致或消息无法解析时服务端关闭连接
+
+constexpr std::uint32_t kDaemonMagic = 0x44534C53;     // "SLSD"
+constexpr std::uint16_t kDaemonProtocolVersion = 1;
+constexpr std::uint32_t kMaxFrameBytes = 64u << 20;     // 单条消息上限，全部商品或交易列表也远小于此
+
+// 操作码，与database.h中的函数一一对应；只能在末尾追加
+enum class DaemonOp : std::uint8_t
+{
+    Hello = 1,
+    Stats,
+    GetIdFromName,
+    AddProduct,
+    AddProductWithBarcode,
+    QueryProductById,
+    QueryProductByName,
+    QueryProductByBarcode,
+    UpdateStockById,
+    UpdateStockByName,
+    GetAllProducts,
+    SaveTransaction,
+    GetAllTransactions,
+    GetCartItems,
+    GetTransactionDetail,
+    GetLowStockProducts,
+    DeleteProductById,
+    DeleteProductByName,
+    UpdateProductById,
+    UpdateProductByName,
+    SetAlertThresholdById,
+    SetAlertThresholdByName,
+    GetAlertThresholdById,
+    GetAlertThresholdByName,
+    SetProductBarcode,
+    RestockProducts,
+    AddReturn,
+    AddReturnSlip,
+    GetAllReturns,
+    GetReturnsByTransaction,
+    GetReturnsByProduct,
+};
+
+// 消息编码
+class WireWriter
+{
+public:
+    void u8(std::uint8_t value) { m_buf.push_back(static_cast<char>(value)); }
+    void u16(std::uint16_t value);
+    void u32(std::uint32_t value);
+    void i32(std::int32_t value) { u32(static_cast<std::uint32_t>(value)); }
+    void i64(std::int64_t value);
+    void f32(float value);
+    void f64(double value);
+    void boolean(bool value) { u8(value ? 1 : 0); }
+    void str(const std::string& value);
+
+    const std::string& data() const { return m_buf; }
+    void clear() { m_buf.clear(); }
+
+private:
+    std::string m_buf;
+};
+
+// 消息解码：越界或长度非法时ok()变为false，之后的读取都返回0或空
+class WireReader
+{
+public:
+    explicit WireReader(const std::string& data) : m_pos(data.data()), m_end(data.data() + data.size()) {}
+
+    std::uint8_t u8();
+    std::uint16_t u16();
+    std::uint32_t u32();
+    std::int32_t i32() { return static_cast<std::int32_t>(u32()); }
+    std::int64_t i64();
+    float f32();
+    double f64();
+    bool boolean() { return u8() != 0; }
+    std::string str();
+    // 读取数组长度，超过剩余字节数（每个元素至少1字节）时视为非法
+    std::uint32_t count();
+
+    bool ok() const { return m_ok; }
+    // 全部读完且没有出错，服务端据此拒绝多余字节的请求
+    bool done() const { return m_ok && m_pos == m_end; }
+
+private:
+    bool take(void* out, size_t size);
+
+    const char* m_pos;
+    const char* m_end;
+    bool m_ok = true;
+};
+
+void write_wire(WireWriter& out, const Product& product);
+void write_wire(WireWriter& out, const CartItem& item);
+void write_wire(WireWriter& out, const Transaction& transaction);
+void write_wire(WireWriter& out, const ReturnItem& item);
+void write_wire(WireWriter& out, const TransactionLine& line);
+void write_wire(WireWriter& out, const TransactionDetail& detail);
+void write_wire(WireWriter& out, const StockConflict& conflict);
+void write_wire(WireWriter& out, const RestockLine& line);
+void write_wire(WireWriter& out, const ReturnLine& line);
+void write_wire(WireWriter& out, const DaemonStats& stats);
+
+void read_wire(WireReader& in, Product& product);
+void read_wire(WireReader& in, CartItem& item);
+void read_wire(WireReader& in, Transaction& transaction);
+void read_wire(WireReader& in, ReturnItem& item);
+void read_wire(WireReader& in, TransactionLine& line);
+void read_wire(WireReader& in, TransactionDetail& detail);
+void read_wire(WireReader& in, StockConflict& conflict);
+void read_wire(WireReader& in, RestockLine& line);
+void read_wire(WireReader& in, ReturnLine& line);
+void read_wire(WireReader& in, DaemonStats& stats);
+
+template <typename T>
+void write_wire(WireWriter& out, const std::vector<T>& items)
+{
+    out.u32(static_cast<std::uint32_t>(items.size()));
+    for (const auto& item : items)
+        write_wire(out, item);
+}
+
+template <typename T>
+void read_wire(WireReader& in, std::vector<T>& items)
+{
+    const std::uint32_t size = in.count();
+    items.clear();
+    items.reserve(size);
+    for (std::uint32_t i = 0; i < size && in.ok(); ++i)
+    {
+        items.emplace_back();
+        read_wire(in, items.back());
+    }
+}
+
+// 本地套接字：Unix域套接字，Windows 10起的AF_UNIX也可用
+#ifdef _WIN32
+using LocalSocket = std::uintptr_t;
+#else
+using LocalSocket = int;
+#endif
+constexpr LocalSocket kInvalidSocket = static_cast<LocalSocket>(-1);
+
+// 在path上监听；已有服务在监听时失败，残留的套接字文件会被删除。套接字文件权限设为0600
+LocalSocket listen_local_socket(const std::string& path, std::string* errorMsg = nullptr);
+LocalSocket connect_local_socket(const std::string& path, std::string* errorMsg = nullptr);
+// 等待新连接，timeout_ms内没有连接时返回kInvalidSocket
+LocalSocket accept_local_socket(LocalSocket listener, int timeout_ms);
+// 对端进程的用户是否与服务相同（或为root）；套接字文件已限制为仅属主可连接，这里再按对端凭据确认
+bool local_peer_allowed(LocalSocket socket);
+void close_local_socket(LocalSocket socket);
+// 关闭读写方向，阻塞在recv_frame上的线程随即返回
+void shutdown_local_socket(LocalSocket socket);
+// 对端是否已关闭连接（不阻塞）；复用空闲连接发送写请求前检查，避免把请求发到已失效的连接上
+bool local_peer_closed(LocalSocket socket);
+bool send_frame(LocalSocket socket, const std::string& payload);
+// 读取一条消息，连接关闭、出错或长度超过kMaxFrameBytes时返回false
+bool recv_frame(LocalSocket socket, std::string& payload);
+
+#endif // IPC_H
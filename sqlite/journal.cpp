@@ -0,0 +1,915 @@
+#include "journal.h"
+#include "database.h"
+#include "db_internal.h"
+#include "detailcache.h"
+#include "lowstock.h"
+#include "log.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    constexpr int kKeptSnapshots = 4;          // 基准快照之外保留的最近快照数
+    constexpr int kReplayChunk = 1000;         // 重放和追上时每次读取的事件数
+    std::atomic<long long> g_snapshotInterval{10000};
+
+    // 当前线程的连接是否装有记录商品表修改的临时触发器
+    thread_local bool t_captureInstalled = false;
+
+    // 临时触发器只存在于init_db打开的连接上；投影线程自己的连接没有，投影时不会重复记录。
+    // 库存记为增量，与尚未投影的销售事件先后次序无关
+    const char* const sql_capture[] = {
+        "CREATE TEMP TABLE IF NOT EXISTS journal_mute (muted INTEGER NOT NULL);",
+        "INSERT INTO journal_mute SELECT 0 WHERE NOT EXISTS (SELECT 1 FROM journal_mute);",
+        "CREATE TEMP TRIGGER IF NOT EXISTS journal_capture_insert AFTER INSERT ON main.products "
+        "WHEN (SELECT enabled FROM journal_state WHERE id = 1) AND NOT (SELECT muted FROM journal_mute) "
+        "BEGIN INSERT INTO sales_journal (event_time, kind, ref_id, payload) "
+        "VALUES (CAST(strftime('%s', 'now') AS INTEGER), 'product', NEW.id, json_object('op', 'insert', "
+        "'name', NEW.name, 'price', NEW.price, 'stock', NEW.stock, 'alert_threshold', NEW.alert_threshold, "
+        "'barcode', NEW.barcode)); END;",
+        "CREATE TEMP TRIGGER IF NOT EXISTS journal_capture_update AFTER UPDATE ON main.products "
+        "WHEN (SELECT enabled FROM journal_state WHERE id = 1) AND NOT (SELECT muted FROM journal_mute) "
+        "BEGIN INSERT INTO sales_journal (event_time, kind, ref_id, payload) "
+        "VALUES (CAST(strftime('%s', 'now') AS INTEGER), 'product', NEW.id, json_object('op', 'update', "
+        "'name', NEW.name, 'price', NEW.price, 'alert_threshold', NEW.alert_threshold, 'barcode', NEW.barcode, "
+        "'stock_delta', NEW.stock - OLD.stock)); END;",
+        "CREATE TEMP TRIGGER IF NOT EXISTS journal_capture_delete AFTER DELETE ON main.products "
+        "WHEN (SELECT enabled FROM journal_state WHERE id = 1) AND NOT (SELECT muted FROM journal_mute) "
+        "BEGIN INSERT INTO sales_journal (event_time, kind, ref_id, payload) "
+        "VALUES (CAST(strftime('%s', 'now') AS INTEGER), 'product', OLD.id, json_object('op', 'delete')); END;",
+        // 尚未投影的销售还要写入该商品的购物车项，此时删除商品会让投影违反外键约束
+        "CREATE TEMP TRIGGER IF NOT EXISTS journal_guard_delete BEFORE DELETE ON main.products "
+        "WHEN (SELECT enabled FROM journal_state WHERE id = 1) "
+        "BEGIN SELECT RAISE(ABORT, '商品有尚未投影的销售，暂不能删除') WHERE EXISTS ("
+        "SELECT 1 FROM journal_reserved_stock WHERE product_id = OLD.id AND quantity > 0); END;",
+    };
+
+    long long query_long(const char* sql, const long long bind = 0)
+    {
+        const CachedStatement stmt(sql);
+        if (!stmt)
+            return 0;
+        sqlite3_bind_int64(stmt.get(), 1, bind);
+        return sqlite3_step(stmt.get()) == SQLITE_ROW ? sqlite3_column_int64(stmt.get(), 0) : 0;
+    }
+
+    // 执行一条不返回行的语句，参数依次绑定为整数
+    int exec_bound(const char* sql, std::initializer_list<long long> values)
+    {
+        const CachedStatement stmt(sql);
+        if (!stmt)
+            return sqlite3_errcode(db);
+        int index = 1;
+        for (const long long value : values)
+            sqlite3_bind_int64(stmt.get(), index++, value);
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+        {
+        }
+        return rc;
+    }
+
+    WriteStatus failed_status(const char* what, const int rc)
+    {
+        SLOG_ERROR("%s: %s", what, sqlite3_errmsg(db));
+        return rc == SQLITE_DONE || rc == SQLITE_OK ? WriteStatus::Failed : write_status_of(rc);
+    }
+
+    // 读取RETURNING name, stock, alert_threshold的一行
+    LowStockEntry stock_entry(sqlite3_stmt* stmt, const int product_id)
+    {
+        const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        return {product_id, name ? name : "", sqlite3_column_int(stmt, 1), sqlite3_column_int(stmt, 2)};
+    }
+
+    WriteStatus apply_sale(const long long transaction_id, const char* payload, std::vector<LowStockEntry>& changed)
+    {
+        const CachedStatement insert_transaction(
+            "INSERT INTO transactions (transaction_id, create_time, is_paid, total_price, amount_paid, change) "
+            "VALUES (?1, json_extract(?2, '$.create_time'), json_extract(?2, '$.is_paid'), "
+            "json_extract(?2, '$.total_price'), json_extract(?2, '$.amount_paid'), json_extract(?2, '$.change'));");
+        const CachedStatement items(
+            "SELECT json_extract(value, '$[0]'), json_extract(value, '$[1]'), json_extract(value, '$[2]'), "
+            "IFNULL(json_extract(value, '$[3]'), 0), json_extract(value, '$[4]') "
+            "FROM json_each(?1, '$.items');");
+        const CachedStatement decrement(
+            "UPDATE products SET stock = stock - ?1 WHERE id = ?2 RETURNING name, stock, alert_threshold;");
+        const CachedStatement insert_item(
+            "INSERT INTO cart_items (transaction_id, product_id, quantity, subtotal, discount, promotion_id) "
+            "VALUES (?1, ?2, ?3, round(?4 / 100.0, 2), round(?5 / 100.0, 2), ?6);");
+        const CachedStatement release(
+            "UPDATE journal_reserved_stock SET quantity = quantity - ?1 WHERE product_id = ?2;");
+        if (!insert_transaction || !items || !decrement || !insert_item || !release)
+            return failed_status("投影销售事件失败", sqlite3_errcode(db));
+
+        sqlite3_bind_int64(insert_transaction.get(), 1, transaction_id);
+        sqlite3_bind_text(insert_transaction.get(), 2, payload, -1, SQLITE_STATIC);
+        int rc = sqlite3_step(insert_transaction.get());
+        if (rc != SQLITE_DONE)
+            return failed_status("投影销售事件失败", rc);
+
+        sqlite3_bind_text(items.get(), 1, payload, -1, SQLITE_STATIC);
+        while ((rc = sqlite3_step(items.get())) == SQLITE_ROW)
+        {
+            const int product_id = sqlite3_column_int(items.get(), 0);
+            const int quantity = sqlite3_column_int(items.get(), 1);
+            sqlite3_reset(decrement.get());
+            sqlite3_bind_int(decrement.get(), 1, quantity);
+            sqlite3_bind_int(decrement.get(), 2, product_id);
+            sqlite3_reset(release.get());
+            sqlite3_bind_int(release.get(), 1, quantity);
+            sqlite3_bind_int(release.get(), 2, product_id);
+            const int release_rc = sqlite3_step(release.get());
+            if (release_rc != SQLITE_DONE)
+                return failed_status("投影销售事件失败", release_rc);
+
+            const int stock_rc = sqlite3_step(decrement.get());
+            if (stock_rc == SQLITE_ROW)
+            {
+                changed.push_back(stock_entry(decrement.get(), product_id));
+                // 结账时已扣除待投影销售校验过库存，这里为负只可能是其他工具改过库存
+                if (changed.back().stock < 0)
+                    SLOG_WARN("投影销售后商品ID %d 库存为负: %d", product_id, changed.back().stock);
+            }
+            else if (stock_rc != SQLITE_DONE)
+                return failed_status("投影销售事件失败", stock_rc);
+
+            sqlite3_reset(insert_item.get());
+            sqlite3_bind_int64(insert_item.get(), 1, transaction_id);
+            sqlite3_bind_int(insert_item.get(), 2, product_id);
+            sqlite3_bind_int(insert_item.get(), 3, quantity);
+            sqlite3_bind_int64(insert_item.get(), 4, sqlite3_column_int64(items.get(), 2));
+            sqlite3_bind_int64(insert_item.get(), 5, sqlite3_column_int64(items.get(), 3));
+            sqlite3_bind_value(insert_item.get(), 6, sqlite3_column_value(items.get(), 4));
+            const int item_rc = sqlite3_step(insert_item.get());
+            if (item_rc != SQLITE_DONE)
+                return failed_status("投影销售事件失败", item_rc);
+        }
+        return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("投影销售事件失败", rc);
+    }
+
+    WriteStatus apply_return(const long long transaction_id, const char* payload, std::vector<LowStockEntry>& changed)
+    {
+        const CachedStatement merged(
+            "SELECT json_extract(value, '$[0]'), SUM(json_extract(value, '$[1]')) FROM json_each(?1, '$.lines') GROUP BY 1;");
+        const CachedStatement restore_stock(
+            "UPDATE products SET stock = stock + ?1 WHERE id = ?2 RETURNING name, stock, alert_threshold;");
+        const CachedStatement return_lines(
+            "SELECT json_extract(value, '$[0]'), json_extract(value, '$[1]'), json_extract(value, '$[2]') "
+            "FROM json_each(?1, '$.lines');");
+        const CachedStatement insert_return(
+            "INSERT INTO returns (transaction_id, product_id, quantity, reason, return_time, amount) "
+            "VALUES (?1, ?2, ?3, ?4, json_extract(?5, '$.return_time'), round(?6, 2));");
+        const CachedStatement update_total(
+            "UPDATE transactions SET total_price = round(total_price - json_extract(?2, '$.amount'), 2) "
+            "WHERE transaction_id = ?1;");
+        if (!merged || !restore_stock || !return_lines || !insert_return || !update_total)
+            return failed_status("重放退货事件失败", sqlite3_errcode(db));
+
+        // 各商品重放时分摊到的退货金额和数量；可退数量不足的商品没有金额，退货记录的金额为NULL
+        std::map<int, std::pair<double, long long>> refunds;
+
+        sqlite3_bind_text(merged.get(), 1, payload, -1, SQLITE_STATIC);
+        int rc;
+        while ((rc = sqlite3_step(merged.get())) == SQLITE_ROW)
+        {
+            const int product_id = sqlite3_column_int(merged.get(), 0);
+            const int quantity = sqlite3_column_int(merged.get(), 1);
+            bool enough = false;
+            double amount = 0.0;
+            const WriteStatus marked = mark_returned_items(transaction_id, product_id, quantity, enough, amount);
+            if (marked != WriteStatus::Ok)
+            {
+                SLOG_ERROR("重放退货事件失败: %s", sqlite3_errmsg(db));
+                return marked;
+            }
+            if (enough)
+                refunds[product_id] = {amount, quantity};
+            else
+                SLOG_WARN("重放退货时交易 %lld 中商品ID %d 的可退数量不足，仅恢复库存", transaction_id, product_id);
+
+            sqlite3_reset(restore_stock.get());
+            sqlite3_bind_int(restore_stock.get(), 1, quantity);
+            sqlite3_bind_int(restore_stock.get(), 2, product_id);
+            const int step_rc = sqlite3_step(restore_stock.get());
+            if (step_rc == SQLITE_ROW)
+                changed.push_back(stock_entry(restore_stock.get(), product_id));
+            else if (step_rc != SQLITE_DONE)
+                return failed_status("重放退货事件失败", step_rc);
+        }
+        if (rc != SQLITE_DONE)
+            return failed_status("重放退货事件失败", rc);
+
+        sqlite3_bind_text(return_lines.get(), 1, payload, -1, SQLITE_STATIC);
+        sqlite3_stmt* insert = insert_return.get();
+        while ((rc = sqlite3_step(return_lines.get())) == SQLITE_ROW)
+        {
+            const int product_id = sqlite3_column_int(return_lines.get(), 0);
+            const int quantity = sqlite3_column_int(return_lines.get(), 1);
+            sqlite3_reset(insert);
+            sqlite3_bind_int64(insert, 1, transaction_id);
+            sqlite3_bind_int(insert, 2, product_id);
+            sqlite3_bind_int(insert, 3, quantity);
+            sqlite3_bind_value(insert, 4, sqlite3_column_value(return_lines.get(), 2));
+            sqlite3_bind_text(insert, 5, payload, -1, SQLITE_STATIC);
+            const auto refund = refunds.find(product_id);
+            if (refund != refunds.end())
+                sqlite3_bind_double(insert, 6, take_return_amount(refund->second.first, refund->second.second, quantity));
+            else
+                sqlite3_bind_null(insert, 6);
+            const int step_rc = sqlite3_step(insert);
+            if (step_rc != SQLITE_DONE)
+                return failed_status("重放退货事件失败", step_rc);
+        }
+        if (rc != SQLITE_DONE)
+            return failed_status("重放退货事件失败", rc);
+
+        sqlite3_bind_int64(update_total.get(), 1, transaction_id);
+        sqlite3_bind_text(update_total.get(), 2, payload, -1, SQLITE_STATIC);
+        rc = sqlite3_step(update_total.get());
+        if (rc != SQLITE_DONE)
+            return failed_status("重放退货事件失败", rc);
+        return WriteStatus::Ok;
+    }
+
+    WriteStatus apply_restock(const char* payload, std::vector<LowStockEntry>& changed)
+    {
+        const CachedStatement lines("SELECT json_extract(value, '$[0]'), json_extract(value, '$[1]') FROM json_each(?1, '$.lines');");
+        const CachedStatement increment(
+            "UPDATE products SET stock = stock + ?1 WHERE id = ?2 RETURNING name, stock, alert_threshold;");
+        if (!lines || !increment)
+            return failed_status("重放进货事件失败", sqlite3_errcode(db));
+        sqlite3_bind_text(lines.get(), 1, payload, -1, SQLITE_STATIC);
+        int rc;
+        while ((rc = sqlite3_step(lines.get())) == SQLITE_ROW)
+        {
+            const int product_id = sqlite3_column_int(lines.get(), 0);
+            sqlite3_reset(increment.get());
+            sqlite3_bind_int64(increment.get(), 1, sqlite3_column_int64(lines.get(), 1));
+            sqlite3_bind_int(increment.get(), 2, product_id);
+            const int step_rc = sqlite3_step(increment.get());
+            if (step_rc == SQLITE_ROW)
+                changed.push_back(stock_entry(increment.get(), product_id));
+            else if (step_rc != SQLITE_DONE)
+                return failed_status("重放进货事件失败", step_rc);
+        }
+        return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("重放进货事件失败", rc);
+    }
+
+    WriteStatus apply_product(const long long product_id, const char* payload, const std::string& op)
+    {
+        const char* sql;
+        if (op == "insert")
+            sql = "INSERT INTO products (id, name, price, stock, alert_threshold, barcode) "
+                  "VALUES (?1, json_extract(?2, '$.name'), json_extract(?2, '$.price'), json_extract(?2, '$.stock'), "
+                  "json_extract(?2, '$.alert_threshold'), json_extract(?2, '$.barcode')) "
+                  "ON CONFLICT(id) DO UPDATE SET name = excluded.name, price = excluded.price, stock = excluded.stock, "
+                  "alert_threshold = excluded.alert_threshold, barcode = excluded.barcode;";
+        else if (op == "update")
+            sql = "UPDATE products SET name = json_extract(?2, '$.name'), price = json_extract(?2, '$.price'), "
+                  "alert_threshold = json_extract(?2, '$.alert_threshold'), barcode = json_extract(?2, '$.barcode'), "
+                  "stock = stock + json_extract(?2, '$.stock_delta') WHERE id = ?1;";
+        else
+            sql = "DELETE FROM products WHERE id = ?1 AND ?2 IS NOT NULL;";
+        const CachedStatement stmt(sql);
+        if (!stmt)
+            return failed_status("重放商品事件失败", sqlite3_errcode(db));
+        sqlite3_bind_int64(stmt.get(), 1, product_id);
+        sqlite3_bind_text(stmt.get(), 2, payload, -1, SQLITE_STATIC);
+        const int rc = sqlite3_step(stmt.get());
+        return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("重放商品事件失败", rc);
+    }
+
+    // 按顺序读取after之后最多limit条事件；sales_only时只应用销售事件，其余事件写入时已经生效
+    WriteStatus apply_events(const long long after, const int limit, const bool sales_only,
+                             std::vector<LowStockEntry>& changed, long long& last, int& count)
+    {
+        const CachedStatement events(
+            "SELECT event_id, kind, ref_id, payload, json_extract(payload, '$.op') FROM sales_journal "
+            "WHERE event_id > ?1 ORDER BY event_id LIMIT ?2;");
+        if (!events)
+            return failed_status("读取事件日志失败", sqlite3_errcode(db));
+        sqlite3_bind_int64(events.get(), 1, after);
+        sqlite3_bind_int(events.get(), 2, limit);
+        last = after;
+        count = 0;
+        int rc;
+        while ((rc = sqlite3_step(events.get())) == SQLITE_ROW)
+        {
+            last = sqlite3_column_int64(events.get(), 0);
+            ++count;
+            const std::string kind = reinterpret_cast<const char*>(sqlite3_column_text(events.get(), 1));
+            const long long ref_id = sqlite3_column_int64(events.get(), 2);
+            const auto* payload = reinterpret_cast<const char*>(sqlite3_column_text(events.get(), 3));
+            WriteStatus status = WriteStatus::Ok;
+            if (kind == "sale")
+                status = apply_sale(ref_id, payload, changed);
+            else if (sales_only)
+                continue;
+            else if (kind == "return")
+                status = apply_return(ref_id, payload, changed);
+            else if (kind == "restock")
+                status = apply_restock(payload, changed);
+            else if (kind == "product")
+            {
+                const auto* op = reinterpret_cast<const char*>(sqlite3_column_text(events.get(), 4));
+                status = apply_product(ref_id, payload, op ? op : "");
+            }
+            if (status != WriteStatus::Ok)
+            {
+                SLOG_ERROR("应用事件 %lld（%s）失败", last, kind.c_str());
+                return status;
+            }
+        }
+        return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("读取事件日志失败", rc);
+    }
+
+    long long projected_event_id()
+    {
+        return query_long("SELECT projected_event_id FROM journal_state WHERE id = 1;");
+    }
+
+    WriteStatus set_projected(const long long event_id)
+    {
+        int rc = exec_bound("UPDATE journal_state SET projected_event_id = ?1 WHERE id = 1;", {event_id});
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("DELETE FROM journal_reserved_stock WHERE quantity <= 0;", {});
+        return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("更新投影位置失败", rc);
+    }
+
+    // 记录投影到event_id时的商品表、各明细表最大ID和非零的已退货数量；调用方保证此时没有待投影事件
+    WriteStatus take_snapshot(const long long event_id)
+    {
+        int rc = exec_bound(
+            "INSERT OR REPLACE INTO journal_snapshots "
+            "(event_id, created_at, max_transaction_id, max_item_id, max_return_id, products, returned_items) "
+            "SELECT ?1, ?2, IFNULL((SELECT MAX(transaction_id) FROM transactions), 0), "
+            "IFNULL((SELECT MAX(item_id) FROM cart_items), 0), IFNULL((SELECT MAX(return_id) FROM returns), 0), "
+            "(SELECT json_group_array(json_array(id, name, price, stock, alert_threshold, barcode)) FROM products), "
+            "(SELECT json_group_array(json_array(item_id, returned_quantity)) FROM cart_items WHERE returned_quantity > 0);",
+            {event_id, static_cast<long long>(time(nullptr))});
+        if (rc == SQLITE_DONE)
+        {
+            rc = exec_bound(
+                "DELETE FROM journal_snapshots WHERE event_id > (SELECT MIN(event_id) FROM journal_snapshots) "
+                "AND event_id NOT IN (SELECT event_id FROM journal_snapshots ORDER BY event_id DESC LIMIT ?1);",
+                {kKeptSnapshots});
+        }
+        if (rc != SQLITE_DONE)
+            return failed_status("生成事件日志快照失败", rc);
+        SLOG_INFO("事件日志快照已生成，事件ID %lld", event_id);
+        return WriteStatus::Ok;
+    }
+
+    // 一个写事务内投影最多batch条事件；全部追上且距上次快照足够远时顺便生成快照
+    bool project_batch(const int batch, std::vector<LowStockEntry>& changed, int& count)
+    {
+        return run_write_transaction("投影事件日志", [&]() -> WriteStatus
+        {
+            changed.clear();
+            count = 0;
+            if (!journal_enabled())
+                return WriteStatus::Ok;
+            const JournalMute mute(true);
+            const long long after = projected_event_id();
+            long long last = after;
+            WriteStatus status = apply_events(after, batch, true, changed, last, count);
+            if (status == WriteStatus::Ok && count > 0)
+                status = set_projected(last);
+            const long long interval = g_snapshotInterval.load(std::memory_order_relaxed);
+            if (status == WriteStatus::Ok && count < batch && interval > 0 &&
+                last - query_long("SELECT IFNULL(MAX(event_id), 0) FROM journal_snapshots;") >= interval)
+                status = take_snapshot(last);
+            return status;
+        });
+    }
+
+    void publish(const std::vector<LowStockEntry>& changed)
+    {
+        for (const auto& entry : changed)
+            note_product_stock(entry.product_id, entry.name, entry.stock, entry.alert_threshold);
+    }
+
+    // 追上全部待投影事件，每批提交后发布库存变化并追加销售日志
+    bool drain(const int batch)
+    {
+        std::vector<LowStockEntry> changed;
+        int count = 0;
+        do
+        {
+            if (!project_batch(batch, changed, count))
+                return false;
+            publish(changed);
+            if (count > 0)
+                try_sync_sales_log();
+        } while (count == batch);
+        return true;
+    }
+
+    // 后台投影线程，连接只在本线程使用，没有临时触发器
+    class Projector
+    {
+    public:
+        ~Projector() { stop(); }
+
+        void start(const std::string& path, const int interval_ms, const int batch)
+        {
+            stop();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = false;
+            m_worker = std::thread(&Projector::run, this, path, interval_ms, std::max(1, batch));
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            if (m_worker.joinable())
+                m_worker.join();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop = false;
+        std::thread m_worker;
+
+        void run(const std::string& path, const int interval_ms, const int batch)
+        {
+            if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK)
+            {
+                SLOG_ERROR("投影线程连接打开失败: %s", sqlite3_errmsg(db));
+                sqlite3_close(db);
+                db = nullptr;
+                return;
+            }
+            sqlite3_busy_timeout(db, 2000);
+            sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+            install_query_tracing(db);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this] { return m_stop; }))
+            {
+                lock.unlock();
+                // 先用读查询判断有没有待投影事件，空闲时不去抢写锁
+                if (query_long("SELECT enabled AND IFNULL((SELECT MAX(event_id) FROM sales_journal), 0) > projected_event_id "
+                               "FROM journal_state WHERE id = 1;") != 0)
+                    drain(batch);
+                lock.lock();
+            }
+            lock.unlock();
+            close_db();
+        }
+    };
+
+    Projector& projector()
+    {
+        static Projector instance;
+        return instance;
+    }
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+}
+
+void install_journal_capture()
+{
+    t_captureInstalled = false;
+    for (const char* sql : sql_capture)
+    {
+        char* err = nullptr;
+        if (sqlite3_exec(db, sql, nullptr, nullptr, &err) != SQLITE_OK)
+        {
+            SLOG_ERROR("创建事件日志触发器失败: %s", err);
+            sqlite3_free(err);
+            return;
+        }
+    }
+    t_captureInstalled = true;
+}
+
+bool journal_enabled()
+{
+    return query_long("SELECT enabled FROM journal_state WHERE id = 1;") != 0;
+}
+
+JournalMute::JournalMute(const bool active) : m_active(active && t_captureInstalled)
+{
+    if (m_active)
+        exec_bound("UPDATE journal_mute SET muted = ?1;", {1});
+}
+
+JournalMute::~JournalMute()
+{
+    if (m_active)
+        exec_bound("UPDATE journal_mute SET muted = ?1;", {0});
+}
+
+WriteStatus project_pending_events(std::vector<LowStockEntry>& changed)
+{
+    long long after = projected_event_id();
+    int count = 0;
+    do
+    {
+        long long last = after;
+        const WriteStatus status = apply_events(after, kReplayChunk, true, changed, last, count);
+        if (status != WriteStatus::Ok)
+            return status;
+        after = last;
+    } while (count == kReplayChunk);
+    return set_projected(after);
+}
+
+WriteStatus append_sale_event(const Transaction& transaction, int& transaction_id, std::vector<StockConflict>& conflicts)
+{
+    // 尚未投影的销售还没有扣减库存，校验时扣除它们占用的数量；同一商品的多行依次占用，
+    // 与直接写入时逐行条件扣减的结果一致。库存不足时事务回滚，占用一并撤销
+    const CachedStatement available(
+        "SELECT p.name, p.stock - IFNULL(r.quantity, 0) FROM products p "
+        "LEFT JOIN journal_reserved_stock r ON r.product_id = p.id WHERE p.id = ?1;");
+    const CachedStatement reserve(
+        "INSERT INTO journal_reserved_stock (product_id, quantity) VALUES (?1, ?2) "
+        "ON CONFLICT(product_id) DO UPDATE SET quantity = quantity + excluded.quantity;");
+    if (!available || !reserve)
+        return failed_status("查询商品库存失败", sqlite3_errcode(db));
+    std::string items = "[";
+    for (const auto& item : transaction.cart.items)
+    {
+        sqlite3_reset(available.get());
+        sqlite3_bind_int(available.get(), 1, item.product.id);
+        int rc = sqlite3_step(available.get());
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE)
+            return failed_status("查询商品库存失败", rc);
+        const long long left = rc == SQLITE_ROW ? sqlite3_column_int64(available.get(), 1) : 0;
+        if (rc != SQLITE_ROW || left < item.quantity)
+        {
+            const auto* name = rc == SQLITE_ROW ? reinterpret_cast<const char*>(sqlite3_column_text(available.get(), 0)) : nullptr;
+            conflicts.push_back({item.product.id, name ? name : item.product.name, item.quantity,
+                                 static_cast<int>(std::max(0LL, left))});
+            continue;
+        }
+        sqlite3_reset(reserve.get());
+        sqlite3_bind_int(reserve.get(), 1, item.product.id);
+        sqlite3_bind_int(reserve.get(), 2, item.quantity);
+        rc = sqlite3_step(reserve.get());
+        if (rc != SQLITE_DONE)
+            return failed_status("占用商品库存失败", rc);
+        if (items.size() > 1)
+            items += ',';
+        // 小计和促销折扣以分为单位的整数记录，不受小数点格式影响；没有促销时promotion_id记为null
+        items += '[' + std::to_string(item.product.id) + ',' + std::to_string(item.quantity) + ',' +
+            std::to_string(std::llround(static_cast<double>(item.subtotal) * 100.0)) + ',' +
+            std::to_string(std::llround(static_cast<double>(item.discount) * 100.0)) + ',' +
+            (item.promotion_id ? std::to_string(item.promotion_id) : std::string("null")) + ']';
+    }
+    if (!conflicts.empty())
+        return WriteStatus::Failed;
+    items += ']';
+
+    // 交易ID在写入事件时分配，投影时按此ID插入，之后的退货和查询都使用它
+    transaction_id = static_cast<int>(query_long(
+        "SELECT MAX(IFNULL((SELECT seq FROM sqlite_sequence WHERE name = 'transactions'), 0), "
+        "IFNULL((SELECT MAX(ref_id) FROM sales_journal WHERE kind = 'sale' "
+        "AND event_id > (SELECT projected_event_id FROM journal_state WHERE id = 1)), 0)) + 1;"));
+
+    const CachedStatement insert(
+        "INSERT INTO sales_journal (event_time, kind, ref_id, payload) VALUES (?1, 'sale', ?2, "
+        "json_object('create_time', ?1, 'is_paid', ?3, 'total_price', round(?4, 2), 'amount_paid', round(?5, 2), "
+        "'change', round(?6, 2), 'items', json(?7)));");
+    if (!insert)
+        return failed_status("写入销售事件失败", sqlite3_errcode(db));
+    sqlite3_bind_int64(insert.get(), 1, transaction.create_time);
+    sqlite3_bind_int(insert.get(), 2, transaction_id);
+    sqlite3_bind_int(insert.get(), 3, transaction.is_paid ? 1 : 0);
+    sqlite3_bind_double(insert.get(), 4, transaction.total_price);
+    sqlite3_bind_double(insert.get(), 5, transaction.amount_paid);
+    sqlite3_bind_double(insert.get(), 6, transaction.change);
+    sqlite3_bind_text(insert.get(), 7, items.c_str(), static_cast<int>(items.size()), SQLITE_STATIC);
+    const int rc = sqlite3_step(insert.get());
+    return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("写入销售事件失败", rc);
+}
+
+WriteStatus append_return_event(const int transaction_id, const std::vector<ReturnLine>& lines,
+                                 const long long return_time, const double amount)
+{
+    // 退货原因是任意文本，逐行用json_array拼接，由SQLite负责转义
+    const CachedStatement line_json("SELECT json_array(?1, ?2, ?3);");
+    if (!line_json)
+        return failed_status("写入退货事件失败", sqlite3_errcode(db));
+    std::string array = "[";
+    for (const auto& line : lines)
+    {
+        sqlite3_reset(line_json.get());
+        sqlite3_bind_int(line_json.get(), 1, line.product_id);
+        sqlite3_bind_int(line_json.get(), 2, line.quantity);
+        sqlite3_bind_text(line_json.get(), 3, line.reason.c_str(), -1, SQLITE_STATIC);
+        if (sqlite3_step(line_json.get()) != SQLITE_ROW)
+            return failed_status("写入退货事件失败", sqlite3_errcode(db));
+        if (array.size() > 1)
+            array += ',';
+        array += reinterpret_cast<const char*>(sqlite3_column_text(line_json.get(), 0));
+    }
+    array += ']';
+
+    const CachedStatement insert(
+        "INSERT INTO sales_journal (event_time, kind, ref_id, payload) VALUES (?1, 'return', ?2, "
+        "json_object('return_time', ?1, 'amount', ?3, 'lines', json(?4)));");
+    if (!insert)
+        return failed_status("写入退货事件失败", sqlite3_errcode(db));
+    sqlite3_bind_int64(insert.get(), 1, return_time);
+    sqlite3_bind_int(insert.get(), 2, transaction_id);
+    sqlite3_bind_double(insert.get(), 3, amount);
+    sqlite3_bind_text(insert.get(), 4, array.c_str(), static_cast<int>(array.size()), SQLITE_STATIC);
+    const int rc = sqlite3_step(insert.get());
+    return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("写入退货事件失败", rc);
+}
+
+WriteStatus append_restock_event(const std::map<int, long long>& quantities)
+{
+    std::string array = "[";
+    for (const auto& [product_id, quantity] : quantities)
+    {
+        if (array.size() > 1)
+            array += ',';
+        array += '[' + std::to_string(product_id) + ',' + std::to_string(quantity) + ']';
+    }
+    array += ']';
+    const CachedStatement insert(
+        "INSERT INTO sales_journal (event_time, kind, ref_id, payload) "
+        "VALUES (?1, 'restock', 0, json_object('lines', json(?2)));");
+    if (!insert)
+        return failed_status("写入进货事件失败", sqlite3_errcode(db));
+    sqlite3_bind_int64(insert.get(), 1, static_cast<long long>(time(nullptr)));
+    sqlite3_bind_text(insert.get(), 2, array.c_str(), static_cast<int>(array.size()), SQLITE_STATIC);
+    const int rc = sqlite3_step(insert.get());
+    return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("写入进货事件失败", rc);
+}
+
+bool enable_sales_journal(std::string* errorMsg)
+{
+    QueryCall call("enable_sales_journal");
+    const bool ok = run_write_transaction("开启事件溯源模式", []() -> WriteStatus
+    {
+        if (journal_enabled())
+            return WriteStatus::Ok;
+        // 之前的事件都已反映在当前状态中，关闭期间的直接写入没有事件，旧快照不能再作为重放起点
+        const long long last = query_long("SELECT IFNULL(MAX(event_id), 0) FROM sales_journal;");
+        int rc = exec_bound("UPDATE journal_state SET enabled = 1, projected_event_id = ?1 WHERE id = 1;", {last});
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("DELETE FROM journal_snapshots;", {});
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("DELETE FROM journal_reserved_stock;", {});
+        if (rc != SQLITE_DONE)
+            return failed_status("开启事件溯源模式失败", rc);
+        return take_snapshot(last);
+    });
+    if (!ok)
+    {
+        fail(errorMsg, std::string("开启事件溯源模式失败: ") + sqlite3_errmsg(db));
+        return false;
+    }
+    SLOG_INFO("已开启事件溯源模式");
+    return true;
+}
+
+bool disable_sales_journal(std::string* errorMsg)
+{
+    QueryCall call("disable_sales_journal");
+    std::vector<LowStockEntry> changed;
+    const bool ok = run_write_transaction("关闭事件溯源模式", [&]() -> WriteStatus
+    {
+        changed.clear();
+        if (!journal_enabled())
+            return WriteStatus::Ok;
+        const JournalMute mute(true);
+        const WriteStatus status = project_pending_events(changed);
+        if (status != WriteStatus::Ok)
+            return status;
+        const int rc = exec_bound("UPDATE journal_state SET enabled = 0 WHERE id = 1;", {});
+        return rc == SQLITE_DONE ? WriteStatus::Ok : failed_status("关闭事件溯源模式失败", rc);
+    });
+    if (!ok)
+    {
+        fail(errorMsg, std::string("关闭事件溯源模式失败: ") + sqlite3_errmsg(db));
+        return false;
+    }
+    publish(changed);
+    try_sync_sales_log();
+    SLOG_INFO("已关闭事件溯源模式");
+    return true;
+}
+
+bool project_sales_journal(std::string* errorMsg)
+{
+    QueryCall call("project_sales_journal");
+    if (!drain(kReplayChunk))
+    {
+        fail(errorMsg, std::string("投影事件日志失败: ") + sqlite3_errmsg(db));
+        return false;
+    }
+    return true;
+}
+
+bool snapshot_sales_journal(std::string* errorMsg)
+{
+    QueryCall call("snapshot_sales_journal");
+    std::vector<LowStockEntry> changed;
+    const bool ok = run_write_transaction("生成事件日志快照", [&]() -> WriteStatus
+    {
+        changed.clear();
+        if (!journal_enabled())
+            return WriteStatus::Failed;
+        const JournalMute mute(true);
+        const WriteStatus status = project_pending_events(changed);
+        return status == WriteStatus::Ok ? take_snapshot(projected_event_id()) : status;
+    });
+    if (!ok)
+    {
+        fail(errorMsg, "生成事件日志快照失败: 未开启事件溯源模式或数据库写入失败");
+        return false;
+    }
+    publish(changed);
+    try_sync_sales_log();
+    return true;
+}
+
+bool replay_sales_journal(const long long from_event_id, std::string* errorMsg)
+{
+    QueryCall call("replay_sales_journal");
+    std::vector<LowStockEntry> changed;
+    std::string err;
+    long long snapshot_event = 0;
+    long long replayed = 0;
+    const bool ok = run_write_transaction("重放事件日志", [&]() -> WriteStatus
+    {
+        changed.clear();
+        err.clear();
+        replayed = 0;
+        const JournalMute mute(true);
+        // 商品表先整体恢复再重放，中间状态可能暂时违反外键约束，提交时再检查
+        sqlite3_exec(db, "PRAGMA defer_foreign_keys = ON;", nullptr, nullptr, nullptr);
+
+        long long max_transaction = 0;
+        long long max_item = 0;
+        long long max_return = 0;
+        std::string products;
+        std::string returned;
+        {
+            const CachedStatement snapshot(
+                "SELECT event_id, max_transaction_id, max_item_id, max_return_id, products, returned_items "
+                "FROM journal_snapshots WHERE event_id <= ?1 ORDER BY event_id DESC LIMIT 1;");
+            if (!snapshot)
+                return failed_status("读取事件日志快照失败", sqlite3_errcode(db));
+            sqlite3_bind_int64(snapshot.get(), 1, from_event_id);
+            if (sqlite3_step(snapshot.get()) != SQLITE_ROW)
+            {
+                err = "没有事件ID不大于 " + std::to_string(from_event_id) + " 的快照";
+                return WriteStatus::Failed;
+            }
+            snapshot_event = sqlite3_column_int64(snapshot.get(), 0);
+            max_transaction = sqlite3_column_int64(snapshot.get(), 1);
+            max_item = sqlite3_column_int64(snapshot.get(), 2);
+            max_return = sqlite3_column_int64(snapshot.get(), 3);
+            products = reinterpret_cast<const char*>(sqlite3_column_text(snapshot.get(), 4));
+            returned = reinterpret_cast<const char*>(sqlite3_column_text(snapshot.get(), 5));
+        }
+
+        // 1. 撤销快照之后的退货对交易总金额的扣减，删除快照之后产生的明细行
+        int rc = exec_bound(
+            "UPDATE transactions SET total_price = round(total_price + r.amount, 2) "
+            "FROM (SELECT ref_id, SUM(json_extract(payload, '$.amount')) AS amount FROM sales_journal "
+            "      WHERE kind = 'return' AND event_id > ?1 GROUP BY ref_id) r "
+            "WHERE transactions.transaction_id = r.ref_id;", {snapshot_event});
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("DELETE FROM returns WHERE return_id > ?1;", {max_return});
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("DELETE FROM cart_items WHERE item_id > ?1;", {max_item});
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("DELETE FROM transactions WHERE transaction_id > ?1;", {max_transaction});
+        // 2. 已退货数量和商品表恢复为快照时的内容
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("UPDATE cart_items SET returned_quantity = 0 WHERE returned_quantity > 0;", {});
+        const auto exec_json = [&](const char* sql, const std::string& json)
+        {
+            const CachedStatement stmt(sql);
+            if (!stmt)
+                return sqlite3_errcode(db);
+            sqlite3_bind_text(stmt.get(), 1, json.c_str(), static_cast<int>(json.size()), SQLITE_STATIC);
+            return sqlite3_step(stmt.get());
+        };
+        if (rc == SQLITE_DONE)
+            rc = exec_json("UPDATE cart_items SET returned_quantity = json_extract(r.value, '$[1]') "
+                           "FROM json_each(?1) r WHERE cart_items.item_id = json_extract(r.value, '$[0]');", returned);
+        // 条码唯一，逐行覆盖时新旧条码可能暂时重复，先全部清空；早期快照没有条码一项，取到NULL
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("UPDATE products SET barcode = NULL WHERE barcode IS NOT NULL;", {});
+        if (rc == SQLITE_DONE)
+            rc = exec_json("INSERT INTO products (id, name, price, stock, alert_threshold, barcode) "
+                           "SELECT json_extract(value, '$[0]'), json_extract(value, '$[1]'), json_extract(value, '$[2]'), "
+                           "json_extract(value, '$[3]'), json_extract(value, '$[4]'), json_extract(value, '$[5]') "
+                           "FROM json_each(?1) WHERE true "
+                           "ON CONFLICT(id) DO UPDATE SET name = excluded.name, price = excluded.price, "
+                           "stock = excluded.stock, alert_threshold = excluded.alert_threshold, barcode = excluded.barcode;",
+                           products);
+        if (rc == SQLITE_DONE)
+            rc = exec_json("DELETE FROM products WHERE id NOT IN (SELECT json_extract(value, '$[0]') FROM json_each(?1));",
+                           products);
+        // 3. 自增序列退回快照时的位置，重放产生的明细行与原来的ID一致
+        if (rc == SQLITE_DONE)
+            rc = exec_bound("UPDATE sqlite_sequence SET seq = CASE name WHEN 'transactions' THEN ?1 "
+                            "WHEN 'cart_items' THEN ?2 ELSE ?3 END "
+                            "WHERE name IN ('transactions', 'cart_items', 'returns');",
+                            {max_transaction, max_item, max_return});
+        if (rc != SQLITE_DONE)
+            return failed_status("恢复事件日志快照失败", rc);
+
+        // 4. 按顺序重放快照之后的全部事件
+        long long after = snapshot_event;
+        int count = 0;
+        do
+        {
+            long long last = after;
+            const WriteStatus status = apply_events(after, kReplayChunk, false, changed, last, count);
+            if (status != WriteStatus::Ok)
+                return status;
+            after = last;
+            replayed += count;
+        } while (count == kReplayChunk);
+        // 全部事件都已应用，没有待投影的销售占用库存
+        const int clear_rc = exec_bound("DELETE FROM journal_reserved_stock;", {});
+        if (clear_rc != SQLITE_DONE)
+            return failed_status("重放事件日志失败", clear_rc);
+        return set_projected(after);
+    });
+    if (!ok)
+    {
+        fail(errorMsg, "重放事件日志失败: " + (err.empty() ? std::string(sqlite3_errmsg(db)) : err));
+        return false;
+    }
+
+    // 当前状态整体替换，派生状态全部重建
+    clear_transaction_detail_cache();
+    reload_low_stock_set();
+    note_catalog_changed();
+    try_sync_sales_log();
+    SLOG_INFO("事件日志已从快照 %lld 重放 %lld 条事件", snapshot_event, replayed);
+    return true;
+}
+
+JournalStatus get_journal_status()
+{
+    QueryCall call("get_journal_status");
+    JournalStatus status;
+    const CachedStatement stmt(
+        "SELECT enabled, projected_event_id, "
+        "(SELECT IFNULL(MAX(event_id), 0) FROM sales_journal), "
+        "(SELECT COUNT(*) FROM sales_journal j WHERE j.event_id > s.projected_event_id AND j.kind = 'sale'), "
+        "(SELECT IFNULL(MAX(event_id), 0) FROM journal_snapshots), "
+        "(SELECT COUNT(*) FROM journal_snapshots) "
+        "FROM journal_state s WHERE id = 1;");
+    if (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+    {
+        status.enabled = sqlite3_column_int(stmt.get(), 0) != 0;
+        status.projected_event_id = sqlite3_column_int64(stmt.get(), 1);
+        status.last_event_id = sqlite3_column_int64(stmt.get(), 2);
+        status.pending_sales = sqlite3_column_int64(stmt.get(), 3);
+        status.last_snapshot_event_id = sqlite3_column_int64(stmt.get(), 4);
+        status.snapshots = sqlite3_column_int(stmt.get(), 5);
+    }
+    call.rows(1);
+    return status;
+}
+
+void start_journal_projector(const int interval_ms, const int batch)
+{
+    const char* path = sqlite3_db_filename(db, "main");
+    // 内存数据库没有文件名，其他连接无法访问，只能由调用方自己投影
+    if (!path || !*path)
+    {
+        SLOG_WARN("内存数据库不启动事件日志投影线程");
+        return;
+    }
+    projector().start(path, interval_ms, batch);
+}
+
+void stop_journal_projector()
+{
+    projector().stop();
+}
+
+void set_journal_snapshot_interval(const long long events)
+{
+    g_snapshotInterval.store(events, std::memory_order_relaxed);
+}
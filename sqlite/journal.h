@@ -0,0 +1,44 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+#include <string>
+
+// 事件溯源模式：销售、退货、进货和商品修改按发生顺序追加到sales_journal，
+// 交易、购物车项、退货和商品表都是它的投影，可以从快照加事件重放重建。
+// 结账只追加一条销售事件（校验库存时扣除尚未投影的销售），由投影线程按批写入各当前状态表；
+// 退货先追上全部待投影事件再按原逻辑写入并记录事件；进货和商品修改直接写入，
+// 同时记录事件（商品表的修改由连接上的临时触发器记录，库存记为增量）。
+// 尚未投影的销售在交易查询、报表中暂时不可见，投影间隔默认200毫秒。
+// 模式开关保存在数据库中，所有终端一致；直接用其他工具修改商品表不会被记录
+
+// 日志状态
+struct JournalStatus
+{
+    bool enabled = false;                   // 是否处于事件溯源模式
+    long long last_event_id = 0;            // 最新事件ID
+    long long projected_event_id = 0;       // 已投影到当前状态表的最大事件ID
+    long long pending_sales = 0;            // 尚未投影的销售事件数
+    long long last_snapshot_event_id = 0;   // 最新快照对应的事件ID，没有快照时为0
+    int snapshots = 0;                      // 保留的快照数
+};
+
+// 开启事件溯源模式并以当前状态作为重放起点的基准快照，之前的快照被删除
+bool enable_sales_journal(std::string* errorMsg = nullptr);
+// 投影全部待投影事件后关闭事件溯源模式，之后的写操作直接修改当前状态表
+bool disable_sales_journal(std::string* errorMsg = nullptr);
+// 在当前线程的连接上投影全部待投影的销售事件
+bool project_sales_journal(std::string* errorMsg = nullptr);
+// 投影全部待投影事件后立即生成快照
+bool snapshot_sales_journal(std::string* errorMsg = nullptr);
+// 从事件ID不大于from_event_id的最新快照恢复当前状态表，再按顺序重放之后的全部事件。
+// 用于当前状态表损坏后的重建；快照之后已归档的交易会被重新写回主库
+bool replay_sales_journal(long long from_event_id, std::string* errorMsg = nullptr);
+JournalStatus get_journal_status();
+
+// 后台投影线程：用独立连接每interval_ms毫秒投影一次，每个写事务最多batch条事件；
+// 在当前线程init_db成功后调用，重复调用会先停止之前的线程
+void start_journal_projector(int interval_ms = 200, int batch = 500);
+void stop_journal_projector();
+// 投影推进多少条事件后自动生成一次快照，默认10000；保留基准快照和最近4个快照
+void set_journal_snapshot_interval(long long events);
+
+#endif // JOURNAL_H
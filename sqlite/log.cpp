@@ -0,0 +1,208 @@
+#include "log.h"
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    constexpr size_t kCapacity = 8192;  // 必须是2的幂
+    constexpr size_t kTextSize = 240;
+    constexpr auto kDrainInterval = std::chrono::milliseconds(10);
+
+    const char* level_name(const LogLevel level)
+    {
+        switch (level)
+        {
+        case LogLevel::Debug: return "DEBUG";
+        case LogLevel::Info: return "INFO";
+        case LogLevel::Warn: return "WARN";
+        case LogLevel::Error: return "ERROR";
+        }
+        return "?";
+    }
+
+    unsigned current_thread_number()
+    {
+        static std::atomic<unsigned> next{1};
+        thread_local const unsigned number = next.fetch_add(1, std::memory_order_relaxed);
+        return number;
+    }
+
+    // 有界多生产者环形缓冲区：每个槽的序号表示它当前可被哪一轮写入或读取，
+    // 生产者只在尾指针上做一次CAS，消费者只有后台线程一个
+    class Logger
+    {
+    public:
+        Logger()
+        {
+            for (size_t i = 0; i < kCapacity; ++i)
+                m_slots[i].sequence.store(i, std::memory_order_relaxed);
+            std::thread([this] { run(); }).detach();
+        }
+
+        void write(const LogLevel level, const char* format, va_list args)
+        {
+            size_t position = m_tail.load(std::memory_order_relaxed);
+            Slot* slot;
+            for (;;)
+            {
+                slot = &m_slots[position & (kCapacity - 1)];
+                const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+                if (diff == 0)
+                {
+                    if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                {
+                    // 缓冲区已满，丢弃而不是阻塞业务线程
+                    m_dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                }
+                else
+                    position = m_tail.load(std::memory_order_relaxed);
+            }
+
+            slot->level = level;
+            slot->thread = current_thread_number();
+            slot->time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            vsnprintf(slot->text, kTextSize, format, args);
+            slot->sequence.store(position + 1, std::memory_order_release);
+        }
+
+        bool set_file(const std::string& path)
+        {
+            FILE* file = stderr;
+            if (!path.empty())
+            {
+                file = fopen(path.c_str(), "a");
+                if (!file)
+                    return false;
+            }
+            std::lock_guard<std::mutex> lock(m_outputMutex);
+            if (m_file && m_file != stderr)
+                fclose(m_file);
+            m_file = file;
+            return true;
+        }
+
+        void flush()
+        {
+            // 等待调用前已进入缓冲区的消息被后台线程写出
+            const size_t target = m_tail.load(std::memory_order_acquire);
+            while (m_head.load(std::memory_order_acquire) < target)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard<std::mutex> lock(m_outputMutex);
+            fflush(m_file);
+        }
+
+        std::atomic<int> level{static_cast<int>(LogLevel::Info)};
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> sequence;
+            LogLevel level;
+            unsigned thread;
+            std::int64_t time_us;
+            char text[kTextSize];
+        };
+
+        void run()
+        {
+            for (;;)
+            {
+                if (!drain())
+                    std::this_thread::sleep_for(kDrainInterval);
+            }
+        }
+
+        // 写出所有已就绪的消息，返回是否写出了内容
+        bool drain()
+        {
+            std::lock_guard<std::mutex> lock(m_outputMutex);
+            bool wrote = false;
+            size_t head = m_head.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Slot& slot = m_slots[head & (kCapacity - 1)];
+                if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+                    break;
+                print(slot);
+                slot.sequence.store(head + kCapacity, std::memory_order_release);
+                m_head.store(++head, std::memory_order_release);
+                wrote = true;
+            }
+
+            const unsigned long long dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped)
+                fprintf(m_file, "WARN 日志缓冲区已满，丢弃 %llu 条日志\n", dropped);
+            if (wrote || dropped)
+                fflush(m_file);
+            return wrote;
+        }
+
+        void print(const Slot& slot) const
+        {
+            const time_t seconds = static_cast<time_t>(slot.time_us / 1000000);
+            char stamp[32];
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+            fprintf(m_file, "%s.%03d %-5s [%u] %s\n", stamp, static_cast<int>(slot.time_us / 1000 % 1000),
+                    level_name(slot.level), slot.thread, slot.text);
+        }
+
+        Slot m_slots[kCapacity];
+        alignas(64) std::atomic<size_t> m_tail{0};
+        alignas(64) std::atomic<size_t> m_head{0};
+        std::atomic<unsigned long long> m_dropped{0};
+        std::mutex m_outputMutex;  // 仅保护输出文件的切换，不在写入路径上
+        FILE* m_file = stderr;
+    };
+
+    // 有意不析构：其他模块的后台线程可能在静态对象析构期间仍在写日志，
+    // 退出时由atexit等待缓冲区写空
+    Logger& logger()
+    {
+        static Logger* instance = []
+        {
+            auto* created = new Logger();
+            std::atexit(flush_log);
+            return created;
+        }();
+        return *instance;
+    }
+}
+
+void log_write(const LogLevel level, const char* format, ...)
+{
+    Logger& instance = logger();
+    if (static_cast<int>(level) < instance.level.load(std::memory_order_relaxed))
+        return;
+    va_list args;
+    va_start(args, format);
+    instance.write(level, format, args);
+    va_end(args);
+}
+
+void set_log_level(const LogLevel level)
+{
+    logger().level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+bool set_log_file(const std::string& path)
+{
+    return logger().set_file(path);
+}
+
+void flush_log()
+{
+    logger().flush();
+}
@@ -0,0 +1,53 @@
+#ifndef SALES_LOG_H
+#define SALES_LOG_H
+#include <string>
+
+// 数据层异步日志：调用线程只把格式化后的消息写入无锁环形缓冲区，
+// 由后台线程批量写出，热路径上不再发生同步的控制台或文件写入
+
+enum class LogLevel
+{
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3,
+};
+
+// 编译期最低级别，低于该级别的日志调用连同参数求值一起被消除。
+// 默认发布版本保留Info及以上，调试版本保留全部
+#ifndef SALES_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define SALES_LOG_MIN_LEVEL 1
+#else
+#define SALES_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define SALES_LOG_PRINTF_FORMAT __attribute__((format(printf, 2, 3)))
+#else
+#define SALES_LOG_PRINTF_FORMAT
+#endif
+
+// 写入一条日志，消息超过缓冲槽长度时截断；缓冲区满时丢弃并计数，不阻塞调用方
+void log_write(LogLevel level, const char* format, ...) SALES_LOG_PRINTF_FORMAT;
+// 运行期最低级别，默认Info
+void set_log_level(LogLevel level);
+// 日志输出到文件（追加），空字符串恢复为标准错误输出
+bool set_log_file(const std::string& path);
+// 等待缓冲区中已有的日志全部写出
+void flush_log();
+
+#define SALES_LOG(level, ...)                                               \
+    do                                                                      \
+    {                                                                       \
+        if constexpr (static_cast<int>(level) >= SALES_LOG_MIN_LEVEL)       \
+            log_write(level, __VA_ARGS__);                                  \
+    } while (0)
+
+#define SLOG_DEBUG(...) SALES_LOG(LogLevel::Debug, __VA_ARGS__)
+#define SLOG_INFO(...) SALES_LOG(LogLevel::Info, __VA_ARGS__)
+#define SLOG_WARN(...) SALES_LOG(LogLevel::Warn, __VA_ARGS__)
+#define SLOG_ERROR(...) SALES_LOG(LogLevel::Error, __VA_ARGS__)
+
+#endif // SALES_LOG_H
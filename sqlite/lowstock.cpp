@@ -0,0 +1,194 @@
+#include "lowstock.h"
+#include "db_internal.h"
+#include "log.h"
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+namespace
+{
+    std::mutex g_mutex;
+    std::map<int, LowStockEntry> g_lowStock;     // 当前低库存集合，按商品ID排序
+    std::map<int, LowStockListener> g_listeners;
+    int g_nextListenerId = 1;
+    bool g_loaded = false;                       // 本进程是否已建立过低库存集合
+    // 当前线程的连接上次同步时的PRAGMA data_version。data_version只在同一连接上可比较，
+    // 所以按连接（即按线程）记录；-1表示该连接还没有同步过
+    thread_local long long t_dataVersion = -1;
+
+    long long read_data_version()
+    {
+        long long version = -1;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "PRAGMA data_version;", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            version = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+        return version;
+    }
+
+    void publish(const std::vector<LowStockCrossing>& crossings)
+    {
+        if (crossings.empty())
+            return;
+        std::vector<LowStockListener> listeners;
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            for (const auto& [id, listener] : g_listeners)
+                listeners.push_back(listener);
+        }
+        for (const auto& crossing : crossings)
+        {
+            for (const auto& listener : listeners)
+                listener(crossing);
+        }
+    }
+}
+
+void reload_low_stock_set()
+{
+    // 先取版本再读取，读取期间其他连接的提交会让下一次检查再同步一次
+    const long long version = read_data_version();
+    // 部分索引idx_products_low_stock只包含低库存的行，冷启动代价与低库存商品数成正比
+    const char* sql =
+        "SELECT id, name, stock, alert_threshold FROM products WHERE stock <= alert_threshold;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+    {
+        SLOG_ERROR("加载低库存商品失败: %s", sqlite3_errmsg(db));
+        return;
+    }
+
+    std::map<int, LowStockEntry> fresh;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        LowStockEntry entry;
+        entry.product_id = sqlite3_column_int(stmt, 0);
+        const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+        entry.name = name ? name : "";
+        entry.stock = sqlite3_column_int(stmt, 2);
+        entry.alert_threshold = sqlite3_column_int(stmt, 3);
+        fresh[entry.product_id] = entry;
+    }
+    sqlite3_finalize(stmt);
+
+    // 与旧集合比较，把其他终端造成的穿越也作为事件发布
+    std::vector<LowStockCrossing> crossings;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for (const auto& [id, entry] : fresh)
+        {
+            if (!g_lowStock.contains(id))
+                crossings.push_back({entry, true});
+        }
+        for (const auto& [id, entry] : g_lowStock)
+        {
+            if (!fresh.contains(id))
+                crossings.push_back({entry, false});
+        }
+        // 回到阈值以上的商品按当前库存发布，已删除的商品保留最后的记录
+        sqlite3_stmt* current = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT name, stock, alert_threshold FROM products WHERE id = ?;", -1, &current,
+                               nullptr) == SQLITE_OK)
+        {
+            for (LowStockCrossing& crossing : crossings)
+            {
+                if (crossing.entered)
+                    continue;
+                sqlite3_reset(current);
+                sqlite3_bind_int(current, 1, crossing.entry.product_id);
+                if (sqlite3_step(current) != SQLITE_ROW)
+                    continue;
+                const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(current, 0));
+                crossing.entry.name = name ? name : "";
+                crossing.entry.stock = sqlite3_column_int(current, 1);
+                crossing.entry.alert_threshold = sqlite3_column_int(current, 2);
+            }
+        }
+        sqlite3_finalize(current);
+        g_lowStock.swap(fresh);
+        g_loaded = true;
+    }
+    t_dataVersion = version;
+    publish(crossings);
+}
+
+void ensure_low_stock_set()
+{
+    t_dataVersion = -1;
+    bool loaded;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        loaded = g_loaded;
+    }
+    if (!loaded)
+        reload_low_stock_set();
+}
+
+void note_product_stock(const int product_id, const std::string& name, const int stock, const int alert_threshold)
+{
+    const LowStockEntry entry = {product_id, name, stock, alert_threshold};
+    const bool low = stock <= alert_threshold;
+    std::vector<LowStockCrossing> crossings;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        const auto it = g_lowStock.find(product_id);
+        if (low)
+        {
+            if (it == g_lowStock.end())
+                crossings.push_back({entry, true});
+            g_lowStock[product_id] = entry;
+        }
+        else if (it != g_lowStock.end())
+        {
+            g_lowStock.erase(it);
+            crossings.push_back({entry, false});
+        }
+    }
+    publish(crossings);
+}
+
+void note_product_removed(const int product_id)
+{
+    std::vector<LowStockCrossing> crossings;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        const auto it = g_lowStock.find(product_id);
+        if (it == g_lowStock.end())
+            return;
+        crossings.push_back({it->second, false});
+        g_lowStock.erase(it);
+    }
+    publish(crossings);
+}
+
+std::vector<LowStockEntry> get_low_stock_entries()
+{
+    // 本进程的提交已增量记录；当前连接的data_version变化说明其他连接写过库，需要重新同步。
+    // 其他连接也可能是本进程的其他线程，此时多同步一次，结果不变
+    if (t_dataVersion == -1 || t_dataVersion != read_data_version())
+        reload_low_stock_set();
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    std::vector<LowStockEntry> entries;
+    entries.reserve(g_lowStock.size());
+    for (const auto& [id, entry] : g_lowStock)
+        entries.push_back(entry);
+    return entries;
+}
+
+int add_low_stock_listener(LowStockListener listener)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    const int id = g_nextListenerId++;
+    g_listeners[id] = std::move(listener);
+    return id;
+}
+
+void remove_low_stock_listener(const int listener_id)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_listeners.erase(listener_id);
+}
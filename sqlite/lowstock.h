@@ -0,0 +1,38 @@
+#ifndef LOWSTOCK_H
+#define LOWSTOCK_H
+#include <functional>
+#include <string>
+#include <vector>
+
+// 低库存商品条目
+typedef struct {
+    int product_id;         // 商品编号
+    std::string name;       // 商品名称
+    int stock;              // 当前库存
+    int alert_threshold;    // 预警阈值
+} LowStockEntry;
+
+// 低库存阈值穿越事件
+typedef struct {
+    LowStockEntry entry;    // 变化后的商品库存信息
+    bool entered;           // true：库存降到阈值及以下；false：库存回到阈值以上或商品被删除
+} LowStockCrossing;
+
+using LowStockListener = std::function<void(const LowStockCrossing&)>;
+
+// 用当前线程的连接从数据库重建低库存集合（走部分索引，只读取低库存的行），批量导入等绕过增量维护的操作之后调用
+void reload_low_stock_set();
+// init_db打开连接后调用：本进程首次调用时建立低库存集合，之后打开的连接（收银服务的连接线程、异步查询线程等）
+// 不再重建，只在该连接上第一次读取集合时同步
+void ensure_low_stock_set();
+// 数据层在库存、阈值或名称提交变化后调用，增量维护低库存集合并发布穿越事件
+void note_product_stock(int product_id, const std::string& name, int stock, int alert_threshold);
+// 商品被删除后调用
+void note_product_removed(int product_id);
+// 当前低库存商品列表，按商品ID排序；当前线程的连接发现其他连接修改过数据库时先同步
+std::vector<LowStockEntry> get_low_stock_entries();
+// 注册/注销穿越事件监听器，回调在执行写操作的线程中调用
+int add_low_stock_listener(LowStockListener listener);
+void remove_low_stock_listener(int listener_id);
+
+#endif // LOWSTOCK_H
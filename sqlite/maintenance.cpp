@@ -0,0 +1,475 @@
+#include "maintenance.h"
+#include "database.h"
+#include "db_internal.h"
+#include "log.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+
+#if defined(__GNUC__)
+#define MAINTENANCE_PRINTF_FORMAT __attribute__((format(printf, 1, 2)))
+#else
+#define MAINTENANCE_PRINTF_FORMAT
+#endif
+
+namespace
+{
+    // 同时到期时按此顺序执行：检查点最轻，完整ANALYZE最重
+    const char* const kJobs[] = {"checkpoint", "optimize", "vacuum", "analyze"};
+    constexpr int kVacuumChunkPages = 64;     // 每个增量清理事务释放的页数
+    constexpr int kMinAnalysisLimit = 100;
+
+    std::mutex g_optionsMutex;
+    MaintenanceOptions g_options;
+    // 完整ANALYZE使用的analysis_limit，0为不抽样；超出预算后改为抽样并逐次减半
+    std::atomic<int> g_analysisLimit{0};
+    // 转换为增量自动清理只在本进程尝试一次，超出预算的库不必每小时重复整库VACUUM
+    std::atomic<bool> g_convertTried{false};
+
+    using Clock = std::chrono::steady_clock;
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+
+    long long query_long(const char* sql)
+    {
+        long long value = 0;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+        return value;
+    }
+
+    std::string format(const char* fmt, ...) MAINTENANCE_PRINTF_FORMAT;
+
+    std::string format(const char* fmt, ...)
+    {
+        char text[256];
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(text, sizeof(text), fmt, args);
+        va_end(args);
+        return text;
+    }
+
+    // 结账活动标记：最新的交易、退货和销售事件ID，只有收银写入会改变它。
+    // 维护、复制发送等后台写入不改变标记，多个终端的维护任务不会互相推迟
+    std::string checkout_marker()
+    {
+        const CachedStatement stmt(
+            "SELECT IFNULL((SELECT MAX(transaction_id) FROM transactions), 0) || ':' || "
+            "IFNULL((SELECT MAX(return_id) FROM returns), 0) || ':' || "
+            "IFNULL((SELECT MAX(event_id) FROM sales_journal), 0);");
+        std::string marker;
+        if (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+            marker = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+        return marker;
+    }
+
+    long long wal_bytes()
+    {
+        const char* path = sqlite3_db_filename(db, "main");
+        if (!path || !*path)
+            return 0;
+        struct stat info{};
+        return stat((std::string(path) + "-wal").c_str(), &info) == 0 ? static_cast<long long>(info.st_size) : 0;
+    }
+
+    int over_deadline(void* deadline)
+    {
+        return Clock::now() > *static_cast<Clock::time_point*>(deadline) ? 1 : 0;
+    }
+
+    // 执行sql，超过deadline时由进度回调中断，语句所在的事务回滚
+    int exec_before(const std::string& sql, Clock::time_point deadline)
+    {
+        sqlite3_progress_handler(db, 1000, over_deadline, &deadline);
+        const int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+        sqlite3_progress_handler(db, 0, nullptr, nullptr);
+        return rc;
+    }
+
+    bool run_optimize(const Clock::time_point deadline, MaintenanceRun& run)
+    {
+        const int rc = exec_before("PRAGMA analysis_limit = 1000; PRAGMA optimize;", deadline);
+        run.over_budget = rc == SQLITE_INTERRUPT;
+        if (rc != SQLITE_OK && !run.over_budget)
+            return false;
+        run.detail = run.over_budget ? "超出预算，已中断" : "统计信息已更新";
+        return !run.over_budget;
+    }
+
+    bool run_analyze(const Clock::time_point deadline, MaintenanceRun& run)
+    {
+        const int limit = g_analysisLimit.load();
+        const int rc = exec_before("PRAGMA analysis_limit = " + std::to_string(limit) + "; ANALYZE;", deadline);
+        run.over_budget = rc == SQLITE_INTERRUPT;
+        if (rc != SQLITE_OK && !run.over_budget)
+            return false;
+        if (run.over_budget)
+        {
+            const int next = limit == 0 ? 1000 : std::max(kMinAnalysisLimit, limit / 2);
+            g_analysisLimit = next;
+            run.detail = format("analysis_limit=%d 超出预算，已中断，下次改为 %d", limit, next);
+            return false;
+        }
+        run.detail = format("analysis_limit=%d，统计行 %lld", limit, query_long("SELECT COUNT(*) FROM sqlite_stat1;"));
+        return true;
+    }
+
+    bool run_vacuum(const MaintenanceOptions& options, const Clock::time_point deadline, MaintenanceRun& run)
+    {
+        const long long mode = query_long("PRAGMA auto_vacuum;");
+        const long long free_before = query_long("PRAGMA freelist_count;");
+        if (mode == 0)
+        {
+            // 早期建的库不是增量模式，设置后由一次VACUUM重写整个文件完成转换
+            if (g_convertTried.exchange(true))
+            {
+                run.detail = format("未启用增量自动清理，空闲页 %lld", free_before);
+                return true;
+            }
+            const int rc = exec_before("PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", deadline);
+            run.over_budget = rc == SQLITE_INTERRUPT;
+            if (rc != SQLITE_OK && !run.over_budget)
+                return false;
+            run.detail = run.over_budget ? "转换为增量自动清理超出预算，保持原模式；可用salesctl maintenance convert在停业时转换"
+                                         : format("已转换为增量自动清理，回收空闲页 %lld", free_before);
+            return !run.over_budget;
+        }
+        if (mode != 2)
+        {
+            run.detail = "完全自动清理模式，无需回收";
+            return true;
+        }
+        if (free_before < options.vacuum_min_free_pages)
+        {
+            run.detail = format("空闲页 %lld，无需回收", free_before);
+            return true;
+        }
+
+        // 每批一个自动提交事务，写锁只占用一批的时间；批与批之间有结账就停止
+        const std::string marker = checkout_marker();
+        const std::string sql = "PRAGMA incremental_vacuum(" + std::to_string(kVacuumChunkPages) + ");";
+        long long free_pages = free_before;
+        const char* stopped = "，超出预算，提前停止";
+        while (free_pages > 0 && Clock::now() < deadline)
+        {
+            const int rc = exec_before(sql, deadline);
+            if (rc == SQLITE_BUSY)
+                stopped = "，有写入，提前停止";
+            if (rc == SQLITE_INTERRUPT || rc == SQLITE_BUSY)
+                break;
+            if (rc != SQLITE_OK)
+                return false;
+            free_pages = query_long("PRAGMA freelist_count;");
+            if (checkout_marker() != marker)
+            {
+                stopped = "，有结账，提前停止";
+                break;
+            }
+        }
+        run.over_budget = free_pages > 0;
+        run.detail = format("回收空闲页 %lld，剩余 %lld%s", free_before - free_pages, free_pages,
+                            run.over_budget ? stopped : "");
+        return true;
+    }
+
+    bool run_checkpoint(const MaintenanceOptions& options, MaintenanceRun& run)
+    {
+        const long long before = wal_bytes();
+        if (before == 0)
+        {
+            run.detail = "WAL文件为空";
+            return true;
+        }
+        int frames = -1;
+        int copied = -1;
+        // PASSIVE不等待也不阻塞任何读写，写不回的帧留到下次
+        int rc = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_PASSIVE, &frames, &copied);
+        if (rc != SQLITE_OK && rc != SQLITE_BUSY)
+            return false;
+        bool truncated = false;
+        if (rc == SQLITE_OK && frames == copied && before > options.wal_truncate_bytes)
+        {
+            // 截断要等读事务结束并短暂阻塞写入，等待时间限制在预算内
+            const long long saved_timeout = query_long("PRAGMA busy_timeout;");
+            sqlite3_busy_timeout(db, options.budget_ms);
+            rc = sqlite3_wal_checkpoint_v2(db, "main", SQLITE_CHECKPOINT_TRUNCATE, nullptr, nullptr);
+            sqlite3_busy_timeout(db, static_cast<int>(saved_timeout));
+            truncated = rc == SQLITE_OK;
+            run.over_budget = rc == SQLITE_BUSY;
+        }
+        run.detail = format("WAL %lld 帧，已写回 %lld 帧，文件 %lld 字节%s", static_cast<long long>(frames),
+                            static_cast<long long>(copied), before,
+                            truncated ? "，已截断" : run.over_budget ? "，有读写未能截断" : "");
+        return true;
+    }
+
+    bool execute_job(const std::string& job, const MaintenanceOptions& options, MaintenanceRun& run, std::string& err)
+    {
+        run = MaintenanceRun{};
+        run.job = job;
+        run.run_at = static_cast<long long>(time(nullptr));
+        const auto start = Clock::now();
+        const auto deadline = start + std::chrono::milliseconds(options.budget_ms);
+        bool known = true;
+        bool ok = false;
+        if (job == "optimize")
+            ok = run_optimize(deadline, run);
+        else if (job == "analyze")
+            ok = run_analyze(deadline, run);
+        else if (job == "vacuum")
+            ok = run_vacuum(options, deadline, run);
+        else if (job == "checkpoint")
+            ok = run_checkpoint(options, run);
+        else
+            known = false;
+        run.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        run.ok = ok;
+        if (!known)
+        {
+            err = "未知的维护任务: " + job;
+            return false;
+        }
+        if (!ok && !run.over_budget)
+        {
+            run.detail = sqlite3_errmsg(db);
+            err = "维护任务" + job + "失败: " + run.detail;
+        }
+
+        const CachedStatement record(
+            "INSERT OR REPLACE INTO maintenance_runs (job, run_at, seconds, ok, over_budget, detail) "
+            "VALUES (?, ?, ?, ?, ?, ?);");
+        if (record)
+        {
+            sqlite3_bind_text(record.get(), 1, run.job.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(record.get(), 2, run.run_at);
+            sqlite3_bind_double(record.get(), 3, run.seconds);
+            sqlite3_bind_int(record.get(), 4, run.ok ? 1 : 0);
+            sqlite3_bind_int(record.get(), 5, run.over_budget ? 1 : 0);
+            sqlite3_bind_text(record.get(), 6, run.detail.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(record.get()) != SQLITE_DONE)
+                SLOG_WARN("记录维护结果失败: %s", sqlite3_errmsg(db));
+        }
+        SLOG_INFO("维护任务 %s: %s, %.3f 秒", run.job.c_str(), run.detail.c_str(), run.seconds);
+        return ok || run.over_budget;
+    }
+
+    // 距上次执行（任一终端）已超过间隔的任务，按kJobs的顺序
+    std::vector<const char*> due_jobs(const MaintenanceOptions& options)
+    {
+        std::map<std::string, long long> last_run;
+        const CachedStatement stmt("SELECT job, run_at FROM maintenance_runs;");
+        while (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+            last_run[reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0))] = sqlite3_column_int64(stmt.get(), 1);
+        const std::map<std::string, long long> intervals = {
+            {"checkpoint", options.checkpoint_interval_seconds},
+            {"optimize", options.optimize_interval_seconds},
+            {"vacuum", options.vacuum_interval_seconds},
+            {"analyze", options.analyze_interval_seconds},
+        };
+        const long long now = static_cast<long long>(time(nullptr));
+        std::vector<const char*> jobs;
+        for (const char* job : kJobs)
+        {
+            const auto it = last_run.find(job);
+            if (it == last_run.end() || now - it->second >= intervals.at(job))
+                jobs.push_back(job);
+        }
+        return jobs;
+    }
+
+    // 后台维护线程，连接只在本线程使用
+    class Scheduler
+    {
+    public:
+        ~Scheduler() { stop(); }
+
+        void start(const std::string& path)
+        {
+            stop();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = false;
+            m_worker = std::thread(&Scheduler::run, this, path);
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            if (m_worker.joinable())
+                m_worker.join();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::atomic<bool> m_stop{false};
+        std::thread m_worker;
+
+        void run(const std::string& path)
+        {
+            if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK)
+            {
+                SLOG_ERROR("维护线程连接打开失败: %s", sqlite3_errmsg(db));
+                sqlite3_close(db);
+                db = nullptr;
+                return;
+            }
+            install_query_tracing(db);
+
+            // 先用data_version判断有没有任何其他连接提交，有提交时再比较结账标记
+            long long version = query_long("PRAGMA data_version;");
+            std::string marker = checkout_marker();
+            auto last_activity = Clock::now();
+            MaintenanceOptions options = get_maintenance_options();
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_cv.wait_for(lock, std::chrono::seconds(std::max(1, options.poll_seconds)), [this] { return m_stop.load(); }))
+            {
+                lock.unlock();
+                options = get_maintenance_options();
+                // 结账最多等一项任务的预算，维护连接也不在别人的写锁后面久等
+                sqlite3_busy_timeout(db, options.budget_ms);
+                const long long current = query_long("PRAGMA data_version;");
+                if (current != version)
+                {
+                    version = current;
+                    const std::string latest = checkout_marker();
+                    if (latest != marker)
+                    {
+                        marker = latest;
+                        last_activity = Clock::now();
+                    }
+                }
+                if (Clock::now() - last_activity >= std::chrono::seconds(options.idle_seconds))
+                {
+                    // 依次执行到期任务，每项之前确认仍没有结账
+                    for (const char* job : due_jobs(options))
+                    {
+                        if (m_stop.load() || checkout_marker() != marker)
+                            break;
+                        MaintenanceRun result;
+                        std::string err;
+                        if (!execute_job(job, options, result, err))
+                            SLOG_ERROR("%s", err.c_str());
+                    }
+                }
+                lock.lock();
+            }
+            lock.unlock();
+            close_db();
+        }
+    };
+
+    Scheduler& scheduler()
+    {
+        static Scheduler instance;
+        return instance;
+    }
+}
+
+void set_maintenance_options(const MaintenanceOptions& options)
+{
+    std::lock_guard<std::mutex> lock(g_optionsMutex);
+    g_options = options;
+}
+
+MaintenanceOptions get_maintenance_options()
+{
+    std::lock_guard<std::mutex> lock(g_optionsMutex);
+    return g_options;
+}
+
+bool run_maintenance_job(const std::string& job, MaintenanceRun* result, std::string* errorMsg)
+{
+    QueryCall call("run_maintenance_job");
+    MaintenanceRun run;
+    std::string err;
+    if (!execute_job(job, get_maintenance_options(), run, err))
+    {
+        fail(errorMsg, err);
+        return false;
+    }
+    if (result) *result = run;
+    return true;
+}
+
+std::vector<MaintenanceRun> get_maintenance_runs()
+{
+    QueryCall call("get_maintenance_runs");
+    std::vector<MaintenanceRun> runs;
+    const CachedStatement stmt("SELECT job, run_at, seconds, ok, over_budget, detail FROM maintenance_runs ORDER BY job;");
+    while (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+    {
+        MaintenanceRun run;
+        run.job = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+        run.run_at = sqlite3_column_int64(stmt.get(), 1);
+        run.seconds = sqlite3_column_double(stmt.get(), 2);
+        run.ok = sqlite3_column_int(stmt.get(), 3) != 0;
+        run.over_budget = sqlite3_column_int(stmt.get(), 4) != 0;
+        const unsigned char* detail = sqlite3_column_text(stmt.get(), 5);
+        run.detail = detail ? reinterpret_cast<const char*>(detail) : "";
+        runs.push_back(std::move(run));
+    }
+    call.rows(runs.size());
+    return runs;
+}
+
+bool convert_to_incremental_vacuum(std::string* errorMsg)
+{
+    QueryCall call("convert_to_incremental_vacuum");
+    if (sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", nullptr, nullptr, nullptr) != SQLITE_OK)
+    {
+        fail(errorMsg, std::string("转换为增量自动清理失败: ") + sqlite3_errmsg(db));
+        return false;
+    }
+    SLOG_INFO("已转换为增量自动清理模式");
+    return true;
+}
+
+DatabaseHealth get_database_health()
+{
+    QueryCall call("get_database_health");
+    DatabaseHealth health;
+    health.page_size = query_long("PRAGMA page_size;");
+    health.page_count = query_long("PRAGMA page_count;");
+    health.freelist_count = query_long("PRAGMA freelist_count;");
+    health.auto_vacuum = static_cast<int>(query_long("PRAGMA auto_vacuum;"));
+    health.wal_bytes = wal_bytes();
+    if (query_long("SELECT COUNT(*) FROM sqlite_master WHERE name = 'sqlite_stat1';") != 0)
+        health.stat_rows = query_long("SELECT COUNT(*) FROM sqlite_stat1;");
+    return health;
+}
+
+void start_maintenance_scheduler()
+{
+    const char* path = sqlite3_db_filename(db, "main");
+    if (!path || !*path)
+    {
+        SLOG_WARN("内存数据库不启动维护线程");
+        return;
+    }
+    scheduler().start(path);
+}
+
+void stop_maintenance_scheduler()
+{
+    scheduler().stop();
+}
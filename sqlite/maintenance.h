@@ -0,0 +1,72 @@
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+#include <string>
+#include <vector>
+
+// 后台维护：在没有结账等写入活动时执行统计信息更新、空闲页回收和WAL检查点，不需要停机窗口。
+// 空闲先由维护连接上的PRAGMA data_version判断：任何其他连接（包括其他终端进程）提交都会使它变化；
+// 变化时再比较结账标记（最新的交易、退货和销售事件ID），只有结账和退货算作活动，维护、复制等后台写入不算。
+// 连续idle_seconds秒没有结账才算空闲，空闲时依次执行全部到期的任务，每项开始前确认结账标记未变，
+// 有新的结账即停止本轮，剩下的任务等下次空闲。
+// 任务：
+//   optimize    PRAGMA optimize，只重新分析统计信息过期的表
+//   analyze     完整ANALYZE，超出预算时下次改用抽样（analysis_limit）并逐次减半
+//   vacuum      增量自动清理模式下分批PRAGMA incremental_vacuum，有写入或超出预算时停止；
+//               早期建的库不是增量模式，在预算内完成时用一次VACUUM转换
+//   checkpoint  PASSIVE检查点；WAL文件超过阈值且已全部写回时截断WAL文件
+// 每项任务有时间预算，语句执行超出预算时中断并回滚，写锁占用时间不超过预算，
+// 结账最多等待预算时长（busy_timeout为2秒）。结果记录在maintenance_runs表中，所有终端共用，
+// 多个终端同时运行时按上次执行时间跳过其他终端刚做过的任务
+
+// 维护参数
+struct MaintenanceOptions
+{
+    int idle_seconds = 120;                         // 连续多少秒没有写入算空闲
+    int poll_seconds = 5;                           // 判断空闲的间隔
+    int budget_ms = 400;                            // 每项任务的时间预算
+    long long optimize_interval_seconds = 3600;
+    long long analyze_interval_seconds = 86400;
+    long long vacuum_interval_seconds = 3600;
+    long long checkpoint_interval_seconds = 60;
+    long long vacuum_min_free_pages = 256;          // 空闲页少于此数时不回收
+    long long wal_truncate_bytes = 4LL << 20;       // WAL文件超过此大小时截断
+};
+
+// 一项任务最近一次的执行结果
+struct MaintenanceRun
+{
+    std::string job;
+    long long run_at = 0;       // 开始时间
+    double seconds = 0.0;       // 耗时
+    bool ok = false;
+    bool over_budget = false;   // 超出预算被中断或提前停止
+    std::string detail;         // 执行情况说明
+};
+
+// 数据库文件状况
+struct DatabaseHealth
+{
+    long long page_size = 0;
+    long long page_count = 0;
+    long long freelist_count = 0;   // 空闲页数
+    int auto_vacuum = 0;            // 0 关闭，1 完全，2 增量
+    long long wal_bytes = 0;        // WAL文件大小
+    long long stat_rows = 0;        // sqlite_stat1中的统计行数，0表示从未ANALYZE
+};
+
+void set_maintenance_options(const MaintenanceOptions& options);
+MaintenanceOptions get_maintenance_options();
+// 在当前线程的连接上立即执行一项任务（optimize、analyze、vacuum、checkpoint），不判断空闲
+bool run_maintenance_job(const std::string& job, MaintenanceRun* result = nullptr, std::string* errorMsg = nullptr);
+// 用一次不限时的VACUUM把早期建的库转换为增量自动清理模式，期间其他终端无法写入，在停业时执行
+bool convert_to_incremental_vacuum(std::string* errorMsg = nullptr);
+// 各任务最近一次的执行结果
+std::vector<MaintenanceRun> get_maintenance_runs();
+DatabaseHealth get_database_health();
+
+// 后台维护线程：用独立连接按poll_seconds判断空闲并执行到期任务；
+// 在当前线程init_db成功后调用，重复调用会先停止之前的线程
+void start_maintenance_scheduler();
+void stop_maintenance_scheduler();
+
+#endif // MAINTENANCE_H
@@ -0,0 +1,725 @@
+#include "promotion.h"
+#include "db_internal.h"
+#include "log.h"
+#include "timeutil.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+// 编译后的规则：金额换算为分，按商品ID索引引用它的规则
+struct PromotionRule
+{
+    enum class Kind { MultiBuy, Bundle, Percent };
+
+    int promotion_id = 0;
+    Kind kind = Kind::Percent;
+    int quantity = 0;
+    long long price_cents = 0;
+    double percent = 0.0;
+    long long start_time = 0;
+    long long end_time = 0;
+    int day_start_minute = 0;
+    int day_end_minute = 0;
+    std::vector<PromotionItem> items;
+};
+
+class PromotionRules
+{
+public:
+    std::vector<PromotionRule> rules;
+    std::unordered_map<int, std::vector<int>> by_product;   // 商品ID -> 引用它的规则下标
+};
+
+namespace
+{
+    long long to_cents(const double amount)
+    {
+        return std::llround(amount * 100.0);
+    }
+
+    bool parse_kind(const std::string& kind, PromotionRule::Kind& result)
+    {
+        if (kind == "multibuy")
+            result = PromotionRule::Kind::MultiBuy;
+        else if (kind == "bundle")
+            result = PromotionRule::Kind::Bundle;
+        else if (kind == "percent")
+            result = PromotionRule::Kind::Percent;
+        else
+            return false;
+        return true;
+    }
+
+    // 促销在now时是否生效：有效期和每天的时段都满足
+    bool rule_live(const PromotionRule& rule, const time_t now)
+    {
+        if (rule.start_time != 0 && now < rule.start_time)
+            return false;
+        if (rule.end_time != 0 && now >= rule.end_time)
+            return false;
+        if (rule.day_start_minute == rule.day_end_minute)
+            return true;
+        // 结账可能在界面线程、收银服务和异步查询线程上同时计价，使用可重入的local_time
+        std::tm local{};
+        local_time(now, local);
+        const int minute = local.tm_hour * 60 + local.tm_min;
+        if (rule.day_start_minute < rule.day_end_minute)
+            return minute >= rule.day_start_minute && minute < rule.day_end_minute;
+        // 跨过零点的时段，如22:00到次日02:00
+        return minute >= rule.day_start_minute || minute < rule.day_end_minute;
+    }
+
+    // 把total按weights的比例分摊，舍去的零头计入权重最大的一项，每项不超过其权重
+    void allocate(const long long total, const std::vector<long long>& weights, std::vector<long long>& shares)
+    {
+        shares.assign(weights.size(), 0);
+        long long sum = 0;
+        size_t largest = 0;
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            sum += weights[i];
+            if (weights[i] > weights[largest])
+                largest = i;
+        }
+        if (total <= 0 || sum <= 0)
+            return;
+        long long assigned = 0;
+        for (size_t i = 0; i < weights.size(); ++i)
+        {
+            shares[i] = total * weights[i] / sum;
+            assigned += shares[i];
+        }
+        shares[largest] = std::min(weights[largest], shares[largest] + total - assigned);
+    }
+
+    std::string validate(const Promotion& promotion)
+    {
+        PromotionRule::Kind kind;
+        if (promotion.name.empty())
+            return "促销名称不能为空";
+        if (!parse_kind(promotion.kind, kind))
+            return "促销种类应为multibuy、bundle或percent: " + promotion.kind;
+        if (promotion.items.empty())
+            return "促销至少要包含一个商品";
+        int units = 0;
+        for (const auto& item : promotion.items)
+        {
+            if (item.quantity <= 0)
+                return "促销中商品ID " + std::to_string(item.product_id) + " 的数量应大于0";
+            units += item.quantity;
+        }
+        if (kind == PromotionRule::Kind::MultiBuy && (promotion.quantity < 2 || promotion.price <= 0))
+            return "任选促销的每组件数应不少于2，每组价格应大于0";
+        if (kind == PromotionRule::Kind::Bundle && (units < 2 || promotion.price <= 0))
+            return "组合促销应至少包含两件商品，每组价格应大于0";
+        if (kind == PromotionRule::Kind::Percent && (promotion.percent <= 0 || promotion.percent > 100))
+            return "折扣促销的减价百分比应在0到100之间";
+        if (promotion.end_time != 0 && promotion.end_time <= promotion.start_time)
+            return "促销的结束时间应晚于开始时间";
+        for (const int minute : {promotion.day_start_minute, promotion.day_end_minute})
+        {
+            if (minute < 0 || minute > 1440)
+                return "每天的生效时段应在0到1440分钟之间";
+        }
+        return "";
+    }
+
+    void fail(std::string* errorMsg, const std::string& message)
+    {
+        SLOG_ERROR("%s", message.c_str());
+        if (errorMsg) *errorMsg = message;
+    }
+
+    // 读出全部促销及其商品；active_only时只读启用的
+    bool read_promotions(const bool active_only, std::vector<Promotion>& promotions)
+    {
+        const CachedStatement header(
+            "SELECT promotion_id, name, kind, quantity, price, percent, start_time, end_time, "
+            "day_start_minute, day_end_minute, active FROM promotions WHERE active OR NOT ?1 ORDER BY promotion_id;");
+        const CachedStatement items(
+            "SELECT promotion_id, product_id, quantity FROM promotion_items ORDER BY promotion_id, product_id;");
+        if (!header || !items)
+            return false;
+        std::map<int, size_t> index;
+        sqlite3_bind_int(header.get(), 1, active_only ? 1 : 0);
+        int rc;
+        while ((rc = sqlite3_step(header.get())) == SQLITE_ROW)
+        {
+            sqlite3_stmt* stmt = header.get();
+            Promotion promotion;
+            promotion.promotion_id = sqlite3_column_int(stmt, 0);
+            const auto* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            promotion.name = name ? name : "";
+            const auto* kind = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+            promotion.kind = kind ? kind : "";
+            promotion.quantity = sqlite3_column_int(stmt, 3);
+            promotion.price = sqlite3_column_double(stmt, 4);
+            promotion.percent = sqlite3_column_double(stmt, 5);
+            promotion.start_time = sqlite3_column_int64(stmt, 6);
+            promotion.end_time = sqlite3_column_int64(stmt, 7);
+            promotion.day_start_minute = sqlite3_column_int(stmt, 8);
+            promotion.day_end_minute = sqlite3_column_int(stmt, 9);
+            promotion.active = sqlite3_column_int(stmt, 10) != 0;
+            index[promotion.promotion_id] = promotions.size();
+            promotions.push_back(promotion);
+        }
+        if (rc != SQLITE_DONE)
+            return false;
+        while ((rc = sqlite3_step(items.get())) == SQLITE_ROW)
+        {
+            const auto found = index.find(sqlite3_column_int(items.get(), 0));
+            if (found != index.end())
+                promotions[found->second].items.push_back({sqlite3_column_int(items.get(), 1),
+                                                           sqlite3_column_int(items.get(), 2)});
+        }
+        return rc == SQLITE_DONE;
+    }
+
+    // 编译结果按数据库文件和促销版本缓存，同一进程中的多个购物车共用
+    std::mutex g_rulesMutex;
+    std::string g_rulesPath;
+    long long g_rulesVersion = -1;
+    std::shared_ptr<const PromotionRules> g_rules;
+}
+
+bool add_promotion(Promotion& promotion, std::string* errorMsg)
+{
+    QueryCall call("add_promotion");
+    const std::string invalid = validate(promotion);
+    if (!invalid.empty())
+    {
+        fail(errorMsg, "新增促销失败: " + invalid);
+        return false;
+    }
+
+    int promotion_id = 0;
+    std::string err;
+    const bool ok = run_write_transaction("新增促销", [&]
+    {
+        err.clear();
+        const CachedStatement insert(
+            "INSERT INTO promotions (name, kind, quantity, price, percent, start_time, end_time, "
+            "day_start_minute, day_end_minute, active) VALUES (?1, ?2, ?3, round(?4, 2), ?5, ?6, ?7, ?8, ?9, ?10);");
+        const CachedStatement exists("SELECT 1 FROM products WHERE id = ?1;");
+        const CachedStatement insert_item(
+            "INSERT INTO promotion_items (promotion_id, product_id, quantity) VALUES (?1, ?2, ?3);");
+        if (!insert || !exists || !insert_item)
+            return write_status_of(sqlite3_errcode(db));
+
+        sqlite3_stmt* stmt = insert.get();
+        sqlite3_bind_text(stmt, 1, promotion.name.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, promotion.kind.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 3, promotion.quantity);
+        sqlite3_bind_double(stmt, 4, promotion.price);
+        sqlite3_bind_double(stmt, 5, promotion.percent);
+        sqlite3_bind_int64(stmt, 6, promotion.start_time);
+        sqlite3_bind_int64(stmt, 7, promotion.end_time);
+        sqlite3_bind_int(stmt, 8, promotion.day_start_minute);
+        sqlite3_bind_int(stmt, 9, promotion.day_end_minute);
+        sqlite3_bind_int(stmt, 10, promotion.active ? 1 : 0);
+        int rc = sqlite3_step(stmt);
+        if (rc != SQLITE_DONE)
+            return write_status_of(rc);
+        promotion_id = static_cast<int>(sqlite3_last_insert_rowid(db));
+
+        for (const auto& item : promotion.items)
+        {
+            sqlite3_reset(exists.get());
+            sqlite3_bind_int(exists.get(), 1, item.product_id);
+            rc = sqlite3_step(exists.get());
+            if (rc == SQLITE_DONE)
+            {
+                err = "新增促销失败: 未找到ID为 " + std::to_string(item.product_id) + " 的商品";
+                return WriteStatus::Failed;
+            }
+            if (rc != SQLITE_ROW)
+                return write_status_of(rc);
+
+            sqlite3_reset(insert_item.get());
+            sqlite3_bind_int(insert_item.get(), 1, promotion_id);
+            sqlite3_bind_int(insert_item.get(), 2, item.product_id);
+            sqlite3_bind_int(insert_item.get(), 3, item.quantity);
+            rc = sqlite3_step(insert_item.get());
+            if (rc == SQLITE_CONSTRAINT)
+            {
+                err = "新增促销失败: 商品ID " + std::to_string(item.product_id) + " 重复出现";
+                return WriteStatus::Failed;
+            }
+            if (rc != SQLITE_DONE)
+                return write_status_of(rc);
+        }
+        return WriteStatus::Ok;
+    });
+    if (!ok)
+    {
+        fail(errorMsg, err.empty() ? "新增促销失败: " + std::string(sqlite3_errmsg(db)) : err);
+        return false;
+    }
+    promotion.promotion_id = promotion_id;
+    SLOG_INFO("促销 %d（%s）已新增，包含 %zu 种商品", promotion_id, promotion.name.c_str(), promotion.items.size());
+    return true;
+}
+
+bool set_promotion_active(const int promotion_id, const bool active, std::string* errorMsg)
+{
+    QueryCall call("set_promotion_active");
+    const CachedStatement stmt("UPDATE promotions SET active = ?1 WHERE promotion_id = ?2;");
+    if (!stmt)
+    {
+        fail(errorMsg, "修改促销状态失败: " + std::string(sqlite3_errmsg(db)));
+        return false;
+    }
+    sqlite3_bind_int(stmt.get(), 1, active ? 1 : 0);
+    sqlite3_bind_int(stmt.get(), 2, promotion_id);
+    const int rc = sqlite3_step(stmt.get());
+    if (rc != SQLITE_DONE)
+    {
+        fail(errorMsg, "修改促销状态失败: " + std::string(sqlite3_errmsg(db)));
+        return false;
+    }
+    if (sqlite3_changes(db) == 0)
+    {
+        fail(errorMsg, "修改促销状态失败: 未找到ID为 " + std::to_string(promotion_id) + " 的促销");
+        return false;
+    }
+    SLOG_INFO("促销 %d 已%s", promotion_id, active ? "启用" : "停用");
+    return true;
+}
+
+bool delete_promotion(const int promotion_id, std::string* errorMsg)
+{
+    QueryCall call("delete_promotion");
+    // 已保存的购物车项只记录促销ID，删除促销不影响历史交易的金额
+    const CachedStatement stmt("DELETE FROM promotions WHERE promotion_id = ?1;");
+    if (!stmt)
+    {
+        fail(errorMsg, "删除促销失败: " + std::string(sqlite3_errmsg(db)));
+        return false;
+    }
+    sqlite3_bind_int(stmt.get(), 1, promotion_id);
+    const int rc = sqlite3_step(stmt.get());
+    if (rc != SQLITE_DONE || sqlite3_changes(db) == 0)
+    {
+        fail(errorMsg, rc != SQLITE_DONE ? "删除促销失败: " + std::string(sqlite3_errmsg(db))
+                                         : "删除促销失败: 未找到ID为 " + std::to_string(promotion_id) + " 的促销");
+        return false;
+    }
+    SLOG_INFO("促销 %d 已删除", promotion_id);
+    return true;
+}
+
+std::vector<Promotion> get_promotions()
+{
+    QueryCall call("get_promotions");
+    std::vector<Promotion> promotions;
+    if (!read_promotions(false, promotions))
+        SLOG_ERROR("查询促销失败: %s", sqlite3_errmsg(db));
+    call.rows(promotions.size());
+    return promotions;
+}
+
+std::shared_ptr<const PromotionRules> load_promotion_rules(std::string* errorMsg)
+{
+    QueryCall call("load_promotion_rules");
+    const char* filename = sqlite3_db_filename(db, "main");
+    const std::string path = filename ? filename : "";
+    long long version = -1;
+    {
+        const CachedStatement stmt("SELECT version FROM promotion_state WHERE id = 1;");
+        if (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+            version = sqlite3_column_int64(stmt.get(), 0);
+    }
+    if (version < 0)
+    {
+        fail(errorMsg, "读取促销版本失败: " + std::string(sqlite3_errmsg(db)));
+        return std::make_shared<const PromotionRules>();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(g_rulesMutex);
+        if (g_rules && g_rulesVersion == version && g_rulesPath == path)
+            return g_rules;
+    }
+
+    std::vector<Promotion> promotions;
+    if (!read_promotions(true, promotions))
+    {
+        fail(errorMsg, "读取促销失败: " + std::string(sqlite3_errmsg(db)));
+        return std::make_shared<const PromotionRules>();
+    }
+    auto rules = std::make_shared<PromotionRules>();
+    for (const auto& promotion : promotions)
+    {
+        PromotionRule rule;
+        if (!parse_kind(promotion.kind, rule.kind) || promotion.items.empty())
+            continue;
+        rule.promotion_id = promotion.promotion_id;
+        rule.quantity = promotion.quantity;
+        rule.price_cents = to_cents(promotion.price);
+        rule.percent = promotion.percent;
+        rule.start_time = promotion.start_time;
+        rule.end_time = promotion.end_time;
+        rule.day_start_minute = promotion.day_start_minute;
+        rule.day_end_minute = promotion.day_end_minute;
+        rule.items = promotion.items;
+        const int index = static_cast<int>(rules->rules.size());
+        for (const auto& item : rule.items)
+            rules->by_product[item.product_id].push_back(index);
+        rules->rules.push_back(std::move(rule));
+    }
+
+    std::lock_guard<std::mutex> lock(g_rulesMutex);
+    g_rulesPath = path;
+    g_rulesVersion = version;
+    g_rules = rules;
+    call.rows(rules->rules.size());
+    SLOG_DEBUG("促销规则已编译: %zu 条，涉及 %zu 种商品，促销版本 %lld",
+               rules->rules.size(), rules->by_product.size(), version);
+    return rules;
+}
+
+size_t promotion_rule_count(const PromotionRules& rules)
+{
+    return rules.rules.size();
+}
+
+CartPricer::CartPricer(std::shared_ptr<const PromotionRules> rules, const time_t now)
+{
+    reset(std::move(rules), now);
+}
+
+const std::vector<int>& CartPricer::reset(std::shared_ptr<const PromotionRules> rules, const time_t now)
+{
+    m_rules = std::move(rules);
+    m_now = now;
+    m_live.clear();
+    if (m_rules)
+    {
+        m_live.reserve(m_rules->rules.size());
+        for (const auto& rule : m_rules->rules)
+            m_live.push_back(rule_live(rule, now) ? 1 : 0);
+    }
+
+    // 清空各行的候选折扣，再对购物车中商品引用到的每条规则计算一次
+    for (auto& [product_id, line] : m_lines)
+        line.offers.clear();
+    std::vector<int> pending;
+    if (m_rules)
+    {
+        std::vector<char> seen(m_rules->rules.size(), 0);
+        for (const auto& [product_id, line] : m_lines)
+        {
+            const auto found = m_rules->by_product.find(product_id);
+            if (found == m_rules->by_product.end())
+                continue;
+            for (const int rule : found->second)
+            {
+                if (!seen[rule] && m_live[rule])
+                {
+                    seen[rule] = 1;
+                    pending.push_back(rule);
+                }
+            }
+        }
+    }
+    m_changed.clear();
+    std::vector<int> touched;
+    for (const int rule : pending)
+        evaluate(rule, touched);
+    // 整车重新选取，不再有任何促销的行折扣归零
+    touched.clear();
+    for (const auto& [product_id, line] : m_lines)
+        touched.push_back(product_id);
+    resolve(touched);
+    return m_changed;
+}
+
+const std::vector<int>& CartPricer::set_line(const int product_id, const double price, const int quantity)
+{
+    m_changed.clear();
+    std::vector<int> touched;
+    const auto found = m_lines.find(product_id);
+    if (quantity <= 0)
+    {
+        if (found == m_lines.end())
+            return m_changed;
+        m_totalDiscount -= found->second.discount_cents;
+        m_lines.erase(found);
+    }
+    else
+    {
+        Line& line = found != m_lines.end() ? found->second : m_lines[product_id];
+        line.price_cents = to_cents(price);
+        line.quantity = quantity;
+        // 单价或数量变化后折扣可能超过该行金额，即使没有相关规则也要重新选取
+        touched.push_back(product_id);
+    }
+
+    if (m_rules)
+    {
+        const auto rules = m_rules->by_product.find(product_id);
+        if (rules != m_rules->by_product.end())
+        {
+            for (const int rule : rules->second)
+            {
+                if (m_live[rule])
+                    evaluate(rule, touched);
+            }
+        }
+    }
+    resolve(touched);
+    return m_changed;
+}
+
+void CartPricer::clear()
+{
+    m_lines.clear();
+    m_totalDiscount = 0;
+    m_changed.clear();
+}
+
+double CartPricer::discount(const int product_id) const
+{
+    const auto found = m_lines.find(product_id);
+    return found != m_lines.end() ? static_cast<double>(found->second.discount_cents) / 100.0 : 0.0;
+}
+
+int CartPricer::promotion_id(const int product_id) const
+{
+    const auto found = m_lines.find(product_id);
+    return found != m_lines.end() ? found->second.promotion_id : 0;
+}
+
+void CartPricer::evaluate(const int rule_index, std::vector<int>& touched)
+{
+    const PromotionRule& rule = m_rules->rules[rule_index];
+    const size_t count = rule.items.size();
+
+    // 规则中各商品在购物车中的行，不在购物车中的为空
+    std::vector<Line*> lines(count, nullptr);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto found = m_lines.find(rule.items[i].product_id);
+        if (found != m_lines.end())
+            lines[i] = &found->second;
+    }
+
+    std::vector<long long> shares(count, 0);
+    switch (rule.kind)
+    {
+    case PromotionRule::Kind::Percent:
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (lines[i])
+                shares[i] = std::llround(static_cast<double>(lines[i]->price_cents * lines[i]->quantity) *
+                                         rule.percent / 100.0);
+        }
+        break;
+    case PromotionRule::Kind::Bundle:
+    {
+        // 可成组数取各商品数量与所需数量之比的最小值
+        long long sets = -1;
+        long long set_cents = 0;
+        std::vector<long long> weights(count, 0);
+        for (size_t i = 0; i < count; ++i)
+        {
+            const long long have = lines[i] ? lines[i]->quantity / rule.items[i].quantity : 0;
+            sets = sets < 0 ? have : std::min(sets, have);
+            if (lines[i])
+            {
+                weights[i] = lines[i]->price_cents * rule.items[i].quantity;
+                set_cents += weights[i];
+            }
+        }
+        if (sets > 0 && set_cents > rule.price_cents)
+        {
+            for (long long& weight : weights)
+                weight *= sets;
+            allocate(sets * (set_cents - rule.price_cents), weights, shares);
+        }
+        break;
+    }
+    case PromotionRule::Kind::MultiBuy:
+    {
+        // 单价高的商品先成组，凑不满一组的剩余件数按原价
+        std::vector<size_t> order;
+        long long units = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (lines[i])
+            {
+                order.push_back(i);
+                units += lines[i]->quantity;
+            }
+        }
+        const long long groups = units / rule.quantity;
+        if (groups == 0)
+            break;
+        std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b)
+        {
+            return lines[a]->price_cents > lines[b]->price_cents;
+        });
+        std::vector<long long> weights(count, 0);
+        long long remaining = groups * rule.quantity;
+        long long grouped_cents = 0;
+        for (const size_t i : order)
+        {
+            const long long taken = std::min<long long>(remaining, lines[i]->quantity);
+            weights[i] = taken * lines[i]->price_cents;
+            grouped_cents += weights[i];
+            remaining -= taken;
+            if (remaining == 0)
+                break;
+        }
+        allocate(grouped_cents - groups * rule.price_cents, weights, shares);
+        break;
+    }
+    }
+
+    // 更新各行中该规则给出的折扣，由resolve重新选取
+    for (size_t i = 0; i < count; ++i)
+    {
+        Line* line = lines[i];
+        if (!line)
+            continue;
+        auto offer = std::find_if(line->offers.begin(), line->offers.end(),
+                                  [rule_index](const Offer& o) { return o.rule == rule_index; });
+        if (shares[i] > 0)
+        {
+            if (offer != line->offers.end())
+                offer->cents = shares[i];
+            else
+                line->offers.push_back({rule_index, shares[i]});
+        }
+        else if (offer != line->offers.end())
+        {
+            line->offers.erase(offer);
+        }
+        touched.push_back(rule.items[i].product_id);
+    }
+}
+
+void CartPricer::resolve(const std::vector<int>& touched)
+{
+    // 组合、任选把多行连在一起：从touched出发沿这些规则找出相连的全部行，只在其中重新分配，
+    // 其余行的候选没有变化，原来的选取仍然成立
+    std::vector<int> component;
+    std::vector<int> pending;
+    auto visit = [&](const int product_id)
+    {
+        if (m_lines.contains(product_id) && std::find(component.begin(), component.end(), product_id) == component.end())
+        {
+            component.push_back(product_id);
+            pending.push_back(product_id);
+        }
+    };
+    for (const int product_id : touched)
+        visit(product_id);
+    while (!pending.empty())
+    {
+        const int product_id = pending.back();
+        pending.pop_back();
+        for (const Offer& offer : m_lines.at(product_id).offers)
+        {
+            const PromotionRule& rule = m_rules->rules[offer.rule];
+            if (rule.kind == PromotionRule::Kind::Percent)
+                continue;
+            for (const auto& item : rule.items)
+                visit(item.product_id);
+        }
+    }
+
+    // 候选：折扣促销每行单独一项；组合、任选整条规则一项，折扣为各行分摊之和
+    struct Candidate
+    {
+        int rule;
+        int product_id;     // 折扣促销所在的行，组合、任选为0
+        long long cents;
+    };
+    std::vector<Candidate> candidates;
+    for (const int product_id : component)
+    {
+        for (const Offer& offer : m_lines.at(product_id).offers)
+        {
+            if (m_rules->rules[offer.rule].kind == PromotionRule::Kind::Percent)
+            {
+                candidates.push_back({offer.rule, product_id, offer.cents});
+                continue;
+            }
+            auto group = std::find_if(candidates.begin(), candidates.end(), [&offer](const Candidate& c)
+            {
+                return c.rule == offer.rule && c.product_id == 0;
+            });
+            if (group != candidates.end())
+                group->cents += offer.cents;
+            else
+                candidates.push_back({offer.rule, 0, offer.cents});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](const Candidate& a, const Candidate& b)
+    {
+        if (a.cents != b.cents)
+            return a.cents > b.cents;
+        const int a_id = m_rules->rules[a.rule].promotion_id;
+        const int b_id = m_rules->rules[b.rule].promotion_id;
+        return a_id != b_id ? a_id < b_id : a.product_id < b.product_id;
+    });
+
+    // 按总折扣从大到小选取；组合、任选涉及的行有一行已被占用则整组放弃
+    std::unordered_map<int, Offer> chosen;
+    std::vector<std::pair<int, long long>> members;
+    for (const Candidate& candidate : candidates)
+    {
+        if (candidate.product_id != 0)
+        {
+            chosen.try_emplace(candidate.product_id, Offer{candidate.rule, candidate.cents});
+            continue;
+        }
+        members.clear();
+        bool free = true;
+        for (const auto& item : m_rules->rules[candidate.rule].items)
+        {
+            const auto line = m_lines.find(item.product_id);
+            if (line == m_lines.end())
+                continue;
+            const auto offer = std::find_if(line->second.offers.begin(), line->second.offers.end(),
+                                            [&candidate](const Offer& o) { return o.rule == candidate.rule; });
+            if (offer == line->second.offers.end())
+                continue;
+            if (chosen.contains(item.product_id))
+            {
+                free = false;
+                break;
+            }
+            members.emplace_back(item.product_id, offer->cents);
+        }
+        if (!free)
+            continue;
+        for (const auto& [product_id, cents] : members)
+            chosen.emplace(product_id, Offer{candidate.rule, cents});
+    }
+
+    for (const int product_id : component)
+    {
+        const auto offer = chosen.find(product_id);
+        if (offer != chosen.end())
+            apply(product_id, m_lines.at(product_id), offer->second.cents,
+                  m_rules->rules[offer->second.rule].promotion_id);
+        else
+            apply(product_id, m_lines.at(product_id), 0, 0);
+    }
+}
+
+void CartPricer::apply(const int product_id, Line& line, long long cents, int promotion_id)
+{
+    cents = std::min(cents, line.price_cents * line.quantity);
+    promotion_id = cents > 0 ? promotion_id : 0;
+    if (cents == line.discount_cents && promotion_id == line.promotion_id)
+        return;
+    m_totalDiscount += cents - line.discount_cents;
+    line.discount_cents = cents;
+    line.promotion_id = promotion_id;
+    if (std::find(m_changed.begin(), m_changed.end(), product_id) == m_changed.end())
+        m_changed.push_back(product_id);
+}
@@ -0,0 +1,111 @@
+#ifndef PROMOTION_H
+#define PROMOTION_H
+#include <ctime>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 促销与定价规则：促销保存在promotions和promotion_items表中，终端把启用的促销编译为按商品ID索引的规则表，
+// 购物车某一行的数量变化时只重新计算引用该商品的规则，折扣和总额增量更新。
+// 促销种类：
+//   multibuy  任选：所列商品中每凑满quantity件按price计价（如任选3件10元），单价高的先成组
+//   bundle    组合：每凑齐一组（各商品按promotion_items中的数量）按price计价，可成多组
+//   percent   折扣：所列商品减价percent%（如8折即20）
+// 每条促销都可以限定有效期[start_time, end_time)和每天的时段[day_start_minute, day_end_minute)，
+// 为0或起止相同表示不限，时段可以跨过零点。
+// 组合和任选的折扣按各行参与成组的金额分摊到各行。同一商品参与多个促销时各促销独立计算，不叠加：
+// 按促销的总折扣从大到小选取，组合和任选只有成组的各行都还没被选中的促销占用时才生效，
+// 否则整组不生效，同一件商品不会同时计入两个促销。折扣记入购物车项的discount，subtotal为扣除折扣后的金额
+
+// 促销中的一个商品
+struct PromotionItem
+{
+    int product_id = 0;
+    int quantity = 1;       // bundle种类中该商品的数量，其余种类忽略
+};
+
+struct Promotion
+{
+    int promotion_id = 0;
+    std::string name;
+    std::string kind;               // multibuy、bundle或percent
+    int quantity = 0;               // multibuy每组件数
+    double price = 0.0;             // multibuy、bundle每组价格
+    double percent = 0.0;           // percent减价百分比，0到100
+    long long start_time = 0;       // 有效期起点（含），0表示不限
+    long long end_time = 0;         // 有效期终点（不含），0表示不限
+    int day_start_minute = 0;       // 每天生效时段，当天的第几分钟，起止相同表示全天
+    int day_end_minute = 0;
+    bool active = true;
+    std::vector<PromotionItem> items;
+};
+
+// 新增促销，成功后写回promotion_id；种类与参数不匹配或商品不存在时失败
+bool add_promotion(Promotion& promotion, std::string* errorMsg = nullptr);
+bool set_promotion_active(int promotion_id, bool active, std::string* errorMsg = nullptr);
+bool delete_promotion(int promotion_id, std::string* errorMsg = nullptr);
+// 全部促销（含停用的），按promotion_id排序
+std::vector<Promotion> get_promotions();
+
+// 编译后的促销规则，只读，多个购物车可共享同一份
+class PromotionRules;
+
+// 当前数据库中启用且未过期的促销编译结果；促销版本（promotion_state）未变时返回缓存的同一份，
+// 每次调用只读一次版本号。失败时返回空规则
+std::shared_ptr<const PromotionRules> load_promotion_rules(std::string* errorMsg = nullptr);
+// 规则数
+size_t promotion_rule_count(const PromotionRules& rules);
+
+// 一个购物车的促销计算状态：记录各行的数量、单价和各相关促销给出的折扣，
+// 修改一行时只计算引用该商品的规则，代价与购物车大小和促销总数无关
+class CartPricer
+{
+public:
+    explicit CartPricer(std::shared_ptr<const PromotionRules> rules = nullptr, time_t now = 0);
+
+    // 换用规则或计价时间后整车重算；返回折扣有变化的商品ID
+    const std::vector<int>& reset(std::shared_ptr<const PromotionRules> rules, time_t now);
+    // 某商品所在行的单价和数量变化，quantity为0表示移出购物车；
+    // 返回折扣有变化且仍在购物车中的商品ID（可能包括该商品本身）
+    const std::vector<int>& set_line(int product_id, double price, int quantity);
+    void clear();
+
+    // 商品所在行的折扣金额和所取的促销，没有折扣时为0
+    double discount(int product_id) const;
+    int promotion_id(int product_id) const;
+    double total_discount() const { return static_cast<double>(m_totalDiscount) / 100.0; }
+    time_t now() const { return m_now; }
+
+private:
+    // 某个促销给一行的折扣，以分为单位
+    struct Offer
+    {
+        int rule;
+        long long cents;
+    };
+
+    struct Line
+    {
+        long long price_cents = 0;
+        int quantity = 0;
+        std::vector<Offer> offers;
+        long long discount_cents = 0;
+        int promotion_id = 0;
+    };
+
+    // 重新计算一条规则给各行的折扣，把涉及的行加入touched
+    void evaluate(int rule, std::vector<int>& touched);
+    // 为touched中的行及经由组合、任选与它们相连的行重新选取促销
+    void resolve(const std::vector<int>& touched);
+    void apply(int product_id, Line& line, long long cents, int promotion_id);
+
+    std::shared_ptr<const PromotionRules> m_rules;
+    std::vector<char> m_live;           // 各规则在m_now时是否生效
+    time_t m_now = 0;
+    std::unordered_map<int, Line> m_lines;
+    long long m_totalDiscount = 0;
+    std::vector<int> m_changed;
+};
+
+#endif // PROMOTION_H
@@ -0,0 +1,364 @@
+#include "querystats.h"
+#include "db_internal.h"
+#include "log.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // 对数分桶：每个2倍区间分8个桶，覆盖1ns到约18分钟
+    constexpr int kBucketsPerOctave = 8;
+    constexpr int kBuckets = kBucketsPerOctave * 40;
+
+    int bucket_of(const std::uint64_t ns)
+    {
+        if (ns <= 1)
+            return 0;
+        const int bucket = static_cast<int>(std::log2(static_cast<double>(ns)) * kBucketsPerOctave);
+        return std::min(bucket, kBuckets - 1);
+    }
+
+    double bucket_upper_ms(const int bucket)
+    {
+        return std::exp2(static_cast<double>(bucket + 1) / kBucketsPerOctave) / 1e6;
+    }
+
+    struct EntryData
+    {
+        std::uint64_t calls = 0;
+        std::uint64_t total_ns = 0;
+        std::uint64_t max_ns = 0;
+        std::uint64_t rows_returned = 0;
+        std::uint64_t rows_changed = 0;
+        std::array<std::uint32_t, kBuckets> histogram{};
+    };
+
+    struct StatementData
+    {
+        std::uint64_t executions = 0;
+        std::uint64_t total_ns = 0;
+        std::uint64_t max_ns = 0;
+        std::uint64_t fullscan_steps = 0;
+        std::uint64_t sorts = 0;
+        std::uint64_t autoindexes = 0;
+        std::uint64_t vm_steps = 0;
+    };
+
+    std::mutex g_mutex;
+    std::unordered_map<std::string, EntryData> g_entries;
+    std::unordered_map<std::string, StatementData> g_statements;
+    std::uint64_t g_slowQueries = 0;
+    std::atomic<std::uint64_t> g_slowThresholdNs{100 * 1000 * 1000ULL};
+
+    // 拼接字面量的SQL每个参数值都是不同文本，超过上限后归入同一项，避免统计表无限增长
+    constexpr size_t kMaxStatements = 512;
+    const char* const kOverflowStatement = "<其他语句>";
+
+    double p99_ms(const EntryData& data)
+    {
+        const std::uint64_t target = data.calls - data.calls / 100;
+        std::uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i)
+        {
+            seen += data.histogram[i];
+            if (seen >= target)
+                return std::min(bucket_upper_ms(i), static_cast<double>(data.max_ns) / 1e6);
+        }
+        return static_cast<double>(data.max_ns) / 1e6;
+    }
+
+    int on_trace(const unsigned type, void*, void* p, void* x)
+    {
+        if (type != SQLITE_TRACE_PROFILE)
+            return 0;
+        auto* stmt = static_cast<sqlite3_stmt*>(p);
+        const auto ns = static_cast<std::uint64_t>(*static_cast<sqlite3_int64*>(x));
+        const char* sql = sqlite3_sql(stmt);
+        if (!sql)
+            return 0;
+
+        // 读取后清零，使计数器对应单次执行
+        const int fullscan = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+        const int sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+        const int autoindexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+        const int vm_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+
+        const std::uint64_t threshold = g_slowThresholdNs.load(std::memory_order_relaxed);
+        const bool slow = threshold != 0 && ns >= threshold;
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            auto it = g_statements.find(sql);
+            if (it == g_statements.end())
+            {
+                const char* key = g_statements.size() < kMaxStatements ? sql : kOverflowStatement;
+                it = g_statements.try_emplace(key).first;
+            }
+            StatementData& data = it->second;
+            ++data.executions;
+            data.total_ns += ns;
+            data.max_ns = std::max(data.max_ns, ns);
+            data.fullscan_steps += fullscan;
+            data.sorts += sorts;
+            data.autoindexes += autoindexes;
+            data.vm_steps += vm_steps;
+            if (slow)
+                ++g_slowQueries;
+        }
+
+        if (slow)
+        {
+            char* expanded = sqlite3_expanded_sql(stmt);
+            SLOG_WARN("慢查询 %.1fms (全表扫描 %d 步, 排序 %d 次, 自动索引 %d 个): %s",
+                    static_cast<double>(ns) / 1e6, fullscan, sorts, autoindexes, expanded ? expanded : sql);
+            sqlite3_free(expanded);
+        }
+        return 0;
+    }
+
+    void append_json_string(std::string& out, const std::string& text)
+    {
+        out += '"';
+        for (const char c : text)
+        {
+            switch (c)
+            {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                }
+                else
+                    out += c;
+            }
+        }
+        out += '"';
+    }
+
+    // 定时把快照写入文件的后台线程
+    class StatsDumper
+    {
+    public:
+        ~StatsDumper() { stop(); }
+
+        void start(const std::string& path, const int interval_seconds)
+        {
+            stop();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_path = path;
+            m_interval = std::chrono::seconds(interval_seconds);
+            m_stopping = false;
+            m_thread = std::thread([this] { run(); });
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (!m_thread.joinable())
+                    return;
+                m_stopping = true;
+            }
+            m_wakeup.notify_all();
+            m_thread.join();
+        }
+
+    private:
+        void run()
+        {
+            // 停止时再写一次，保留最后一个周期的数据
+            std::unique_lock<std::mutex> lock(m_mutex);
+            bool stopping = false;
+            while (!stopping)
+            {
+                stopping = m_wakeup.wait_for(lock, m_interval, [this] { return m_stopping; });
+                const std::string path = m_path;
+                lock.unlock();
+                write(path);
+                lock.lock();
+            }
+        }
+
+        static void write(const std::string& path)
+        {
+            const std::string json = query_stats_to_json(get_query_stats());
+            const std::string temp = path + ".tmp";
+            FILE* file = fopen(temp.c_str(), "wb");
+            if (!file)
+            {
+                SLOG_ERROR("写入统计文件失败: %s", temp.c_str());
+                return;
+            }
+            fwrite(json.data(), 1, json.size(), file);
+            fclose(file);
+            std::error_code ec;
+            std::filesystem::rename(temp, path, ec);
+            if (ec)
+                SLOG_ERROR("写入统计文件失败: %s", ec.message().c_str());
+        }
+
+        std::mutex m_mutex;
+        std::condition_variable m_wakeup;
+        std::thread m_thread;
+        std::string m_path;
+        std::chrono::seconds m_interval{60};
+        bool m_stopping = false;
+    };
+
+    StatsDumper& dumper()
+    {
+        static StatsDumper instance;
+        return instance;
+    }
+}
+
+QueryCall::QueryCall(const char* name)
+    : m_name(name), m_rows(0), m_changesBefore(db ? sqlite3_total_changes64(db) : 0), m_start(Clock::now())
+{
+}
+
+QueryCall::~QueryCall()
+{
+    const auto ns = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count());
+    const sqlite3_int64 changes = db ? sqlite3_total_changes64(db) - m_changesBefore : 0;
+
+    std::lock_guard<std::mutex> lock(g_mutex);
+    EntryData& data = g_entries[m_name];
+    ++data.calls;
+    data.total_ns += ns;
+    data.max_ns = std::max(data.max_ns, ns);
+    data.rows_returned += m_rows;
+    data.rows_changed += static_cast<std::uint64_t>(std::max<sqlite3_int64>(changes, 0));
+    ++data.histogram[bucket_of(ns)];
+}
+
+void install_query_tracing(sqlite3* conn)
+{
+    sqlite3_trace_v2(conn, SQLITE_TRACE_PROFILE, on_trace, nullptr);
+}
+
+QueryStatsSnapshot get_query_stats()
+{
+    QueryStatsSnapshot snapshot;
+    snapshot.taken_at = static_cast<std::int64_t>(time(nullptr));
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        snapshot.slow_queries = g_slowQueries;
+        for (const auto& [name, data] : g_entries)
+        {
+            EntryPointStats stats;
+            stats.name = name;
+            stats.calls = data.calls;
+            stats.total_ms = static_cast<double>(data.total_ns) / 1e6;
+            stats.p99_ms = p99_ms(data);
+            stats.max_ms = static_cast<double>(data.max_ns) / 1e6;
+            stats.rows_returned = data.rows_returned;
+            stats.rows_changed = data.rows_changed;
+            snapshot.entry_points.push_back(std::move(stats));
+        }
+        for (const auto& [sql, data] : g_statements)
+        {
+            StatementStats stats;
+            stats.sql = sql;
+            stats.executions = data.executions;
+            stats.total_ms = static_cast<double>(data.total_ns) / 1e6;
+            stats.max_ms = static_cast<double>(data.max_ns) / 1e6;
+            stats.fullscan_steps = data.fullscan_steps;
+            stats.sorts = data.sorts;
+            stats.autoindexes = data.autoindexes;
+            stats.vm_steps = data.vm_steps;
+            snapshot.statements.push_back(std::move(stats));
+        }
+    }
+
+    std::sort(snapshot.entry_points.begin(), snapshot.entry_points.end(),
+              [](const auto& a, const auto& b) { return a.total_ms > b.total_ms; });
+    std::sort(snapshot.statements.begin(), snapshot.statements.end(),
+              [](const auto& a, const auto& b) { return a.total_ms > b.total_ms; });
+    return snapshot;
+}
+
+void reset_query_stats()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_entries.clear();
+    g_statements.clear();
+    g_slowQueries = 0;
+}
+
+void set_slow_query_threshold_ms(const int threshold_ms)
+{
+    g_slowThresholdNs.store(static_cast<std::uint64_t>(std::max(threshold_ms, 0)) * 1000 * 1000,
+                            std::memory_order_relaxed);
+}
+
+bool start_query_stats_dump(const std::string& path, const int interval_seconds)
+{
+    if (path.empty() || interval_seconds <= 0)
+        return false;
+    dumper().start(path, interval_seconds);
+    return true;
+}
+
+void stop_query_stats_dump()
+{
+    dumper().stop();
+}
+
+std::string query_stats_to_json(const QueryStatsSnapshot& snapshot)
+{
+    std::string out;
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "{\n  \"taken_at\": %lld,\n  \"slow_queries\": %llu,\n  \"entry_points\": [",
+             static_cast<long long>(snapshot.taken_at), static_cast<unsigned long long>(snapshot.slow_queries));
+    out += buffer;
+    for (size_t i = 0; i < snapshot.entry_points.size(); ++i)
+    {
+        const auto& stats = snapshot.entry_points[i];
+        out += i ? ",\n    {\"name\": " : "\n    {\"name\": ";
+        append_json_string(out, stats.name);
+        snprintf(buffer, sizeof(buffer),
+                 ", \"calls\": %llu, \"total_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f, "
+                 "\"rows_returned\": %llu, \"rows_changed\": %llu}",
+                 static_cast<unsigned long long>(stats.calls), stats.total_ms, stats.p99_ms, stats.max_ms,
+                 static_cast<unsigned long long>(stats.rows_returned),
+                 static_cast<unsigned long long>(stats.rows_changed));
+        out += buffer;
+    }
+    out += "\n  ],\n  \"statements\": [";
+    for (size_t i = 0; i < snapshot.statements.size(); ++i)
+    {
+        const auto& stats = snapshot.statements[i];
+        out += i ? ",\n    {\"sql\": " : "\n    {\"sql\": ";
+        append_json_string(out, stats.sql);
+        snprintf(buffer, sizeof(buffer),
+                 ", \"executions\": %llu, \"total_ms\": %.3f, \"max_ms\": %.3f, \"fullscan_steps\": %llu, "
+                 "\"sorts\": %llu, \"autoindexes\": %llu, \"vm_steps\": %llu}",
+                 static_cast<unsigned long long>(stats.executions), stats.total_ms, stats.max_ms,
+                 static_cast<unsigned long long>(stats.fullscan_steps),
+                 static_cast<unsigned long long>(stats.sorts), static_cast<unsigned long long>(stats.autoindexes),
+                 static_cast<unsigned long long>(stats.vm_steps));
+        out += buffer;
+    }
+    out += "\n  ]\n}\n";
+    return out;
+}
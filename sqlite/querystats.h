@@ -0,0 +1,52 @@
+#ifndef QUERYSTATS_H
+#define QUERYSTATS_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 数据层入口函数的调用统计
+struct EntryPointStats
+{
+    std::string name;
+    std::uint64_t calls = 0;
+    double total_ms = 0;
+    double p99_ms = 0;              // 由对数分桶直方图估计，误差约10%
+    double max_ms = 0;
+    std::uint64_t rows_returned = 0;
+    std::uint64_t rows_changed = 0; // 调用期间连接上的sqlite3_total_changes增量
+};
+
+// 按SQL文本聚合的语句统计，计数器来自sqlite3_stmt_status
+struct StatementStats
+{
+    std::string sql;
+    std::uint64_t executions = 0;
+    double total_ms = 0;
+    double max_ms = 0;
+    std::uint64_t fullscan_steps = 0;
+    std::uint64_t sorts = 0;
+    std::uint64_t autoindexes = 0;
+    std::uint64_t vm_steps = 0;
+};
+
+struct QueryStatsSnapshot
+{
+    std::int64_t taken_at = 0;       // Unix时间戳
+    std::uint64_t slow_queries = 0;  // 超过阈值的语句执行次数
+    std::vector<EntryPointStats> entry_points;  // 按总耗时降序
+    std::vector<StatementStats> statements;     // 按总耗时降序
+};
+
+// 取得当前统计快照
+QueryStatsSnapshot get_query_stats();
+// 清空全部统计
+void reset_query_stats();
+// 设置慢查询阈值（毫秒），超过阈值的语句连同绑定参数写入日志，0表示关闭，默认100
+void set_slow_query_threshold_ms(int threshold_ms);
+// 每隔interval_seconds把快照以JSON格式写入path（先写临时文件再替换），重复调用会替换之前的设置
+bool start_query_stats_dump(const std::string& path, int interval_seconds);
+void stop_query_stats_dump();
+// 把快照序列化为JSON
+std::string query_stats_to_json(const QueryStatsSnapshot& snapshot);
+
+#endif // QUERYSTATS_H
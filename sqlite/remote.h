@@ -0,0 +1,46 @@
+#ifndef REMOTE_H
+#define REMOTE_H
+#include <string>
+#include <vector>
+#include "saleStruct.h"
+
+// 收银服务客户端：与database.h同名同参的函数，经由connect_sales_daemon连接的服务执行，失败时的返回值也相同。
+// 连接服务后database.h中的函数自动转发到这里，一般不需要直接调用
+namespace remote
+{
+    int getIdFromName(const std::string& name);
+    bool add_product(const std::string& name, double price, int stock, int alert_threshold = 10);
+    Product query_product(int id);
+    Product query_product(const std::string& name);
+    bool update_stock(int id, int new_stock);
+    int update_stock(const std::string& name, int new_stock);
+    std::vector<Product> get_all_products();
+    bool save_transaction(const Transaction& transaction, std::vector<StockConflict>* conflicts = nullptr);
+    std::vector<Transaction> get_all_transactions();
+    std::vector<CartItem> get_cart_items_by_transaction_id(int transaction_id);
+    TransactionDetail get_transaction_detail(int transaction_id);
+    std::vector<Product> get_low_stock_products();
+    bool delete_product(int id);
+    bool delete_product(const std::string& name);
+    bool update_product(int id, const std::string& name, double price, int stock, int alert_threshold, std::string* errorMsg = nullptr);
+    bool update_product(const std::string& old_name, const std::string& new_name, double price, int stock, int alert_threshold, std::string* errorMsg = nullptr);
+    bool set_product_alert_threshold(int id, int threshold);
+    bool set_product_alert_threshold(const std::string& name, int threshold);
+    int get_product_alert_threshold(int id);
+    int get_product_alert_threshold(const std::string& name);
+
+    bool set_product_barcode(int id, const std::string& barcode, std::string* errorMsg = nullptr);
+    bool add_product(const std::string& name, double price, int stock, int alert_threshold, const std::string& barcode,
+                     std::string* errorMsg = nullptr);
+    Product query_product_by_barcode(const std::string& barcode);
+
+    bool restock_products(const std::vector<RestockLine>& lines, std::vector<Product>* updated = nullptr, std::string* errorMsg = nullptr);
+
+    bool add_return(int transaction_id, int product_id, int quantity, const std::string& reason = "");
+    bool add_return_slip(int transaction_id, const std::vector<ReturnLine>& lines, std::string* errorMsg = nullptr);
+    std::vector<ReturnItem> get_all_returns();
+    std::vector<ReturnItem> get_returns_by_transaction_id(int transaction_id);
+    std::vector<ReturnItem> get_returns_by_product_id(int product_id);
+}
+
+#endif // REMOTE_H
@@ -0,0 +1,1289 @@
+#include "replication.h"
+#include "database.h"
+#include "db_internal.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#ifdef SALES_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+    constexpr char kBatchMagic[8] = {'S', 'A', 'L', 'E', 'S', 'R', 'B', '1'};
+    constexpr long long kMaxBatchBytes = 4LL << 20;   // 每批合并的发件箱变更集上限
+    // 总部接受的解压后批次大小上限：一批在达到kMaxBatchBytes后至多再合并一条发件箱记录，
+    // 超过该值的批次视为损坏，不按文件中声明的大小分配内存
+    constexpr long long kMaxRawBatchBytes = kMaxBatchBytes * 16;
+    constexpr unsigned char kCompressionNone = 0;
+    constexpr unsigned char kCompressionZlib = 1;
+
+    // 复制的表及其在总部库中的列，门店表中多出的列不复制
+    struct ReplicatedTable
+    {
+        const char* name;
+        const char* hq_table;
+        const char* key;                    // 门店表的主键列
+        std::vector<std::string> columns;
+    };
+
+    const std::vector<ReplicatedTable>& replicated_tables()
+    {
+        static const std::vector<ReplicatedTable> tables = {
+            {"products", "hq_products", "id", {"id", "name", "price", "stock", "alert_threshold"}},
+            {"transactions", "hq_transactions", "transaction_id",
+             {"transaction_id", "create_time", "is_paid", "total_price", "amount_paid", "change"}},
+            {"cart_items", "hq_cart_items", "item_id",
+             {"item_id", "transaction_id", "product_id", "quantity", "returned_quantity", "subtotal"}},
+            {"returns", "hq_returns", "return_id", {"return_id", "transaction_id", "product_id", "quantity", "reason", "return_time"}},
+        };
+        return tables;
+    }
+
+    const ReplicatedTable* find_table(const char* name)
+    {
+        for (const auto& table : replicated_tables())
+        {
+            if (std::strcmp(table.name, name) == 0)
+                return &table;
+        }
+        return nullptr;
+    }
+
+    // 总部库表结构，各门店的行以门店编号加原主键区分
+    const char* const sql_hq_schema =
+        "CREATE TABLE IF NOT EXISTS hq_stores ("
+        "store_id TEXT PRIMARY KEY,"
+        "applied_batch_id INTEGER NOT NULL DEFAULT 0,"
+        "applied_at INTEGER NOT NULL DEFAULT 0,"
+        "last_delay_seconds INTEGER NOT NULL DEFAULT 0,"
+        "batches INTEGER NOT NULL DEFAULT 0,"
+        "changes INTEGER NOT NULL DEFAULT 0,"
+        "wire_bytes INTEGER NOT NULL DEFAULT 0,"
+        "apply_us INTEGER NOT NULL DEFAULT 0"
+        ");"
+        "CREATE TABLE IF NOT EXISTS hq_products ("
+        "store_id TEXT NOT NULL, id INTEGER NOT NULL, name TEXT, price REAL, stock INTEGER, alert_threshold INTEGER,"
+        "PRIMARY KEY (store_id, id)) WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS hq_transactions ("
+        "store_id TEXT NOT NULL, transaction_id INTEGER NOT NULL, create_time INTEGER, is_paid INTEGER,"
+        "total_price REAL, amount_paid REAL, change REAL,"
+        "PRIMARY KEY (store_id, transaction_id)) WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS hq_cart_items ("
+        "store_id TEXT NOT NULL, item_id INTEGER NOT NULL, transaction_id INTEGER, product_id INTEGER,"
+        "quantity INTEGER, returned_quantity INTEGER, subtotal REAL,"
+        "PRIMARY KEY (store_id, item_id)) WITHOUT ROWID;"
+        "CREATE TABLE IF NOT EXISTS hq_returns ("
+        "store_id TEXT NOT NULL, return_id INTEGER NOT NULL, transaction_id INTEGER, product_id INTEGER,"
+        "quantity INTEGER, reason TEXT, return_time INTEGER,"
+        "PRIMARY KEY (store_id, return_id)) WITHOUT ROWID;"
+        "CREATE INDEX IF NOT EXISTS idx_hq_transactions_time ON hq_transactions(create_time);"
+        "CREATE INDEX IF NOT EXISTS idx_hq_cart_items_transaction ON hq_cart_items(store_id, transaction_id);";
+
+    // 一个批次：发件箱(prev, last]区间的记录合并后的变更集
+    struct Batch
+    {
+        std::string store_id;
+        long long prev = 0;             // 构建时总部已应用的位置
+        long long first = 0;
+        long long last = 0;
+        long long oldest = 0;           // 最早一条记录的提交时间
+        long long newest = 0;
+        long long changes = 0;
+        long long raw_bytes = 0;        // 解压后的变更集字节数
+        unsigned char compression = kCompressionNone;
+        std::string columns;            // 门店各表列名：表=列,列;表=列,...
+        std::vector<unsigned char> payload;
+    };
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+
+    // ---------- 批次编码，整数按本机字节序（与销售日志一致，只在小端平台间传送） ----------
+
+    template <typename T>
+    void put(std::vector<unsigned char>& out, const T value)
+    {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(&value);
+        out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    void put_bytes(std::vector<unsigned char>& out, const void* data, const std::uint64_t size)
+    {
+        put(out, size);
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    std::vector<unsigned char> encode_batch(const Batch& batch)
+    {
+        std::vector<unsigned char> out(kBatchMagic, kBatchMagic + sizeof(kBatchMagic));
+        put_bytes(out, batch.store_id.data(), batch.store_id.size());
+        for (const long long value : {batch.prev, batch.first, batch.last, batch.oldest, batch.newest,
+                                      batch.changes, batch.raw_bytes})
+            put(out, value);
+        put(out, batch.compression);
+        put_bytes(out, batch.columns.data(), batch.columns.size());
+        put_bytes(out, batch.payload.data(), batch.payload.size());
+        return out;
+    }
+
+    class Reader
+    {
+    public:
+        Reader(const unsigned char* data, const size_t size) : m_data(data), m_size(size) {}
+
+        template <typename T>
+        bool get(T& value)
+        {
+            if (m_size - m_pos < sizeof(T))
+                return false;
+            std::memcpy(&value, m_data + m_pos, sizeof(T));
+            m_pos += sizeof(T);
+            return true;
+        }
+
+        template <typename Container>
+        bool get_bytes(Container& out)
+        {
+            std::uint64_t size = 0;
+            if (!get(size) || m_size - m_pos < size)
+                return false;
+            out.assign(m_data + m_pos, m_data + m_pos + size);
+            m_pos += static_cast<size_t>(size);
+            return true;
+        }
+
+        bool done() const { return m_pos == m_size; }
+
+    private:
+        const unsigned char* m_data;
+        size_t m_size;
+        size_t m_pos = 0;
+    };
+
+    bool decode_batch(const std::vector<unsigned char>& data, Batch& batch)
+    {
+        if (data.size() < sizeof(kBatchMagic) || std::memcmp(data.data(), kBatchMagic, sizeof(kBatchMagic)) != 0)
+            return false;
+        Reader reader(data.data() + sizeof(kBatchMagic), data.size() - sizeof(kBatchMagic));
+        bool ok = reader.get_bytes(batch.store_id);
+        for (long long* value : {&batch.prev, &batch.first, &batch.last, &batch.oldest, &batch.newest,
+                                 &batch.changes, &batch.raw_bytes})
+            ok = ok && reader.get(*value);
+        return ok && reader.get(batch.compression) && reader.get_bytes(batch.columns) &&
+            reader.get_bytes(batch.payload) && reader.done();
+    }
+
+    void compress_payload(Batch& batch, std::vector<unsigned char> raw)
+    {
+        batch.raw_bytes = static_cast<long long>(raw.size());
+#ifdef SALES_HAVE_ZLIB
+        uLongf size = compressBound(static_cast<uLong>(raw.size()));
+        std::vector<unsigned char> packed(size);
+        if (compress2(packed.data(), &size, raw.data(), static_cast<uLong>(raw.size()), Z_DEFAULT_COMPRESSION) == Z_OK &&
+            size < raw.size())
+        {
+            packed.resize(size);
+            batch.compression = kCompressionZlib;
+            batch.payload = std::move(packed);
+            return;
+        }
+#endif
+        batch.compression = kCompressionNone;
+        batch.payload = std::move(raw);
+    }
+
+    bool decompress_payload(const Batch& batch, std::vector<unsigned char>& raw, std::string& err)
+    {
+        if (batch.compression == kCompressionNone)
+        {
+            raw = batch.payload;
+            return true;
+        }
+#ifdef SALES_HAVE_ZLIB
+        if (batch.compression == kCompressionZlib)
+        {
+            if (batch.raw_bytes <= 0 || batch.raw_bytes > kMaxRawBatchBytes)
+            {
+                err = "批次解压后大小无效: " + std::to_string(batch.raw_bytes);
+                return false;
+            }
+            raw.resize(static_cast<size_t>(batch.raw_bytes));
+            uLongf size = static_cast<uLongf>(raw.size());
+            if (uncompress(raw.data(), &size, batch.payload.data(), static_cast<uLong>(batch.payload.size())) == Z_OK &&
+                size == raw.size())
+                return true;
+            err = "批次解压失败";
+            return false;
+        }
+#endif
+        err = "不支持的批次压缩方式: " + std::to_string(batch.compression);
+        return false;
+    }
+
+    // ---------- 总部库 ----------
+
+    class HqConnection
+    {
+    public:
+        ~HqConnection() { sqlite3_close(m_db); }
+
+        bool open(const std::string& path, std::string& err)
+        {
+            if (sqlite3_open_v2(path.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+            {
+                err = "打开总部库失败: " + std::string(sqlite3_errmsg(m_db));
+                return false;
+            }
+            sqlite3_busy_timeout(m_db, 5000);
+            sqlite3_exec(m_db, "PRAGMA journal_mode = WAL;", nullptr, nullptr, nullptr);
+            return exec(sql_hq_schema, err);
+        }
+
+        bool exec(const char* sql, std::string& err) const
+        {
+            char* message = nullptr;
+            if (sqlite3_exec(m_db, sql, nullptr, nullptr, &message) == SQLITE_OK)
+                return true;
+            err = "总部库执行失败: " + std::string(message ? message : sqlite3_errmsg(m_db));
+            sqlite3_free(message);
+            return false;
+        }
+
+        long long applied(const std::string& store_id) const
+        {
+            long long value = 0;
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db, "SELECT applied_batch_id FROM hq_stores WHERE store_id = ?;", -1, &stmt,
+                                   nullptr) == SQLITE_OK)
+            {
+                sqlite3_bind_text(stmt, 1, store_id.c_str(), -1, SQLITE_STATIC);
+                if (sqlite3_step(stmt) == SQLITE_ROW)
+                    value = sqlite3_column_int64(stmt, 0);
+            }
+            sqlite3_finalize(stmt);
+            return value;
+        }
+
+        sqlite3* get() const { return m_db; }
+
+    private:
+        sqlite3* m_db = nullptr;
+    };
+
+    // 按表、操作和列组合缓存的总部写入语句
+    class HqStatements
+    {
+    public:
+        explicit HqStatements(sqlite3* conn) : m_db(conn) {}
+        ~HqStatements()
+        {
+            for (const auto& [sql, stmt] : m_cache)
+                sqlite3_finalize(stmt);
+        }
+
+        sqlite3_stmt* get(const std::string& sql)
+        {
+            sqlite3_stmt*& stmt = m_cache[sql];
+            if (!stmt && sqlite3_prepare_v3(m_db, sql.c_str(), -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+            {
+                sqlite3_finalize(stmt);
+                stmt = nullptr;
+            }
+            if (stmt)
+                sqlite3_reset(stmt);
+            return stmt;
+        }
+
+    private:
+        sqlite3* m_db;
+        std::unordered_map<std::string, sqlite3_stmt*> m_cache;
+    };
+
+    std::map<std::string, std::vector<std::string>> parse_columns(const std::string& text)
+    {
+        std::map<std::string, std::vector<std::string>> columns;
+        size_t start = 0;
+        while (start < text.size())
+        {
+            size_t end = text.find(';', start);
+            if (end == std::string::npos)
+                end = text.size();
+            const std::string entry = text.substr(start, end - start);
+            const size_t equals = entry.find('=');
+            if (equals != std::string::npos)
+            {
+                auto& list = columns[entry.substr(0, equals)];
+                size_t pos = equals + 1;
+                while (pos <= entry.size())
+                {
+                    size_t comma = entry.find(',', pos);
+                    if (comma == std::string::npos)
+                        comma = entry.size();
+                    list.push_back(entry.substr(pos, comma - pos));
+                    pos = comma + 1;
+                }
+            }
+            start = end + 1;
+        }
+        return columns;
+    }
+
+#ifdef SQLITE_ENABLE_SESSION
+    // 逐条把变更写入总部表：插入按主键覆盖，更新只改变更了的列，删除按主键删除，重复应用结果不变
+    bool apply_changeset(sqlite3* hq, const Batch& batch, std::vector<unsigned char>& raw, long long& changes,
+                         std::string& err)
+    {
+        const auto columns = parse_columns(batch.columns);
+        HqStatements statements(hq);
+        sqlite3_changeset_iter* iter = nullptr;
+        if (sqlite3changeset_start(&iter, static_cast<int>(raw.size()), raw.data()) != SQLITE_OK)
+        {
+            err = "批次变更集格式错误";
+            return false;
+        }
+        changes = 0;
+        int rc;
+        while ((rc = sqlite3changeset_next(iter)) == SQLITE_ROW)
+        {
+            const char* name = nullptr;
+            int count = 0;
+            int op = 0;
+            sqlite3changeset_op(iter, &name, &count, &op, nullptr);
+            unsigned char* pk = nullptr;
+            sqlite3changeset_pk(iter, &pk, nullptr);
+            const ReplicatedTable* table = find_table(name);
+            const auto found = columns.find(name);
+            if (!table || found == columns.end() || static_cast<int>(found->second.size()) != count)
+            {
+                err = std::string("批次中表结构与门店声明不符: ") + name;
+                break;
+            }
+
+            // 列出本条变更要写的列，值取新值或旧值
+            std::string sql;
+            std::vector<sqlite3_value*> values;
+            std::string assignments;
+            std::string keys;
+            std::vector<sqlite3_value*> key_values;
+            // 主键条件只用本地登记的主键列名拼接，批次中的列名不进入条件
+            bool key_ok = true;
+            for (int i = 0; i < count; ++i)
+            {
+                const std::string& column = found->second[i];
+                const bool known = std::find(table->columns.begin(), table->columns.end(), column) != table->columns.end();
+                sqlite3_value* value = nullptr;
+                if (pk[i])
+                {
+                    if (column != table->key || !key_values.empty())
+                    {
+                        key_ok = false;
+                        break;
+                    }
+                    (op == SQLITE_INSERT ? sqlite3changeset_new : sqlite3changeset_old)(iter, i, &value);
+                    keys = " AND " + std::string(table->key) + " = ?";
+                    key_values.push_back(value);
+                    if (op != SQLITE_INSERT)
+                        continue;
+                }
+                if (!known || op == SQLITE_DELETE)
+                    continue;
+                sqlite3changeset_new(iter, i, &value);
+                if (!value)
+                    continue;
+                assignments += (assignments.empty() ? "" : ", ") + column;
+                values.push_back(value);
+            }
+            if (!key_ok || key_values.size() != 1)
+            {
+                err = std::string("批次中表主键与总部不符: ") + name;
+                break;
+            }
+
+            if (op == SQLITE_INSERT)
+            {
+                std::string placeholders = "?";
+                for (size_t i = 0; i < values.size(); ++i)
+                    placeholders += ", ?";
+                sql = "INSERT OR REPLACE INTO " + std::string(table->hq_table) + " (store_id, " + assignments +
+                    ") VALUES (" + placeholders + ");";
+                key_values.clear();
+            }
+            else if (op == SQLITE_UPDATE)
+            {
+                if (values.empty())
+                    continue;
+                std::string set;
+                size_t pos = 0;
+                while (pos <= assignments.size())
+                {
+                    size_t comma = assignments.find(", ", pos);
+                    if (comma == std::string::npos)
+                        comma = assignments.size();
+                    set += (set.empty() ? "" : ", ") + assignments.substr(pos, comma - pos) + " = ?";
+                    pos = comma + 2;
+                }
+                sql = "UPDATE " + std::string(table->hq_table) + " SET " + set + " WHERE store_id = ?" + keys + ";";
+            }
+            else
+            {
+                values.clear();
+                sql = "DELETE FROM " + std::string(table->hq_table) + " WHERE store_id = ?" + keys + ";";
+            }
+
+            sqlite3_stmt* stmt = statements.get(sql);
+            if (!stmt)
+            {
+                err = "编译总部写入语句失败: " + std::string(sqlite3_errmsg(hq));
+                break;
+            }
+            int index = 1;
+            // 插入：门店编号在前；更新：先绑定各列再绑定门店编号与主键；删除：门店编号与主键
+            if (op != SQLITE_UPDATE)
+                sqlite3_bind_text(stmt, index++, batch.store_id.c_str(), -1, SQLITE_STATIC);
+            for (sqlite3_value* value : values)
+                sqlite3_bind_value(stmt, index++, value);
+            if (op == SQLITE_UPDATE)
+                sqlite3_bind_text(stmt, index++, batch.store_id.c_str(), -1, SQLITE_STATIC);
+            for (sqlite3_value* value : key_values)
+                sqlite3_bind_value(stmt, index++, value);
+            if (sqlite3_step(stmt) != SQLITE_DONE)
+            {
+                err = "写入总部表失败: " + std::string(sqlite3_errmsg(hq));
+                break;
+            }
+            ++changes;
+        }
+        const int finalize_rc = sqlite3changeset_finalize(iter);
+        if (err.empty() && (rc != SQLITE_DONE || finalize_rc != SQLITE_OK))
+            err = "读取批次变更集失败";
+        return err.empty();
+    }
+#endif
+
+    // 在总部库的一个事务中应用批次；已应用过的批次跳过，缺少前面的批次时拒绝
+    bool apply_batch(HqConnection& hq, const Batch& batch, const size_t wire_bytes, bool& skipped, std::string& err)
+    {
+        skipped = false;
+#ifndef SQLITE_ENABLE_SESSION
+        (void)hq;
+        (void)batch;
+        (void)wire_bytes;
+        err = "当前SQLite未启用会话扩展，无法应用复制批次";
+        return false;
+#else
+        const auto start = std::chrono::steady_clock::now();
+        if (!hq.exec("BEGIN IMMEDIATE;", err))
+            return false;
+        const long long applied = hq.applied(batch.store_id);
+        if (batch.last <= applied)
+        {
+            skipped = true;
+            return hq.exec("COMMIT;", err);
+        }
+        if (batch.prev > applied)
+        {
+            err = "门店 " + batch.store_id + " 缺少发件箱记录 " + std::to_string(applied + 1) + " 到 " +
+                std::to_string(batch.prev) + " 的批次";
+            std::string ignored;
+            hq.exec("ROLLBACK;", ignored);
+            return false;
+        }
+
+        std::vector<unsigned char> raw;
+        long long changes = 0;
+        bool ok = decompress_payload(batch, raw, err) && apply_changeset(hq.get(), batch, raw, changes, err);
+        if (ok)
+        {
+            const long long apply_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+            sqlite3_stmt* stmt = nullptr;
+            ok = sqlite3_prepare_v2(hq.get(),
+                "INSERT INTO hq_stores (store_id, applied_batch_id, applied_at, last_delay_seconds, batches, changes, "
+                "wire_bytes, apply_us) VALUES (?1, ?2, ?3, MAX(0, ?3 - ?4), 1, ?5, ?6, ?7) "
+                "ON CONFLICT(store_id) DO UPDATE SET applied_batch_id = excluded.applied_batch_id, "
+                "applied_at = excluded.applied_at, last_delay_seconds = excluded.last_delay_seconds, "
+                "batches = batches + 1, changes = changes + excluded.changes, "
+                "wire_bytes = wire_bytes + excluded.wire_bytes, apply_us = apply_us + excluded.apply_us;",
+                -1, &stmt, nullptr) == SQLITE_OK;
+            if (ok)
+            {
+                sqlite3_bind_text(stmt, 1, batch.store_id.c_str(), -1, SQLITE_STATIC);
+                sqlite3_bind_int64(stmt, 2, batch.last);
+                sqlite3_bind_int64(stmt, 3, static_cast<long long>(time(nullptr)));
+                sqlite3_bind_int64(stmt, 4, batch.oldest);
+                sqlite3_bind_int64(stmt, 5, changes);
+                sqlite3_bind_int64(stmt, 6, static_cast<long long>(wire_bytes));
+                sqlite3_bind_int64(stmt, 7, apply_us);
+                ok = sqlite3_step(stmt) == SQLITE_DONE;
+            }
+            sqlite3_finalize(stmt);
+            if (!ok)
+                err = "更新总部复制位置失败: " + std::string(sqlite3_errmsg(hq.get()));
+        }
+        if (ok && hq.exec("COMMIT;", err))
+            return true;
+        std::string ignored;
+        hq.exec("ROLLBACK;", ignored);
+        return false;
+#endif
+    }
+
+    // ---------- 门店端 ----------
+
+    bool replication_enabled()
+    {
+        const CachedStatement stmt("SELECT enabled FROM replication_state WHERE id = 1;");
+        return stmt && sqlite3_step(stmt.get()) == SQLITE_ROW && sqlite3_column_int(stmt.get(), 0) != 0;
+    }
+
+    std::string store_id()
+    {
+        const CachedStatement stmt("SELECT store_id FROM replication_state WHERE id = 1;");
+        if (!stmt || sqlite3_step(stmt.get()) != SQLITE_ROW)
+            return "";
+        const auto* text = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+        return text ? text : "";
+    }
+
+    long long shipped_batch_id()
+    {
+        const CachedStatement stmt("SELECT shipped_batch_id FROM replication_state WHERE id = 1;");
+        return stmt && sqlite3_step(stmt.get()) == SQLITE_ROW ? sqlite3_column_int64(stmt.get(), 0) : 0;
+    }
+
+    WriteStatus insert_outbox(const void* data, const int size)
+    {
+        const CachedStatement stmt("INSERT INTO replication_outbox (created_at, data) VALUES (?, ?);");
+        if (!stmt)
+            return write_status_of(sqlite3_errcode(db));
+        sqlite3_bind_int64(stmt.get(), 1, static_cast<long long>(time(nullptr)));
+        sqlite3_bind_blob(stmt.get(), 2, data, size, SQLITE_STATIC);
+        const int rc = sqlite3_step(stmt.get());
+        if (rc != SQLITE_DONE)
+        {
+            SLOG_ERROR("写入复制发件箱失败: %s", sqlite3_errmsg(db));
+            return write_status_of(rc);
+        }
+        return WriteStatus::Ok;
+    }
+
+    // 门店各表的列名，随批次发送，总部按列名写入
+    std::string describe_columns()
+    {
+        std::string text;
+        const CachedStatement stmt("SELECT name FROM pragma_table_info(?) ORDER BY cid;");
+        if (!stmt)
+            return text;
+        for (const auto& table : replicated_tables())
+        {
+            sqlite3_reset(stmt.get());
+            sqlite3_bind_text(stmt.get(), 1, table.name, -1, SQLITE_STATIC);
+            text += (text.empty() ? "" : ";") + std::string(table.name) + "=";
+            bool first = true;
+            while (sqlite3_step(stmt.get()) == SQLITE_ROW)
+            {
+                if (!first)
+                    text += ',';
+                text += reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+                first = false;
+            }
+        }
+        return text;
+    }
+
+    // 把after之后的发件箱记录合并为一个批次，rows为0时表示没有待发送的记录
+    bool build_batch(const long long after, Batch& batch, long long& rows, std::string& err)
+    {
+        rows = 0;
+#ifndef SQLITE_ENABLE_SESSION
+        (void)after;
+        (void)batch;
+        err = "当前SQLite未启用会话扩展";
+        return false;
+#else
+        batch = Batch{};
+        batch.store_id = store_id();
+        batch.prev = after;
+        sqlite3_changegroup* group = nullptr;
+        if (sqlite3changegroup_new(&group) != SQLITE_OK)
+        {
+            err = "创建变更集合并器失败";
+            return false;
+        }
+        long long bytes = 0;
+        {
+            const CachedStatement stmt(
+                "SELECT batch_id, created_at, data FROM replication_outbox WHERE batch_id > ? ORDER BY batch_id;");
+            if (!stmt)
+            {
+                sqlite3changegroup_delete(group);
+                err = "读取复制发件箱失败: " + std::string(sqlite3_errmsg(db));
+                return false;
+            }
+            sqlite3_bind_int64(stmt.get(), 1, after);
+            while (bytes < kMaxBatchBytes && sqlite3_step(stmt.get()) == SQLITE_ROW)
+            {
+                const int size = sqlite3_column_bytes(stmt.get(), 2);
+                if (sqlite3changegroup_add(group, size, const_cast<void*>(sqlite3_column_blob(stmt.get(), 2))) != SQLITE_OK)
+                {
+                    sqlite3changegroup_delete(group);
+                    err = "合并发件箱记录 " + std::to_string(sqlite3_column_int64(stmt.get(), 0)) + " 失败";
+                    return false;
+                }
+                batch.last = sqlite3_column_int64(stmt.get(), 0);
+                const long long created = sqlite3_column_int64(stmt.get(), 1);
+                if (rows++ == 0)
+                {
+                    batch.first = batch.last;
+                    batch.oldest = created;
+                }
+                batch.newest = created;
+                bytes += size;
+            }
+        }
+        if (rows == 0)
+        {
+            sqlite3changegroup_delete(group);
+            return true;
+        }
+
+        int size = 0;
+        void* data = nullptr;
+        const int rc = sqlite3changegroup_output(group, &size, &data);
+        sqlite3changegroup_delete(group);
+        if (rc != SQLITE_OK)
+        {
+            err = "输出合并变更集失败";
+            return false;
+        }
+        sqlite3_changeset_iter* iter = nullptr;
+        if (sqlite3changeset_start(&iter, size, data) == SQLITE_OK)
+        {
+            while (sqlite3changeset_next(iter) == SQLITE_ROW)
+                ++batch.changes;
+            sqlite3changeset_finalize(iter);
+        }
+        const auto* bytes_begin = static_cast<const unsigned char*>(data);
+        compress_payload(batch, std::vector<unsigned char>(bytes_begin, bytes_begin + size));
+        sqlite3_free(data);
+        batch.columns = describe_columns();
+        return true;
+#endif
+    }
+
+    // 总部确认后推进发送位置并删除已确认的发件箱记录
+    bool confirm_shipped(const long long shipped, const long long confirmed)
+    {
+        return run_write_transaction("确认复制发件箱", [&]() -> WriteStatus
+        {
+            const CachedStatement update(
+                "UPDATE replication_state SET shipped_batch_id = MAX(shipped_batch_id, ?) WHERE id = 1;");
+            const CachedStatement prune("DELETE FROM replication_outbox WHERE batch_id <= ?;");
+            if (!update || !prune)
+                return write_status_of(sqlite3_errcode(db));
+            sqlite3_bind_int64(update.get(), 1, shipped);
+            int rc = sqlite3_step(update.get());
+            if (rc == SQLITE_DONE)
+            {
+                sqlite3_bind_int64(prune.get(), 1, confirmed);
+                rc = sqlite3_step(prune.get());
+            }
+            return rc == SQLITE_DONE ? WriteStatus::Ok : write_status_of(rc);
+        });
+    }
+
+    void add_result(ReplicationShipResult& total, const Batch& batch, const long long rows, const size_t wire_bytes)
+    {
+        ++total.batches;
+        total.outbox_rows += rows;
+        total.changes += batch.changes;
+        total.raw_bytes += batch.raw_bytes;
+        total.wire_bytes += static_cast<long long>(wire_bytes);
+    }
+
+    // ---------- 会话 ----------
+
+#ifdef SQLITE_ENABLE_SESSION
+    // 当前线程连接上的会话；staged是已写入发件箱、等待事务提交结果的会话
+    struct Capture
+    {
+        sqlite3* conn = nullptr;
+        sqlite3_session* active = nullptr;
+        sqlite3_session* staged = nullptr;
+    };
+
+    thread_local Capture t_capture;
+
+    int filter_table(void*, const char* table)
+    {
+        return find_table(table) != nullptr;
+    }
+
+    sqlite3_session* create_session()
+    {
+        sqlite3_session* session = nullptr;
+        if (sqlite3session_create(db, "main", &session) != SQLITE_OK)
+        {
+            SLOG_ERROR("创建复制会话失败: %s", sqlite3_errmsg(db));
+            return nullptr;
+        }
+        sqlite3session_table_filter(session, filter_table, nullptr);
+        if (sqlite3session_attach(session, nullptr) != SQLITE_OK)
+        {
+            SLOG_ERROR("创建复制会话失败: %s", sqlite3_errmsg(db));
+            sqlite3session_delete(session);
+            return nullptr;
+        }
+        return session;
+    }
+
+    void delete_session(sqlite3_session*& session)
+    {
+        if (session)
+            sqlite3session_delete(session);
+        session = nullptr;
+    }
+
+    // 开启复制时的基线：与结构相同的空库对比，得到插入当前全部行的变更集
+    WriteStatus write_baseline(std::string& err)
+    {
+        sqlite3_session* session = nullptr;
+        if (sqlite3session_create(db, "main", &session) != SQLITE_OK)
+        {
+            err = "创建复制会话失败: " + std::string(sqlite3_errmsg(db));
+            return WriteStatus::Failed;
+        }
+        WriteStatus status = WriteStatus::Ok;
+        for (const auto& table : replicated_tables())
+        {
+            char* message = nullptr;
+            if (sqlite3session_attach(session, table.name) != SQLITE_OK ||
+                sqlite3session_diff(session, "replication_base", table.name, &message) != SQLITE_OK)
+            {
+                err = "生成复制基线失败: " + std::string(message ? message : sqlite3_errmsg(db));
+                sqlite3_free(message);
+                status = WriteStatus::Failed;
+                break;
+            }
+        }
+        int size = 0;
+        void* data = nullptr;
+        if (status == WriteStatus::Ok && sqlite3session_changeset(session, &size, &data) != SQLITE_OK)
+        {
+            err = "生成复制基线失败: " + std::string(sqlite3_errmsg(db));
+            status = WriteStatus::Failed;
+        }
+        if (status == WriteStatus::Ok && size > 0)
+            status = insert_outbox(data, size);
+        sqlite3_free(data);
+        sqlite3session_delete(session);
+        return status;
+    }
+
+    // 附加与主库结构相同的空内存库，作为基线对比的起点；ATTACH不能在事务中执行
+    bool attach_baseline(std::string& err)
+    {
+        std::string sql = "ATTACH DATABASE ':memory:' AS replication_base;";
+        {
+            const CachedStatement stmt("SELECT sql FROM main.sqlite_schema WHERE type = 'table' AND name = ?;");
+            if (!stmt)
+            {
+                err = sqlite3_errmsg(db);
+                return false;
+            }
+            for (const auto& table : replicated_tables())
+            {
+                sqlite3_reset(stmt.get());
+                sqlite3_bind_text(stmt.get(), 1, table.name, -1, SQLITE_STATIC);
+                if (sqlite3_step(stmt.get()) != SQLITE_ROW)
+                {
+                    err = std::string("缺少表 ") + table.name;
+                    return false;
+                }
+                const std::string create = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 0));
+                const std::string prefix = "CREATE TABLE ";
+                if (create.rfind(prefix, 0) != 0)
+                {
+                    err = std::string("无法识别表结构: ") + table.name;
+                    return false;
+                }
+                sql += prefix + "replication_base." + create.substr(prefix.size()) + ";";
+            }
+        }
+        char* message = nullptr;
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &message) != SQLITE_OK)
+        {
+            err = "创建复制基线对比库失败: " + std::string(message ? message : "");
+            sqlite3_free(message);
+            sqlite3_exec(db, "DETACH DATABASE replication_base;", nullptr, nullptr, nullptr);
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    // 后台发送线程，连接只在本线程使用
+    class Shipper
+    {
+    public:
+        ~Shipper() { stop(); }
+
+        void start(const std::string& path, const std::string& hq_path, const int interval_ms)
+        {
+            stop();
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = false;
+            m_worker = std::thread(&Shipper::run, this, path, hq_path, interval_ms);
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_cv.notify_all();
+            if (m_worker.joinable())
+                m_worker.join();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop = false;
+        std::thread m_worker;
+
+        void run(const std::string& path, const std::string& hq_path, const int interval_ms)
+        {
+            if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK)
+            {
+                SLOG_ERROR("复制发送线程连接打开失败: %s", sqlite3_errmsg(db));
+                sqlite3_close(db);
+                db = nullptr;
+                return;
+            }
+            sqlite3_busy_timeout(db, 2000);
+            install_query_tracing(db);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this] { return m_stop; }))
+            {
+                lock.unlock();
+                // 先用读查询判断有没有待发送记录，空闲时不打开总部库
+                const CachedStatement pending(
+                    "SELECT EXISTS (SELECT 1 FROM replication_outbox WHERE batch_id > "
+                    "(SELECT shipped_batch_id FROM replication_state WHERE id = 1));");
+                const bool has_pending = pending && sqlite3_step(pending.get()) == SQLITE_ROW &&
+                    sqlite3_column_int(pending.get(), 0) != 0;
+                sqlite3_reset(pending.get());
+                if (has_pending)
+                    ship_replication(hq_path);
+                lock.lock();
+            }
+            lock.unlock();
+            close_db();
+        }
+    };
+
+    Shipper& shipper()
+    {
+        static Shipper instance;
+        return instance;
+    }
+}
+
+void ensure_replication_capture()
+{
+#ifdef SQLITE_ENABLE_SESSION
+    if (!db)
+        return;
+    if (t_capture.conn != db)
+    {
+        release_replication_capture();
+        t_capture.conn = db;
+    }
+    if (!replication_enabled())
+    {
+        delete_session(t_capture.active);
+        return;
+    }
+    if (!t_capture.active)
+        t_capture.active = create_session();
+#endif
+}
+
+WriteStatus stage_replication_changes()
+{
+#ifdef SQLITE_ENABLE_SESSION
+    if (!t_capture.active || t_capture.conn != db || sqlite3session_isempty(t_capture.active))
+        return WriteStatus::Ok;
+    int size = 0;
+    void* data = nullptr;
+    if (sqlite3session_changeset(t_capture.active, &size, &data) != SQLITE_OK)
+    {
+        SLOG_ERROR("生成复制变更集失败: %s", sqlite3_errmsg(db));
+        return WriteStatus::Failed;
+    }
+    WriteStatus status = WriteStatus::Ok;
+    // 会话中的修改都已撤销时变更集为空
+    if (size > 0)
+    {
+        status = insert_outbox(data, size);
+        if (status == WriteStatus::Ok)
+        {
+            sqlite3_session* next = create_session();
+            if (next)
+            {
+                t_capture.staged = t_capture.active;
+                t_capture.active = next;
+            }
+            else
+                status = WriteStatus::Failed;
+        }
+    }
+    sqlite3_free(data);
+    return status;
+#else
+    return WriteStatus::Ok;
+#endif
+}
+
+void finish_replication_capture(const bool committed)
+{
+#ifdef SQLITE_ENABLE_SESSION
+    if (!t_capture.staged)
+        return;
+    // 未提交时发件箱记录随事务回滚，恢复原会话，之前的变更下次再写入
+    if (committed)
+        delete_session(t_capture.staged);
+    else
+    {
+        delete_session(t_capture.active);
+        t_capture.active = t_capture.staged;
+        t_capture.staged = nullptr;
+    }
+#else
+    (void)committed;
+#endif
+}
+
+void release_replication_capture()
+{
+#ifdef SQLITE_ENABLE_SESSION
+    delete_session(t_capture.active);
+    delete_session(t_capture.staged);
+    t_capture.conn = nullptr;
+#endif
+}
+
+ReplicationMute::ReplicationMute() : m_active(false)
+{
+#ifdef SQLITE_ENABLE_SESSION
+    m_active = t_capture.active && t_capture.conn == db;
+    if (m_active)
+        sqlite3session_enable(t_capture.active, 0);
+#endif
+}
+
+ReplicationMute::~ReplicationMute()
+{
+#ifdef SQLITE_ENABLE_SESSION
+    if (m_active && t_capture.active)
+        sqlite3session_enable(t_capture.active, 1);
+#endif
+}
+
+bool enable_replication(const std::string& store_id, std::string* errorMsg)
+{
+    QueryCall call("enable_replication");
+#ifndef SQLITE_ENABLE_SESSION
+    (void)store_id;
+    fail(errorMsg, "开启门店复制失败: 当前SQLite未启用会话扩展");
+    return false;
+#else
+    std::string err;
+    if (!attach_baseline(err))
+    {
+        fail(errorMsg, "开启门店复制失败: " + err);
+        return false;
+    }
+    bool baseline = false;
+    const bool ok = run_write_transaction("开启门店复制", [&]() -> WriteStatus
+    {
+        err.clear();
+        baseline = false;
+        const bool enabled = replication_enabled();
+        const CachedStatement update(
+            "UPDATE replication_state SET enabled = 1, "
+            "store_id = CASE WHEN ?1 <> '' THEN ?1 WHEN store_id <> '' THEN store_id "
+            "ELSE (SELECT printf('%016X', token) FROM catalog_state WHERE id = 1) END WHERE id = 1;");
+        if (!update)
+            return write_status_of(sqlite3_errcode(db));
+        sqlite3_bind_text(update.get(), 1, store_id.c_str(), -1, SQLITE_STATIC);
+        const int rc = sqlite3_step(update.get());
+        if (rc != SQLITE_DONE)
+            return write_status_of(rc);
+        if (enabled)
+            return WriteStatus::Ok;
+        baseline = true;
+        return write_baseline(err);
+    });
+    sqlite3_exec(db, "DETACH DATABASE replication_base;", nullptr, nullptr, nullptr);
+    if (!ok)
+    {
+        fail(errorMsg, "开启门店复制失败: " + (err.empty() ? std::string(sqlite3_errmsg(db)) : err));
+        return false;
+    }
+    ensure_replication_capture();
+    SLOG_INFO("门店复制已开启，门店编号 %s%s", ::store_id().c_str(), baseline ? "，已写入基线" : "");
+    return true;
+#endif
+}
+
+bool disable_replication(std::string* errorMsg)
+{
+    QueryCall call("disable_replication");
+    const bool ok = run_write_transaction("关闭门店复制", []() -> WriteStatus
+    {
+        const CachedStatement update("UPDATE replication_state SET enabled = 0 WHERE id = 1;");
+        if (!update)
+            return write_status_of(sqlite3_errcode(db));
+        const int rc = sqlite3_step(update.get());
+        return rc == SQLITE_DONE ? WriteStatus::Ok : write_status_of(rc);
+    });
+    if (!ok)
+    {
+        fail(errorMsg, "关闭门店复制失败: " + std::string(sqlite3_errmsg(db)));
+        return false;
+    }
+    ensure_replication_capture();
+    SLOG_INFO("门店复制已关闭");
+    return true;
+}
+
+ReplicationStatus get_replication_status()
+{
+    QueryCall call("get_replication_status");
+    ReplicationStatus status;
+#ifdef SQLITE_ENABLE_SESSION
+    status.available = true;
+#endif
+    const CachedStatement stmt(
+        "SELECT s.enabled, s.store_id, s.shipped_batch_id, "
+        "IFNULL((SELECT seq FROM sqlite_sequence WHERE name = 'replication_outbox'), 0), "
+        "COUNT(o.batch_id), IFNULL(SUM(length(o.data)), 0), MIN(o.created_at) "
+        "FROM replication_state s LEFT JOIN replication_outbox o ON o.batch_id > s.shipped_batch_id "
+        "WHERE s.id = 1;");
+    if (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW)
+    {
+        status.enabled = sqlite3_column_int(stmt.get(), 0) != 0;
+        const auto* id = reinterpret_cast<const char*>(sqlite3_column_text(stmt.get(), 1));
+        status.store_id = id ? id : "";
+        status.shipped_batch_id = sqlite3_column_int64(stmt.get(), 2);
+        status.last_batch_id = sqlite3_column_int64(stmt.get(), 3);
+        status.pending_batches = sqlite3_column_int64(stmt.get(), 4);
+        status.pending_bytes = sqlite3_column_int64(stmt.get(), 5);
+        if (sqlite3_column_type(stmt.get(), 6) != SQLITE_NULL)
+            status.lag_seconds = std::max(0LL, static_cast<long long>(time(nullptr)) - sqlite3_column_int64(stmt.get(), 6));
+    }
+    call.rows(1);
+    return status;
+}
+
+bool ship_replication(const std::string& hq_path, ReplicationShipResult* result, std::string* errorMsg)
+{
+    QueryCall call("ship_replication");
+    const auto start = std::chrono::steady_clock::now();
+    ReplicationShipResult total;
+    std::string err;
+    HqConnection hq;
+    bool ok = hq.open(hq_path, err);
+    const std::string id = store_id();
+    long long applied = ok ? hq.applied(id) : 0;
+    while (ok)
+    {
+        Batch batch;
+        long long rows = 0;
+        if (!build_batch(applied, batch, rows, err))
+        {
+            ok = false;
+            break;
+        }
+        if (rows == 0)
+            break;
+        // 经过与批次文件相同的编码，总部只依赖批次内容
+        const std::vector<unsigned char> wire = encode_batch(batch);
+        Batch received;
+        bool skipped = false;
+        if (!decode_batch(wire, received) || !apply_batch(hq, received, wire.size(), skipped, err))
+        {
+            if (err.empty()) err = "批次编码错误";
+            ok = false;
+            break;
+        }
+        applied = batch.last;
+        add_result(total, batch, rows, wire.size());
+        if (!confirm_shipped(applied, applied))
+        {
+            err = "更新复制发送位置失败";
+            ok = false;
+        }
+    }
+    // 总部已应用但门店尚未删除的记录（上次确认前中断）也在这里清理
+    if (ok && applied > 0 && total.batches == 0)
+        confirm_shipped(applied, applied);
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (result) *result = total;
+    if (!ok)
+    {
+        fail(errorMsg, "发送复制批次失败: " + err);
+        return false;
+    }
+    if (total.batches > 0)
+    {
+        SLOG_INFO("复制批次已发送: %d 批, %lld 行变更, %lld 字节", total.batches, total.changes, total.wire_bytes);
+    }
+    return true;
+}
+
+bool export_replication_batch(const std::string& path, ReplicationShipResult* result, std::string* errorMsg)
+{
+    QueryCall call("export_replication_batch");
+    const auto start = std::chrono::steady_clock::now();
+    ReplicationShipResult total;
+    Batch batch;
+    long long rows = 0;
+    std::string err;
+    if (!build_batch(shipped_batch_id(), batch, rows, err))
+    {
+        fail(errorMsg, "导出复制批次失败: " + err);
+        return false;
+    }
+    if (rows > 0)
+    {
+        const std::vector<unsigned char> wire = encode_batch(batch);
+        FILE* file = fopen(path.c_str(), "wb");
+        const bool written = file && fwrite(wire.data(), 1, wire.size(), file) == wire.size();
+        if (file && fclose(file) != 0)
+        {
+            fail(errorMsg, "导出复制批次失败: 写入文件失败: " + path);
+            return false;
+        }
+        if (!written)
+        {
+            fail(errorMsg, "导出复制批次失败: 写入文件失败: " + path);
+            return false;
+        }
+        // 只推进发送位置，记录等总部确认（ship_replication）后再删除
+        if (!confirm_shipped(batch.last, 0))
+        {
+            fail(errorMsg, "导出复制批次失败: 更新发送位置失败");
+            return false;
+        }
+        add_result(total, batch, rows, wire.size());
+    }
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (result) *result = total;
+    return true;
+}
+
+bool apply_replication_batch_file(const std::string& hq_path, const std::string& path, std::string* errorMsg)
+{
+    QueryCall call("apply_replication_batch_file");
+    std::vector<unsigned char> wire;
+    if (FILE* file = fopen(path.c_str(), "rb"))
+    {
+        unsigned char buffer[65536];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            wire.insert(wire.end(), buffer, buffer + read);
+        fclose(file);
+    }
+    else
+    {
+        fail(errorMsg, "打开复制批次文件失败: " + path);
+        return false;
+    }
+    Batch batch;
+    if (!decode_batch(wire, batch))
+    {
+        fail(errorMsg, "复制批次文件格式错误: " + path);
+        return false;
+    }
+    std::string err;
+    HqConnection hq;
+    bool skipped = false;
+    if (!hq.open(hq_path, err) || !apply_batch(hq, batch, wire.size(), skipped, err))
+    {
+        fail(errorMsg, "应用复制批次失败: " + err);
+        return false;
+    }
+    SLOG_INFO("复制批次 %s（门店 %s，发件箱记录 %lld-%lld）%s", path.c_str(), batch.store_id.c_str(), batch.first,
+              batch.last, skipped ? "已应用过，跳过" : "已应用");
+    return true;
+}
+
+std::vector<HqStoreStatus> get_hq_replication_status(const std::string& hq_path, std::string* errorMsg)
+{
+    QueryCall call("get_hq_replication_status");
+    std::vector<HqStoreStatus> stores;
+    std::string err;
+    HqConnection hq;
+    if (!hq.open(hq_path, err))
+    {
+        fail(errorMsg, err);
+        return stores;
+    }
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(hq.get(),
+        "SELECT store_id, applied_batch_id, applied_at, last_delay_seconds, batches, changes, wire_bytes, apply_us "
+        "FROM hq_stores ORDER BY store_id;", -1, &stmt, nullptr) == SQLITE_OK)
+    {
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            HqStoreStatus store;
+            store.store_id = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            store.applied_batch_id = sqlite3_column_int64(stmt, 1);
+            store.applied_at = sqlite3_column_int64(stmt, 2);
+            store.last_delay_seconds = sqlite3_column_int64(stmt, 3);
+            store.batches = sqlite3_column_int64(stmt, 4);
+            store.changes = sqlite3_column_int64(stmt, 5);
+            store.wire_bytes = sqlite3_column_int64(stmt, 6);
+            const long long apply_us = sqlite3_column_int64(stmt, 7);
+            store.changes_per_second = apply_us > 0 ? static_cast<double>(store.changes) * 1e6 / apply_us : 0.0;
+            stores.push_back(store);
+        }
+    }
+    sqlite3_finalize(stmt);
+    call.rows(stores.size());
+    return stores;
+}
+
+void start_replication_shipper(const std::string& hq_path, const int interval_ms)
+{
+    const char* path = sqlite3_db_filename(db, "main");
+    if (!path || !*path)
+    {
+        SLOG_WARN("内存数据库不启动复制发送线程");
+        return;
+    }
+    shipper().start(path, hq_path, interval_ms);
+}
+
+void stop_replication_shipper()
+{
+    shipper().stop();
+}
@@ -0,0 +1,70 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+#include <string>
+#include <vector>
+
+// 门店向总部复制：开启后每个连接用SQLite会话扩展记录交易、购物车项、退货和商品（含库存）表的变更，
+// 每个写事务提交前把变更集写入发件箱replication_outbox，与业务修改一同提交；
+// 不在写事务中的单条修改（如直接改库存）随该连接的下一个写事务写入。
+// 发送时把一段发件箱记录合并为一个变更集并压缩成批次，在总部库按门店编号写入hq_*表；
+// 总部按门店记录已应用的最大发件箱ID，重复或过期的批次直接跳过，重叠部分按主键覆盖，应用结果与次数无关。
+// 开启时先把当前各表内容作为一批基线写入发件箱
+
+// 门店端复制状态
+struct ReplicationStatus
+{
+    bool available = false;             // SQLite启用了会话扩展
+    bool enabled = false;               // 是否开启复制
+    std::string store_id;               // 门店编号
+    long long last_batch_id = 0;        // 最新发件箱记录ID
+    long long shipped_batch_id = 0;     // 已发送的最大发件箱记录ID
+    long long pending_batches = 0;      // 尚未发送的发件箱记录数
+    long long pending_bytes = 0;        // 尚未发送的变更集字节数
+    long long lag_seconds = 0;          // 最早一条未发送记录距今秒数，没有时为0
+};
+
+// 一次发送或导出的统计
+struct ReplicationShipResult
+{
+    int batches = 0;                    // 批次数
+    long long outbox_rows = 0;          // 合并的发件箱记录数
+    long long changes = 0;              // 合并后的行变更数
+    long long raw_bytes = 0;            // 合并后的变更集字节数
+    long long wire_bytes = 0;           // 压缩编码后的批次字节数
+    double seconds = 0.0;               // 耗时
+};
+
+// 总部端每个门店的应用状态
+struct HqStoreStatus
+{
+    std::string store_id;
+    long long applied_batch_id = 0;     // 已应用的最大发件箱记录ID
+    long long applied_at = 0;           // 最近一次应用的时间
+    long long last_delay_seconds = 0;   // 最近一批中最早的变更从门店提交到总部应用的秒数
+    long long batches = 0;              // 累计应用的批次数
+    long long changes = 0;              // 累计应用的行变更数
+    long long wire_bytes = 0;           // 累计收到的批次字节数
+    double changes_per_second = 0.0;    // 应用吞吐（行变更数/应用耗时）
+};
+
+// 开启复制，store_id为空时由数据库标识生成；已开启时只更新门店编号
+bool enable_replication(const std::string& store_id = "", std::string* errorMsg = nullptr);
+// 关闭复制，未发送的发件箱记录保留
+bool disable_replication(std::string* errorMsg = nullptr);
+ReplicationStatus get_replication_status();
+// 按总部已应用的位置发送全部未应用的发件箱记录，每批合并最多约4MB变更集，并删除总部已确认的记录
+bool ship_replication(const std::string& hq_path, ReplicationShipResult* result = nullptr,
+                      std::string* errorMsg = nullptr);
+// 把上次导出之后的发件箱记录写成一个批次文件，供离线传送；记录在总部确认前不删除
+bool export_replication_batch(const std::string& path, ReplicationShipResult* result = nullptr,
+                              std::string* errorMsg = nullptr);
+// 在总部库应用批次文件
+bool apply_replication_batch_file(const std::string& hq_path, const std::string& path,
+                                  std::string* errorMsg = nullptr);
+std::vector<HqStoreStatus> get_hq_replication_status(const std::string& hq_path, std::string* errorMsg = nullptr);
+
+// 后台发送线程：用独立连接每interval_ms毫秒发送一次；在当前线程init_db成功后调用，重复调用会先停止之前的线程
+void start_replication_shipper(const std::string& hq_path, int interval_ms = 1000);
+void stop_replication_shipper();
+
+#endif // REPLICATION_H
@@ -0,0 +1,709 @@
+#include "saleslog.h"
+#include "db_internal.h"
+#include "log.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr char kMagic[8] = {'S', 'A', 'L', 'E', 'S', 'L', 'G', '1'};
+    constexpr std::uint32_t kVersion = 1;
+    constexpr std::uint32_t kBlockCapacity = 4096;
+    constexpr std::uint64_t kGrowBlocks = 16;  // 文件每次扩展的块数，约1.5MB
+
+    struct FileHeader
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t block_capacity;
+        std::uint64_t block_count;      // 已使用的块数，最后一块可能未满
+        std::uint64_t line_count;
+        std::int64_t last_item_id;      // 已写入日志的最大购物车项ID
+        std::int64_t last_return_id;    // 已写入日志的最大退货ID
+        std::uint64_t reserved[2];
+    };
+    static_assert(sizeof(FileHeader) == 64);
+
+    struct BlockHeader
+    {
+        std::uint32_t count;
+        std::uint32_t reserved;
+        std::int64_t base_time;
+        std::int64_t base_transaction;
+        std::int64_t min_time;
+        std::int64_t max_time;
+        std::int64_t reserved2[3];
+    };
+    static_assert(sizeof(BlockHeader) == 64);
+
+    // 块内布局：块头之后依次是time_delta、transaction_delta、product_id、quantity四个int32列和amount_cents一个int64列
+    constexpr std::uint64_t kBlockSize =
+        sizeof(BlockHeader) + kBlockCapacity * (4 * sizeof(std::int32_t) + sizeof(std::int64_t));
+
+    struct LogLine
+    {
+        std::int64_t time;
+        std::int64_t transaction_id;
+        std::int32_t product_id;
+        std::int32_t quantity;
+        std::int64_t amount_cents;
+    };
+
+    // 可读写的共享内存映射文件，带跨进程的建议锁
+    class MappedFile
+    {
+    public:
+        ~MappedFile() { close(); }
+
+        bool open(const std::string& path, std::string& err)
+        {
+            close();
+#ifdef _WIN32
+            m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE)
+            {
+                err = "无法打开销售日志: " + path;
+                return false;
+            }
+#else
+            m_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (m_fd < 0)
+            {
+                err = "无法打开销售日志: " + path + ": " + std::strerror(errno);
+                return false;
+            }
+#endif
+            return remap(err);
+        }
+
+        void close()
+        {
+            unmap();
+#ifdef _WIN32
+            if (m_file != INVALID_HANDLE_VALUE)
+                CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+#else
+            if (m_fd >= 0)
+                ::close(m_fd);
+            m_fd = -1;
+#endif
+        }
+
+        bool isOpen() const
+        {
+#ifdef _WIN32
+            return m_file != INVALID_HANDLE_VALUE;
+#else
+            return m_fd >= 0;
+#endif
+        }
+
+        std::uint64_t fileSize() const
+        {
+#ifdef _WIN32
+            LARGE_INTEGER size;
+            return GetFileSizeEx(m_file, &size) ? static_cast<std::uint64_t>(size.QuadPart) : 0;
+#else
+            struct stat st{};
+            return fstat(m_fd, &st) == 0 ? static_cast<std::uint64_t>(st.st_size) : 0;
+#endif
+        }
+
+        // 扩展文件并重新映射，之前取得的指针全部失效
+        bool resize(const std::uint64_t size, std::string& err)
+        {
+            unmap();
+#ifdef _WIN32
+            LARGE_INTEGER position;
+            position.QuadPart = static_cast<LONGLONG>(size);
+            const bool ok = SetFilePointerEx(m_file, position, nullptr, FILE_BEGIN) && SetEndOfFile(m_file);
+#else
+            const bool ok = ftruncate(m_fd, static_cast<off_t>(size)) == 0;
+#endif
+            if (!ok)
+            {
+                err = "扩展销售日志文件失败";
+                return false;
+            }
+            return remap(err);
+        }
+
+        // 其他进程扩展了文件时重新映射到当前大小
+        bool refresh(std::string& err)
+        {
+            return fileSize() == m_size || remap(err);
+        }
+
+        char* data() const { return m_data; }
+        std::uint64_t size() const { return m_size; }
+
+        // 跨进程锁：写入用独占锁，扫描用共享锁；blocking为false时拿不到锁立即返回false
+        bool lock(const bool exclusive, const bool blocking)
+        {
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            DWORD flags = exclusive ? LOCKFILE_EXCLUSIVE_LOCK : 0;
+            if (!blocking)
+                flags |= LOCKFILE_FAIL_IMMEDIATELY;
+            return LockFileEx(m_file, flags, 0, MAXDWORD, MAXDWORD, &overlapped) != 0;
+#else
+            return flock(m_fd, (exclusive ? LOCK_EX : LOCK_SH) | (blocking ? 0 : LOCK_NB)) == 0;
+#endif
+        }
+
+        void unlock()
+        {
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            UnlockFileEx(m_file, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+            flock(m_fd, LOCK_UN);
+#endif
+        }
+
+    private:
+#ifdef _WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#else
+        int m_fd = -1;
+#endif
+        char* m_data = nullptr;
+        std::uint64_t m_size = 0;
+
+        void unmap()
+        {
+#ifdef _WIN32
+            if (m_data)
+                UnmapViewOfFile(m_data);
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            m_mapping = nullptr;
+#else
+            if (m_data)
+                munmap(m_data, m_size);
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        bool remap(std::string& err)
+        {
+            unmap();
+            const std::uint64_t size = fileSize();
+            if (size == 0)
+                return true;
+#ifdef _WIN32
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+            if (m_mapping)
+                m_data = static_cast<char*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+            if (!m_data)
+            {
+                err = "映射销售日志失败";
+                return false;
+            }
+#else
+            void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+            if (data == MAP_FAILED)
+            {
+                err = std::string("映射销售日志失败: ") + std::strerror(errno);
+                return false;
+            }
+            m_data = static_cast<char*>(data);
+#endif
+            m_size = size;
+            return true;
+        }
+    };
+
+    // 一个块的可写列指针
+    struct BlockColumns
+    {
+        BlockHeader* header;
+        std::int32_t* time_delta;
+        std::int32_t* transaction_delta;
+        std::int32_t* product_id;
+        std::int32_t* quantity;
+        std::int64_t* amount_cents;
+    };
+
+    bool fits_int32(const std::int64_t value)
+    {
+        return value >= INT32_MIN && value <= INT32_MAX;
+    }
+
+    std::int64_t to_cents(const double amount)
+    {
+        return std::llround(amount * 100.0);
+    }
+
+    class SalesLog
+    {
+    public:
+        bool open(const std::string& path, std::string& err)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_open.store(false, std::memory_order_release);
+            if (!m_file.open(path, err))
+                return false;
+            if (!m_file.lock(true, true))
+            {
+                err = "锁定销售日志失败: " + path;
+                m_file.close();
+                return false;
+            }
+            bool ok = true;
+            if (!headerValid())
+            {
+                SLOG_INFO("销售日志 %s 不存在或已损坏，重新生成", path.c_str());
+                ok = reset(err);
+            }
+            // 未打开数据库时只准备文件，等第一次写操作提交后追上
+            if (ok && db)
+                ok = syncLocked(err);
+            m_file.unlock();
+            if (!ok)
+            {
+                m_file.close();
+                return false;
+            }
+            m_open.store(true, std::memory_order_release);
+            return true;
+        }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_open.store(false, std::memory_order_release);
+            m_file.close();
+        }
+
+        bool isOpen() const { return m_open.load(std::memory_order_acquire); }
+
+        bool sync(const bool blocking, std::string& err)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex, std::defer_lock);
+            if (blocking)
+                lock.lock();
+            else if (!lock.try_lock())
+                return true;
+            if (!m_file.isOpen())
+                return true;
+            // 其他线程或进程正在写入或扫描时，提交路径不等待，留给下一次同步追上
+            if (!m_file.lock(true, blocking))
+                return true;
+            const bool ok = m_file.refresh(err) && (headerValid() || reset(err)) && syncLocked(err);
+            m_file.unlock();
+            return ok;
+        }
+
+        bool rebuild(std::string& err)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_file.isOpen())
+            {
+                err = "销售日志未打开";
+                return false;
+            }
+            m_file.lock(true, true);
+            const bool ok = m_file.refresh(err) && reset(err) && syncLocked(err);
+            m_file.unlock();
+            return ok;
+        }
+
+        bool scan(const long long from, const long long to, const std::function<void(const SalesLogBlock&)>& visit)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_file.isOpen())
+                return false;
+
+            // 先追上数据库，再以共享锁扫描，扫描期间其他进程的提交跳过追加
+            std::string err;
+            m_file.lock(true, true);
+            if (!m_file.refresh(err) || !(headerValid() || reset(err)) || !syncLocked(err))
+                SLOG_WARN("扫描前同步销售日志失败: %s", err.c_str());
+            m_file.unlock();
+            m_file.lock(false, true);
+            if (!m_file.refresh(err) || !headerValid())
+            {
+                m_file.unlock();
+                SLOG_ERROR("读取销售日志失败: %s", err.c_str());
+                return false;
+            }
+
+            const FileHeader* file_header = header();
+            for (std::uint64_t i = 0; i < file_header->block_count; ++i)
+            {
+                const BlockColumns columns = block(i);
+                const BlockHeader& block_header = *columns.header;
+                if (block_header.count == 0 || block_header.max_time < from || block_header.min_time >= to)
+                    continue;
+                SalesLogBlock view;
+                view.count = block_header.count;
+                view.base_time = block_header.base_time;
+                view.base_transaction = block_header.base_transaction;
+                view.min_time = block_header.min_time;
+                view.max_time = block_header.max_time;
+                view.time_delta = columns.time_delta;
+                view.transaction_delta = columns.transaction_delta;
+                view.product_id = columns.product_id;
+                view.quantity = columns.quantity;
+                view.amount_cents = columns.amount_cents;
+                visit(view);
+            }
+            m_file.unlock();
+            return true;
+        }
+
+    private:
+        std::mutex m_mutex;
+        MappedFile m_file;
+        std::atomic<bool> m_open{false};
+
+        FileHeader* header() const { return reinterpret_cast<FileHeader*>(m_file.data()); }
+
+        BlockColumns block(const std::uint64_t index) const
+        {
+            char* base = m_file.data() + sizeof(FileHeader) + index * kBlockSize;
+            BlockColumns columns;
+            columns.header = reinterpret_cast<BlockHeader*>(base);
+            char* column = base + sizeof(BlockHeader);
+            columns.time_delta = reinterpret_cast<std::int32_t*>(column);
+            columns.transaction_delta = columns.time_delta + kBlockCapacity;
+            columns.product_id = columns.transaction_delta + kBlockCapacity;
+            columns.quantity = columns.product_id + kBlockCapacity;
+            columns.amount_cents = reinterpret_cast<std::int64_t*>(columns.quantity + kBlockCapacity);
+            return columns;
+        }
+
+        std::uint64_t blocksMapped() const
+        {
+            return m_file.size() < sizeof(FileHeader) ? 0 : (m_file.size() - sizeof(FileHeader)) / kBlockSize;
+        }
+
+        // 文件头与各块行数一致；中途退出留下的不一致由调用方重建
+        bool headerValid() const
+        {
+            if (m_file.size() < sizeof(FileHeader))
+                return false;
+            const FileHeader* file_header = header();
+            if (std::memcmp(file_header->magic, kMagic, sizeof(kMagic)) != 0 || file_header->version != kVersion ||
+                file_header->block_capacity != kBlockCapacity || file_header->block_count > blocksMapped())
+                return false;
+            std::uint64_t lines = 0;
+            for (std::uint64_t i = 0; i < file_header->block_count; ++i)
+                lines += block(i).header->count;
+            if (file_header->block_count < blocksMapped() && block(file_header->block_count).header->count != 0)
+                return false;
+            return lines == file_header->line_count;
+        }
+
+        bool reset(std::string& err)
+        {
+            if (blocksMapped() < kGrowBlocks && !m_file.resize(sizeof(FileHeader) + kGrowBlocks * kBlockSize, err))
+                return false;
+            FileHeader* file_header = header();
+            std::memset(file_header, 0, sizeof(FileHeader));
+            std::memcpy(file_header->magic, kMagic, sizeof(kMagic));
+            file_header->version = kVersion;
+            file_header->block_capacity = kBlockCapacity;
+            std::memset(block(0).header, 0, sizeof(BlockHeader));
+            return true;
+        }
+
+        // 追加一行；当前块已满或增量超出int32范围时另起一块
+        bool append(const LogLine& line, std::uint64_t& block_count, std::string& err)
+        {
+            if (block_count > 0)
+            {
+                const BlockColumns columns = block(block_count - 1);
+                BlockHeader& block_header = *columns.header;
+                const std::int64_t time_delta = line.time - block_header.base_time;
+                const std::int64_t transaction_delta = line.transaction_id - block_header.base_transaction;
+                if (block_header.count < kBlockCapacity && fits_int32(time_delta) && fits_int32(transaction_delta))
+                {
+                    const std::uint32_t row = block_header.count;
+                    columns.time_delta[row] = static_cast<std::int32_t>(time_delta);
+                    columns.transaction_delta[row] = static_cast<std::int32_t>(transaction_delta);
+                    columns.product_id[row] = line.product_id;
+                    columns.quantity[row] = line.quantity;
+                    columns.amount_cents[row] = line.amount_cents;
+                    block_header.min_time = std::min(block_header.min_time, line.time);
+                    block_header.max_time = std::max(block_header.max_time, line.time);
+                    block_header.count = row + 1;
+                    return true;
+                }
+            }
+
+            if (block_count >= blocksMapped() &&
+                !m_file.resize(sizeof(FileHeader) + (block_count + kGrowBlocks) * kBlockSize, err))
+                return false;
+            BlockHeader& block_header = *block(block_count).header;
+            std::memset(&block_header, 0, sizeof(BlockHeader));
+            block_header.base_time = line.time;
+            block_header.base_transaction = line.transaction_id;
+            block_header.min_time = line.time;
+            block_header.max_time = line.time;
+            ++block_count;
+            return append(line, block_count, err);
+        }
+
+        // 持有独占锁时调用：按水位读取新的购物车项和退货记录并追加
+        bool syncLocked(std::string& err)
+        {
+            if (!db)
+            {
+                err = "当前线程没有打开数据库";
+                return false;
+            }
+
+            // 数据库被替换（序列号小于水位）时日志作废，从头生成
+            {
+                const CachedStatement stmt(
+                    "SELECT IFNULL((SELECT seq FROM sqlite_sequence WHERE name = 'cart_items'), 0), "
+                    "       IFNULL((SELECT seq FROM sqlite_sequence WHERE name = 'returns'), 0);");
+                if (stmt && sqlite3_step(stmt.get()) == SQLITE_ROW &&
+                    (sqlite3_column_int64(stmt.get(), 0) < header()->last_item_id ||
+                     sqlite3_column_int64(stmt.get(), 1) < header()->last_return_id))
+                {
+                    SLOG_WARN("销售日志与数据库不一致，重新生成");
+                    if (!reset(err))
+                        return false;
+                }
+            }
+
+            std::uint64_t block_count = header()->block_count;
+            std::uint64_t lines = 0;
+            std::int64_t last_item_id = header()->last_item_id;
+            std::int64_t last_return_id = header()->last_return_id;
+
+            // 退货金额取退货时按各购物车行实付单价分摊的金额，重建时结果不随商品调价变化；
+            // 早期版本没有记录金额的退货按该商品各行的平均实付单价估算
+            const char* const sql[] = {
+                "SELECT c.item_id, t.create_time, c.transaction_id, c.product_id, c.quantity, c.subtotal "
+                "FROM cart_items c JOIN transactions t ON t.transaction_id = c.transaction_id "
+                "WHERE c.item_id > ?1 ORDER BY c.item_id;",
+                "SELECT r.return_id, r.return_time, r.transaction_id, r.product_id, -r.quantity, "
+                "       -IFNULL(r.amount, r.quantity * IFNULL((SELECT SUM(c.subtotal) / SUM(c.quantity) FROM cart_items c "
+                "                                              WHERE c.transaction_id = r.transaction_id "
+                "                                                AND c.product_id = r.product_id), 0)) "
+                "FROM returns r WHERE r.return_id > ?1 ORDER BY r.return_id;",
+            };
+            std::int64_t* watermarks[] = {&last_item_id, &last_return_id};
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                const CachedStatement stmt(sql[pass]);
+                if (!stmt)
+                {
+                    err = std::string("读取销售明细失败: ") + sqlite3_errmsg(db);
+                    return false;
+                }
+                sqlite3_bind_int64(stmt.get(), 1, *watermarks[pass]);
+                int rc;
+                while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+                {
+                    LogLine line;
+                    line.time = sqlite3_column_int64(stmt.get(), 1);
+                    line.transaction_id = sqlite3_column_int64(stmt.get(), 2);
+                    line.product_id = sqlite3_column_int(stmt.get(), 3);
+                    line.quantity = sqlite3_column_int(stmt.get(), 4);
+                    line.amount_cents = to_cents(sqlite3_column_double(stmt.get(), 5));
+                    if (!append(line, block_count, err))
+                        return false;
+                    *watermarks[pass] = sqlite3_column_int64(stmt.get(), 0);
+                    ++lines;
+                }
+                if (rc != SQLITE_DONE)
+                {
+                    err = std::string("读取销售明细失败: ") + sqlite3_errmsg(db);
+                    return false;
+                }
+            }
+
+            // append已就地增加各块的行数，文件头的总行数最后写入，作为本次追加的提交点：
+            // 进程在此之前退出时各块行数之和与总行数不符，headerValid检出后从头重建，不会重复计入
+            FileHeader* file_header = header();
+            file_header->last_item_id = last_item_id;
+            file_header->last_return_id = last_return_id;
+            file_header->block_count = block_count;
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+            file_header->line_count += lines;
+            if (lines > 0)
+                SLOG_DEBUG("销售日志追加 %llu 行", static_cast<unsigned long long>(lines));
+            return true;
+        }
+    };
+
+    SalesLog& sales_log()
+    {
+        static SalesLog instance;
+        return instance;
+    }
+
+    void fail(std::string* errorMsg, const std::string& err)
+    {
+        SLOG_ERROR("%s", err.c_str());
+        if (errorMsg) *errorMsg = err;
+    }
+
+    // 对区间内的每一行调用visit(块, 行号)；块完全落在区间内时省去逐行的时间比较
+    template <typename Visit>
+    bool for_each_line(const long long from, const long long to, Visit visit)
+    {
+        return sales_log().scan(from, to, [&](const SalesLogBlock& block)
+        {
+            if (block.min_time >= from && block.max_time < to)
+            {
+                for (std::uint32_t i = 0; i < block.count; ++i)
+                    visit(block, i);
+                return;
+            }
+            for (std::uint32_t i = 0; i < block.count; ++i)
+            {
+                const std::int64_t time = block.base_time + block.time_delta[i];
+                if (time >= from && time < to)
+                    visit(block, i);
+            }
+        });
+    }
+}
+
+void try_sync_sales_log()
+{
+    if (!sales_log().isOpen())
+        return;
+    std::string err;
+    if (!sales_log().sync(false, err))
+        SLOG_WARN("追加销售日志失败: %s", err.c_str());
+}
+
+bool open_sales_log(const std::string& path, std::string* errorMsg)
+{
+    QueryCall call("open_sales_log");
+    std::string err;
+    if (!sales_log().open(path, err))
+    {
+        fail(errorMsg, err);
+        return false;
+    }
+    return true;
+}
+
+void close_sales_log()
+{
+    sales_log().close();
+}
+
+bool sync_sales_log(std::string* errorMsg)
+{
+    QueryCall call("sync_sales_log");
+    if (!sales_log().isOpen())
+        return true;
+    std::string err;
+    if (!sales_log().sync(true, err))
+    {
+        fail(errorMsg, err);
+        return false;
+    }
+    return true;
+}
+
+bool rebuild_sales_log(std::string* errorMsg)
+{
+    QueryCall call("rebuild_sales_log");
+    std::string err;
+    if (!sales_log().rebuild(err))
+    {
+        fail(errorMsg, err);
+        return false;
+    }
+    SLOG_INFO("销售日志已从数据库重建");
+    return true;
+}
+
+bool scan_sales_log(const long long from, const long long to, const std::function<void(const SalesLogBlock&)>& visit)
+{
+    return sales_log().scan(from, to, visit);
+}
+
+SalesLogSummary summarize_sales_log(const long long from, const long long to)
+{
+    QueryCall call("summarize_sales_log");
+    std::int64_t gross_cents = 0;
+    std::int64_t refund_cents = 0;
+    SalesLogSummary summary{};
+    for_each_line(from, to, [&](const SalesLogBlock& block, const std::uint32_t i)
+    {
+        const std::int32_t quantity = block.quantity[i];
+        ++summary.lines;
+        if (quantity >= 0)
+        {
+            summary.quantity_sold += quantity;
+            gross_cents += block.amount_cents[i];
+        }
+        else
+        {
+            summary.quantity_returned -= quantity;
+            refund_cents -= block.amount_cents[i];
+        }
+    });
+    summary.gross = static_cast<double>(gross_cents) / 100.0;
+    summary.refunds = static_cast<double>(refund_cents) / 100.0;
+    summary.net = static_cast<double>(gross_cents - refund_cents) / 100.0;
+    call.rows(1);
+    return summary;
+}
+
+std::vector<ProductSales> get_sales_log_products(const long long from, const long long to)
+{
+    QueryCall call("get_sales_log_products");
+    struct Totals
+    {
+        long long quantity = 0;
+        long long returned = 0;
+        std::int64_t revenue_cents = 0;
+    };
+    std::unordered_map<std::int32_t, Totals> totals;
+    for_each_line(from, to, [&](const SalesLogBlock& block, const std::uint32_t i)
+    {
+        Totals& product = totals[block.product_id[i]];
+        const std::int32_t quantity = block.quantity[i];
+        if (quantity >= 0)
+        {
+            product.quantity += quantity;
+            product.revenue_cents += block.amount_cents[i];
+        }
+        else
+            product.returned -= quantity;
+    });
+
+    std::vector<ProductSales> result;
+    result.reserve(totals.size());
+    for (const auto& [product_id, product] : totals)
+    {
+        result.push_back({product_id, "", static_cast<int>(product.quantity), static_cast<int>(product.returned),
+                          static_cast<double>(product.revenue_cents) / 100.0});
+    }
+    std::sort(result.begin(), result.end(), [](const ProductSales& a, const ProductSales& b)
+    {
+        return a.revenue != b.revenue ? a.revenue > b.revenue : a.product_id < b.product_id;
+    });
+    call.rows(result.size());
+    return result;
+}
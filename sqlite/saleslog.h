@@ -0,0 +1,43 @@
+#ifndef SALESLOG_H
+#define SALESLOG_H
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "saleStruct.h"
+
+// 列式销售日志：每个售出的购物车行和每条退货记录各占一行（退货的数量和金额为负），
+// 按块存放，块内各列定宽并相对块首行做增量编码，通过内存映射读取，扫描时不经过SQLite。
+// 日志是数据库的派生数据：按购物车项ID和退货ID的水位增量追加，随时可以从数据库重建。
+// 重建只能恢复主库中仍有的交易，已归档交易的行只保留在未重建的日志里
+
+// 一个块的列视图，指针指向映射内存，只在scan_sales_log的回调内有效
+struct SalesLogBlock
+{
+    std::uint32_t count = 0;                        // 行数
+    std::int64_t base_time = 0;                     // 首行时间，time_delta相对它
+    std::int64_t base_transaction = 0;              // 首行交易ID，transaction_delta相对它
+    std::int64_t min_time = 0;                      // 块内最早时间
+    std::int64_t max_time = 0;                      // 块内最晚时间
+    const std::int32_t* time_delta = nullptr;
+    const std::int32_t* transaction_delta = nullptr;
+    const std::int32_t* product_id = nullptr;
+    const std::int32_t* quantity = nullptr;         // 退货行为负数
+    const std::int64_t* amount_cents = nullptr;     // 金额，单位分，退货行为负数
+};
+
+// 打开或创建日志文件并追上数据库，之后写操作提交时自动追加；重复调用会先关闭之前的日志
+bool open_sales_log(const std::string& path, std::string* errorMsg = nullptr);
+void close_sales_log();
+// 把当前线程连接上尚未写入日志的购物车项和退货记录追加到日志，日志未打开时直接返回true
+bool sync_sales_log(std::string* errorMsg = nullptr);
+// 清空日志并从数据库重新生成
+bool rebuild_sales_log(std::string* errorMsg = nullptr);
+// 依次访问时间范围与[from, to)有交集的块，块内的行仍需调用方按时间过滤
+bool scan_sales_log(long long from, long long to, const std::function<void(const SalesLogBlock&)>& visit);
+// 区间内的销售与退货合计
+SalesLogSummary summarize_sales_log(long long from, long long to);
+// 区间内按商品汇总，按销售额降序；名称不在日志中，留空
+std::vector<ProductSales> get_sales_log_products(long long from, long long to);
+
+#endif // SALESLOG_H
@@ -0,0 +1,198 @@
+#include "startup.h"
+#include "database.h"
+#include "db_internal.h"
+#include "detailcache.h"
+#include "log.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // 启动时预取的最近交易笔数，与明细缓存默认容量相比留出余量
+    constexpr int kWarmupRecentTransactions = 16;
+
+    using Clock = std::chrono::steady_clock;
+
+    class Startup
+    {
+    public:
+        ~Startup()
+        {
+            if (m_worker.joinable())
+                m_worker.join();
+        }
+
+        void markBootStart()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_start = Clock::now();
+            m_timings = BootTimings{};
+        }
+
+        void startWarmup(const std::string& path)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_worker.joinable())
+            {
+                if (m_timings.warmup_done_ms < 0)
+                    return;
+                // 上一次预热已结束，线程只剩退出
+                m_worker.join();
+                m_timings.warmup_done_ms = -1;
+            }
+            m_timings.db_ready_ms = elapsedLocked();
+            m_worker = std::thread(&Startup::warmup, this, path);
+        }
+
+        bool waitWarmup(const int timeout_ms)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            const auto done = [this] { return !m_worker.joinable() || m_timings.warmup_done_ms >= 0; };
+            if (timeout_ms < 0)
+            {
+                m_cv.wait(lock, done);
+                return true;
+            }
+            return m_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), done);
+        }
+
+        void markUiReady()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_timings.ui_ready_ms < 0)
+                m_timings.ui_ready_ms = elapsedLocked();
+            checkScanReadyLocked();
+        }
+
+        void setTarget(const int target_ms)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_targetMs = target_ms;
+        }
+
+        BootTimings timings()
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            BootTimings result = m_timings;
+            result.target_ms = m_targetMs;
+            return result;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::thread m_worker;
+        Clock::time_point m_start = Clock::now();
+        BootTimings m_timings;
+        int m_targetMs = 1000;
+
+        double elapsedLocked() const
+        {
+            return std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+        }
+
+        void checkScanReadyLocked()
+        {
+            if (m_timings.scan_ready_ms >= 0 || m_timings.ui_ready_ms < 0 || m_timings.warmup_done_ms < 0)
+                return;
+            m_timings.scan_ready_ms = elapsedLocked();
+            if (m_timings.scan_ready_ms > m_targetMs)
+            {
+                SLOG_WARN("启动到可扫码耗时 %.0f ms，超过目标 %d ms（数据库 %.0f ms，界面 %.0f ms，预热 %.0f ms）",
+                          m_timings.scan_ready_ms, m_targetMs, m_timings.db_ready_ms, m_timings.ui_ready_ms,
+                          m_timings.warmup_done_ms);
+            }
+            else
+            {
+                SLOG_INFO("启动到可扫码耗时 %.0f ms（数据库 %.0f ms，界面 %.0f ms，预热 %.0f ms）",
+                          m_timings.scan_ready_ms, m_timings.db_ready_ms, m_timings.ui_ready_ms,
+                          m_timings.warmup_done_ms);
+            }
+        }
+
+        // 预热线程的连接只在本线程使用，和其他线程一样通过thread_local的db访问数据层
+        void warmup(const std::string& path)
+        {
+            if (path.empty())
+            {
+                // 没有可供其他连接打开的数据库文件，直接视为预热完成
+            }
+            else if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
+            {
+                SLOG_ERROR("预热连接打开失败: %s", sqlite3_errmsg(db));
+                sqlite3_close(db);
+                db = nullptr;
+            }
+            else
+            {
+                sqlite3_busy_timeout(db, 200);
+                install_query_tracing(db);
+
+                // 顺序读一遍商品表，把扫码查询要访问的页面读进操作系统缓存
+                const size_t products = get_all_products().size();
+
+                std::vector<int> recent;
+                sqlite3_stmt* stmt = nullptr;
+                if (sqlite3_prepare_v2(db, "SELECT transaction_id FROM transactions ORDER BY transaction_id DESC LIMIT ?;",
+                                       -1, &stmt, nullptr) == SQLITE_OK)
+                {
+                    sqlite3_bind_int(stmt, 1, kWarmupRecentTransactions);
+                    while (sqlite3_step(stmt) == SQLITE_ROW)
+                        recent.push_back(sqlite3_column_int(stmt, 0));
+                }
+                sqlite3_finalize(stmt);
+                // 明细由缓存自己的预取线程加载，不等待其完成
+                prefetch_transaction_details(recent);
+                close_db();
+                SLOG_DEBUG("启动预热完成：商品 %zu 种，预取交易 %zu 笔", products, recent.size());
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_timings.warmup_done_ms = elapsedLocked();
+            checkScanReadyLocked();
+            m_cv.notify_all();
+        }
+    };
+
+    Startup& startup()
+    {
+        static Startup instance;
+        return instance;
+    }
+}
+
+void mark_boot_start()
+{
+    startup().markBootStart();
+}
+
+void start_startup_warmup()
+{
+    const char* path = sqlite3_db_filename(db, "main");
+    // 内存数据库没有文件名，其他连接无法访问
+    startup().startWarmup(path ? path : "");
+}
+
+bool wait_startup_warmup(const int timeout_ms)
+{
+    return startup().waitWarmup(timeout_ms);
+}
+
+void mark_ui_ready()
+{
+    startup().markUiReady();
+}
+
+void set_boot_target_ms(const int target_ms)
+{
+    startup().setTarget(target_ms);
+}
+
+BootTimings get_boot_timings()
+{
+    return startup().timings();
+}
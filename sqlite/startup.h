@@ -0,0 +1,31 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+// 收银端启动：后台预热与“开机到可扫码”计时。
+// 顺序为mark_boot_start -> init_db -> start_startup_warmup -> 显示主窗口 -> mark_ui_ready，
+// 界面显示与预热完成两者都到达时视为可以扫码收银
+
+// 启动各阶段耗时（毫秒，从mark_boot_start起算），尚未到达的阶段为-1
+struct BootTimings
+{
+    double db_ready_ms = -1;      // init_db完成，预热开始
+    double ui_ready_ms = -1;      // 主窗口首次显示
+    double warmup_done_ms = -1;   // 后台预热完成
+    double scan_ready_ms = -1;    // 可以扫码收银
+    double target_ms = 0;         // 可扫码耗时目标
+};
+
+// 记录启动起点，在main入口处调用
+void mark_boot_start();
+// 在后台线程用独立只读连接读取商品目录、预取最近交易明细，让首次扫码和翻看小票不必冷读磁盘。
+// 在当前线程init_db成功后调用，预热进行中时重复调用被忽略
+void start_startup_warmup();
+// 等待预热完成，超时返回false；timeout_ms小于0时一直等待
+bool wait_startup_warmup(int timeout_ms = -1);
+// 主窗口首次显示后调用
+void mark_ui_ready();
+// 设置可扫码耗时目标（毫秒），超过时写警告日志，默认1000
+void set_boot_target_ms(int target_ms);
+BootTimings get_boot_timings();
+
+#endif // STARTUP_H
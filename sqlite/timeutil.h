@@ -0,0 +1,26 @@
+#ifndef TIMEUTIL_H
+#define TIMEUTIL_H
+#include <ctime>
+
+// 可重入的时间转换：结果写入调用方的tm，多个线程可以同时调用。
+// MSVC没有localtime_r/gmtime_r，改用参数顺序相反的localtime_s/gmtime_s
+
+inline bool local_time(const std::time_t seconds, std::tm& out)
+{
+#ifdef _WIN32
+    return localtime_s(&out, &seconds) == 0;
+#else
+    return localtime_r(&seconds, &out) != nullptr;
+#endif
+}
+
+inline bool utc_time(const std::time_t seconds, std::tm& out)
+{
+#ifdef _WIN32
+    return gmtime_s(&out, &seconds) == 0;
+#else
+    return gmtime_r(&seconds, &out) != nullptr;
+#endif
+}
+
+#endif // TIMEUTIL_H